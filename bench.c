@@ -0,0 +1,836 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		bench.c
+ *
+ * @brief 		Load generator and latency benchmark for cse
+ *
+ * @details 	Opens one or more MCTP/TCP sessions to a running cse and
+ * 				replays a weighted mix of FM API requests for a fixed time.
+ * 				Session N connects to TCP port base + N, so cse must be
+ * 				started with at least as many connections (-n). With -U all
+ * 				sessions connect to the local AF_UNIX socket of cse instead,
+ * 				to compare against the TCP loopback path. Each session
+ * 				keeps one request outstanding and records the round trip
+ * 				time of every response in a log-linear histogram. At the end
+ * 				the requests completed per second and the p50, p99 and p999
+ * 				latency of each opcode are printed.
+ *
+ * 				Build with: make bench
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ */
+/* INCLUDES ==================================================================*/
+
+/* printf()
+ */
+#include <stdio.h>
+
+/* memset()
+ * strtok_r()
+ * strcmp()
+ */
+#include <string.h>
+
+/* calloc()
+ * free()
+ * strtoul()
+ * rand_r()
+ */
+#include <stdlib.h>
+
+/* inet_pton()
+ */
+#include <arpa/inet.h>
+
+/* close()
+ */
+#include <unistd.h>
+
+/* socket()
+ * connect()
+ * sendmsg()
+ * recv()
+ */
+#include <sys/socket.h>
+
+/* struct sockaddr_un
+ */
+#include <sys/un.h>
+
+/* struct argp
+ * argp_parse()
+ */
+#include <argp.h>
+
+/* clock_gettime()
+ */
+#include <time.h>
+
+/* pthread_create()
+ * pthread_cond_wait()
+ */
+#include <pthread.h>
+
+/* __u8
+ * __u64
+ */
+#include <linux/types.h>
+
+/* mctp_init()
+ * mctp_run()
+ * mctp_submit()
+ * mctp_retire()
+ */
+#include <mctp.h>
+
+#include <fmapi.h>
+
+/* struct hist
+ * metrics_hist_add()
+ * metrics_hist_pct()
+ */
+#include "metrics.h"
+
+/* struct local_hdr
+ */
+#include "local.h"
+
+/* MACROS ====================================================================*/
+
+#define BELN_SESSIONS 		16 		//!< Max number of sessions
+#define BELN_MIX 			256 	//!< Max length of the command mix string
+#define BELN_MPC_MEM 		4096 	//!< Length of an MPC Memory transaction
+#define BELN_MPC_MEM_HDR 	0x10 	//!< Offset of Transaction Data in an MPC Memory request
+#define BELN_RANGE 			(1 << 20) 	//!< Default LD range MPC Memory requests are spread over
+#define BELN_DURATION 		10 		//!< Default run time in seconds
+#define BELN_TIMEOUT 		5 		//!< Seconds to wait for a response before a session gives up
+#define BELN_PORT 			2508 	//!< Default TCP port of the first session
+
+#define BE_NS 				1000000000ULL
+
+/* ENUMERATIONS ==============================================================*/
+
+/**
+ * Benchmark operations (OP)
+ */
+enum _BEOP
+{
+	BEOP_PSC_PORT 	= 0,	//!< Get Physical Port State of one port
+	BEOP_VSC_BIND 	= 1,	//!< Bind a vPPB, alternates with BEOP_VSC_UNBIND
+	BEOP_VSC_UNBIND = 2,	//!< Unbind the vPPB bound by BEOP_VSC_BIND
+	BEOP_MEM_READ 	= 3,	//!< MPC LD CXL.io Memory read of BELN_MPC_MEM bytes
+	BEOP_MEM_WRITE 	= 4,	//!< MPC LD CXL.io Memory write of BELN_MPC_MEM bytes
+	BEOP_MPC_TMC 	= 5,	//!< MPC Tunnel of an MCC Get QoS Status
+	BEOP_MAX
+};
+
+/* STRUCTS ===================================================================*/
+
+/**
+ * Results of one operation
+ */
+struct bestats
+{
+	__u64 count; 			//!< Responses received
+	__u64 errors; 			//!< Responses with a return code other than Success or Background Operation Started
+	__u64 failed; 			//!< Requests the MCTP library could not complete
+	struct hist lat; 		//!< Round trip time (ns)
+};
+
+/**
+ * One MCTP session and its load generator thread
+ */
+struct session
+{
+	unsigned id;
+	struct mctp *m;
+	int fd; 				//!< Local socket, -1 for an MCTP/TCP session
+	pthread_t thread;
+
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;
+	int done; 				//!< Set by the MCTP callbacks when the outstanding request finished
+	int failed;
+	unsigned rc; 			//!< FM API return code of the response
+	struct timespec end; 	//!< Time the response arrived
+
+	unsigned seed;
+	int bound; 				//!< 1 if the next bind churn request is an unbind
+	__u8 tag;
+
+	struct bestats stats[BEOP_MAX];
+};
+
+/**
+ * Benchmark configuration
+ */
+struct beconf
+{
+	__u32 address;
+	__u16 port;
+	char *path; 				//!< Local socket of cse, NULL to use TCP
+	unsigned sessions;
+	unsigned duration;
+	unsigned weight[BEOP_MAX]; 	//!< Relative frequency of each operation
+	__u8 ppid; 					//!< Port used by every operation
+	__u16 ldid;
+	__u8 vcsid;
+	__u8 vppbid;
+	__u64 range; 				//!< Bytes of the LD MPC Memory requests are spread over
+};
+
+/* PROTOTYPES ================================================================*/
+
+static int pr_bench(int key, char *arg, struct argp_state *state);
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/**
+ * Names of the operations in the command mix and the report
+ */
+static char *STR_BEOP[] = {
+	"psc_port",
+	"bind",
+	"unbind",
+	"mem_read",
+	"mem_write",
+	"tmc"
+};
+
+/**
+ * FM API opcode sent by each operation
+ */
+static unsigned BEOP_OPCODE[] = {
+	FMOP_PSC_PORT,
+	FMOP_VSC_BIND,
+	FMOP_VSC_UNBIND,
+	FMOP_MPC_MEM,
+	FMOP_MPC_MEM,
+	FMOP_MPC_TMC
+};
+
+static struct beconf conf;
+
+static struct argp_option ao_bench[] =
+{
+	{"tcp-address", 	'T', "ADDR", 0, "Address of cse (default 127.0.0.1)", 0},
+	{"tcp-port", 		'P', "INT", 0, "TCP port of the first session (default 2508)", 0},
+	{"sessions", 		'n', "INT", 0, "Number of sessions, session N uses TCP port + N (default 1)", 0},
+	{"unix-socket", 	'U', "PATH", 0, "Connect all sessions to this local socket of cse instead of TCP", 0},
+	{"duration", 		'd', "SEC", 0, "Run time in seconds (default 10)", 0},
+	{"mix", 			'm', "MIX", 0, "Command mix, e.g. psc_port=50,bind=10,mem_read=20,mem_write=20,tmc=0", 0},
+	{"ppid", 			'p', "INT", 0, "Physical port used by all operations (default 1)", 0},
+	{"ldid", 			'l', "INT", 0, "LD used by bind and MPC operations (default 0)", 0},
+	{"vcsid", 			'c', "INT", 0, "VCS used by bind churn (default 0)", 0},
+	{"vppbid", 			'b', "INT", 0, "vPPB used by bind churn (default 1)", 0},
+	{"range", 			'r', "BYTES", 0, "LD range MPC Memory requests are spread over (default 1 MiB)", 0},
+	{0,0,0,0,0,0}
+};
+
+static struct argp argp_bench = { ao_bench, pr_bench, NULL, "Load generator and latency benchmark for cse", NULL, NULL, NULL };
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Parse a command mix of NAME=WEIGHT pairs
+ *
+ * @return 	0 upon success. Non zero otherwise
+ */
+static int bench_parse_mix(char *arg)
+{
+	char buf[BELN_MIX], *tok, *save, *val;
+	unsigned i;
+
+	strncpy(buf, arg, sizeof(buf) - 1);
+	buf[sizeof(buf) - 1] = 0;
+	memset(conf.weight, 0, sizeof(conf.weight));
+
+	for ( tok = strtok_r(buf, ",", &save) ; tok != NULL ; tok = strtok_r(NULL, ",", &save) )
+	{
+		val = strchr(tok, '=');
+		if (val == NULL)
+			return 1;
+		*val++ = 0;
+
+		for ( i = 0 ; i < BEOP_MAX ; i++ )
+			if (!strcmp(tok, STR_BEOP[i]))
+				break;
+
+		// Unbinds are issued by the bind churn and have no weight of their own
+		if (i == BEOP_MAX || i == BEOP_VSC_UNBIND)
+			return 1;
+
+		conf.weight[i] = strtoul(val, NULL, 0);
+	}
+
+	return 0;
+}
+
+/**
+ * Handle each option based on the key
+ */
+static int pr_bench(int key, char *arg, struct argp_state *state)
+{
+	switch (key)
+	{
+		case 'T':
+			if (inet_pton(AF_INET, arg, &conf.address) != 1)
+				argp_failure(state, 1, 0, "invalid TCP address: %s", arg);
+			break;
+
+		case 'P': conf.port 	= strtoul(arg, NULL, 0); break;
+		case 'n': conf.sessions = strtoul(arg, NULL, 0); break;
+		case 'U': conf.path 	= arg; break;
+		case 'd': conf.duration = strtoul(arg, NULL, 0); break;
+		case 'p': conf.ppid 	= strtoul(arg, NULL, 0); break;
+		case 'l': conf.ldid 	= strtoul(arg, NULL, 0); break;
+		case 'c': conf.vcsid 	= strtoul(arg, NULL, 0); break;
+		case 'b': conf.vppbid 	= strtoul(arg, NULL, 0); break;
+		case 'r': conf.range 	= strtoull(arg, NULL, 0); break;
+
+		case 'm':
+			if (bench_parse_mix(arg) != 0)
+				argp_failure(state, 1, 0, "invalid command mix: %s", arg);
+			break;
+
+		case ARGP_KEY_ARG:
+			argp_failure(state, 1, 0, "too many arguments");
+			break;
+
+		case ARGP_KEY_END:
+			if (conf.sessions == 0 || conf.sessions > BELN_SESSIONS)
+				argp_failure(state, 1, 0, "sessions must be 1 to %d", BELN_SESSIONS);
+			if (conf.range < BELN_MPC_MEM)
+				argp_failure(state, 1, 0, "range must be at least %d bytes", BELN_MPC_MEM);
+			break;
+
+		default:
+			return ARGP_ERR_UNKNOWN;
+	}
+
+	return 0;
+}
+
+/**
+ * Return a time in nanoseconds
+ */
+static __u64 bench_ns(struct timespec *ts)
+{
+	return ts->tv_sec * BE_NS + ts->tv_nsec;
+}
+
+/**
+ * Return the number of nanoseconds from a to b
+ */
+static __u64 bench_elapsed(struct timespec *a, struct timespec *b)
+{
+	return bench_ns(b) - bench_ns(a);
+}
+
+/**
+ * MCTP callback when the response to a request arrived
+ */
+static void bench_completed(struct mctp *m, struct mctp_action *ma)
+{
+	struct session *s;
+	struct fmapi_hdr hdr;
+
+	(void) m;
+	s = (struct session*) ma->user_data;
+
+	memset(&hdr, 0, sizeof(hdr));
+	if (ma->rsp != NULL)
+		fmapi_deserialize(&hdr, ((struct fmapi_buf*) ma->rsp->payload)->hdr, FMOB_HDR, NULL);
+
+	pthread_mutex_lock(&s->mtx);
+	clock_gettime(CLOCK_MONOTONIC, &s->end);
+	s->rc = hdr.return_code;
+	s->failed = (ma->rsp == NULL);
+	s->done = 1;
+	pthread_cond_signal(&s->cond);
+	pthread_mutex_unlock(&s->mtx);
+}
+
+/**
+ * MCTP callback when a request could not be completed
+ */
+static void bench_failed(struct mctp *m, struct mctp_action *ma)
+{
+	struct session *s;
+
+	(void) m;
+	s = (struct session*) ma->user_data;
+
+	pthread_mutex_lock(&s->mtx);
+	clock_gettime(CLOCK_MONOTONIC, &s->end);
+	s->failed = 1;
+	s->done = 1;
+	pthread_cond_signal(&s->cond);
+	pthread_mutex_unlock(&s->mtx);
+}
+
+/**
+ * Connect to the local socket of cse
+ *
+ * @return 	Socket file descriptor or -1 upon failure
+ */
+static int bench_connect(char *path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return -1;
+
+	fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+	if (fd < 0)
+		return -1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/**
+ * Send a request on the local socket and wait for its response
+ *
+ * Fills in the same session fields as the MCTP callbacks
+ *
+ * @return 	0 upon success. Non zero if the connection failed
+ */
+static int bench_local(struct session *s, struct fmapi_buf *b, int len)
+{
+	struct local_hdr hdr;
+	struct fmapi_hdr rsp;
+	struct iovec iov[2];
+	struct msghdr msg;
+	__u8 buf[LOLN_PACKET];
+	ssize_t n;
+
+	hdr.type 	= MCMT_CXLFMAPI;
+	hdr.tag 	= s->tag;
+	hdr.dst 	= 0;
+	hdr.src 	= 0;
+
+	iov[0].iov_base = &hdr;
+	iov[0].iov_len 	= LOLN_HDR;
+	iov[1].iov_base = b;
+	iov[1].iov_len 	= len;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov 	= iov;
+	msg.msg_iovlen 	= 2;
+
+	if (sendmsg(s->fd, &msg, MSG_NOSIGNAL) < 0)
+		return 1;
+
+	n = recv(s->fd, buf, sizeof(buf), 0);
+	clock_gettime(CLOCK_MONOTONIC, &s->end);
+	if (n <= 0)
+		return 1;
+
+	memset(&rsp, 0, sizeof(rsp));
+	if (n >= LOLN_HDR + FMLN_HDR)
+		fmapi_deserialize(&rsp, ((struct fmapi_buf*) &buf[LOLN_HDR])->hdr, FMOB_HDR, NULL);
+
+	s->rc = rsp.return_code;
+	s->failed = (n < LOLN_HDR + FMLN_HDR);
+	s->done = 1;
+
+	return 0;
+}
+
+/**
+ * Pick the next operation from the command mix
+ */
+static unsigned bench_pick(struct session *s)
+{
+	unsigned i, total, r;
+
+	for ( i = 0, total = 0 ; i < BEOP_MAX ; i++ )
+		total += conf.weight[i];
+
+	r = rand_r(&s->seed) % total;
+	for ( i = 0 ; i < BEOP_MAX - 1 ; i++ )
+	{
+		if (r < conf.weight[i])
+			break;
+		r -= conf.weight[i];
+	}
+
+	if (i == BEOP_VSC_BIND && s->bound)
+		i = BEOP_VSC_UNBIND;
+
+	return i;
+}
+
+/**
+ * Serialize the request of an operation
+ *
+ * @return 	Length of the FM API message including the header
+ */
+static int bench_build(struct session *s, unsigned op, struct fmapi_buf *b)
+{
+	struct fmapi_hdr hdr, sub;
+	union fmapi_obj obj;
+	struct fmapi_buf *inner;
+	__u64 offset;
+	int len, i;
+
+	memset(&obj, 0, sizeof(obj));
+	len = 0;
+
+	switch (op)
+	{
+		case BEOP_PSC_PORT:
+			obj.psc_port_req.num = 1;
+			obj.psc_port_req.ports[0] = conf.ppid;
+			len = fmapi_serialize(b->payload, &obj, fmapi_fmob_req(FMOP_PSC_PORT));
+			break;
+
+		case BEOP_VSC_BIND:
+			obj.vsc_bind_req.vcsid 	= conf.vcsid;
+			obj.vsc_bind_req.vppbid = conf.vppbid;
+			obj.vsc_bind_req.ppid 	= conf.ppid;
+			obj.vsc_bind_req.ldid 	= conf.ldid;
+			len = fmapi_serialize(b->payload, &obj, fmapi_fmob_req(FMOP_VSC_BIND));
+			break;
+
+		case BEOP_VSC_UNBIND:
+			obj.vsc_unbind_req.vcsid 	= conf.vcsid;
+			obj.vsc_unbind_req.vppbid 	= conf.vppbid;
+			obj.vsc_unbind_req.option 	= 0;
+			len = fmapi_serialize(b->payload, &obj, fmapi_fmob_req(FMOP_VSC_UNBIND));
+			break;
+
+		case BEOP_MEM_READ:
+		case BEOP_MEM_WRITE:
+			// Layout decoded by _parse_mpc_mem_req() in fmapi_mpc_handler.c
+			offset = (rand_r(&s->seed) % (conf.range / BELN_MPC_MEM)) * (__u64) BELN_MPC_MEM;
+			memset(b->payload, 0, BELN_MPC_MEM_HDR);
+			b->payload[0] = conf.ppid;
+			b->payload[1] = 0xFF;
+			b->payload[3] = (op == BEOP_MEM_WRITE) << 7;
+			b->payload[4] = conf.ldid & 0xFF;
+			b->payload[5] = (conf.ldid >> 8) & 0xFF;
+			b->payload[6] = BELN_MPC_MEM & 0xFF;
+			b->payload[7] = (BELN_MPC_MEM >> 8) & 0xFF;
+			for ( i = 0 ; i < 8 ; i++ )
+				b->payload[8 + i] = (offset >> (8 * i)) & 0xFF;
+			len = BELN_MPC_MEM_HDR;
+
+			if (op == BEOP_MEM_WRITE)
+			{
+				memset(&b->payload[BELN_MPC_MEM_HDR], s->tag, BELN_MPC_MEM);
+				len += BELN_MPC_MEM;
+			}
+			break;
+
+		case BEOP_MPC_TMC:
+			// Tunneled MCC Get QoS Status, which has no request payload
+			inner = (struct fmapi_buf*) obj.mpc_tmc_req.msg;
+			obj.mpc_tmc_req.ppid = conf.ppid;
+			obj.mpc_tmc_req.type = MCMT_CXLCCI;
+			obj.mpc_tmc_req.len = fmapi_fill_hdr(&sub, FMMT_REQ, s->tag, FMOP_MCC_QOS_STAT, 0, 0, 0, 0);
+			fmapi_serialize(inner->hdr, &sub, FMOB_HDR);
+			len = fmapi_serialize(b->payload, &obj, fmapi_fmob_req(FMOP_MPC_TMC));
+			break;
+	}
+
+	if (len < 0)
+		return len;
+
+	len = fmapi_fill_hdr(&hdr, FMMT_REQ, s->tag, BEOP_OPCODE[op], 0, len, 0, 0);
+	fmapi_serialize(b->hdr, &hdr, FMOB_HDR);
+
+	return len;
+}
+
+/**
+ * Load generator thread of one session
+ *
+ * STEPS
+ * 1: Pick and serialize the next operation
+ * 2: Submit the request and wait for its response
+ * 3: Record the result
+ */
+static void *bench_run(void *arg)
+{
+	struct session *s;
+	struct mctp_action *ma;
+	struct fmapi_buf buf;
+	struct timespec start, timeout;
+	__u64 stop;
+	struct bestats *st;
+	unsigned op;
+	int len, rv;
+
+	s = (struct session*) arg;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	stop = bench_ns(&start) + conf.duration * BE_NS;
+
+	for (;;)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		if (bench_ns(&start) >= stop)
+			break;
+
+		// STEP 1: Pick and serialize the next operation
+		op = bench_pick(s);
+		st = &s->stats[op];
+		s->tag++;
+
+		len = bench_build(s, op, &buf);
+		if (len < 0)
+		{
+			st->failed++;
+			continue;
+		}
+
+		// STEP 2: Submit the request and wait for its response
+		s->done = 0;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		ma = NULL;
+		if (s->fd >= 0)
+		{
+			if (bench_local(s, &buf, len) != 0)
+			{
+				printf("Session %u: local socket closed\n", s->id);
+				st->failed++;
+				break;
+			}
+			goto record;
+		}
+
+		ma = mctp_submit(s->m, MCMT_CXLFMAPI, &buf, len, 0, NULL, s, NULL, bench_completed, bench_failed);
+		if (ma == NULL)
+		{
+			printf("Session %u: could not submit request\n", s->id);
+			break;
+		}
+
+		clock_gettime(CLOCK_REALTIME, &timeout);
+		timeout.tv_sec += BELN_TIMEOUT;
+
+		rv = 0;
+		pthread_mutex_lock(&s->mtx);
+		while (!s->done && rv == 0)
+			rv = pthread_cond_timedwait(&s->cond, &s->mtx, &timeout);
+		pthread_mutex_unlock(&s->mtx);
+
+		if (!s->done)
+		{
+			printf("Session %u: no response to %s after %d s\n", s->id, STR_BEOP[op], BELN_TIMEOUT);
+			st->failed++;
+			break;
+		}
+
+record:
+
+		// STEP 3: Record the result
+		if (s->failed)
+			st->failed++;
+		else
+		{
+			st->count++;
+			metrics_hist_add(&st->lat, bench_elapsed(&start, &s->end));
+
+			if (s->rc == FMRC_SUCCESS || s->rc == FMRC_BACKGROUND_OP_STARTED)
+			{
+				if (op == BEOP_VSC_BIND)
+					s->bound = 1;
+				else if (op == BEOP_VSC_UNBIND)
+					s->bound = 0;
+			}
+			else
+				st->errors++;
+		}
+
+		if (ma != NULL)
+			mctp_retire(s->m, ma);
+	}
+
+	return NULL;
+}
+
+/**
+ * Print the results of all sessions
+ */
+static void bench_report(struct session *ss, unsigned n, double secs)
+{
+	struct bestats t, all;
+	unsigned i, k, b;
+
+	memset(&all, 0, sizeof(all));
+
+	printf("%-10s %10s %10s %8s %8s %10s %10s %10s %10s\n", "op", "count", "ops/s", "errors", "failed", "p50(us)", "p99(us)", "p999(us)", "max(us)");
+
+	for ( k = 0 ; k < BEOP_MAX ; k++ )
+	{
+		memset(&t, 0, sizeof(t));
+		for ( i = 0 ; i < n ; i++ )
+		{
+			t.count 	+= ss[i].stats[k].count;
+			t.errors 	+= ss[i].stats[k].errors;
+			t.failed 	+= ss[i].stats[k].failed;
+			t.lat.sum 	+= ss[i].stats[k].lat.sum;
+			if (ss[i].stats[k].lat.max > t.lat.max)
+				t.lat.max = ss[i].stats[k].lat.max;
+			for ( b = 0 ; b < MTLN_BUCKETS ; b++ )
+				t.lat.bucket[b] += ss[i].stats[k].lat.bucket[b];
+		}
+
+		if (t.count == 0 && t.failed == 0)
+			continue;
+
+		all.count 	+= t.count;
+		all.errors 	+= t.errors;
+		all.failed 	+= t.failed;
+		if (t.lat.max > all.lat.max)
+			all.lat.max = t.lat.max;
+		for ( b = 0 ; b < MTLN_BUCKETS ; b++ )
+			all.lat.bucket[b] += t.lat.bucket[b];
+
+		printf("%-10s %10llu %10.0f %8llu %8llu %10.1f %10.1f %10.1f %10.1f\n", STR_BEOP[k], t.count, t.count / secs, t.errors, t.failed,
+			metrics_hist_pct(&t.lat, 500) / 1000.0,
+			metrics_hist_pct(&t.lat, 990) / 1000.0,
+			metrics_hist_pct(&t.lat, 999) / 1000.0,
+			t.lat.max / 1000.0);
+	}
+
+	printf("%-10s %10llu %10.0f %8llu %8llu %10.1f %10.1f %10.1f %10.1f\n", "total", all.count, all.count / secs, all.errors, all.failed,
+		metrics_hist_pct(&all.lat, 500) / 1000.0,
+		metrics_hist_pct(&all.lat, 990) / 1000.0,
+		metrics_hist_pct(&all.lat, 999) / 1000.0,
+		all.lat.max / 1000.0);
+}
+
+/**
+ * bench main
+ *
+ * STEPS
+ * 1: Parse CLI options
+ * 2: Connect the sessions
+ * 3: Run the load generator threads
+ * 4: Print the report
+ * 5: Disconnect and free the sessions
+ */
+int main(int argc, char *argv[])
+{
+	struct session *ss;
+	struct timespec start, end;
+	unsigned i, running, total;
+	int rv;
+
+	rv = 1;
+
+	// STEP 1: Parse CLI options
+	memset(&conf, 0, sizeof(conf));
+	inet_pton(AF_INET, "127.0.0.1", &conf.address);
+	conf.port 		= BELN_PORT;
+	conf.sessions 	= 1;
+	conf.duration 	= BELN_DURATION;
+	conf.ppid 		= 1;
+	conf.vppbid 	= 1;
+	conf.range 		= BELN_RANGE;
+	bench_parse_mix("psc_port=50,bind=10,mem_read=20,mem_write=20");
+
+	argp_parse(&argp_bench, argc, argv, 0, 0, NULL);
+
+	for ( i = 0, total = 0 ; i < BEOP_MAX ; i++ )
+		total += conf.weight[i];
+	if (total == 0)
+	{
+		printf("Error: the command mix has no operations\n");
+		goto end;
+	}
+
+	ss = calloc(conf.sessions, sizeof(struct session));
+	if (ss == NULL)
+		goto end;
+
+	for ( i = 0 ; i < conf.sessions ; i++ )
+		ss[i].fd = -1;
+
+	// STEP 2: Connect the sessions
+	for ( i = 0 ; i < conf.sessions ; i++ )
+	{
+		ss[i].id = i;
+		ss[i].seed = i + 1;
+		pthread_mutex_init(&ss[i].mtx, NULL);
+		pthread_cond_init(&ss[i].cond, NULL);
+
+		if (conf.path != NULL)
+		{
+			ss[i].fd = bench_connect(conf.path);
+			if (ss[i].fd < 0)
+			{
+				printf("Error: could not connect session %u to %s\n", i, conf.path);
+				goto end_sessions;
+			}
+			continue;
+		}
+
+		ss[i].m = mctp_init();
+		if (ss[i].m == NULL)
+		{
+			printf("Error: mctp init failed\n");
+			goto end_sessions;
+		}
+
+		if (mctp_run(ss[i].m, conf.port + i, conf.address, MCRM_CLIENT, 1, 1) != 0)
+		{
+			printf("Error: could not connect session %u to TCP port %u\n", i, conf.port + i);
+			goto end_sessions;
+		}
+	}
+
+	// STEP 3: Run the load generator threads
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for ( running = 0 ; running < conf.sessions ; running++ )
+		if (pthread_create(&ss[running].thread, NULL, bench_run, &ss[running]) != 0)
+			break;
+
+	for ( i = 0 ; i < running ; i++ )
+		pthread_join(ss[i].thread, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	// STEP 4: Print the report
+	printf("%u session(s), %.1f s\n", running, bench_elapsed(&start, &end) / (double) BE_NS);
+	bench_report(ss, running, bench_elapsed(&start, &end) / (double) BE_NS);
+
+	rv = 0;
+
+end_sessions:
+
+	// STEP 5: Disconnect and free the sessions
+	for ( i = 0 ; i < conf.sessions ; i++ )
+	{
+		if (ss[i].m != NULL)
+		{
+			mctp_stop(ss[i].m);
+			mctp_free(ss[i].m);
+		}
+		if (ss[i].fd >= 0)
+			close(ss[i].fd);
+		pthread_cond_destroy(&ss[i].cond);
+		pthread_mutex_destroy(&ss[i].mtx);
+	}
+	free(ss);
+
+end:
+
+	return rv;
+}
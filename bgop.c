@@ -0,0 +1,345 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		bgop.c
+ *
+ * @brief 		Code file for the executor of FM API background operations
+ *
+ * @details 	Bind, Unbind and Physical Port Control may have to power a
+ * 				QEMU slot up or down, which can take a long time. The FM API
+ * 				handler validates the request, records the new state, starts
+ * 				the operation here and responds at once. A single executor
+ * 				thread performs the slot power change without holding any
+ * 				state lock and reports progress through the background
+ * 				operation status read by fmop_isc_bos(). As in the CXL
+ * 				specification only one background operation runs at a time
+ * 				on each switch.
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ */
+/* INCLUDES ==================================================================*/
+
+/* gettid()
+ */
+#define _GNU_SOURCE
+
+/* write()
+ * close()
+ */
+#include <unistd.h>
+
+/* snprintf()
+ */
+#include <stdio.h>
+
+/* memset()
+ */
+#include <string.h>
+
+/* open()
+ */
+#include <fcntl.h>
+
+/* pthread_create()
+ * pthread_mutex_t
+ * pthread_cond_t
+ */
+#include <pthread.h>
+
+#include <fmapi.h>
+#include <cxlstate.h>
+
+#include "options.h"
+
+#include "trace.h"
+
+#include "state.h"
+
+#include "events.h"
+
+/* logger_printf()
+ */
+#include "logger.h"
+
+/* SWLN_SWITCHES
+ * switches_select()
+ */
+#include "switches.h"
+
+#include "bgop.h"
+
+/* MACROS ====================================================================*/
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/* PROTOTYPES ================================================================*/
+
+static void *bgop_run(void *arg);
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/**
+ * Executor thread and the operation of each switch it is waiting to perform
+ *
+ * Each switch runs one background operation at a time, so the thread has at
+ * most one operation per switch to perform
+ */
+static pthread_t thread;
+static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static struct bgop pending[SWLN_SWITCHES];
+static int queued[SWLN_SWITCHES]; 	//!< 1 if pending[] of the switch holds an operation
+static unsigned num_queued = 0; 	//!< Number of entries of queued[] set
+static int stop = 0; 		//!< Set to 1 to request the thread to exit
+static int running = 0; 	//!< 1 if the thread was started
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Start the background operation executor thread
+ *
+ * @return 	0 upon success. Non zero otherwise
+ */
+int bgop_init()
+{
+	INIT
+	int rv;
+
+	ENTER
+
+	// Initialize variables
+	rv = 1;
+	stop = 0;
+	memset(queued, 0, sizeof(queued));
+	num_queued = 0;
+
+	STEP // 1: Start the thread
+	if (pthread_create(&thread, NULL, bgop_run, NULL) != 0)
+	{
+		IFV(CLVB_ERRORS) logger_printf("%d:%s ERR: Could not start background operation thread\n", gettid(), __FUNCTION__);
+		goto end;
+	}
+	running = 1;
+
+	rv = 0;
+
+end:
+
+	EXIT(rv)
+
+	return rv;
+}
+
+/**
+ * Stop the executor thread
+ *
+ * An operation that was already started is completed before the thread exits
+ */
+void bgop_free()
+{
+	if (!running)
+		return;
+
+	pthread_mutex_lock(&mtx);
+	stop = 1;
+	pthread_cond_signal(&cond);
+	pthread_mutex_unlock(&mtx);
+
+	pthread_join(thread, NULL);
+	running = 0;
+}
+
+/**
+ * Start a background operation on the switch selected by the calling thread
+ *
+ * Caller must hold the write id lock, which guards the background operation
+ * status. The status is set to running at 0 percent before returning and the
+ * executor does not touch the port until the caller releases its locks
+ *
+ * @param op 	struct bgop* describing the operation. Copied
+ * @return 		FMRC_BACKGROUND_OP_STARTED if started, FMRC_BUSY if another
+ * 				operation is running, FMRC_INTERNAL_ERROR if there is no
+ * 				executor thread
+ */
+int bgop_start(struct bgop *op)
+{
+	if (!running)
+		return FMRC_INTERNAL_ERROR;
+
+	if (cxls->bos_running)
+		return FMRC_BUSY;
+
+	cxls->bos_running = 1;
+	cxls->bos_pcnt = BGPC_QUEUED;
+	cxls->bos_opcode = op->opcode;
+	cxls->bos_rc = FMRC_SUCCESS;
+	cxls->bos_ext = 0;
+
+	pthread_mutex_lock(&mtx);
+	pending[cxls_id] = *op;
+	if (!queued[cxls_id])
+		num_queued++;
+	queued[cxls_id] = 1;
+	pthread_cond_signal(&cond);
+	pthread_mutex_unlock(&mtx);
+
+	return FMRC_BACKGROUND_OP_STARTED;
+}
+
+/**
+ * Write the slot power file of a port
+ *
+ * @return 	0 upon success, 1 otherwise
+ */
+static int bgop_power(unsigned ppid, int on)
+{
+	char path[BGLN_PATH];
+	int fd, rv;
+
+	snprintf(path, sizeof(path), BGFN_SLOT_POWER, ppid);
+
+	fd = open(path, O_WRONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		IFV(CLVB_ERRORS) logger_printf("%d:%s ERR: Could not open %s\n", gettid(), __FUNCTION__, path);
+		return 1;
+	}
+
+	rv = (write(fd, on ? "1" : "0", 1) == 1) ? 0 : 1;
+	close(fd);
+
+	if (rv != 0)
+		IFV(CLVB_ERRORS) logger_printf("%d:%s ERR: Could not write %s\n", gettid(), __FUNCTION__, path);
+
+	return rv;
+}
+
+/**
+ * Executor thread main loop
+ *
+ * STEPS
+ * 1: Wait for an operation and select its switch
+ * 2: Change the slot power
+ * 3: Roll back the binding if the slot power change failed
+ * 4: Move the port to its final state and complete the status
+ */
+static void *bgop_run(void *arg)
+{
+	struct bgop op;
+	struct cxl_port *p;
+	struct cxl_vppb *b;
+	unsigned id;
+	int rc;
+
+	(void) arg;
+
+	while (1)
+	{
+		// STEP 1: Wait for an operation and select its switch
+		pthread_mutex_lock(&mtx);
+		while (num_queued == 0 && stop == 0)
+			pthread_cond_wait(&cond, &mtx);
+
+		if (num_queued == 0)
+		{
+			pthread_mutex_unlock(&mtx);
+			break;
+		}
+
+		for ( id = 0 ; id < SWLN_SWITCHES && !queued[id] ; id++ )
+			;
+
+		op = pending[id];
+		queued[id] = 0;
+		num_queued--;
+		pthread_mutex_unlock(&mtx);
+
+		switches_select(id);
+
+		// STEP 2: Change the slot power
+		rc = FMRC_SUCCESS;
+		if (op.power != BGPW_NONE)
+		{
+			if (bgop_power(op.ppid, op.power == BGPW_ON) != 0)
+				rc = FMRC_INTERNAL_ERROR;
+
+			// A failed power change is reported by bos_rc when the operation completes
+			if (rc == FMRC_SUCCESS)
+			{
+				state_lock_id(1);
+				cxls->bos_pcnt = BGPC_POWERED;
+				state_unlock_id();
+			}
+		}
+
+		// STEP 3: Roll back the binding if the slot power change failed
+		if (rc != FMRC_SUCCESS && op.undo)
+		{
+			state_lock_topology();
+			state_lock_id(1);
+			state_lock_vcs(op.vcsid);
+			state_lock_port(op.ppid);
+
+			// Only undo the binding this operation recorded
+			b = &cxls->vcss[op.vcsid].vppbs[op.vppbid];
+			if (b->bind_status != FMBS_UNBOUND && b->ppid == op.ppid)
+			{
+				state_binds_remove(b);
+				b->bind_status = FMBS_UNBOUND;
+				b->ppid = 0;
+				b->ldid = 0;
+				state_gen_bump(STATE_GEN_VCS, op.vcsid);
+			}
+
+			p = &cxls->ports[op.ppid];
+			if (p->state == FMPS_BINDING)
+				p->state = op.prev;
+			state_gen_bump(STATE_GEN_PORT, op.ppid);
+
+			cxls->bos_rc = rc;
+			cxls->bos_pcnt = BGPC_DONE;
+			cxls->bos_running = 0;
+
+			state_unlock_port(op.ppid);
+			state_unlock_vcs(op.vcsid);
+			state_unlock_id();
+			state_unlock_topology();
+
+			events_post(EVTY_UNBIND, op.ppid);
+			events_post(EVTY_BOS, EVLN_SWITCH);
+
+			IFV(CLVB_ERRORS) logger_printf("%d:%s ERR: Rolled back binding of VCSID %u vPPBID %u to PPID %u\n", gettid(), __FUNCTION__, op.vcsid, op.vppbid, op.ppid);
+			continue;
+		}
+
+		// STEP 4: Move the port to its final state and complete the status
+		state_lock_id(1);
+		state_lock_port(op.ppid);
+
+		// Leave the port alone if something else changed it meanwhile
+		p = &cxls->ports[op.ppid];
+		if (op.set_state && (p->state == FMPS_BINDING || p->state == FMPS_UNBINDING))
+			p->state = op.state;
+		state_gen_bump(STATE_GEN_PORT, op.ppid);
+
+		cxls->bos_rc = rc;
+		cxls->bos_pcnt = BGPC_DONE;
+		cxls->bos_running = 0;
+
+		state_unlock_port(op.ppid);
+		state_unlock_id();
+
+		if (op.event != 0)
+			events_post(op.event, op.ppid);
+		events_post(EVTY_BOS, EVLN_SWITCH);
+
+		IFV(CLVB_ACTIONS) logger_printf("%d:%s Completed background operation 0x%04x on PPID %u rc %d\n", gettid(), __FUNCTION__, op.opcode, op.ppid, rc);
+	}
+
+	return NULL;
+}
@@ -0,0 +1,88 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		bgop.h
+ *
+ * @brief 		Header file for the executor of FM API background operations
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ * Macro / Enumeration Prefixes (BG)
+ * BGFN	- Background Operation File Name (FN)
+ * BGLN	- Background Operation Length (LN)
+ * BGPW	- Background Operation Slot Power (PW)
+ * BGPC	- Background Operation Percent Complete (PC)
+ */
+#ifndef _BGOP_H
+#define _BGOP_H
+
+/* INCLUDES ==================================================================*/
+
+/* __u8
+ * __u16
+ */
+#include <linux/types.h>
+
+/* MACROS ====================================================================*/
+
+#define BGFN_SLOT_POWER 	"/sys/bus/pci/slots/%u/power" 	//!< Slot power control file of a QEMU port
+#define BGLN_PATH 			64 		//!< Max length of a slot power file path
+
+/* ENUMERATIONS ==============================================================*/
+
+/**
+ * Slot power change performed by a background operation (BGPW)
+ */
+enum _BGPW
+{
+	BGPW_NONE 	= 0,	//!< Leave the slot power alone
+	BGPW_OFF 	= 1,	//!< Write 0 to the slot power file
+	BGPW_ON 	= 2		//!< Write 1 to the slot power file
+};
+
+/**
+ * Percent complete reported while a background operation runs (BGPC)
+ */
+enum _BGPC
+{
+	BGPC_QUEUED 	= 0,	//!< Waiting for the executor thread
+	BGPC_POWERED 	= 50,	//!< Slot power changed, port state not yet updated
+	BGPC_DONE 		= 100
+};
+
+/* STRUCTS ===================================================================*/
+
+/**
+ * Background operation handed to the executor
+ *
+ * The FM API handler validates the request and performs the state changes
+ * that must be visible at once, such as recording the vPPB binding. The
+ * executor performs the slow part and then moves the port to its final state.
+ * When undo is set and the slot power change fails, the executor removes the
+ * binding of vPPB vppbid in VCS vcsid and returns the port to prev instead
+ */
+struct bgop
+{
+	__u16 opcode; 		//!< FM API opcode reported in the background operation status
+	__u8 ppid; 			//!< Physical port the operation acts on
+	__u8 power; 		//!< enum _BGPW
+	__u8 set_state; 	//!< 1 to set the port state to state when done
+	__u8 state; 		//!< Final port state (FMPS)
+	__u16 event; 		//!< Events posted for the port on completion in addition to EVTY_BOS
+	__u8 undo; 			//!< 1 to roll back the vPPB binding if the slot power change fails
+	__u8 vcsid; 		//!< VCS of the vPPB to roll back
+	__u8 vppbid; 		//!< vPPB to roll back
+	__u8 prev; 			//!< Port state (FMPS) restored on roll back
+};
+
+/* PROTOTYPES ================================================================*/
+
+int bgop_init();
+void bgop_free();
+int bgop_start(struct bgop *op);
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+#endif //_BGOP_H
@@ -0,0 +1,257 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		cache.c
+ *
+ * @brief 		Code file for the cache of serialized query responses
+ *
+ * @details 	Query opcodes such as Identify Switch Device, Get Physical
+ * 				Port State and Get Virtual CXL Switch Info are polled far more
+ * 				often than the state they report changes. A handler looks up
+ * 				its opcode and request arguments together with the generation
+ * 				of the state it reports. On a hit the serialized payload is
+ * 				copied into the response. On a miss the handler builds the
+ * 				response as before and stores it under the generation it read
+ * 				before it started. The cache is direct mapped, a store
+ * 				replaces whatever occupied the slot.
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ */
+/* INCLUDES ==================================================================*/
+
+/* gettid()
+ */
+#define _GNU_SOURCE
+
+#include <unistd.h>
+
+/* printf()
+ */
+#include <stdio.h>
+
+/* memcpy()
+ * memcmp()
+ */
+#include <string.h>
+
+/* calloc()
+ * free()
+ */
+#include <stdlib.h>
+
+/* pthread_mutex_t
+ */
+#include <pthread.h>
+
+#include "options.h"
+
+#include "trace.h"
+
+/* cxls_id
+ */
+#include "state.h"
+
+#include "cache.h"
+
+/* MACROS ====================================================================*/
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/**
+ * Cached response
+ */
+struct centry
+{
+	pthread_mutex_t mtx;
+	int used;
+	unsigned sw; 				//!< Switch the response is for [cxls_id]
+	unsigned api; 				//!< enum _CAAPI
+	unsigned opcode;
+	unsigned keylen;
+	__u8 key[CALN_KEY];
+	__u64 gen; 					//!< Generation the response was built at
+	unsigned aux; 				//!< Response header field stored with the payload
+	unsigned len;
+	__u8 data[CALN_DATA];
+};
+
+/* PROTOTYPES ================================================================*/
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/**
+ * Cache entries, NULL if the cache is disabled
+ */
+static struct centry *entries = NULL;
+
+/**
+ * Counters, updated with relaxed atomics
+ */
+static struct cache_stats stats;
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Allocate the cache
+ *
+ * @return 	0 upon success. Non zero otherwise
+ */
+int cache_init()
+{
+	INIT
+	int rv;
+	unsigned i;
+
+	ENTER
+
+	// Initialize variables
+	rv = 1;
+
+	STEP // 1: Allocate entries
+	entries = calloc(CALN_ENTRIES, sizeof(struct centry));
+	if (entries == NULL)
+		goto end;
+
+	for ( i = 0 ; i < CALN_ENTRIES ; i++ )
+		pthread_mutex_init(&entries[i].mtx, NULL);
+
+	memset(&stats, 0, sizeof(stats));
+
+	rv = 0;
+
+end:
+
+	EXIT(rv)
+
+	return rv;
+}
+
+/**
+ * Free the cache
+ */
+void cache_free()
+{
+	unsigned i;
+
+	if (entries == NULL)
+		return;
+
+	for ( i = 0 ; i < CALN_ENTRIES ; i++ )
+		pthread_mutex_destroy(&entries[i].mtx);
+
+	free(entries);
+	entries = NULL;
+}
+
+/**
+ * Select the entry for a key of a switch with an FNV-1a hash
+ */
+static struct centry *_cache_slot(unsigned sw, unsigned api, unsigned opcode, __u8 *key, unsigned keylen)
+{
+	__u32 h;
+	unsigned i;
+
+	h = 2166136261u;
+	h = (h ^ sw) * 16777619u;
+	h = (h ^ api) * 16777619u;
+	h = (h ^ (opcode & 0xFF)) * 16777619u;
+	h = (h ^ (opcode >> 8)) * 16777619u;
+	for ( i = 0 ; i < keylen ; i++ )
+		h = (h ^ key[i]) * 16777619u;
+
+	return &entries[h % CALN_ENTRIES];
+}
+
+/**
+ * Look up a cached response payload of the switch selected by the calling thread
+ *
+ * @param api 		enum _CAAPI
+ * @param opcode 	Opcode of the request
+ * @param key 		Request arguments
+ * @param keylen 	Length of key in bytes
+ * @param gen 		Current generation of the state the response reports
+ * @param dst 		Buffer of at least CALN_DATA bytes to copy the payload to
+ * @param aux 		Set to the value stored with the payload. May be NULL
+ * @return 			Length of the payload, -1 on a miss
+ */
+int cache_get(unsigned api, unsigned opcode, __u8 *key, unsigned keylen, __u64 gen, __u8 *dst, unsigned *aux)
+{
+	struct centry *e;
+	int rv;
+
+	if (entries == NULL || keylen > CALN_KEY)
+		return -1;
+
+	e = _cache_slot(cxls_id, api, opcode, key, keylen);
+	rv = -1;
+
+	pthread_mutex_lock(&e->mtx);
+	if (e->used && e->gen == gen && e->sw == cxls_id && e->api == api && e->opcode == opcode
+		&& e->keylen == keylen && memcmp(e->key, key, keylen) == 0)
+	{
+		memcpy(dst, e->data, e->len);
+		if (aux != NULL)
+			*aux = e->aux;
+		rv = e->len;
+	}
+	pthread_mutex_unlock(&e->mtx);
+
+	if (rv < 0)
+		__atomic_add_fetch(&stats.misses, 1, __ATOMIC_RELAXED);
+	else
+		__atomic_add_fetch(&stats.hits, 1, __ATOMIC_RELAXED);
+
+	return rv;
+}
+
+/**
+ * Store a response payload of the switch selected by the calling thread
+ *
+ * @param api 		enum _CAAPI
+ * @param opcode 	Opcode of the request
+ * @param key 		Request arguments
+ * @param keylen 	Length of key in bytes
+ * @param gen 		Generation read before the response was built
+ * @param src 		Serialized response payload
+ * @param len 		Length of src in bytes
+ * @param aux 		Response header field to return with the payload, e.g. a count
+ */
+void cache_put(unsigned api, unsigned opcode, __u8 *key, unsigned keylen, __u64 gen, __u8 *src, unsigned len, unsigned aux)
+{
+	struct centry *e;
+
+	if (entries == NULL || keylen > CALN_KEY || len > CALN_DATA)
+		return;
+
+	e = _cache_slot(cxls_id, api, opcode, key, keylen);
+
+	pthread_mutex_lock(&e->mtx);
+	e->used = 1;
+	e->sw = cxls_id;
+	e->api = api;
+	e->opcode = opcode;
+	e->keylen = keylen;
+	memcpy(e->key, key, keylen);
+	e->gen = gen;
+	e->aux = aux;
+	e->len = len;
+	memcpy(e->data, src, len);
+	pthread_mutex_unlock(&e->mtx);
+
+	__atomic_add_fetch(&stats.stores, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Copy the cache counters
+ */
+void cache_stats(struct cache_stats *s)
+{
+	s->hits 	= __atomic_load_n(&stats.hits, 	__ATOMIC_RELAXED);
+	s->misses 	= __atomic_load_n(&stats.misses, 	__ATOMIC_RELAXED);
+	s->stores 	= __atomic_load_n(&stats.stores, 	__ATOMIC_RELAXED);
+}
@@ -0,0 +1,69 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		cache.h
+ *
+ * @brief 		Header file for the cache of serialized query responses
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ * Macro / Enumeration Prefixes (CA)
+ * CAAPI - Cache API the opcode belongs to (API)
+ * CALN	- Cache Length (LN)
+ */
+#ifndef _CACHE_H
+#define _CACHE_H
+
+/* INCLUDES ==================================================================*/
+
+/* __u8
+ * __u64
+ */
+#include <linux/types.h>
+
+/* MCLN_BTU
+ */
+#include <mctp.h>
+
+/* MACROS ====================================================================*/
+
+#define CALN_ENTRIES 		64 		//!< Number of cached responses
+#define CALN_KEY 			264 	//!< Max length of the request arguments used as a key
+#define CALN_DATA 			MCLN_BTU 	//!< Max length of a cached response payload
+
+/* ENUMERATIONS ==============================================================*/
+
+/**
+ * API an opcode belongs to, so FM API and EM API opcodes do not collide (API)
+ */
+enum _CAAPI
+{
+	CAAPI_FM 	= 0,
+	CAAPI_EM 	= 1
+};
+
+/* STRUCTS ===================================================================*/
+
+/**
+ * Hit and miss counters of the cache
+ */
+struct cache_stats
+{
+	__u64 hits;
+	__u64 misses;
+	__u64 stores;
+};
+
+/* PROTOTYPES ================================================================*/
+
+int cache_init();
+void cache_free();
+int cache_get(unsigned api, unsigned opcode, __u8 *key, unsigned keylen, __u64 gen, __u8 *dst, unsigned *aux);
+void cache_put(unsigned api, unsigned opcode, __u8 *key, unsigned keylen, __u64 gen, __u8 *src, unsigned len, unsigned aux);
+void cache_stats(struct cache_stats *s);
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+#endif //_CACHE_H
@@ -0,0 +1,83 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		dispatch.c
+ *
+ * @brief 		Code file for the opcode tables used by the FM API and EM API
+ * 				dispatchers
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ */
+/* INCLUDES ==================================================================*/
+
+/* NULL
+ */
+#include <stddef.h>
+
+#include "dispatch.h"
+
+/* MACROS ====================================================================*/
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/* PROTOTYPES ================================================================*/
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/**
+ * String representation of CSLK Enumeration 
+ */ 
+char *STR_CSLK[] = {
+	"None",
+	"Topology",
+	"Identity",
+	"VCS",
+	"Port"
+};
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Find the entry for an opcode in a sorted opcode table
+ *
+ * @param table 	Array of struct opcode sorted by opcode
+ * @param num 		Number of entries in table
+ * @param opcode 	Opcode to look up 
+ * @return 			struct opcode* or NULL if the opcode is not in the table
+ */
+struct opcode *opcode_find(struct opcode *table, unsigned num, unsigned opcode)
+{
+	unsigned lo, hi, mid;
+
+	lo = 0;
+	hi = num;
+	while (lo < hi)
+	{
+		mid = (lo + hi) / 2;
+		if (table[mid].opcode == opcode)
+			return &table[mid];
+		if (table[mid].opcode < opcode)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return NULL;
+}
+
+/**
+ * Return a string representation of Lock Scope [CSLK]
+ *
+ * @param u Lock Scope Enumeration value [CSLK]
+ */
+char *cslk(int u)
+{
+	if (u >= CSLK_MAX) 
+		return NULL;
+	return STR_CSLK[u];
+}
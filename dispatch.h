@@ -0,0 +1,109 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		dispatch.h
+ *
+ * @brief 		Header file for the opcode tables used by the FM API and EM API
+ * 				dispatchers
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ * Macro / Enumeration Prefixes (CS)
+ * CSLK	- Lock scope an opcode requires (LK)
+ * CSOF	- Opcode Flags (OF)
+ */
+#ifndef _DISPATCH_H
+#define _DISPATCH_H
+
+/* INCLUDES ==================================================================*/
+
+/* __u16
+ * __u64
+ */
+#include <linux/types.h>
+
+/* struct mctp
+ * struct mctp_action
+ */
+#include <mctp.h>
+
+/* struct fmapi_msg
+ */
+#include <fmapi.h>
+
+/* struct opstats
+ */
+#include "metrics.h"
+
+/* MACROS ====================================================================*/
+
+/* ENUMERATIONS ==============================================================*/
+
+/**
+ * Portion of the switch state an opcode locks (LK)
+ *
+ * Listed in the order the locks must be acquired. See state.h
+ */
+enum _CSLK
+{
+	CSLK_NONE		= 0, 	//!< Does not touch switch state
+	CSLK_TOPOLOGY	= 1, 	//!< Whole switch topology (cxls->mtx)
+	CSLK_ID			= 2, 	//!< Switch identity fields 
+	CSLK_VCS		= 3, 	//!< A single Virtual CXL Switch
+	CSLK_PORT		= 4, 	//!< A single Physical Port
+	CSLK_MAX
+};
+
+/**
+ * Opcode Flags (OF)
+ */
+enum _CSOF
+{
+	CSOF_MUTATE		= (1 << 0), //!< Opcode modifies switch state
+	CSOF_RAW 		= (1 << 1), //!< Request object is not deserialized by the dispatcher
+};
+
+/* STRUCTS ===================================================================*/
+
+/**
+ * Handler for an FM API opcode. Called with the request already decoded
+ */
+typedef int (*fmop_fn)(struct mctp *m, struct mctp_action *ma, struct fmapi_msg *req);
+
+/**
+ * Handler for an EM API opcode
+ */
+typedef int (*emop_fn)(struct mctp *m, struct mctp_action *ma);
+
+/**
+ * Entry in an opcode dispatch table
+ *
+ * Tables are sorted by opcode. The obj fields are filled in from the API 
+ * library on first use. The stats are updated by the dispatcher
+ */
+struct opcode
+{
+	__u16 opcode;
+	const char *name;
+	union 
+	{
+		fmop_fn fm;
+		emop_fn em;
+	} fn; 						//!< NULL if the opcode is accepted but not handled
+	unsigned scope; 			//!< enum _CSLK
+	unsigned flags; 			//!< enum _CSOF
+	unsigned req_obj; 			//!< Request object type 
+	unsigned rsp_obj; 			//!< Response object type 
+	struct opstats stats; 		//!< Counters and latency histograms
+};
+
+/* PROTOTYPES ================================================================*/
+
+struct opcode *opcode_find(struct opcode *table, unsigned num, unsigned opcode);
+char *cslk(int u);
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+#endif //_DISPATCH_H
@@ -26,6 +26,24 @@
  */
 #include <string.h>
 
+/* qsort()
+ */
+#include <stdlib.h>
+
+/* open()
+ */
+#include <fcntl.h>
+
+/* pread()
+ * pwrite()
+ * close()
+ */
+#include <unistd.h>
+
+/* pthread_once()
+ */
+#include <pthread.h>
+
 /* struct timespec 
  * timespec_get()
  *
@@ -42,38 +60,54 @@
  */
 #include <mctp.h>
 #include <ptrqueue.h>
-#include <timeutils.h>
 #include <emapi.h>
 #include <cxlstate.h>
 #include "signals.h"
 
 #include "options.h"
 
+#include "trace.h"
+
+#include "logger.h"
+
+#include "metrics.h"
+
 #include "state.h"
 
+#include "workers.h"
+
+#include "dispatch.h"
+
+#include "respool.h"
+
+#include "fmapi_handler.h"
+
 #include "emapi_handler.h"
 
+#include "memspace.h"
+
+#include "events.h"
+
+#include "cache.h"
+
+#include "qos.h"
+
+#include "switches.h"
+
 /* MACROS ====================================================================*/
 
-#ifdef CSE_VERBOSE
- #define INIT 			unsigned step = 0;
- #define ENTER 					if (opts[CLOP_VERBOSITY].u64 & CLVB_CALLSTACK) 	printf("%d:%s Enter\n", 			gettid(), __FUNCTION__);
- #define STEP 			step++; if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u\n", 			gettid(), __FUNCTION__, step);
- #define HEX32(m, i)			if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u %s: 0x%x\n",	gettid(), __FUNCTION__, step, m, i);
- #define INT32(m, i)			if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u %s: %d\n",	gettid(), __FUNCTION__, step, m, i);
- #define EXIT(rc) 				if (opts[CLOP_VERBOSITY].u64 & CLVB_CALLSTACK) 	printf("%d:%s Exit: %d\n", 			gettid(), __FUNCTION__,rc);
-#else
- #define ENTER
- #define EXIT(rc)
- #define STEP
- #define HEX32(m, i)
- #define INT32(m, i)
- #define INIT 
-#endif // CSE_VERBOSE
-
-#define IFV(u) 							if (opts[CLOP_VERBOSITY].u64 & u) 
-
-#define ISO_TIME_BUF_LEN 	32
+#define EMLN_XFER_REQ_HDR 	0x10 	//!< Offset of data or file offset in a LD Memory Transfer request
+#define EMLN_XFER_FILE_HDR 	0x18 	//!< Offset of the host file name in a LD Memory Transfer request
+#define EMLN_XFER_RSP_HDR 	0x04 	//!< Offset of return data in a LD Memory Transfer response
+#define EMLN_XFER_MAX 		(MCLN_BTU - EMLN_HDR - EMLN_XFER_RSP_HDR) 	//!< Max bytes in a single read or write
+#define EMLN_XFER_CHUNK 	(1 << 20) 	//!< Bytes moved per read() or write() of a host file
+#define EMLN_XFER_PATH 		1024 	//!< Max length of the path of a load or save file
+#define EMLN_XFER_FILE_MAX 	(64 << 20) 	//!< Max bytes moved between LD memory and a file in one request
+#define EMLN_XFER_FILE_RSP 	0x0C 	//!< Length of a LD Memory Transfer load or save response
+#define EMLN_LIST_REQ 		0x04 	//!< Length of a List Devices request with 16 bit count and start
+#define EMLN_LIST_MAX 		(MCLN_BTU - EMLN_HDR) 	//!< Max bytes of a List Devices response payload
+#define EMLN_LIST_PAGE 		0xFF 	//!< Max devices in one List Devices response, counted in hdr.a
+#define EMLN_LIST_NARROW 	0x100 	//!< Devices addressable by a request with 8 bit ids
 
 /* ENUMERATIONS ==============================================================*/
 
@@ -81,29 +115,98 @@
 
 /* PROTOTYPES ================================================================*/
 
+static int emapi_dispatch  (struct mctp *m, struct mctp_action *ma);
 static int emop_conn_dev   (struct mctp *m, struct mctp_action *ma);
 static int emop_disconn_dev(struct mctp *m, struct mctp_action *ma);
 static int emop_list_dev   (struct mctp *m, struct mctp_action *ma);
+static int emop_cse_stats  (struct mctp *m, struct mctp_action *ma);
+static int emop_cse_pool   (struct mctp *m, struct mctp_action *ma);
+static int emop_cse_conn_name(struct mctp *m, struct mctp_action *ma);
+static int emop_cse_ld_xfer(struct mctp *m, struct mctp_action *ma);
+static int emop_xfer_open(int type, char *name);
+static __u8 *emop_xfer_mem(unsigned ppid, unsigned ldid, __u64 base, __u64 size);
+static __u64 emop_xfer_file(int type, int fd, __u8 *mem, __u64 foffset, __u64 len);
+static int emop_event      (struct mctp *m, struct mctp_action *ma);
 static int emop_unsupported(struct mctp *m, struct mctp_action *ma);
+static int emop_busy       (struct mctp *m, struct mctp_action *ma, struct emapi_hdr *hdr);
+static void emop_table_init ();
+static int emop_cmp        (const void *a, const void *b);
 
 /* GLOBAL VARIABLES ==========================================================*/
 
+/**
+ * EM API opcode dispatch table
+ *
+ * Sorted by opcode and the object types filled in by emop_table_init()
+ */
+static struct opcode emops[] = {
+	{ EMOP_EVENT,			"Event",						{ .em = emop_event },			CSLK_NONE,		0,				0, 0, { 0 } },
+	{ EMOP_LIST_DEV,		"List Devices",					{ .em = emop_list_dev },		CSLK_TOPOLOGY,	0,				0, 0, { 0 } },
+	{ EMOP_CONN_DEV,		"Connect Device",				{ .em = emop_conn_dev },		CSLK_TOPOLOGY,	CSOF_MUTATE,	0, 0, { 0 } },
+	{ EMOP_DISCON_DEV,		"Disconnect Device",			{ .em = emop_disconn_dev },		CSLK_TOPOLOGY,	CSOF_MUTATE,	0, 0, { 0 } },
+	{ EMOP_CSE_STATS,		"CSE Opcode Statistics",		{ .em = emop_cse_stats },		CSLK_NONE,		0,				0, 0, { 0 } },
+	{ EMOP_CSE_POOL,		"CSE Pool Statistics",			{ .em = emop_cse_pool },		CSLK_NONE,		0,				0, 0, { 0 } },
+	{ EMOP_CSE_CONN_NAME,	"CSE Connect Device by Name",	{ .em = emop_cse_conn_name },	CSLK_TOPOLOGY,	CSOF_MUTATE,	0, 0, { 0 } },
+	{ EMOP_CSE_LD_XFER,		"CSE LD Memory Transfer",		{ .em = emop_cse_ld_xfer },		CSLK_PORT,		CSOF_MUTATE,	0, 0, { 0 } },
+};
+
+/**
+ * Guards the one time initialization of emops[]
+ */
+static pthread_once_t emops_once = PTHREAD_ONCE_INIT;
+
 /* FUNCTIONS =================================================================*/
 
 /**
  * Handler for all CXL Emulator API Opcodes
+ *
+ * Selects the switch of the connection, then hands the request to the worker
+ * pool if one is running. Otherwise the request is serviced inline on the 
+ * MCTP handler thread
+ * 
+ * @return 	0 upon success, 1 otherwise 
+ */
+int emapi_handler(struct mctp *m, struct mctp_action *ma)
+{
+	switches_enter(m);
+
+	if (workers_num() > 0 && workers_submit(m, ma, emapi_dispatch, -1) == 0)
+		return 0;
+
+	return emapi_dispatch(m, ma);
+}
+
+/**
+ * Return the EM API opcode dispatch table
+ *
+ * @param num 	Set to the number of entries in the table
+ */
+struct opcode *emapi_opcodes(unsigned *num)
+{
+	pthread_once(&emops_once, emop_table_init);
+
+	*num = sizeof(emops) / sizeof(struct opcode);
+	return emops;
+}
+
+/**
+ * Service a CXL Emulator API request 
  * 
  * @return 	0 upon success, 1 otherwise 
  *
  * STEPS 
  * 1: Deserialize Header
  * 2: Verify EM API Message Type
- * 3: Handle Opcode
+ * 3: Look up Opcode
+ * 4: Checkout Response mctp_msg buffer
+ * 5: Handle Opcode
  */
-int emapi_handler(struct mctp *m, struct mctp_action *ma)
+static int emapi_dispatch(struct mctp *m, struct mctp_action *ma)
 {
 	INIT
 	struct emapi_hdr hdr; 
+	struct opcode *op;
+	unsigned num;
 	int rv;
 
 	ENTER
@@ -119,28 +222,37 @@ int emapi_handler(struct mctp *m, struct mctp_action *ma)
 	if (hdr.type != EMMT_REQ) 
 		goto fail;
 
-	STEP // 3: Handle Opcode
+	STEP // 3: Look up Opcode
 	HEX32("Opcode",  hdr.opcode);
-	switch(hdr.opcode)
-	{
-		case EMOP_EVENT: 						// 0x00
-			break;
+	op = opcode_find(emapi_opcodes(&num), num, hdr.opcode);
 
-		case EMOP_LIST_DEV:						// 0x01
-			rv = emop_list_dev(m, ma);
-			break;
+	// Accepted opcode that is not handled, return the action so it is not leaked
+	if (op != NULL && op->fn.em == NULL)
+		goto fail;
 
-		case EMOP_CONN_DEV:						// 0x02
-			rv = emop_conn_dev(m, ma);
-			break;
+	if (op != NULL)
+		metrics_begin();
 
-		case EMOP_DISCON_DEV: 					// 0x03
-			rv = emop_disconn_dev(m, ma);
-			break;
+	STEP // 4: Checkout Response mctp_msg buffer
+	ma->rsp = respool_get(m);
+	if (ma->rsp == NULL)
+	{
+		IFV(CLVB_ERRORS) logger_printf("ERR: No response buffer available. Responding busy to Opcode: 0x%02x\n", hdr.opcode);
+		rv = emop_busy(m, ma, &hdr);
+		if (op != NULL)
+			metrics_end(&op->stats, rv);
+		if (rv != 0)
+			goto fail;
+		goto end;
+	}
 
-		default: 
-			rv = emop_unsupported(m, ma);
-			break;
+	STEP // 5: Handle Opcode
+	if (op == NULL) 
+		rv = emop_unsupported(m, ma);
+	else 
+	{
+		rv = op->fn.em(m, ma);
+		metrics_end(&op->stats, rv);
 	}
 
 	rv = 0;
@@ -167,7 +279,7 @@ end:
  *
  * STEPS
  *  1: Initialize variables
- *  2: Checkout Response mctp_msg buffer
+ *  2: Verify Response mctp_msg buffer
  *  3: Fill Response MCTP Header
  *  4: Set buffer pointers 
  *  5: Deserialize Request Header
@@ -188,7 +300,6 @@ end:
 static int emop_conn_dev(struct mctp *m, struct mctp_action *ma)
 {
 	INIT
-	char now[ISO_TIME_BUF_LEN];
 	struct emapi_msg reqm, rspm;
 	struct emapi_buf *reqb, *rspb;
 	unsigned rc;
@@ -201,10 +312,8 @@ static int emop_conn_dev(struct mctp *m, struct mctp_action *ma)
 	rv = 1; 
 	len = 0;
 	rc = FMRC_INVALID_INPUT;
-	isotime(now, ISO_TIME_BUF_LEN);
 
-	STEP // 2: Get response mctp_msg buffer
-	ma->rsp = pq_pop(m->msgs, 1);
+	STEP // 2: Verify Response mctp_msg buffer was checked out by the dispatcher
 	if (ma->rsp == NULL)  
 		goto fail;
 
@@ -228,34 +337,37 @@ static int emop_conn_dev(struct mctp *m, struct mctp_action *ma)
 	ppid = reqm.hdr.a;
 	dev  = reqm.hdr.b; 
 
-	IFV(CLVB_COMMANDS) printf("%s CMD: EM API Connect Device. PPID: %d Device: %d\n", now, ppid, dev);
+	IFV(CLVB_COMMANDS) logger_printf("CMD: EM API Connect Device. PPID: %d Device: %d\n", ppid, dev);
 
 	STEP // 8: Obtain lock on switch state 
-	pthread_mutex_lock(&cxls->mtx);
+	state_lock_topology();
 
 	STEP // 9: Validate Inputs 
 	if (ppid >= cxls->num_ports)
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: PPID out of range. PPID: %d Total: %d\n", now, ppid, cxls->num_ports);
+		IFV(CLVB_ERRORS) logger_printf("ERR: PPID out of range. PPID: %d Total: %d\n", ppid, cxls->num_ports);
 		goto send;
 	}
+	state_lock_port(ppid);
 	
 	if (dev >= cxls->num_devices) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Device ID out of range. Device ID: %d Total: %d\n", now, dev, cxls->num_devices);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Device ID out of range. Device ID: %d Total: %d\n", dev, cxls->num_devices);
 		goto send;
 	}
 	
 	if (cxls->devices[dev].name == NULL) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Device is NULL. Device ID: %d\n", now, dev);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Device is NULL. Device ID: %d\n", dev);
 		goto send;
 	}
 
-	IFV(CLVB_ACTIONS) printf("%s ACT: Connecting Device %d to PPID %d\n", now, dev, ppid);
+	IFV(CLVB_ACTIONS) logger_printf("ACT: Connecting Device %d to PPID %d\n", dev, ppid);
 
 	STEP // 10: Perform Action 
-	cxls_connect(&cxls->ports[ppid], &cxls->devices[dev], cxls->dir);	
+	memspace_connect(&cxls->ports[ppid], &cxls->devices[dev], cxls->dir);	
+	state_gen_bump(STATE_GEN_PORT, ppid);
+	events_post(EVTY_CONNECT, ppid);
 
 	STEP // 11: Prepare Response Object
 
@@ -268,12 +380,15 @@ static int emop_conn_dev(struct mctp *m, struct mctp_action *ma)
 send:
 
 	STEP // 14: Release lock on switch state 
-	pthread_mutex_unlock(&cxls->mtx);
+	if (ppid < cxls->num_ports)
+		state_unlock_port(ppid);
+	state_unlock_topology();
 
 	if(len < 0)
 		goto fail;
 
 	STEP // 15: Fill Response Header
+	metrics_rc(rc);
 	ma->rsp->len = emapi_fill_hdr(&rspm.hdr, EMMT_RSP, reqm.hdr.tag, rc, reqm.hdr.opcode, len, 0, 0);
 
 	STEP // 16: Serialize Header 
@@ -306,7 +421,7 @@ end:
  *
  * STEPS
  *  1: Initialize variables
- *  2: Checkout Response mctp_msg buffer
+ *  2: Verify Response mctp_msg buffer
  *  3: Fill Response MCTP Header
  *  4: Set buffer pointers 
  *  5: Deserialize Request Header
@@ -327,12 +442,14 @@ end:
 static int emop_disconn_dev(struct mctp *m, struct mctp_action *ma)
 {
 	INIT
-	char now[ISO_TIME_BUF_LEN];
 	struct emapi_msg reqm, rspm;
 	struct emapi_buf *reqb, *rspb;
 	unsigned rc;
 	int rv, len;
-	__u8 ppid, all, start, end, i;
+	__u8 ppid, all;
+	unsigned start, end, i, k, vcsid;
+	struct state_port_binds *pb;
+	struct cxl_vppb *b;
 
 	ENTER
 
@@ -340,10 +457,8 @@ static int emop_disconn_dev(struct mctp *m, struct mctp_action *ma)
 	rv = 1; 
 	len = 0;
 	rc = FMRC_INVALID_INPUT;
-	isotime(now, ISO_TIME_BUF_LEN);
 
-	STEP // 2: Get response mctp_msg buffer
-	ma->rsp = pq_pop(m->msgs, 1);
+	STEP // 2: Verify Response mctp_msg buffer was checked out by the dispatcher
 	if (ma->rsp == NULL)  
 		goto fail;
 
@@ -367,10 +482,11 @@ static int emop_disconn_dev(struct mctp *m, struct mctp_action *ma)
 	ppid = reqm.hdr.a;
 	all  = reqm.hdr.b; 
 
-	IFV(CLVB_COMMANDS) printf("%s CMD: EM API Disconnect Device. PPID: %d All: %d\n", now, ppid, all);
+	IFV(CLVB_COMMANDS) logger_printf("CMD: EM API Disconnect Device. PPID: %d All: %d\n", ppid, all);
 
 	STEP // 8: Obtain lock on switch state 
-	pthread_mutex_lock(&cxls->mtx);
+	// VCS and port locks are obtained one at a time in step 10 
+	state_lock_topology();
 
 	STEP // 9: Validate Inputs 
 	if (all) {
@@ -384,21 +500,49 @@ static int emop_disconn_dev(struct mctp *m, struct mctp_action *ma)
 
 	if (start >= cxls->num_ports) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: PPID out of range. PPID: %d Total: %d\n", now, ppid, cxls->num_ports);
+		IFV(CLVB_ERRORS) logger_printf("ERR: PPID out of range. PPID: %d Total: %d\n", ppid, cxls->num_ports);
 		goto send;
 	}
 
 	STEP // 10: Perform Action 
 	for ( i = start ; i < end ; i++ )
 	{
+		// The LDs of an MLD go away with the device so release their bindings
+		pb = state_binds_port(i);
+		for ( k = 0 ; pb != NULL && k < MAX_LD ; k++ )
+		{
+			if (!pb->ld[k].bound)
+				continue;
+
+			IFV(CLVB_ACTIONS) logger_printf("ACT: Unbinding VCSID: %d vPPBID: %d from PPID %d LDID %d\n", pb->ld[k].vcsid, pb->ld[k].vppbid, i, k);
+
+			vcsid = pb->ld[k].vcsid;
+			state_lock_vcs(vcsid);
+			b = &cxls->vcss[vcsid].vppbs[pb->ld[k].vppbid];
+			state_binds_remove(b);
+			b->bind_status = FMBS_UNBOUND;
+			b->ppid = 0;
+			b->ldid = 0;
+			state_gen_bump(STATE_GEN_VCS, vcsid);
+			state_unlock_vcs(vcsid);
+
+			events_post(EVTY_UNBIND, i);
+		}
+
+		state_lock_port(i);
+
 		// Validate if port is connected 
 		if (cxls->ports[i].prsnt == 1) 
 		{
-			IFV(CLVB_ACTIONS) printf("%s ACT: Disconnecting PPID %d\n", now, i);
+			IFV(CLVB_ACTIONS) logger_printf("ACT: Disconnecting PPID %d\n", i);
 
 			// Perform disconnect
-			cxls_disconnect(&cxls->ports[i]);	
+			memspace_disconnect(&cxls->ports[i]);	
+			state_gen_bump(STATE_GEN_PORT, i);
+			events_post(EVTY_DISCONNECT, i);
 		}
+
+		state_unlock_port(i);
 	}
 
 	STEP // 11: Prepare Response Object
@@ -412,12 +556,14 @@ static int emop_disconn_dev(struct mctp *m, struct mctp_action *ma)
 send:
 
 	STEP // 14: Release lock on switch state 
-	pthread_mutex_unlock(&cxls->mtx);
+	// VCS and port locks were released in step 10 
+	state_unlock_topology();
 
 	if (len < 0)
 		goto fail;
 
 	STEP // 15: Fill Response Header
+	metrics_rc(rc);
 	ma->rsp->len = emapi_fill_hdr(&rspm.hdr, EMMT_RSP, reqm.hdr.tag, rc, reqm.hdr.opcode, len, 0, 0);
 
 	STEP // 16: Serialize Header 
@@ -444,13 +590,27 @@ end:
 /**
  * Handler for EM API List Devices Opcode
  *
+ * A request without a payload uses 8 bit ids and only reaches the first 
+ * EMLN_LIST_NARROW devices. A request with a payload uses 16 bit ids. The 
+ * response holds as many entries as fit, up to EMLN_LIST_PAGE, and the FM 
+ * asks for the next page starting after the last id returned.
+ *
+ * Request:  hdr.a = Number requested (0 = all from start), hdr.b = Start id
+ *           or hdr.len = 4 and
+ *           00h Number requested, 0 = all from start (__u16)
+ *           02h Start id (__u16)
+ * Response: hdr.a = Number of entries, for each entry
+ *           00h Id (__u8, or __u16 if the request had a payload)
+ *           Length of the name including the terminator (__u8)
+ *           Name
+ *
  * @param m 	struct mctp* 
  * @param mm 	struct mctp_msg* 
  * @return 		0 upon success, 1 otherwise
  *
  * STEPS
  *  1: Initialize variables
- *  2: Checkout Response mctp_msg buffer
+ *  2: Verify Response mctp_msg buffer
  *  3: Fill Response MCTP Header
  *  4: Set buffer pointers 
  *  5: Deserialize Request Header
@@ -471,15 +631,15 @@ end:
 static int emop_list_dev(struct mctp *m, struct mctp_action *ma)
 {
 	INIT
-	char now[ISO_TIME_BUF_LEN];
 	struct emapi_msg reqm, rspm;
 	struct emapi_buf *reqb, *rspb;
 	unsigned rc;
 	int rv, len;
 
-	unsigned i, count;
-	__u8 num_requested, start_num; 
+	unsigned i, n, id, count, num_requested, start_num, wide;
 	struct cxl_device *d;
+	__u64 gen;
+	__u8 key[5];
 
 	ENTER
 
@@ -487,11 +647,9 @@ static int emop_list_dev(struct mctp *m, struct mctp_action *ma)
 	rv = 1; 
 	len = 0;
 	rc = FMRC_INVALID_INPUT;
-	isotime(now, ISO_TIME_BUF_LEN);
 	count = 0;
 
-	STEP // 2: Get response mctp_msg buffer
-	ma->rsp = pq_pop(m->msgs, 1);
+	STEP // 2: Verify Response mctp_msg buffer was checked out by the dispatcher
 	if (ma->rsp == NULL)  
 		goto fail;
 
@@ -512,52 +670,97 @@ static int emop_list_dev(struct mctp *m, struct mctp_action *ma)
 		goto fail;
 
 	STEP // 7: Extract parameters
+	wide          = 0;
 	num_requested = reqm.hdr.a;
 	start_num     = reqm.hdr.b; 
+	if (reqm.hdr.len >= EMLN_LIST_REQ)
+	{
+		// The length in the header comes from the FM, the payload must have been received
+		if (EMLN_HDR + (unsigned) reqm.hdr.len > ma->req->len)
+		{
+			IFV(CLVB_ERRORS) logger_printf("ERR: Request payload length exceeds message length. Payload: %d Message: %d\n", reqm.hdr.len, ma->req->len);
+			goto cached;
+		}
+
+		wide          = 1;
+		num_requested = reqb->payload[0] | (reqb->payload[1] << 8);
+		start_num     = reqb->payload[2] | (reqb->payload[3] << 8);
+	}
 
-	IFV(CLVB_COMMANDS) printf("%s CMD: EM API list Devices. Start: %d Num: %d\n", now, start_num, num_requested);
+	IFV(CLVB_COMMANDS) logger_printf("CMD: EM API list Devices. Start: %d Num: %d\n", start_num, num_requested);
+
+	// Reuse the last response to the same range if no device was added
+	key[0] = wide;
+	key[1] = num_requested & 0xFF;
+	key[2] = (num_requested >> 8) & 0xFF;
+	key[3] = start_num & 0xFF;
+	key[4] = (start_num >> 8) & 0xFF;
+	gen = state_gen(STATE_GEN_DEVICES, 0);
+	len = cache_get(CAAPI_EM, reqm.hdr.opcode, key, sizeof(key), gen, rspb->payload, &count);
+	if (len >= 0)
+	{
+		rc = EMRC_SUCCESS;
+		goto cached;
+	}
+	len = 0;
+	count = 0;
 
 	STEP // 8: Obtain lock on switch state 
-	pthread_mutex_lock(&cxls->mtx);
+	state_lock_topology();
 
 	STEP // 9: Validate Inputs 
-	if (num_requested == 0)
-		num_requested = (cxls->num_devices - start_num);
-
-	if (start_num >= cxls->num_devices) 
+	if (start_num >= cxls->num_devices || (!wide && start_num >= EMLN_LIST_NARROW)) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Start num out of range. Start: %d Total: %d\n", now, start_num, num_requested);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Start num out of range. Start: %d Total: %d\n", start_num, cxls->num_devices);
 		goto send;
 	}
-	
-	if ( (start_num + num_requested) >= cxls->num_devices)
-		num_requested = (cxls->num_devices - start_num);
+
+	if (num_requested == 0 || num_requested > cxls->num_devices - start_num)
+		num_requested = cxls->num_devices - start_num;
+
+	// An 8 bit id cannot name the devices past the first EMLN_LIST_NARROW
+	if (!wide && start_num + num_requested > EMLN_LIST_NARROW)
+		num_requested = EMLN_LIST_NARROW - start_num;
 
 	STEP // 10: Perform Action 
-	IFV(CLVB_ACTIONS) printf("%s ACT: Responding with %d devices\n", now, num_requested);
 
 	STEP // 11: Prepare Response Object
-	for ( i = 0 ; i < num_requested ; i++ )
+	for ( i = 0 ; i < num_requested && count < EMLN_LIST_PAGE ; i++ )
 	{
 		d = &cxls->devices[start_num + i];
+		id = start_num + i;
+
+		n = 0;
+		if (d->name != NULL)
+			n = strlen(d->name) + 1;
+		if (n > 0xFF)
+			n = 0xFF;
+
+		// Stop at the first entry that does not fit, the FM asks for the rest
+		if ((unsigned) len + (wide ? 2 : 1) + 1 + n > EMLN_LIST_MAX)
+			break;
 
 		// Serialize the id number
-		rspb->payload[len+0] = start_num + i;
+		rspb->payload[len++] = id & 0xFF;
+		if (wide)
+			rspb->payload[len++] = (id >> 8) & 0xFF;
 
 		// Serialize the name string 
-		if (d->name != NULL )
+		rspb->payload[len++] = n;
+		if (n > 0)
 		{
-			rspb->payload[len+1] = strlen(d->name) + 1;
-			memcpy(&rspb->payload[len+2], d->name, rspb->payload[len+1]);
+			memcpy(&rspb->payload[len], d->name, n - 1);
+			rspb->payload[len + n - 1] = 0;
 		}
-		else 
-			rspb->payload[len+1] = 0;
 
-		len += (2 + rspb->payload[len+1]);
+		len += n;
 		count++;
 	}
 
+	IFV(CLVB_ACTIONS) logger_printf("ACT: Responding with %d devices\n", count);
+
 	STEP // 12: Serialize Response Object
+	cache_put(CAAPI_EM, reqm.hdr.opcode, key, sizeof(key), gen, rspb->payload, len, count);
 
 	STEP // 13: Set return code
 	rc = EMRC_SUCCESS;
@@ -565,9 +768,12 @@ static int emop_list_dev(struct mctp *m, struct mctp_action *ma)
 send:
 
 	STEP // 14: Release lock on switch state 
-	pthread_mutex_unlock(&cxls->mtx);
+	state_unlock_topology();
+
+cached:
 
 	STEP // 15: Fill Response Header
+	metrics_rc(rc);
 	ma->rsp->len = emapi_fill_hdr(&rspm.hdr, EMMT_RSP, reqm.hdr.tag, rc, reqm.hdr.opcode, len, count, 0);
 
 	STEP // 16: Serialize Header 
@@ -592,7 +798,15 @@ end:
 }
 
 /**
- * Handler for EM API List Devices Opcode
+ * Handler for CSE vendor EM API Get Opcode Statistics Command 
+ *
+ * Returns the counters and latency histograms of one dispatch table entry. 
+ * Entries are numbered across the FM API table followed by the EM API table.
+ *
+ * Request:  hdr.a = Entry index 
+ * Response: hdr.a = Entry index, hdr.b = Total number of entries
+ *           00h API (0 = FM API, 1 = EM API), 01h Lock scope (CSLK), 
+ *           02h Opcode (__u16), 04h Statistics (see metrics_serialize())
  *
  * @param m 	struct mctp* 
  * @param mm 	struct mctp_msg* 
@@ -600,42 +814,39 @@ end:
  *
  * STEPS
  *  1: Initialize variables
- *  2: Checkout Response mctp_msg buffer
+ *  2: Verify Response mctp_msg buffer
  *  3: Fill Response MCTP Header
  *  4: Set buffer pointers 
  *  5: Deserialize Request Header
- *  6: Deserialize Request Object 
- *  7: Extract parameters
- *  8: Obtain lock on switch state 
- *  9: Validate Inputs 
- * 10: Perform Action 
- * 11: Prepare Response Object
- * 12: Serialize Response Object
- * 13: Set return code
- * 14: Release lock on switch state 
- * 15: Fill Response Header
- * 16: Serialize Header 
- * 17: Push Response mctp_msg onto Transmit Message Queue 
- * 18: Checkin mctp_msgs 
+ *  6: Extract parameters
+ *  7: Validate Inputs 
+ *  8: Prepare Response Object
+ *  9: Set return code
+ * 10: Fill Response Header
+ * 11: Serialize Header 
+ * 12: Push Response mctp_msg onto Transmit Message Queue 
  */
-static int emop_unsupported(struct mctp *m, struct mctp_action *ma)
+static int emop_cse_stats(struct mctp *m, struct mctp_action *ma)
 {
 	INIT
-	char now[ISO_TIME_BUF_LEN];
 	struct emapi_msg reqm, rspm;
 	struct emapi_buf *reqb, *rspb;
 	unsigned rc;
-	int rv;
+	int rv, len;
+
+	struct opcode *fm, *em, *op;
+	unsigned num_fm, num_em, index, api;
 
 	ENTER
 
 	STEP // 1: Initialize variables
 	rv = 1; 
-	rc = EMRC_UNSUPPORTED;
-	isotime(now, ISO_TIME_BUF_LEN);
+	len = 0;
+	rc = EMRC_INVALID_INPUT;
+	fm = fmapi_opcodes(&num_fm);
+	em = emapi_opcodes(&num_em);
 
-	STEP // 2: Get response mctp_msg buffer
-	ma->rsp = pq_pop(m->msgs, 1);
+	STEP // 2: Verify Response mctp_msg buffer was checked out by the dispatcher
 	if (ma->rsp == NULL)  
 		goto fail;
 
@@ -651,32 +862,182 @@ static int emop_unsupported(struct mctp *m, struct mctp_action *ma)
 	if ( emapi_deserialize(&reqm.hdr, reqb->hdr, EMOB_HDR, NULL) <= 0 )
 		goto fail;
 
-	STEP // 6: Deserialize Request Object 
+	STEP // 6: Extract parameters
+	index = reqm.hdr.a;
 
-	STEP // 7: Extract parameters
-	IFV(CLVB_COMMANDS) printf("%s ERR: Unsupported Opcode: 0x%04x\n", now, reqm.hdr.opcode);
+	IFV(CLVB_COMMANDS) logger_printf("CMD: EM API CSE Opcode Statistics. Index: %d\n", index);
 
-	STEP // 8: Obtain lock on switch state 
+	STEP // 7: Validate Inputs 
+	if (index < num_fm)
+	{
+		op = &fm[index];
+		api = 0;
+	}
+	else if (index < num_fm + num_em)
+	{
+		op = &em[index - num_fm];
+		api = 1;
+	}
+	else 
+	{
+		IFV(CLVB_ERRORS) logger_printf("ERR: Index out of range. Index: %d Total: %d\n", index, num_fm + num_em);
+		goto send;
+	}
 
-	STEP // 9: Validate Inputs 
+	STEP // 8: Prepare Response Object
+	rspb->payload[0] = api;
+	rspb->payload[1] = op->scope;
+	rspb->payload[2] = op->opcode & 0xFF;
+	rspb->payload[3] = (op->opcode >> 8) & 0xFF;
+	len = 4 + metrics_serialize(&rspb->payload[4], &op->stats);
 
-	STEP // 10: Perform Action 
+	STEP // 9: Set return code
+	rc = EMRC_SUCCESS;
 
-	STEP // 11: Prepare Response Object
+send:
 
-	STEP // 12: Serialize Response Object
+	STEP // 10: Fill Response Header
+	metrics_rc(rc);
+	ma->rsp->len = emapi_fill_hdr(&rspm.hdr, EMMT_RSP, reqm.hdr.tag, rc, reqm.hdr.opcode, len, index, num_fm + num_em);
 
-	STEP // 13: Set return code
+	STEP // 11: Serialize Header 
+	emapi_serialize(rspb->hdr, &rspm.hdr, EMOB_HDR, NULL);
 
-	STEP // 14: Release lock on switch state 
+	STEP // 12: Push response mctp_msg onto queue 
+	pq_push(m->tmq, ma);
 
-	STEP // 15: Fill Response Header
-	ma->rsp->len = emapi_fill_hdr(&rspm.hdr, EMMT_RSP, reqm.hdr.tag, rc, reqm.hdr.opcode, 0, 0, 0);
+	rv = 0;
+	goto end;
 
-	STEP // 16: Serialize Header 
+fail:
+
+	ma->completion_code = 1;	
+	pq_push(m->acq, ma);
+
+end:				
+
+	EXIT(rc)
+
+	return rv;
+}
+
+/**
+ * Handler for CSE vendor EM API Get Pool Statistics Command 
+ *
+ * Returns the response buffer accounting of one FM connection and the queue 
+ * high water marks of the worker threads. The reserve of busy response 
+ * buffers is kept per connection rather than per worker, so its count and 
+ * low water mark are those of the connection in hdr.a.
+ *
+ * Request:  hdr.a = Connection index 
+ * Response: hdr.a = Connection index, hdr.b = Number of connections
+ *           00h Reserve size, 01h Reserve count, 02h Reserve low water mark,
+ *           03h Number of workers, 04h Buffers checked out (__u64), 
+ *           0Ch Pool empty count (__u64), 14h Busy responses (__u64), 
+ *           1Ch Requests dropped (__u64), 24h Queue high water mark of each
+ *           worker (__u16)
+ *
+ * @param m 	struct mctp* 
+ * @param mm 	struct mctp_msg* 
+ * @return 		0 upon success, 1 otherwise
+ *
+ * STEPS
+ *  1: Initialize variables
+ *  2: Verify Response mctp_msg buffer
+ *  3: Fill Response MCTP Header
+ *  4: Set buffer pointers 
+ *  5: Deserialize Request Header
+ *  6: Extract parameters
+ *  7: Validate Inputs 
+ *  8: Prepare Response Object
+ *  9: Set return code
+ * 10: Fill Response Header
+ * 11: Serialize Header 
+ * 12: Push Response mctp_msg onto Transmit Message Queue 
+ */
+static int emop_cse_pool(struct mctp *m, struct mctp_action *ma)
+{
+	INIT
+	struct emapi_msg reqm, rspm;
+	struct emapi_buf *reqb, *rspb;
+	unsigned rc;
+	int rv, len;
+
+	struct respool_stats st;
+	unsigned index, i, k, w;
+	__u64 v[4];
+
+	ENTER
+
+	STEP // 1: Initialize variables
+	rv = 1; 
+	len = 0;
+	rc = EMRC_INVALID_INPUT;
+
+	STEP // 2: Verify Response mctp_msg buffer was checked out by the dispatcher
+	if (ma->rsp == NULL)  
+		goto fail;
+
+	STEP // 3: Fill Response MCTP Header: dst, src, owner, tag, and type 
+	mctp_fill_msg_hdr(ma->rsp, ma->req->src, m->state.eid, 0, ma->req->tag);
+	ma->rsp->type = ma->req->type;
+	
+	STEP // 4: Set buffer pointers 
+	reqb = (struct emapi_buf*) ma->req->payload;
+	rspb = (struct emapi_buf*) ma->rsp->payload;
+
+	STEP // 5: Deserialize Request Header
+	if ( emapi_deserialize(&reqm.hdr, reqb->hdr, EMOB_HDR, NULL) <= 0 )
+		goto fail;
+
+	STEP // 6: Extract parameters
+	index = reqm.hdr.a;
+
+	IFV(CLVB_COMMANDS) logger_printf("CMD: EM API CSE Pool Statistics. Index: %d\n", index);
+
+	STEP // 7: Validate Inputs 
+	if (respool_stats(index, &st) != 0)
+	{
+		IFV(CLVB_ERRORS) logger_printf("ERR: Index out of range. Index: %d Total: %d\n", index, respool_num());
+		goto send;
+	}
+
+	STEP // 8: Prepare Response Object
+	w = workers_num();
+	rspb->payload[0] = RPLN_RESERVE;
+	rspb->payload[1] = st.num;
+	rspb->payload[2] = st.min;
+	rspb->payload[3] = w;
+	len = 4;
+
+	v[0] = st.acquired;
+	v[1] = st.exhausted;
+	v[2] = st.busy;
+	v[3] = st.dropped;
+	for ( i = 0 ; i < 4 ; i++ )
+		for ( k = 0 ; k < 8 ; k++ )
+			rspb->payload[len++] = (v[i] >> (8*k)) & 0xFF;
+
+	for ( i = 0 ; i < w ; i++ )
+	{
+		k = workers_max(i);
+		rspb->payload[len++] = k & 0xFF;
+		rspb->payload[len++] = (k >> 8) & 0xFF;
+	}
+
+	STEP // 9: Set return code
+	rc = EMRC_SUCCESS;
+
+send:
+
+	STEP // 10: Fill Response Header
+	metrics_rc(rc);
+	ma->rsp->len = emapi_fill_hdr(&rspm.hdr, EMMT_RSP, reqm.hdr.tag, rc, reqm.hdr.opcode, len, index, respool_num());
+
+	STEP // 11: Serialize Header 
 	emapi_serialize(rspb->hdr, &rspm.hdr, EMOB_HDR, NULL);
 
-	STEP // 17: Push response mctp_msg onto queue 
+	STEP // 12: Push response mctp_msg onto queue 
 	pq_push(m->tmq, ma);
 
 	rv = 0;
@@ -694,3 +1055,867 @@ end:
 	return rv;
 }
 
+/**
+ * Handler for CSE vendor EM API Connect Device by Name Command 
+ *
+ * Connects a device profile from the device catalog to a physical port by the 
+ * name of the profile. Unlike the Connect Device command this is not limited 
+ * to the first 256 entries of the catalog.
+ *
+ * Request:  hdr.a = PPID, payload = Device profile name (hdr.len bytes)
+ * Response: hdr.a = PPID, 00h Index of the device in the catalog (__u16)
+ *
+ * @param m 	struct mctp* 
+ * @param mm 	struct mctp_msg* 
+ * @return 		0 upon success, 1 otherwise
+ *
+ * STEPS
+ *  1: Initialize variables
+ *  2: Verify Response mctp_msg buffer
+ *  3: Fill Response MCTP Header
+ *  4: Set buffer pointers 
+ *  5: Deserialize Request Header
+ *  6: Extract parameters
+ *  7: Obtain lock on switch state 
+ *  8: Validate Inputs 
+ *  9: Perform Action 
+ * 10: Prepare Response Object
+ * 11: Set return code
+ * 12: Release lock on switch state 
+ * 13: Fill Response Header
+ * 14: Serialize Header 
+ * 15: Push Response mctp_msg onto Transmit Message Queue 
+ */
+static int emop_cse_conn_name(struct mctp *m, struct mctp_action *ma)
+{
+	INIT
+	struct emapi_msg reqm, rspm;
+	struct emapi_buf *reqb, *rspb;
+	unsigned rc;
+	int rv, len, dev, locked;
+
+	char name[MAX_FILE_NAME_LEN];
+	unsigned n;
+	__u8 ppid;
+
+	ENTER
+
+	STEP // 1: Initialize variables
+	rv = 1; 
+	len = 0;
+	rc = EMRC_INVALID_INPUT;
+	ppid = 0;
+	locked = 0;
+
+	STEP // 2: Verify Response mctp_msg buffer was checked out by the dispatcher
+	if (ma->rsp == NULL)  
+		goto fail;
+
+	STEP // 3: Fill Response MCTP Header: dst, src, owner, tag, and type 
+	mctp_fill_msg_hdr(ma->rsp, ma->req->src, m->state.eid, 0, ma->req->tag);
+	ma->rsp->type = ma->req->type;
+	
+	STEP // 4: Set buffer pointers 
+	reqb = (struct emapi_buf*) ma->req->payload;
+	rspb = (struct emapi_buf*) ma->rsp->payload;
+
+	STEP // 5: Deserialize Request Header
+	if ( emapi_deserialize(&reqm.hdr, reqb->hdr, EMOB_HDR, NULL) <= 0 )
+		goto fail;
+
+	STEP // 6: Extract parameters
+	ppid = reqm.hdr.a;
+	n = reqm.hdr.len;
+
+	// The length in the header comes from the FM, the name must have been received
+	if (EMLN_HDR + n > ma->req->len)
+	{
+		IFV(CLVB_ERRORS) logger_printf("ERR: Request payload length exceeds message length. Payload: %d Message: %d\n", reqm.hdr.len, ma->req->len);
+		goto send;
+	}
+
+	if (n >= MAX_FILE_NAME_LEN)
+		n = MAX_FILE_NAME_LEN - 1;
+	memcpy(name, reqb->payload, n);
+	name[n] = 0;
+
+	IFV(CLVB_COMMANDS) logger_printf("CMD: EM API CSE Connect Device by Name. PPID: %d Device: %s\n", ppid, name);
+
+	STEP // 7: Obtain lock on switch state 
+	state_lock_topology();
+	locked = 1;
+
+	STEP // 8: Validate Inputs 
+	if (ppid >= cxls->num_ports)
+	{
+		IFV(CLVB_ERRORS) logger_printf("ERR: PPID out of range. PPID: %d Total: %d\n", ppid, cxls->num_ports);
+		goto send;
+	}
+	state_lock_port(ppid);
+
+	dev = state_device_find(name);
+	if (dev < 0) 
+	{
+		IFV(CLVB_ERRORS) logger_printf("ERR: Device not found. Device: %s\n", name);
+		goto send;
+	}
+
+	IFV(CLVB_ACTIONS) logger_printf("ACT: Connecting Device %s (%d) to PPID %d\n", name, dev, ppid);
+
+	STEP // 9: Perform Action 
+	memspace_connect(&cxls->ports[ppid], &cxls->devices[dev], cxls->dir);	
+	state_gen_bump(STATE_GEN_PORT, ppid);
+	events_post(EVTY_CONNECT, ppid);
+
+	STEP // 10: Prepare Response Object
+	rspb->payload[0] = dev & 0xFF;
+	rspb->payload[1] = (dev >> 8) & 0xFF;
+	len = 2;
+
+	STEP // 11: Set return code
+	rc = EMRC_SUCCESS;
+
+send:
+
+	STEP // 12: Release lock on switch state 
+	if (locked)
+	{
+		if (ppid < cxls->num_ports)
+			state_unlock_port(ppid);
+		state_unlock_topology();
+	}
+
+	STEP // 13: Fill Response Header
+	metrics_rc(rc);
+	ma->rsp->len = emapi_fill_hdr(&rspm.hdr, EMMT_RSP, reqm.hdr.tag, rc, reqm.hdr.opcode, len, ppid, 0);
+
+	STEP // 14: Serialize Header 
+	emapi_serialize(rspb->hdr, &rspm.hdr, EMOB_HDR, NULL);
+
+	STEP // 15: Push response mctp_msg onto queue 
+	pq_push(m->tmq, ma);
+
+	rv = 0;
+	goto end;
+
+fail:
+
+	ma->completion_code = 1;	
+	pq_push(m->acq, ma);
+
+end:				
+
+	EXIT(rc)
+
+	return rv;
+}
+
+/**
+ * Handler for CSE vendor EM API LD Memory Transfer Command 
+ *
+ * Moves a range of the memory space of an LD in one request. Reads and writes
+ * carry up to EMLN_XFER_MAX bytes, bounded by the MCTP transmission unit 
+ * rather than the 4 KB limit of the FM API MPC Memory command, and a client 
+ * may keep several requests with different tags in flight to stream a large 
+ * range. Loads and saves move the range directly between the memory space 
+ * and a file in the transfer directory in EMLN_XFER_CHUNK pieces. The port 
+ * lock is released between pieces so other requests for the port are not 
+ * held up, and a request stops after EMLN_XFER_FILE_MAX bytes. The response
+ * reports the bytes left so the FM can follow the progress of a large image
+ * and resume it, or stop by not asking for the rest.
+ *
+ * Request:  hdr.a = PPID, hdr.b = LDID
+ *           00h Transfer type [EMXT] (__u8)
+ *           04h Length in bytes (__u32). 0 with a load or save moves the rest
+ *               of the LD, or for a load the rest of the file if it is shorter
+ *           08h Byte offset into the LD (__u64)
+ *           10h Write: data. Load / Save: byte offset into the file (__u64)
+ *           18h Load / Save: file name (to the end of the payload)
+ * Response: hdr.a = PPID, hdr.b = LDID
+ *           00h Bytes transferred (__u32)
+ *           04h Read: data. Load / Save: bytes of the request left (__u64). 
+ *               Resume at the offsets plus the bytes transferred. A load that
+ *               is short with none left reached the end of the file
+ *
+ * @param m 	struct mctp* 
+ * @param mm 	struct mctp_msg* 
+ * @return 		0 upon success, 1 otherwise
+ *
+ * STEPS
+ *  1: Initialize variables
+ *  2: Verify Response mctp_msg buffer
+ *  3: Fill Response MCTP Header
+ *  4: Set buffer pointers 
+ *  5: Deserialize Request Header
+ *  6: Extract parameters
+ *  7: Obtain lock on port 
+ *  8: Validate Inputs 
+ *  9: Perform Action 
+ * 10: Prepare Response Object
+ * 11: Set return code
+ * 12: Release lock on port 
+ * 13: Fill Response Header
+ * 14: Serialize Header 
+ * 15: Push Response mctp_msg onto Transmit Message Queue 
+ */
+static int emop_cse_ld_xfer(struct mctp *m, struct mctp_action *ma)
+{
+	INIT
+	struct emapi_msg reqm, rspm;
+	struct emapi_buf *reqb, *rspb;
+	unsigned rc;
+	int rv, len, fd;
+
+	struct cxl_port *p;
+	char name[MAX_FILE_NAME_LEN];
+	__u64 offset, foffset, base, ld_size, count, done, left, chunk, moved;
+	__u8 ppid, ldid, type, *mem;
+	unsigned n;
+
+	ENTER
+
+	STEP // 1: Initialize variables
+	rv = 1; 
+	len = 0;
+	rc = EMRC_INVALID_INPUT;
+	p = NULL;
+	ppid = 0;
+	ldid = 0;
+	done = 0;
+	left = 0;
+	fd = -1;
+
+	STEP // 2: Verify Response mctp_msg buffer was checked out by the dispatcher
+	if (ma->rsp == NULL)  
+		goto fail;
+
+	STEP // 3: Fill Response MCTP Header: dst, src, owner, tag, and type 
+	mctp_fill_msg_hdr(ma->rsp, ma->req->src, m->state.eid, 0, ma->req->tag);
+	ma->rsp->type = ma->req->type;
+	
+	STEP // 4: Set buffer pointers 
+	reqb = (struct emapi_buf*) ma->req->payload;
+	rspb = (struct emapi_buf*) ma->rsp->payload;
+
+	STEP // 5: Deserialize Request Header
+	if ( emapi_deserialize(&reqm.hdr, reqb->hdr, EMOB_HDR, NULL) <= 0 )
+		goto fail;
+
+	STEP // 6: Extract parameters
+	ppid = reqm.hdr.a;
+	ldid = reqm.hdr.b;
+	if (reqm.hdr.len < EMLN_XFER_REQ_HDR)
+		goto send;
+
+	// The length in the header comes from the FM, the payload must have been received
+	if (EMLN_HDR + (unsigned) reqm.hdr.len > ma->req->len)
+	{
+		IFV(CLVB_ERRORS) logger_printf("ERR: Request payload length exceeds message length. Payload: %d Message: %d\n", reqm.hdr.len, ma->req->len);
+		goto send;
+	}
+
+	type   = reqb->payload[0];
+	count  = (__u64) reqb->payload[4] | (__u64) reqb->payload[5] << 8 | (__u64) reqb->payload[6] << 16 | (__u64) reqb->payload[7] << 24;
+	offset = 0;
+	for ( n = 0 ; n < 8 ; n++ )
+		offset |= (__u64) reqb->payload[8 + n] << (8 * n);
+
+	IFV(CLVB_COMMANDS) logger_printf("CMD: EM API CSE LD Memory Transfer. PPID: %d LDID: %d Type: %d Offset: 0x%llx Len: %llu\n", ppid, ldid, type, offset, count);
+
+	STEP // 7: Obtain lock on port 
+	// Obtained below once the port number has been validated
+
+	STEP // 8: Validate Inputs 
+	if (ppid >= cxls->num_ports)
+	{
+		IFV(CLVB_ERRORS) logger_printf("ERR: PPID out of range. PPID: %d Total: %d\n", ppid, cxls->num_ports);
+		goto send;
+	}
+	p = &cxls->ports[ppid];
+	state_lock_port(ppid);
+
+	if ( !(p->dt == FMDT_CXL_TYPE_3 || p->dt == FMDT_CXL_TYPE_3_POOLED) ) 
+	{
+		IFV(CLVB_ERRORS) logger_printf("ERR: Port is not Type 3 device. Requested Type: %s\n", fmdt(p->dt));
+		goto send;
+	}
+
+	if (ldid >= p->ld) 
+	{
+		IFV(CLVB_ERRORS) logger_printf("ERR: Requested LD ID exceeds supported LD count of specified port. LDID: %d\n", ldid);
+		goto send;
+	}
+
+	if (p->mld == NULL || memspace_get(p) == NULL) 
+	{
+		IFV(CLVB_ERRORS) logger_printf("ERR: Requested port does not have memory space on the specified port. Port: %d\n", ppid);
+		rc = EMRC_UNSUPPORTED;
+		goto send;
+	}
+
+	if (state_ld_memrange(p, ldid, &base, &ld_size) != 0)
+	{
+		IFV(CLVB_ERRORS) logger_printf("ERR: LD range exceeds the memory space of the port. PPID: %d LDID: %d\n", ppid, ldid);
+		goto send;
+	}
+
+	if (offset >= ld_size) 
+	{
+		IFV(CLVB_ERRORS) logger_printf("ERR: Requested offset exceeds size of LD. LD size (Bytes): %llu Offset: %llu\n", ld_size, offset);
+		goto send;
+	}
+
+	// A load or save of length 0 covers the rest of the LD
+	if (count == 0 && (type == EMXT_LOAD || type == EMXT_SAVE))
+		count = ld_size - offset;
+
+	if (count > ld_size - offset) 
+	{
+		IFV(CLVB_ERRORS) logger_printf("ERR: Requested offset + length exceeds size of LD. LD size (Bytes): %llu Requested up to Byte: %llu\n", ld_size, offset + count);
+		goto send;
+	}
+	mem = &p->mld->memspace[base + offset];
+
+	STEP // 9: Perform Action 
+	switch (type)
+	{
+		case EMXT_READ:
+			if (count > EMLN_XFER_MAX)
+			{
+				IFV(CLVB_ERRORS) logger_printf("ERR: Requested length exceeds maximum length supported. Max: %d Len: %llu\n", EMLN_XFER_MAX, count);
+				goto send;
+			}
+
+			if (qos_charge(p, ldid, count) != 0)
+			{
+				rc = EMRC_BUSY;
+				goto send;
+			}
+
+			IFV(CLVB_ACTIONS) logger_printf("ACT: Reading %llu bytes of LD memory on PPID: %d LDID: %d\n", count, ppid, ldid);
+			memcpy(&rspb->payload[EMLN_XFER_RSP_HDR], mem, count);
+			done = count;
+			break;
+
+		case EMXT_WRITE:
+			if (count > EMLN_XFER_MAX)
+			{
+				IFV(CLVB_ERRORS) logger_printf("ERR: Requested length exceeds maximum length supported. Max: %d Len: %llu\n", EMLN_XFER_MAX, count);
+				goto send;
+			}
+
+			if (reqm.hdr.len < EMLN_XFER_REQ_HDR + count || EMLN_HDR + EMLN_XFER_REQ_HDR + count > ma->req->len)
+			{
+				IFV(CLVB_ERRORS) logger_printf("ERR: Request payload shorter than transfer length. Payload: %d Len: %llu\n", reqm.hdr.len, count);
+				goto send;
+			}
+
+			if (qos_charge(p, ldid, count) != 0)
+			{
+				rc = EMRC_BUSY;
+				goto send;
+			}
+
+			IFV(CLVB_ACTIONS) logger_printf("ACT: Writing %llu bytes of LD memory on PPID: %d LDID: %d\n", count, ppid, ldid);
+			memcpy(mem, &reqb->payload[EMLN_XFER_REQ_HDR], count);
+			done = count;
+			break;
+
+		case EMXT_LOAD:
+		case EMXT_SAVE:
+			if (reqm.hdr.len <= EMLN_XFER_FILE_HDR)
+			{
+				IFV(CLVB_ERRORS) logger_printf("ERR: Request does not carry a file name\n");
+				goto send;
+			}
+
+			foffset = 0;
+			for ( n = 0 ; n < 8 ; n++ )
+				foffset |= (__u64) reqb->payload[EMLN_XFER_REQ_HDR + n] << (8 * n);
+
+			n = reqm.hdr.len - EMLN_XFER_FILE_HDR;
+			if (n >= MAX_FILE_NAME_LEN)
+				n = MAX_FILE_NAME_LEN - 1;
+			memcpy(name, &reqb->payload[EMLN_XFER_FILE_HDR], n);
+			name[n] = 0;
+
+			// Host files are only reachable when a transfer directory is set
+			if (!opts[CLOP_XFER_DIR].set)
+			{
+				IFV(CLVB_ERRORS) logger_printf("ERR: LD memory loads and saves are disabled, no transfer directory is set\n");
+				rc = EMRC_UNSUPPORTED;
+				goto send;
+			}
+
+			fd = emop_xfer_open(type, name);
+			if (fd < 0)
+			{
+				IFV(CLVB_ERRORS) logger_printf("ERR: Could not open host file: %s\n", name);
+				goto send;
+			}
+
+			IFV(CLVB_ACTIONS) logger_printf("ACT: %s %llu bytes of LD memory on PPID: %d LDID: %d %s %s\n", type == EMXT_LOAD ? "Loading" : "Saving", count, ppid, ldid, type == EMXT_LOAD ? "from" : "to", name);
+
+			while (done < count)
+			{
+				if (done >= EMLN_XFER_FILE_MAX)
+				{
+					left = count - done;
+					break;
+				}
+
+				chunk = count - done;
+				if (chunk > EMLN_XFER_CHUNK)
+					chunk = EMLN_XFER_CHUNK;
+
+				moved = emop_xfer_file(type, fd, &mem[done], foffset + done, chunk);
+				done += moved;
+				if (moved < chunk || done == count)
+					break;
+
+				// Let other requests for the port in between chunks
+				state_unlock_port(ppid);
+				state_lock_port(ppid);
+
+				// The device may have been disconnected or the LD resized meanwhile
+				mem = emop_xfer_mem(ppid, ldid, base, ld_size);
+				if (mem == NULL)
+				{
+					IFV(CLVB_ERRORS) logger_printf("ERR: LD changed during transfer. PPID: %d LDID: %d Transferred: %llu\n", ppid, ldid, done);
+					left = count - done;
+					break;
+				}
+				mem = &mem[offset];
+				p = &cxls->ports[ppid];
+			}
+			close(fd);
+
+			// A short load is the end of the file, a short save is an error
+			if (type == EMXT_SAVE && done < count && left == 0)
+			{
+				IFV(CLVB_ERRORS) logger_printf("ERR: Could not write host file: %s Written: %llu\n", name, done);
+				goto send;
+			}
+			break;
+
+		default:
+			IFV(CLVB_ERRORS) logger_printf("ERR: Invalid transfer type. Type: %d\n", type);
+			goto send;
+	}
+
+	STEP // 10: Prepare Response Object
+	// Reads are limited to EMLN_XFER_MAX so the count of a read always fits
+	if (done > 0xFFFFFFFF)
+		done = 0xFFFFFFFF;
+	rspb->payload[0] = done & 0xFF;
+	rspb->payload[1] = (done >> 8) & 0xFF;
+	rspb->payload[2] = (done >> 16) & 0xFF;
+	rspb->payload[3] = (done >> 24) & 0xFF;
+	len = EMLN_XFER_RSP_HDR + (type == EMXT_READ ? done : 0);
+
+	if (type == EMXT_LOAD || type == EMXT_SAVE)
+	{
+		for ( n = 0 ; n < 8 ; n++ )
+			rspb->payload[EMLN_XFER_RSP_HDR + n] = (left >> (8 * n)) & 0xFF;
+		len = EMLN_XFER_FILE_RSP;
+	}
+
+	STEP // 11: Set return code
+	rc = EMRC_SUCCESS;
+
+send:
+
+	STEP // 12: Release lock on port 
+	if (p != NULL)
+		state_unlock_port(ppid);
+
+	STEP // 13: Fill Response Header
+	metrics_rc(rc);
+	ma->rsp->len = emapi_fill_hdr(&rspm.hdr, EMMT_RSP, reqm.hdr.tag, rc, reqm.hdr.opcode, len, ppid, ldid);
+
+	STEP // 14: Serialize Header 
+	emapi_serialize(rspb->hdr, &rspm.hdr, EMOB_HDR, NULL);
+
+	STEP // 15: Push response mctp_msg onto queue 
+	pq_push(m->tmq, ma);
+
+	rv = 0;
+	goto end;
+
+fail:
+
+	ma->completion_code = 1;	
+	pq_push(m->acq, ma);
+
+end:				
+
+	EXIT(rc)
+
+	return rv;
+}
+
+/**
+ * Open a load or save file in the transfer directory
+ *
+ * The name comes from the FM, so it must be relative to the transfer 
+ * directory and may not climb out of it. Absolute names and names with a ..
+ * component are rejected, and a symbolic link is not followed
+ *
+ * @param type 		EMXT_LOAD to open for reading, EMXT_SAVE to open for writing
+ * @param name 		File name from the request
+ * @return 			File descriptor, -1 upon error
+ */
+static int emop_xfer_open(int type, char *name)
+{
+	char path[EMLN_XFER_PATH];
+	char *c;
+	int flags;
+
+	if (name[0] == 0 || name[0] == '/')
+		return -1;
+
+	// Look for .. between the start, separators and the end of the name
+	for ( c = name ; c != NULL ; c = strchr(c, '/') )
+	{
+		if (*c == '/')
+			c++;
+		if (c[0] == '.' && c[1] == '.' && (c[2] == '/' || c[2] == 0))
+			return -1;
+	}
+
+	if (snprintf(path, EMLN_XFER_PATH, "%s/%s", opts[CLOP_XFER_DIR].str, name) >= EMLN_XFER_PATH)
+		return -1;
+
+	flags = O_NOFOLLOW | O_CLOEXEC;
+	if (type == EMXT_LOAD)
+		return open(path, O_RDONLY | flags);
+	else 
+		return open(path, O_WRONLY | O_CREAT | flags, 0644);
+}
+
+/**
+ * Find the LD memory of a transfer again after the port lock was re-taken
+ *
+ * Call with the port lock held
+ *
+ * @param base 	Offset of the LD into the memory space when the transfer started
+ * @param size 	Size of the LD when the transfer started
+ * @return 		Start of the LD memory, NULL if the port no longer has the same LD
+ */
+static __u8 *emop_xfer_mem(unsigned ppid, unsigned ldid, __u64 base, __u64 size)
+{
+	struct cxl_port *p;
+	__u64 b, s;
+
+	if (ppid >= cxls->num_ports)
+		return NULL;
+	p = &cxls->ports[ppid];
+
+	if ( !(p->dt == FMDT_CXL_TYPE_3 || p->dt == FMDT_CXL_TYPE_3_POOLED) || ldid >= p->ld ) 
+		return NULL;
+
+	if (p->mld == NULL || memspace_get(p) == NULL)
+		return NULL;
+
+	if (state_ld_memrange(p, ldid, &b, &s) != 0 || b != base || s != size)
+		return NULL;
+
+	return &p->mld->memspace[base];
+}
+
+/**
+ * Move bytes between LD memory and a host file in EMLN_XFER_CHUNK pieces
+ *
+ * @param type 		EMXT_LOAD to read the file into memory, EMXT_SAVE to write it
+ * @param fd 		Open file descriptor
+ * @param mem 		Start of the range of LD memory
+ * @param foffset 	Byte offset into the file
+ * @param len 		Number of bytes to move
+ * @return 			Number of bytes moved. Less than len at the end of the file or
+ * 					upon error 
+ */
+static __u64 emop_xfer_file(int type, int fd, __u8 *mem, __u64 foffset, __u64 len)
+{
+	__u64 done, chunk;
+	ssize_t n;
+
+	done = 0;
+	while (done < len)
+	{
+		chunk = len - done;
+		if (chunk > EMLN_XFER_CHUNK)
+			chunk = EMLN_XFER_CHUNK;
+
+		if (type == EMXT_LOAD)
+			n = pread(fd, &mem[done], chunk, foffset + done);
+		else 
+			n = pwrite(fd, &mem[done], chunk, foffset + done);
+		if (n <= 0)
+			break;
+
+		done += n;
+	}
+
+	return done;
+}
+
+/**
+ * Handler for EM API Event Opcode
+ *
+ * Returns the switch state changes after the sequence number in the request,
+ * coalesced into one record per port. If there are none the request waits 
+ * for up to the timeout for one to be posted, so a Fabric Manager can follow
+ * connects, disconnects and bind completion with one outstanding request 
+ * rather than polling. The response layout is described in events.c
+ *
+ * Request:  00h Last sequence number seen, 0 for none (__u64)
+ *           08h Timeout in ms, 0 to return at once (__u32)
+ *           0Ch Event types of interest [EVTY], 0 for all (__u32)
+ *
+ * @param m 	struct mctp* 
+ * @param mm 	struct mctp_msg* 
+ * @return 		0 upon success, 1 otherwise
+ *
+ * STEPS
+ *  1: Initialize variables
+ *  2: Verify Response mctp_msg buffer
+ *  3: Fill Response MCTP Header
+ *  4: Set buffer pointers 
+ *  5: Deserialize Request Header
+ *  6: Extract parameters
+ *  7: Validate Inputs 
+ *  8: Respond now or wait for an event
+ */
+static int emop_event(struct mctp *m, struct mctp_action *ma)
+{
+	INIT
+	struct emapi_msg reqm, rspm;
+	struct emapi_buf *reqb, *rspb;
+	unsigned rc, n;
+	int rv;
+	__u64 seq;
+	__u32 timeout, mask;
+
+	ENTER
+
+	STEP // 1: Initialize variables
+	rv = 1; 
+	rc = EMRC_INVALID_INPUT;
+
+	STEP // 2: Verify Response mctp_msg buffer was checked out by the dispatcher
+	if (ma->rsp == NULL)  
+		goto fail;
+
+	STEP // 3: Fill Response MCTP Header: dst, src, owner, tag, and type 
+	mctp_fill_msg_hdr(ma->rsp, ma->req->src, m->state.eid, 0, ma->req->tag);
+	ma->rsp->type = ma->req->type;
+	
+	STEP // 4: Set buffer pointers 
+	reqb = (struct emapi_buf*) ma->req->payload;
+	rspb = (struct emapi_buf*) ma->rsp->payload;
+
+	STEP // 5: Deserialize Request Header
+	if ( emapi_deserialize(&reqm.hdr, reqb->hdr, EMOB_HDR, NULL) <= 0 )
+		goto fail;
+
+	STEP // 6: Extract parameters
+	if (reqm.hdr.len < EVLN_REQ)
+	{
+		IFV(CLVB_ERRORS) logger_printf("ERR: Event request too short. Len: %d\n", reqm.hdr.len);
+		goto send;
+	}
+
+	seq = 0;
+	for ( n = 0 ; n < 8 ; n++ )
+		seq |= (__u64) reqb->payload[n] << (8 * n);
+	timeout = (__u32) reqb->payload[8]  | (__u32) reqb->payload[9]  << 8 | (__u32) reqb->payload[10] << 16 | (__u32) reqb->payload[11] << 24;
+	mask    = (__u32) reqb->payload[12] | (__u32) reqb->payload[13] << 8 | (__u32) reqb->payload[14] << 16 | (__u32) reqb->payload[15] << 24;
+
+	IFV(CLVB_COMMANDS) logger_printf("CMD: EM API Event. Seq: %llu Timeout: %u Mask: 0x%x\n", seq, timeout, mask);
+
+	STEP // 7: Validate Inputs 
+	if (mask & ~EVTY_ALL)
+	{
+		IFV(CLVB_ERRORS) logger_printf("ERR: Invalid event types. Mask: 0x%x\n", mask);
+		goto send;
+	}
+
+	STEP // 8: Respond now or wait for an event
+	events_wait(m, ma, reqm.hdr.tag, reqm.hdr.opcode, seq, mask, timeout);
+
+	rv = 0;
+	goto end;
+
+send:
+
+	metrics_rc(rc);
+	ma->rsp->len = emapi_fill_hdr(&rspm.hdr, EMMT_RSP, reqm.hdr.tag, rc, reqm.hdr.opcode, 0, 0, 0);
+	emapi_serialize(rspb->hdr, &rspm.hdr, EMOB_HDR, NULL);
+	pq_push(m->tmq, ma);
+
+	rv = 0;
+	goto end;
+
+fail:
+
+	ma->completion_code = 1;	
+	pq_push(m->acq, ma);
+
+end:				
+
+	EXIT(rc)
+
+	return rv;
+}
+
+/**
+ * Handler for EM API Unsupported Opcode
+ *
+ * @param m 	struct mctp* 
+ * @param mm 	struct mctp_msg* 
+ * @return 		0 upon success, 1 otherwise
+ *
+ * STEPS
+ *  1: Initialize variables
+ *  2: Verify Response mctp_msg buffer
+ *  3: Fill Response MCTP Header
+ *  4: Set buffer pointers 
+ *  5: Deserialize Request Header
+ *  6: Deserialize Request Object 
+ *  7: Extract parameters
+ *  8: Obtain lock on switch state 
+ *  9: Validate Inputs 
+ * 10: Perform Action 
+ * 11: Prepare Response Object
+ * 12: Serialize Response Object
+ * 13: Set return code
+ * 14: Release lock on switch state 
+ * 15: Fill Response Header
+ * 16: Serialize Header 
+ * 17: Push Response mctp_msg onto Transmit Message Queue 
+ * 18: Checkin mctp_msgs 
+ */
+static int emop_unsupported(struct mctp *m, struct mctp_action *ma)
+{
+	INIT
+	struct emapi_msg reqm, rspm;
+	struct emapi_buf *reqb, *rspb;
+	unsigned rc;
+	int rv;
+
+	ENTER
+
+	STEP // 1: Initialize variables
+	rv = 1; 
+	rc = EMRC_UNSUPPORTED;
+
+	STEP // 2: Verify Response mctp_msg buffer was checked out by the dispatcher
+	if (ma->rsp == NULL)  
+		goto fail;
+
+	STEP // 3: Fill Response MCTP Header: dst, src, owner, tag, and type 
+	mctp_fill_msg_hdr(ma->rsp, ma->req->src, m->state.eid, 0, ma->req->tag);
+	ma->rsp->type = ma->req->type;
+	
+	STEP // 4: Set buffer pointers 
+	reqb = (struct emapi_buf*) ma->req->payload;
+	rspb = (struct emapi_buf*) ma->rsp->payload;
+
+	STEP // 5: Deserialize Request Header
+	if ( emapi_deserialize(&reqm.hdr, reqb->hdr, EMOB_HDR, NULL) <= 0 )
+		goto fail;
+
+	STEP // 6: Deserialize Request Object 
+
+	STEP // 7: Extract parameters
+	IFV(CLVB_COMMANDS) logger_printf("ERR: Unsupported Opcode: 0x%04x\n", reqm.hdr.opcode);
+
+	STEP // 8: Obtain lock on switch state 
+
+	STEP // 9: Validate Inputs 
+
+	STEP // 10: Perform Action 
+
+	STEP // 11: Prepare Response Object
+
+	STEP // 12: Serialize Response Object
+
+	STEP // 13: Set return code
+
+	STEP // 14: Release lock on switch state 
+
+	STEP // 15: Fill Response Header
+	metrics_rc(rc);
+	ma->rsp->len = emapi_fill_hdr(&rspm.hdr, EMMT_RSP, reqm.hdr.tag, rc, reqm.hdr.opcode, 0, 0, 0);
+
+	STEP // 16: Serialize Header 
+	emapi_serialize(rspb->hdr, &rspm.hdr, EMOB_HDR, NULL);
+
+	STEP // 17: Push response mctp_msg onto queue 
+	pq_push(m->tmq, ma);
+
+	rv = 0;
+	goto end;
+
+fail:
+
+	ma->completion_code = 1;	
+	pq_push(m->acq, ma);
+
+end:				
+
+	EXIT(rc)
+
+	return rv;
+}
+
+/**
+ * Respond busy to a request using a buffer from the response reserve 
+ *
+ * @param hdr 	struct emapi_hdr* of the decoded request
+ * @return 		0 upon success, 1 if no reserve buffer was available
+ */
+static int emop_busy(struct mctp *m, struct mctp_action *ma, struct emapi_hdr *hdr)
+{
+	struct emapi_hdr rsp;
+
+	ma->rsp = respool_get_reserve(m);
+	if (ma->rsp == NULL)
+		return 1;
+
+	mctp_fill_msg_hdr(ma->rsp, ma->req->src, m->state.eid, 0, ma->req->tag);
+	ma->rsp->type = ma->req->type;
+
+	metrics_rc(EMRC_BUSY);
+	ma->rsp->len = emapi_fill_hdr(&rsp, EMMT_RSP, hdr->tag, EMRC_BUSY, hdr->opcode, 0, 0, 0);
+	emapi_serialize(((struct emapi_buf*) ma->rsp->payload)->hdr, &rsp, EMOB_HDR, NULL);
+
+	pq_push(m->tmq, ma);
+
+	return 0;
+}
+
+/**
+ * Fill in the object types of emops[] from the EM API library and sort it
+ */
+static void emop_table_init()
+{
+	unsigned i, num;
+
+	num = sizeof(emops) / sizeof(struct opcode);
+	for ( i = 0 ; i < num ; i++ ) 
+	{
+		emops[i].req_obj = emapi_emob_req(emops[i].opcode);
+		emops[i].rsp_obj = emapi_emob_rsp(emops[i].opcode);
+	}
+
+	qsort(emops, num, sizeof(struct opcode), emop_cmp);
+}
+
+/**
+ * Compare two struct opcode by opcode for qsort()
+ */
+static int emop_cmp(const void *a, const void *b)
+{
+	return (int) ((struct opcode*) a)->opcode - (int) ((struct opcode*) b)->opcode;
+}
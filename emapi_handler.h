@@ -20,15 +20,55 @@
  */
 #include <mctp.h>
 
+/* struct opcode
+ */
+#include "dispatch.h"
+
 /* MACROS ====================================================================*/
 
+/**
+ * CSE vendor specific EM API opcode to read per opcode statistics
+ */
+#define EMOP_CSE_STATS 		0x80
+
+/**
+ * CSE vendor specific EM API opcode to read response buffer and worker queue
+ * high water marks
+ */
+#define EMOP_CSE_POOL 		0x81
+
+/**
+ * CSE vendor specific EM API opcode to connect a device to a port by the name
+ * of its device profile
+ */
+#define EMOP_CSE_CONN_NAME 	0x82
+
+/**
+ * CSE vendor specific EM API opcode to transfer a range of LD memory to or 
+ * from the FM or a file on the host 
+ */
+#define EMOP_CSE_LD_XFER 	0x83
+
 /* ENUMERATIONS ==============================================================*/
 
+/**
+ * CSE LD Memory Transfer types (XT)
+ */
+enum _EMXT
+{
+	EMXT_READ 		= 0, 	//!< Return LD memory in the response
+	EMXT_WRITE 		= 1, 	//!< Write the request payload to LD memory
+	EMXT_LOAD 		= 2, 	//!< Read a host file into LD memory
+	EMXT_SAVE 		= 3, 	//!< Write LD memory to a host file
+	EMXT_MAX
+};
+
 /* STRUCTS ===================================================================*/
 
 /* PROTOTYPES ================================================================*/
 
 int emapi_handler(struct mctp *m, struct mctp_action *ma);
+struct opcode *emapi_opcodes(unsigned *num);
 
 /* GLOBAL VARIABLES ==========================================================*/
 
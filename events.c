@@ -0,0 +1,505 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		events.c
+ *
+ * @brief 		Code file for switch state change notifications
+ *
+ * @details 	Code that changes the switch state posts an event naming the
+ * 				port and what happened. Events are numbered and kept in a
+ * 				ring. A Fabric Manager sends an EM API Event request carrying
+ * 				the last sequence number it has seen and how long it is
+ * 				willing to wait. If newer events are present it is answered
+ * 				at once, otherwise the request is parked until an event is
+ * 				posted or the wait expires. The events of each port are
+ * 				coalesced into a bit mask so a response has at most one
+ * 				record per port no matter how many events occurred.
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ */
+/* INCLUDES ==================================================================*/
+
+/* gettid()
+ */
+#define _GNU_SOURCE
+
+#include <unistd.h>
+
+/* printf()
+ */
+#include <stdio.h>
+
+/* memset()
+ */
+#include <string.h>
+
+/* clock_gettime()
+ */
+#include <time.h>
+
+/* pthread_create()
+ * pthread_mutex_t
+ * pthread_cond_t
+ */
+#include <pthread.h>
+
+#include <mctp.h>
+#include <ptrqueue.h>
+#include <emapi.h>
+
+#include "options.h"
+
+#include "trace.h"
+
+#include "metrics.h"
+
+#include "state.h"
+
+#include "events.h"
+
+/* MACROS ====================================================================*/
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/**
+ * Entry of the event ring
+ */
+struct evrec
+{
+	__u64 seq;
+	__u16 type; 		//!< enum _EVTY
+	__u16 ppid; 		//!< PPID or EVLN_SWITCH
+	__u16 sw; 			//!< Switch the event is about [cxls_id]
+};
+
+/**
+ * Event request waiting for an event
+ */
+struct evwait
+{
+	struct mctp *m;
+	struct mctp_action *ma;
+	unsigned sw; 				//!< Switch the requester manages [cxls_id]
+	__u64 seq; 					//!< Last sequence number seen by the requester
+	__u32 mask; 				//!< Event types of interest
+	struct timespec deadline; 	//!< When to answer with no events
+	__u8 tag;
+	__u8 opcode;
+	int used;
+};
+
+/* PROTOTYPES ================================================================*/
+
+static void *events_run(void *arg);
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/**
+ * Event ring. The entry of sequence number n is ring[n % EVLN_RING]
+ *
+ * The events of all switches share the ring and its sequence numbers. A 
+ * requester is only told about the events of its own switch
+ */
+static struct evrec ring[EVLN_RING];
+
+/**
+ * Sequence number of the last posted event, 0 if none
+ */
+static __u64 evseq = 0;
+
+/**
+ * Parked event requests
+ */
+static struct evwait waiters[EVLN_WAITERS];
+
+/**
+ * Delivery thread state. All fields above are guarded by mtx
+ */
+static pthread_t thread;
+static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond;
+static struct timespec flush_at; 	//!< When posted events are delivered
+static int pending = 0; 			//!< 1 if events were posted since the last delivery
+static int stop = 0;
+static int running = 0;
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Return 1 if time a is at or after time b
+ */
+static int _ev_after(struct timespec *a, struct timespec *b)
+{
+	return a->tv_sec > b->tv_sec || (a->tv_sec == b->tv_sec && a->tv_nsec >= b->tv_nsec);
+}
+
+/**
+ * Set ts to now plus ms milliseconds on the monotonic clock
+ */
+static void _ev_deadline(struct timespec *ts, unsigned ms)
+{
+	clock_gettime(CLOCK_MONOTONIC, ts);
+	ts->tv_sec += ms / 1000;
+	ts->tv_nsec += (long) (ms % 1000) * 1000000;
+	if (ts->tv_nsec >= 1000000000)
+	{
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000;
+	}
+}
+
+/**
+ * Start the event delivery thread
+ *
+ * @return 	0 upon success. Non zero otherwise
+ *
+ * STEPS
+ * 1: Use the monotonic clock for timed waits
+ * 2: Start the thread
+ */
+int events_init()
+{
+	INIT
+	pthread_condattr_t attr;
+	int rv;
+
+	ENTER
+
+	// Initialize variables
+	rv = 1;
+	stop = 0;
+	pending = 0;
+
+	STEP // 1: Use the monotonic clock for timed waits
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	STEP // 2: Start the thread
+	if (pthread_create(&thread, NULL, events_run, NULL) != 0)
+	{
+		IFV(CLVB_ERRORS) printf("%d:%s ERR: Could not start event thread\n", gettid(), __FUNCTION__);
+		pthread_cond_destroy(&cond);
+		goto end;
+	}
+	running = 1;
+
+	rv = 0;
+
+end:
+
+	EXIT(rv)
+
+	return rv;
+}
+
+/**
+ * Stop the event delivery thread
+ *
+ * Parked requests are answered with the events present before the thread
+ * exits. Call before the MCTP connections are stopped
+ */
+void events_free()
+{
+	if (!running)
+		return;
+
+	pthread_mutex_lock(&mtx);
+	stop = 1;
+	pthread_cond_signal(&cond);
+	pthread_mutex_unlock(&mtx);
+
+	pthread_join(thread, NULL);
+	pthread_cond_destroy(&cond);
+	running = 0;
+}
+
+/**
+ * Record an event of the switch selected by the calling thread
+ *
+ * May be called with any state lock held
+ *
+ * @param type 	enum _EVTY
+ * @param ppid 	Port the event is about or EVLN_SWITCH
+ */
+void events_post(unsigned type, unsigned ppid)
+{
+	struct evrec *r;
+
+	pthread_mutex_lock(&mtx);
+
+	evseq++;
+	r = &ring[evseq % EVLN_RING];
+	r->seq = evseq;
+	r->type = type;
+	r->ppid = ppid;
+	r->sw = cxls_id;
+
+	// Deliver after a short delay so a burst of events goes out in one response
+	if (!pending)
+	{
+		pending = 1;
+		_ev_deadline(&flush_at, EVLN_COALESCE_MS);
+		pthread_cond_signal(&cond);
+	}
+
+	pthread_mutex_unlock(&mtx);
+}
+
+/**
+ * Coalesce the events of a switch after a sequence number into response records
+ *
+ * Caller must hold mtx
+ *
+ * Response: 00h Sequence number of the last event (__u64)
+ *           08h Number of records (__u16)
+ *           0Ah Flags [EVFL] (__u16)
+ *           0Ch Reserved
+ *           10h Records of EVLN_REC bytes: PPID (__u8), reserved (__u8),
+ *               event types [EVTY] (__u16)
+ *
+ * @param sw 	Switch of the requester [cxls_id]
+ * @param seq 	Last sequence number seen by the requester
+ * @param mask 	Event types of interest
+ * @param buf 	Response payload to fill
+ * @param num 	Set to the number of records plus 1 if a flag is set, so
+ * 				non zero whenever the requester has something to learn
+ * @return 		Length of the response payload in bytes
+ */
+static unsigned _ev_collect(unsigned sw, __u64 seq, __u32 mask, __u8 *buf, unsigned *num)
+{
+	__u16 types[MAX_PORTS + 1];
+	__u16 flags;
+	__u64 first, s;
+	struct evrec *r;
+	unsigned i, len;
+
+	memset(types, 0, sizeof(types));
+	flags = 0;
+
+	// A sequence number from the future means CSE restarted, start over
+	if (seq > evseq)
+	{
+		flags |= EVFL_RESYNC;
+		seq = 0;
+	}
+
+	// Entries older than the ring have been overwritten
+	first = (evseq > EVLN_RING) ? evseq - EVLN_RING + 1 : 1;
+	if (seq + 1 < first)
+	{
+		flags |= EVFL_LOST;
+		seq = first - 1;
+	}
+
+	for ( s = seq + 1 ; s <= evseq ; s++ )
+	{
+		r = &ring[s % EVLN_RING];
+		if ((r->type & mask) == 0 || r->sw != sw)
+			continue;
+
+		if (r->ppid < MAX_PORTS)
+			types[r->ppid] |= r->type;
+		else
+			types[MAX_PORTS] |= r->type;
+	}
+
+	*num = 0;
+	len = EVLN_RSP_HDR;
+	for ( i = 0 ; i <= MAX_PORTS ; i++ )
+	{
+		if (types[i] == 0)
+			continue;
+
+		buf[len + 0] = (i < MAX_PORTS) ? i : EVLN_SWITCH;
+		buf[len + 1] = 0;
+		buf[len + 2] = types[i] & 0xFF;
+		buf[len + 3] = types[i] >> 8;
+		len += EVLN_REC;
+		(*num)++;
+	}
+
+	for ( i = 0 ; i < 8 ; i++ )
+		buf[i] = (evseq >> (8 * i)) & 0xFF;
+	buf[8] = *num & 0xFF;
+	buf[9] = *num >> 8;
+	buf[10] = flags & 0xFF;
+	buf[11] = flags >> 8;
+	memset(&buf[12], 0, 4);
+
+	// A lost or resync flag must reach the requester even without records
+	if (flags != 0)
+		(*num)++;
+
+	return len;
+}
+
+/**
+ * Send the response to an event request
+ *
+ * Caller must hold mtx
+ */
+static void _ev_respond(struct mctp *m, struct mctp_action *ma, __u8 tag, __u8 opcode, unsigned len)
+{
+	struct emapi_buf *rspb;
+	struct emapi_hdr hdr;
+
+	rspb = (struct emapi_buf*) ma->rsp->payload;
+
+	metrics_rc(EMRC_SUCCESS);
+	ma->rsp->len = emapi_fill_hdr(&hdr, EMMT_RSP, tag, EMRC_SUCCESS, opcode, len, 0, 0);
+	emapi_serialize(rspb->hdr, &hdr, EMOB_HDR, NULL);
+
+	pq_push(m->tmq, ma);
+}
+
+/**
+ * Answer an event request now or park it until an event is posted
+ *
+ * The response MCTP header must already be filled. The request is answered
+ * at once if it asks for no wait, if events newer than seq are present or if
+ * too many requests are already waiting
+ *
+ * @param m 		struct mctp* the request was received on
+ * @param ma 		struct mctp_action* holding the request and response buffer
+ * @param tag 		EM API tag of the request
+ * @param opcode 	EM API opcode of the request
+ * @param seq 		Last sequence number seen by the requester
+ * @param mask 		Event types of interest, 0 for all
+ * @param timeout 	Longest time to wait in ms
+ */
+void events_wait(struct mctp *m, struct mctp_action *ma, __u8 tag, __u8 opcode, __u64 seq, __u32 mask, unsigned timeout)
+{
+	struct emapi_buf *rspb;
+	struct evwait *w;
+	unsigned len, num, i;
+
+	rspb = (struct emapi_buf*) ma->rsp->payload;
+
+	if (mask == 0)
+		mask = EVTY_ALL;
+	if (timeout > EVLN_MAX_TIMEOUT)
+		timeout = EVLN_MAX_TIMEOUT;
+
+	pthread_mutex_lock(&mtx);
+
+	len = _ev_collect(cxls_id, seq, mask, rspb->payload, &num);
+	if (num > 0 || timeout == 0 || !running || stop)
+		goto respond;
+
+	w = NULL;
+	for ( i = 0 ; i < EVLN_WAITERS ; i++ )
+	{
+		if (!waiters[i].used)
+		{
+			w = &waiters[i];
+			break;
+		}
+	}
+
+	// Respond with no events rather than hold more response buffers
+	if (w == NULL)
+		goto respond;
+
+	w->m = m;
+	w->ma = ma;
+	w->sw = cxls_id;
+	w->seq = seq;
+	w->mask = mask;
+	w->tag = tag;
+	w->opcode = opcode;
+	w->used = 1;
+	_ev_deadline(&w->deadline, timeout);
+
+	pthread_cond_signal(&cond);
+	pthread_mutex_unlock(&mtx);
+	return;
+
+respond:
+
+	_ev_respond(m, ma, tag, opcode, len);
+	pthread_mutex_unlock(&mtx);
+}
+
+/**
+ * Event delivery thread main loop
+ *
+ * STEPS
+ * 1: Wait for the next deadline or until an event is posted
+ * 2: Answer parked requests that have events, expired or must be stopped
+ */
+static void *events_run(void *arg)
+{
+	struct timespec now, next;
+	struct emapi_buf *rspb;
+	struct evwait *w;
+	unsigned i, len, num;
+	int has, flush;
+
+	(void) arg;
+
+	pthread_mutex_lock(&mtx);
+
+	while (1)
+	{
+		// STEP 1: Wait for the next deadline or until an event is posted
+		has = 0;
+		if (pending)
+		{
+			next = flush_at;
+			has = 1;
+		}
+		for ( i = 0 ; i < EVLN_WAITERS ; i++ )
+		{
+			if (!waiters[i].used)
+				continue;
+			if (!has || _ev_after(&next, &waiters[i].deadline))
+				next = waiters[i].deadline;
+			has = 1;
+		}
+
+		if (!stop)
+		{
+			if (has)
+				pthread_cond_timedwait(&cond, &mtx, &next);
+			else
+				pthread_cond_wait(&cond, &mtx);
+		}
+
+		// STEP 2: Answer parked requests that have events, expired or must be stopped
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		flush = pending && _ev_after(&now, &flush_at);
+		if (flush)
+			pending = 0;
+
+		for ( i = 0 ; i < EVLN_WAITERS ; i++ )
+		{
+			w = &waiters[i];
+			if (!w->used)
+				continue;
+			if (!flush && !stop && !_ev_after(&now, &w->deadline))
+				continue;
+
+			rspb = (struct emapi_buf*) w->ma->rsp->payload;
+			len = _ev_collect(w->sw, w->seq, w->mask, rspb->payload, &num);
+			if (num == 0 && !stop && !_ev_after(&now, &w->deadline))
+				continue;
+
+			_ev_respond(w->m, w->ma, w->tag, w->opcode, len);
+			w->used = 0;
+		}
+
+		if (stop)
+			break;
+	}
+
+	pthread_mutex_unlock(&mtx);
+
+	return NULL;
+}
@@ -0,0 +1,81 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		events.h
+ *
+ * @brief 		Header file for switch state change notifications
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ * Macro / Enumeration Prefixes (EV)
+ * EVFL	- Event Response Flags (FL)
+ * EVLN	- Event Length (LN)
+ * EVTY	- Event Type (TY)
+ */
+#ifndef _EVENTS_H
+#define _EVENTS_H
+
+/* INCLUDES ==================================================================*/
+
+/* __u8
+ * __u16
+ * __u32
+ * __u64
+ */
+#include <linux/types.h>
+
+/* struct mctp
+ * struct mctp_action
+ */
+#include <mctp.h>
+
+/* MACROS ====================================================================*/
+
+#define EVLN_RING 			1024 	//!< Events kept for subscribers that fall behind
+#define EVLN_WAITERS 		16 		//!< Event requests that may wait at once
+#define EVLN_MAX_TIMEOUT 	60000 	//!< Longest time in ms an event request waits
+#define EVLN_COALESCE_MS 	10 		//!< Time waited after an event so a burst is sent in one response
+#define EVLN_REQ 			0x10 	//!< Length of an Event request
+#define EVLN_RSP_HDR 		0x10 	//!< Offset of the first record in an Event response
+#define EVLN_REC 			4 		//!< Length of an Event response record
+#define EVLN_SWITCH 		0xFF 	//!< PPID of records that are not about one port
+
+/* ENUMERATIONS ==============================================================*/
+
+/**
+ * Event types, one bit each so events can be coalesced per port (TY)
+ */
+enum _EVTY
+{
+	EVTY_CONNECT 		= (1 << 0), 	//!< A device was connected to the port
+	EVTY_DISCONNECT 	= (1 << 1), 	//!< The device was disconnected from the port
+	EVTY_BIND 			= (1 << 2), 	//!< A vPPB bind to the port completed
+	EVTY_UNBIND 		= (1 << 3), 	//!< A vPPB unbind from the port completed
+	EVTY_PORT 			= (1 << 4), 	//!< PERST or the slot power of the port changed
+	EVTY_BOS 			= (1 << 5), 	//!< A background operation completed
+	EVTY_ALL 			= 0x3F
+};
+
+/**
+ * Event response flags (FL)
+ */
+enum _EVFL
+{
+	EVFL_LOST 			= (1 << 0), 	//!< Events after the requested sequence number were dropped
+	EVFL_RESYNC 		= (1 << 1) 		//!< The requested sequence number was never issued
+};
+
+/* STRUCTS ===================================================================*/
+
+/* PROTOTYPES ================================================================*/
+
+int events_init();
+void events_free();
+void events_post(unsigned type, unsigned ppid);
+void events_wait(struct mctp *m, struct mctp_action *ma, __u8 tag, __u8 opcode, __u64 seq, __u32 mask, unsigned timeout);
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+#endif //_EVENTS_H
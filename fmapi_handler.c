@@ -26,6 +26,14 @@
  */
 #include <string.h>
 
+/* qsort()
+ */
+#include <stdlib.h>
+
+/* pthread_once()
+ */
+#include <pthread.h>
+
 /* struct timespec 
  * timespec_get()
  *
@@ -46,29 +54,25 @@
 
 #include "options.h"
 
+#include "trace.h"
+
+#include "logger.h"
+
 #include <fmapi.h>
 
 #include "fmapi_handler.h"
 
-/* MACROS ====================================================================*/
+#include "dispatch.h"
+
+#include "respool.h"
+
+#include "workers.h"
+
+#include "numa.h"
+
+#include "switches.h"
 
-#ifdef CSE_VERBOSE
- #define INIT 			unsigned step = 0;
- #define ENTER 					if (opts[CLOP_VERBOSITY].u64 & CLVB_CALLSTACK) 	printf("%d:%s Enter\n", 			gettid(), __FUNCTION__);
- #define STEP 			step++; if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u\n", 			gettid(), __FUNCTION__, step);
- #define HEX32(m, i)			if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u %s: 0x%x\n",	gettid(), __FUNCTION__, step, m, i);
- #define INT32(m, i)			if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u %s: %d\n",	gettid(), __FUNCTION__, step, m, i);
- #define EXIT(rc) 				if (opts[CLOP_VERBOSITY].u64 & CLVB_CALLSTACK) 	printf("%d:%s Exit: %d\n", 			gettid(), __FUNCTION__,rc);
-#else
- #define ENTER
- #define EXIT(rc)
- #define STEP
- #define HEX32(m, i)
- #define INT32(m, i)
- #define INIT 
-#endif // CSE_VERBOSE
-
-#define IFV(u) 					if (opts[CLOP_VERBOSITY].u64 & u) 
+/* MACROS ====================================================================*/
 
 /* ENUMERATIONS ==============================================================*/
 
@@ -76,81 +80,195 @@
 
 /* PROTOTYPES ================================================================*/
 
-int fmop_isc_bos			(struct mctp *m, struct mctp_action *ma);
-int fmop_isc_id				(struct mctp *m, struct mctp_action *ma);
-int fmop_isc_msg_limit_get	(struct mctp *m, struct mctp_action *ma);
-int fmop_isc_msg_limit_set	(struct mctp *m, struct mctp_action *ma);
+static int fmapi_dispatch	(struct mctp *m, struct mctp_action *ma);
+static int fmapi_node		(struct mctp_action *ma);
+static int fmapi_busy		(struct mctp *m, struct mctp_action *ma, struct fmapi_hdr *hdr);
+static void fmop_table_init	();
+static int fmop_cmp			(const void *a, const void *b);
+
+int fmop_isc_bos			(struct mctp *m, struct mctp_action *ma, struct fmapi_msg *req);
+int fmop_isc_id				(struct mctp *m, struct mctp_action *ma, struct fmapi_msg *req);
+int fmop_isc_msg_limit_get	(struct mctp *m, struct mctp_action *ma, struct fmapi_msg *req);
+int fmop_isc_msg_limit_set	(struct mctp *m, struct mctp_action *ma, struct fmapi_msg *req);
 
-int fmop_mpc_cfg			(struct mctp *m, struct mctp_action *ma);
-int fmop_mpc_mem			(struct mctp *m, struct mctp_action *ma);
-int fmop_mpc_tmc			(struct mctp *m, struct mctp_action *ma);
+int fmop_mpc_cfg			(struct mctp *m, struct mctp_action *ma, struct fmapi_msg *req);
+int fmop_mpc_mem			(struct mctp *m, struct mctp_action *ma, struct fmapi_msg *req);
+int fmop_mpc_tmc			(struct mctp *m, struct mctp_action *ma, struct fmapi_msg *req);
 
-int fmop_psc_cfg 			(struct mctp *m, struct mctp_action *ma);
-int fmop_psc_id 			(struct mctp *m, struct mctp_action *ma);
-int fmop_psc_port 			(struct mctp *m, struct mctp_action *ma);
-int fmop_psc_port_ctrl 		(struct mctp *m, struct mctp_action *ma);
+int fmop_psc_cfg 			(struct mctp *m, struct mctp_action *ma, struct fmapi_msg *req);
+int fmop_psc_id 			(struct mctp *m, struct mctp_action *ma, struct fmapi_msg *req);
+int fmop_psc_port 			(struct mctp *m, struct mctp_action *ma, struct fmapi_msg *req);
+int fmop_psc_port_ctrl 		(struct mctp *m, struct mctp_action *ma, struct fmapi_msg *req);
 
-int fmop_vsc_aer 			(struct mctp *m, struct mctp_action *ma);
-int fmop_vsc_bind 			(struct mctp *m, struct mctp_action *ma);
-int fmop_vsc_info 			(struct mctp *m, struct mctp_action *ma);
-int fmop_vsc_unbind 		(struct mctp *m, struct mctp_action *ma);
+int fmop_vsc_aer 			(struct mctp *m, struct mctp_action *ma, struct fmapi_msg *req);
+int fmop_vsc_bind 			(struct mctp *m, struct mctp_action *ma, struct fmapi_msg *req);
+int fmop_vsc_info 			(struct mctp *m, struct mctp_action *ma, struct fmapi_msg *req);
+int fmop_vsc_unbind 		(struct mctp *m, struct mctp_action *ma, struct fmapi_msg *req);
 
 /* GLOBAL VARIABLES ==========================================================*/
 
+/**
+ * FM API opcode dispatch table
+ *
+ * Sorted by opcode and the object types filled in by fmop_table_init()
+ */
+static struct opcode fmops[] = {
+	{ FMOP_ISC_ID, 				"ISC Identify", 				{ .fm = fmop_isc_id }, 				CSLK_ID, 		0, 						0, 0, { 0 } },
+	{ FMOP_ISC_BOS, 			"ISC Background Op Status", 	{ .fm = fmop_isc_bos }, 			CSLK_ID, 		0, 						0, 0, { 0 } },
+	{ FMOP_ISC_MSG_LIMIT_GET, 	"ISC Get Msg Limit", 			{ .fm = fmop_isc_msg_limit_get }, 	CSLK_ID, 		0, 						0, 0, { 0 } },
+	{ FMOP_ISC_MSG_LIMIT_SET, 	"ISC Set Msg Limit", 			{ .fm = fmop_isc_msg_limit_set }, 	CSLK_ID, 		CSOF_MUTATE, 			0, 0, { 0 } },
+	{ FMOP_PSC_ID, 				"PSC Identify Switch", 			{ .fm = fmop_psc_id }, 				CSLK_TOPOLOGY, 	0, 						0, 0, { 0 } },
+	{ FMOP_PSC_PORT, 			"PSC Get Port State", 			{ .fm = fmop_psc_port }, 			CSLK_PORT, 		0, 						0, 0, { 0 } },
+	{ FMOP_PSC_PORT_CTRL, 		"PSC Port Control", 			{ .fm = fmop_psc_port_ctrl }, 		CSLK_PORT, 		CSOF_MUTATE, 			0, 0, { 0 } },
+	{ FMOP_PSC_CFG, 			"PSC Config Request", 			{ .fm = fmop_psc_cfg }, 			CSLK_PORT, 		CSOF_MUTATE, 			0, 0, { 0 } },
+	{ FMOP_VSC_INFO, 			"VSC Get Info", 				{ .fm = fmop_vsc_info }, 			CSLK_VCS, 		0, 						0, 0, { 0 } },
+	{ FMOP_VSC_BIND, 			"VSC Bind", 					{ .fm = fmop_vsc_bind }, 			CSLK_TOPOLOGY, 	CSOF_MUTATE, 			0, 0, { 0 } },
+	{ FMOP_VSC_UNBIND, 			"VSC Unbind", 					{ .fm = fmop_vsc_unbind }, 			CSLK_TOPOLOGY, 	CSOF_MUTATE, 			0, 0, { 0 } },
+	{ FMOP_VSC_AER, 			"VSC Generate AER", 			{ .fm = fmop_vsc_aer }, 			CSLK_VCS, 		CSOF_MUTATE, 			0, 0, { 0 } },
+	{ FMOP_MPC_TMC, 			"MPC Tunnel Mgmt Command", 		{ .fm = fmop_mpc_tmc }, 			CSLK_PORT, 		CSOF_MUTATE, 			0, 0, { 0 } },
+	{ FMOP_MPC_CFG, 			"MPC LD CXL.io Config", 		{ .fm = fmop_mpc_cfg }, 			CSLK_PORT, 		CSOF_MUTATE, 			0, 0, { 0 } },
+	{ FMOP_MPC_MEM, 			"MPC LD CXL.io Memory", 		{ .fm = fmop_mpc_mem }, 			CSLK_PORT, 		CSOF_MUTATE | CSOF_RAW, 0, 0, { 0 } },
+};
+
+/**
+ * Guards the one time initialization of fmops[]
+ */
+static pthread_once_t fmops_once = PTHREAD_ONCE_INIT;
+
 /* FUNCTIONS =================================================================*/
 
 /**
  * Handler for all FM API Opcodes
+ *
+ * Selects the switch of the connection, then hands the request to the worker
+ * pool if one is running. Otherwise the request is serviced inline on the 
+ * MCTP handler thread
+ * 
+ * @return 	0 upon success, 1 otherwise
+ */
+int fmapi_handler(struct mctp *m, struct mctp_action *ma)
+{
+	switches_enter(m);
+
+	if (workers_num() > 0 && workers_submit(m, ma, fmapi_dispatch, fmapi_node(ma)) == 0)
+		return 0;
+
+	return fmapi_dispatch(m, ma);
+}
+
+/**
+ * Return the NUMA node a request should be serviced on
+ *
+ * MPC LD CXL.io Memory requests touch the memory space of their port, so they
+ * are serviced on the node the memory space is bound to. The header is peeked
+ * here before the request is handed to a worker
+ *
+ * @return 	NUMA node, -1 for any worker
+ */
+static int fmapi_node(struct mctp_action *ma)
+{
+	struct fmapi_hdr hdr;
+	struct fmapi_buf *buf;
+
+	if (!numa_used() || ma == NULL || ma->req == NULL || ma->req->len <= FMLN_HDR)
+		return -1;
+
+	buf = (struct fmapi_buf*) ma->req->payload;
+	if (fmapi_deserialize(&hdr, buf->hdr, FMOB_HDR, NULL) <= 0 || hdr.opcode != FMOP_MPC_MEM)
+		return -1;
+
+	// The PPID is the first byte of the request, see _parse_mpc_mem_req()
+	return numa_port(buf->payload[0]);
+}
+
+/**
+ * Return the FM API opcode dispatch table
+ *
+ * @param num 	Set to the number of entries in the table
+ */
+struct opcode *fmapi_opcodes(unsigned *num)
+{
+	pthread_once(&fmops_once, fmop_table_init);
+
+	*num = sizeof(fmops) / sizeof(struct opcode);
+	return fmops;
+}
+
+/**
+ * Service an FM API request 
  * 
+ * The request header and object are deserialized once here and the decoded
+ * message is passed to the opcode handler. Opcodes flagged CSOF_RAW, such as
+ * the MPC LD CXL.io Memory Request, decode their object directly from the 
+ * request buffer
+ *
  * @return 	0 upon success, 1 otherwise
  *			
  * STEPS 
  * 1: Deserialize Header
  * 2: Verify FM API Message Category
- * 3: Handle Opcode
+ * 3: Look up Opcode
+ * 4: Deserialize Request Object 
+ * 5: Checkout Response mctp_msg buffer
+ * 6: Handle Opcode
  */
-int fmapi_handler(struct mctp *m, struct mctp_action *ma)
+static int fmapi_dispatch(struct mctp *m, struct mctp_action *ma)
 {
 	INIT
-	struct fmapi_hdr hdr; 
+	struct fmapi_msg req; 
+	struct opcode *op;
+	unsigned num;
 	int rv;
 
 	ENTER
 
 	// Initialize variables 
 	rv = 0;
+	req.buf = (struct fmapi_buf*) ma->req->payload;
 
 	STEP // 1: Deserialize FM API Header
-	rv = fmapi_deserialize(&hdr, ma->req->payload, FMOB_HDR, NULL);
+	rv = fmapi_deserialize(&req.hdr, req.buf->hdr, FMOB_HDR, NULL);
 	if (rv <= 0) 
 		goto end;
 
 	STEP // 2: Verify FM API Message Category
-	if (hdr.category != FMMT_REQ) 
+	if (req.hdr.category != FMMT_REQ) 
+		goto end;
+
+	STEP // 3: Look up Opcode
+	HEX32("Opcode",  req.hdr.opcode);
+	op = opcode_find(fmapi_opcodes(&num), num, req.hdr.opcode);
+	if (op == NULL || op->fn.fm == NULL)
+	{
+		IFV(CLVB_ERRORS) logger_printf("ERR: Unsupported FM API Opcode: 0x%04x\n", req.hdr.opcode);
+		rv = 1;
+		goto end;
+	}
+
+	STEP // 4: Deserialize Request Object 
+	metrics_begin();
+	if ( !(op->flags & CSOF_RAW) 
+	    && fmapi_deserialize(&req.obj, req.buf->payload, op->req_obj, NULL) < 0 )
+	{
+		rv = 1;
+		metrics_end(&op->stats, rv);
 		goto end;
+	}
 
-	STEP // 3: Handle Opcode
-	HEX32("Opcode",  hdr.opcode);
-	switch(hdr.opcode)
+	STEP // 5: Checkout Response mctp_msg buffer
+	ma->rsp = respool_get(m);
+	if (ma->rsp == NULL)
 	{
-		case FMOP_ISC_BOS: 				rv = fmop_isc_bos(m, ma); 			break;	
-		case FMOP_ISC_ID: 				rv = fmop_isc_id(m, ma); 			break;	
-		case FMOP_ISC_MSG_LIMIT_GET:	rv = fmop_isc_msg_limit_get(m, ma); break;	
-		case FMOP_ISC_MSG_LIMIT_SET:	rv = fmop_isc_msg_limit_set(m, ma); break;	
-		case FMOP_PSC_ID:      			rv = fmop_psc_id(m, ma); 			break;	
-		case FMOP_PSC_PORT:         	rv = fmop_psc_port(m, ma); 			break;	
-		case FMOP_PSC_PORT_CTRL:       	rv = fmop_psc_port_ctrl(m, ma); 	break;
-		case FMOP_PSC_CFG:             	rv = fmop_psc_cfg(m, ma); 			break;
-		case FMOP_VSC_INFO:      		rv = fmop_vsc_info(m, ma); 			break;	
-		case FMOP_VSC_BIND:            	rv = fmop_vsc_bind(m, ma); 			break;	
-		case FMOP_VSC_UNBIND:          	rv = fmop_vsc_unbind(m, ma); 		break;	
-		case FMOP_VSC_AER:             	rv = fmop_vsc_aer(m, ma); 			break;	
-		case FMOP_MPC_TMC:        	   	rv = fmop_mpc_tmc(m, ma); 			break;
-		case FMOP_MPC_CFG:             	rv = fmop_mpc_cfg(m, ma); 			break;
-		case FMOP_MPC_MEM:             	rv = fmop_mpc_mem(m, ma); 			break;
-		default: 															break;
+		IFV(CLVB_ERRORS) logger_printf("ERR: No response buffer available. Responding busy to Opcode: 0x%04x\n", req.hdr.opcode);
+		rv = fmapi_busy(m, ma, &req.hdr);
+		metrics_end(&op->stats, rv);
+		goto end;
 	}
 
+	STEP // 6: Handle Opcode
+	rv = op->fn.fm(m, ma, &req);
+	metrics_end(&op->stats, rv);
+
 end:				
 	
 	// If subhandler fails, check in mctp_action
@@ -164,3 +282,56 @@ end:
 	return rv;
 
 }
+
+/**
+ * Respond busy to a request using a buffer from the response reserve 
+ *
+ * @param hdr 	struct fmapi_hdr* of the decoded request
+ * @return 		0 upon success, 1 if no reserve buffer was available
+ */
+static int fmapi_busy(struct mctp *m, struct mctp_action *ma, struct fmapi_hdr *hdr)
+{
+	struct fmapi_msg rsp;
+
+	ma->rsp = respool_get_reserve(m);
+	if (ma->rsp == NULL)
+		return 1;
+
+	mctp_fill_msg_hdr(ma->rsp, ma->req->src, m->state.eid, 0, ma->req->tag);
+	ma->rsp->type = ma->req->type;
+
+	rsp.buf = (struct fmapi_buf*) ma->rsp->payload;
+
+	metrics_rc(FMRC_BUSY);
+	ma->rsp->len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, hdr->tag, hdr->opcode, 0, 0, FMRC_BUSY, 0);
+	fmapi_serialize(rsp.buf->hdr, &rsp.hdr, FMOB_HDR);
+
+	pq_push(m->tmq, ma);
+
+	return 0;
+}
+
+/**
+ * Fill in the object types of fmops[] from the FM API library and sort it
+ */
+static void fmop_table_init()
+{
+	unsigned i, num;
+
+	num = sizeof(fmops) / sizeof(struct opcode);
+	for ( i = 0 ; i < num ; i++ ) 
+	{
+		fmops[i].req_obj = fmapi_fmob_req(fmops[i].opcode);
+		fmops[i].rsp_obj = fmapi_fmob_rsp(fmops[i].opcode);
+	}
+
+	qsort(fmops, num, sizeof(struct opcode), fmop_cmp);
+}
+
+/**
+ * Compare two struct opcode by opcode for qsort()
+ */
+static int fmop_cmp(const void *a, const void *b)
+{
+	return (int) ((struct opcode*) a)->opcode - (int) ((struct opcode*) b)->opcode;
+}
@@ -20,6 +20,10 @@
  */
 #include <mctp.h>
 
+/* struct opcode
+ */
+#include "dispatch.h"
+
 /* MACROS ====================================================================*/
 
 /* ENUMERATIONS ==============================================================*/
@@ -29,6 +33,7 @@
 /* PROTOTYPES ================================================================*/
 
 int fmapi_handler(struct mctp *m, struct mctp_action *ma);
+struct opcode *fmapi_opcodes(unsigned *num);
 
 /* GLOBAL VARIABLES ==========================================================*/
 
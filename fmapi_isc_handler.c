@@ -42,40 +42,27 @@
  */
 #include <mctp.h>
 #include <ptrqueue.h>
-#include <timeutils.h>
 #include <cxlstate.h>
 #include "signals.h"
 
 #include "options.h"
 
+#include "trace.h"
+
+#include "logger.h"
+
+#include "metrics.h"
+
 #include "state.h"
 
+#include "cache.h"
+
 #include <fmapi.h>
 
 #include "fmapi_handler.h"
 
 /* MACROS ====================================================================*/
 
-#ifdef CSE_VERBOSE
- #define INIT 			unsigned step = 0;
- #define ENTER 					if (opts[CLOP_VERBOSITY].u64 & CLVB_CALLSTACK) 	printf("%d:%s Enter\n", 			gettid(), __FUNCTION__);
- #define STEP 			step++; if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u\n", 			gettid(), __FUNCTION__, step);
- #define HEX32(m, i)			if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u %s: 0x%x\n",	gettid(), __FUNCTION__, step, m, i);
- #define INT32(m, i)			if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u %s: %d\n",	gettid(), __FUNCTION__, step, m, i);
- #define EXIT(rc) 				if (opts[CLOP_VERBOSITY].u64 & CLVB_CALLSTACK) 	printf("%d:%s Exit: %d\n", 			gettid(), __FUNCTION__,rc);
-#else
- #define ENTER
- #define EXIT(rc)
- #define STEP
- #define HEX32(m, i)
- #define INT32(m, i)
- #define INIT 
-#endif // CSE_VERBOSE
-
-#define IFV(u) 					if (opts[CLOP_VERBOSITY].u64 & u) 
-
-#define ISO_TIME_BUF_LEN		32
-
 /* ENUMERATIONS ==============================================================*/
 
 /* STRUCTS ===================================================================*/
@@ -91,33 +78,31 @@
  *
  * @param m 	struct mctp* 
  * @param mm 	struct mctp_msg* 
+ * @param req 	struct fmapi_msg* holding the decoded request
  * @return 		0 upon success, 1 otherwise
  *
  * STEPS
  *  1: Initialize variables
- *  2: Checkout Response mctp_msg buffer
+ *  2: Verify Response mctp_msg buffer
  *  3: Fill Response MCTP Header
- *  4: Set buffer pointers 
- *  5: Deserialize Request Header
- *  6: Deserialize Request Object 
- *  7: Extract parameters
- *  8: Obtain lock on switch state 
- *  9: Validate Inputs 
- * 10: Perform Action 
- * 11: Prepare Response Object
- * 12: Serialize Response Object
- * 13: Set return code
- * 14: Release lock on switch state 
- * 15: Fill Response Header
- * 16: Serialize Header 
- * 17: Push Response mctp_msg onto Transmit Message Queue 
- * 18: Checkin mctp_msgs 
+ *  4: Set response buffer pointer 
+ *  5: Extract parameters
+ *  6: Obtain lock on switch state 
+ *  7: Validate Inputs 
+ *  8: Perform Action 
+ *  9: Prepare Response Object
+ * 10: Serialize Response Object
+ * 11: Set return code
+ * 12: Release lock on switch state 
+ * 13: Fill Response Header
+ * 14: Serialize Header 
+ * 15: Push Response mctp_msg onto Transmit Message Queue 
+ * 16: Checkin mctp_msgs 
  */
-int fmop_isc_bos(struct mctp *m, struct mctp_action *ma)
+int fmop_isc_bos(struct mctp *m, struct mctp_action *ma, struct fmapi_msg *req)
 {
 	INIT
-	char now[ISO_TIME_BUF_LEN];
-	struct fmapi_msg req, rsp;
+	struct fmapi_msg rsp;
 	unsigned rc;
 	int rv, len;
 
@@ -127,10 +112,8 @@ int fmop_isc_bos(struct mctp *m, struct mctp_action *ma)
 	rv = 1; 
 	len = 0;
 	rc = FMRC_INVALID_INPUT;
-	isotime(now, ISO_TIME_BUF_LEN);
 
-	STEP // 2: Get response mctp_msg buffer
-	ma->rsp = pq_pop(m->msgs, 1);
+	STEP // 2: Verify Response mctp_msg buffer was checked out by the dispatcher
 	if (ma->rsp == NULL)  
 		goto end;
 
@@ -138,57 +121,49 @@ int fmop_isc_bos(struct mctp *m, struct mctp_action *ma)
 	mctp_fill_msg_hdr(ma->rsp, ma->req->src, m->state.eid, 0, ma->req->tag);
 	ma->rsp->type = ma->req->type;
 	
-	// 4: Set buffer pointers 
-	req.buf = (struct fmapi_buf*) ma->req->payload;
+	// 4: Set response buffer pointer 
 	rsp.buf = (struct fmapi_buf*) ma->rsp->payload;
 
-	STEP // 5: Deserialize Request Header
-	if ( fmapi_deserialize(&req.hdr, req.buf->hdr, FMOB_HDR, NULL) <= 0 )
-		goto end;
-
-	STEP // 6: Deserialize Request Object 
-	if ( fmapi_deserialize(&req.obj, req.buf->payload, fmapi_fmob_req(req.hdr.opcode), NULL) < 0 )
-		goto end;
+	STEP // 5: Extract parameters
 
-	STEP // 7: Extract parameters
+	IFV(CLVB_COMMANDS) logger_printf("CMD: FM API ISC Background Operation Status\n");
 
-	IFV(CLVB_COMMANDS) printf("%s CMD: FM API ISC Background Operation Status\n", now);
+	STEP // 6: Obtain lock on switch state 
+	state_lock_id(0);
 
-	STEP // 8: Obtain lock on switch state 
-	pthread_mutex_lock(&cxls->mtx);
+	STEP // 7: Validate Inputs 
 
-	STEP // 9: Validate Inputs 
+	STEP // 8: Perform Action 
 
-	STEP // 10: Perform Action 
-
-	STEP // 11: Prepare Response Object
+	STEP // 9: Prepare Response Object
 	rsp.obj.isc_bos.running = cxls->bos_running;
 	rsp.obj.isc_bos.pcnt 	= cxls->bos_pcnt;
 	rsp.obj.isc_bos.opcode 	= cxls->bos_opcode;
 	rsp.obj.isc_bos.rc 		= cxls->bos_rc;
 	rsp.obj.isc_bos.ext 	= cxls->bos_ext;
 
-	STEP // 12: Serialize Response Object
-	len = fmapi_serialize(rsp.buf->payload, &rsp.obj, fmapi_fmob_rsp(req.hdr.opcode));
+	STEP // 10: Serialize Response Object
+	len = fmapi_serialize(rsp.buf->payload, &rsp.obj, fmapi_fmob_rsp(req->hdr.opcode));
 
-	STEP // 13: Set return code
+	STEP // 11: Set return code
 	rc = FMRC_SUCCESS;
 
 //send:
 
-	STEP // 14: Release lock on switch state 
-	pthread_mutex_unlock(&cxls->mtx);
+	STEP // 12: Release lock on switch state 
+	state_unlock_id();
 
 	if (len < 0)
 		goto end;
 
-	STEP // 15: Fill Response Header
-	ma->rsp->len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, req.hdr.tag, req.hdr.opcode, 0, len, rc, 0);
+	STEP // 13: Fill Response Header
+	metrics_rc(rc);
+	ma->rsp->len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, req->hdr.tag, req->hdr.opcode, 0, len, rc, 0);
 
-	STEP // 16: Serialize Header 
+	STEP // 14: Serialize Header 
 	fmapi_serialize(rsp.buf->hdr, &rsp.hdr, FMOB_HDR);
 
-	STEP // 17: Push mctp_action onto queue 
+	STEP // 15: Push mctp_action onto queue 
 	pq_push(m->tmq, ma);
 
 	rv = 0;
@@ -205,46 +180,44 @@ end:
  *
  * @param m 	struct mctp* 
  * @param mm 	struct mctp_msg* 
+ * @param req 	struct fmapi_msg* holding the decoded request
  * @return 		0 upon success, 1 otherwise
  *
  * STEPS
  *  1: Initialize variables
- *  2: Checkout Response mctp_msg buffer
+ *  2: Verify Response mctp_msg buffer
  *  3: Fill Response MCTP Header
- *  4: Set buffer pointers 
- *  5: Deserialize Request Header
- *  6: Deserialize Request Object 
- *  7: Extract parameters
- *  8: Obtain lock on switch state 
- *  9: Validate Inputs 
- * 10: Perform Action 
- * 11: Prepare Response Object
- * 12: Serialize Response Object
- * 13: Set return code
- * 14: Release lock on switch state 
- * 15: Fill Response Header
- * 16: Serialize Header 
- * 17: Push Response mctp_msg onto Transmit Message Queue 
- * 18: Checkin mctp_msgs 
+ *  4: Set response buffer pointer 
+ *  5: Extract parameters
+ *  6: Obtain lock on switch state 
+ *  7: Validate Inputs 
+ *  8: Perform Action 
+ *  9: Prepare Response Object
+ * 10: Serialize Response Object
+ * 11: Set return code
+ * 12: Release lock on switch state 
+ * 13: Fill Response Header
+ * 14: Serialize Header 
+ * 15: Push Response mctp_msg onto Transmit Message Queue 
+ * 16: Checkin mctp_msgs 
  */
-int fmop_isc_id(struct mctp *m, struct mctp_action *ma)
+int fmop_isc_id(struct mctp *m, struct mctp_action *ma, struct fmapi_msg *req)
 {
 	INIT
-	char now[ISO_TIME_BUF_LEN];
-	struct fmapi_msg req, rsp;
+	struct fmapi_msg rsp;
 	unsigned rc;
 	int rv, len;
 
+	__u64 gen;
+
 	ENTER
 
 	STEP // 1: Initialize variables
 	rv = 1; 
 	len = 0;
 	rc = FMRC_INVALID_INPUT;
-	isotime(now, ISO_TIME_BUF_LEN);
 
-	STEP // 2: Get response mctp_msg buffer
-	ma->rsp = pq_pop(m->msgs, 1);
+	STEP // 2: Verify Response mctp_msg buffer was checked out by the dispatcher
 	if (ma->rsp == NULL)  
 		goto end;
 
@@ -252,30 +225,31 @@ int fmop_isc_id(struct mctp *m, struct mctp_action *ma)
 	mctp_fill_msg_hdr(ma->rsp, ma->req->src, m->state.eid, 0, ma->req->tag);
 	ma->rsp->type = ma->req->type;
 	
-	STEP // 4: Set buffer pointers 
-	req.buf = (struct fmapi_buf*) ma->req->payload;
+	STEP // 4: Set response buffer pointer 
 	rsp.buf = (struct fmapi_buf*) ma->rsp->payload;
 
-	STEP // 5: Deserialize Request Header
-	if ( fmapi_deserialize(&req.hdr, req.buf->hdr, FMOB_HDR, NULL) <= 0 )
-		goto end;
+	STEP // 5: Extract parameters
 
-	STEP // 6: Deserialize Request Object 
-	if ( fmapi_deserialize(&req.obj, req.buf->payload, fmapi_fmob_req(req.hdr.opcode), NULL) < 0 )
-		goto end;
+	IFV(CLVB_COMMANDS) logger_printf("CMD: FM API ISC Identify\n");
 
-	STEP // 7: Extract parameters
-
-	IFV(CLVB_COMMANDS) printf("%s CMD: FM API ISC Identify\n", now);
+	// Reuse the last response if the switch identity did not change
+	gen = state_gen(STATE_GEN_ID, 0);
+	len = cache_get(CAAPI_FM, req->hdr.opcode, NULL, 0, gen, rsp.buf->payload, NULL);
+	if (len >= 0)
+	{
+		rc = FMRC_SUCCESS;
+		goto cached;
+	}
+	len = 0;
 
-	STEP // 8: Obtain lock on switch state 
-	pthread_mutex_lock(&cxls->mtx);
+	STEP // 6: Obtain lock on switch state 
+	state_lock_id(0);
 
-	STEP // 9: Validate Inputs 
+	STEP // 7: Validate Inputs 
 
-	STEP // 10: Perform Action 
+	STEP // 8: Perform Action 
 
-	STEP // 11: Prepare Response Object
+	STEP // 9: Prepare Response Object
 	rsp.obj.isc_id_rsp.vid 	= cxls->vid;
 	rsp.obj.isc_id_rsp.did 	= cxls->did;
 	rsp.obj.isc_id_rsp.svid = cxls->svid;
@@ -283,27 +257,32 @@ int fmop_isc_id(struct mctp *m, struct mctp_action *ma)
 	rsp.obj.isc_id_rsp.sn 	= cxls->sn;
 	rsp.obj.isc_id_rsp.size = cxls->max_msg_size_n;
 
-	STEP // 12: Serialize Response Object
-	len = fmapi_serialize(rsp.buf->payload, &rsp.obj, fmapi_fmob_rsp(req.hdr.opcode));
+	STEP // 10: Serialize Response Object
+	len = fmapi_serialize(rsp.buf->payload, &rsp.obj, fmapi_fmob_rsp(req->hdr.opcode));
+	if (len >= 0)
+		cache_put(CAAPI_FM, req->hdr.opcode, NULL, 0, gen, rsp.buf->payload, len, 0);
 
-	STEP // 13: Set return code
+	STEP // 11: Set return code
 	rc = FMRC_SUCCESS;
 
 //send:
 
-	STEP // 14: Release lock on switch state 
-	pthread_mutex_unlock(&cxls->mtx);
+	STEP // 12: Release lock on switch state 
+	state_unlock_id();
+
+cached:
 
 	if (len < 0)
 		goto end;
 
-	STEP // 15: Fill Response Header
-	ma->rsp->len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, req.hdr.tag, req.hdr.opcode, 0, len, rc, 0);
+	STEP // 13: Fill Response Header
+	metrics_rc(rc);
+	ma->rsp->len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, req->hdr.tag, req->hdr.opcode, 0, len, rc, 0);
 
-	STEP // 16: Serialize Header 
+	STEP // 14: Serialize Header 
 	fmapi_serialize(rsp.buf->hdr, &rsp.hdr, FMOB_HDR);
 
-	STEP // 17: Push mctp_action onto queue 
+	STEP // 15: Push mctp_action onto queue 
 	pq_push(m->tmq, ma);
 
 	rv = 0;
@@ -320,33 +299,31 @@ end:
  *
  * @param m 	struct mctp* 
  * @param mm 	struct mctp_msg* 
+ * @param req 	struct fmapi_msg* holding the decoded request
  * @return 		0 upon success, 1 otherwise
  *
  * STEPS
  *  1: Initialize variables
- *  2: Checkout Response mctp_msg buffer
+ *  2: Verify Response mctp_msg buffer
  *  3: Fill Response MCTP Header
- *  4: Set buffer pointers 
- *  5: Deserialize Request Header
- *  6: Deserialize Request Object 
- *  7: Extract parameters
- *  8: Obtain lock on switch state 
- *  9: Validate Inputs 
- * 10: Perform Action 
- * 11: Prepare Response Object
- * 12: Serialize Response Object
- * 13: Set return code
- * 14: Release lock on switch state 
- * 15: Fill Response Header
- * 16: Serialize Header 
- * 17: Push Response mctp_msg onto Transmit Message Queue 
- * 18: Checkin mctp_msgs 
+ *  4: Set response buffer pointer 
+ *  5: Extract parameters
+ *  6: Obtain lock on switch state 
+ *  7: Validate Inputs 
+ *  8: Perform Action 
+ *  9: Prepare Response Object
+ * 10: Serialize Response Object
+ * 11: Set return code
+ * 12: Release lock on switch state 
+ * 13: Fill Response Header
+ * 14: Serialize Header 
+ * 15: Push Response mctp_msg onto Transmit Message Queue 
+ * 16: Checkin mctp_msgs 
  */
-int fmop_isc_msg_limit_get(struct mctp *m, struct mctp_action *ma)
+int fmop_isc_msg_limit_get(struct mctp *m, struct mctp_action *ma, struct fmapi_msg *req)
 {
 	INIT
-	char now[ISO_TIME_BUF_LEN];
-	struct fmapi_msg req, rsp;
+	struct fmapi_msg rsp;
 	unsigned rc;
 	int rv, len;
 
@@ -356,10 +333,8 @@ int fmop_isc_msg_limit_get(struct mctp *m, struct mctp_action *ma)
 	rv = 1; 
 	len = 0;
 	rc = FMRC_INVALID_INPUT;
-	isotime(now, ISO_TIME_BUF_LEN);
 
-	STEP // 2: Get response mctp_msg buffer
-	ma->rsp = pq_pop(m->msgs, 1);
+	STEP // 2: Verify Response mctp_msg buffer was checked out by the dispatcher
 	if (ma->rsp == NULL)  
 		goto end;
 
@@ -367,53 +342,45 @@ int fmop_isc_msg_limit_get(struct mctp *m, struct mctp_action *ma)
 	mctp_fill_msg_hdr(ma->rsp, ma->req->src, m->state.eid, 0, ma->req->tag);
 	ma->rsp->type = ma->req->type;
 	
-	// 4: Set buffer pointers 
-	req.buf = (struct fmapi_buf*) ma->req->payload;
+	// 4: Set response buffer pointer 
 	rsp.buf = (struct fmapi_buf*) ma->rsp->payload;
 
-	STEP // 5: Deserialize Request Header
-	if ( fmapi_deserialize(&req.hdr, req.buf->hdr, FMOB_HDR, NULL) <= 0 )
-		goto end;
-
-	STEP // 6: Deserialize Request Object 
-	if ( fmapi_deserialize(&req.obj, req.buf->payload, fmapi_fmob_req(req.hdr.opcode), NULL) < 0 )
-		goto end;
-
-	STEP // 7: Extract parameters
+	STEP // 5: Extract parameters
 
-	IFV(CLVB_COMMANDS) printf("%s CMD: FM API ISC Get Response Message Limit\n", now);
+	IFV(CLVB_COMMANDS) logger_printf("CMD: FM API ISC Get Response Message Limit\n");
 
-	STEP // 8: Obtain lock on switch state 
-	pthread_mutex_lock(&cxls->mtx);
+	STEP // 6: Obtain lock on switch state 
+	state_lock_id(0);
 
-	STEP // 9: Validate Inputs 
+	STEP // 7: Validate Inputs 
 
-	STEP // 10: Perform Action 
+	STEP // 8: Perform Action 
 
-	STEP // 11: Prepare Response Object
+	STEP // 9: Prepare Response Object
 	rsp.obj.isc_msg_limit.limit = cxls->msg_rsp_limit_n;
 
-	STEP // 12: Serialize Response Object
-	len = fmapi_serialize(rsp.buf->payload, &rsp.obj, fmapi_fmob_rsp(req.hdr.opcode));
+	STEP // 10: Serialize Response Object
+	len = fmapi_serialize(rsp.buf->payload, &rsp.obj, fmapi_fmob_rsp(req->hdr.opcode));
 
-	STEP // 13: Set return code
+	STEP // 11: Set return code
 	rc = FMRC_SUCCESS;
 
 //send:
 
-	STEP // 14: Release lock on switch state 
-	pthread_mutex_unlock(&cxls->mtx);
+	STEP // 12: Release lock on switch state 
+	state_unlock_id();
 
 	if (len < 0)
 		goto end;
 
-	STEP // 15: Fill Response Header
-	ma->rsp->len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, req.hdr.tag, req.hdr.opcode, 0, len, rc, 0);
+	STEP // 13: Fill Response Header
+	metrics_rc(rc);
+	ma->rsp->len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, req->hdr.tag, req->hdr.opcode, 0, len, rc, 0);
 
-	STEP // 16: Serialize Header 
+	STEP // 14: Serialize Header 
 	fmapi_serialize(rsp.buf->hdr, &rsp.hdr, FMOB_HDR);
 
-	STEP // 17: Push mctp_action onto queue 
+	STEP // 15: Push mctp_action onto queue 
 	pq_push(m->tmq, ma);
 
 	rv = 0;
@@ -430,33 +397,31 @@ end:
  *
  * @param m 	struct mctp* 
  * @param mm 	struct mctp_msg* 
+ * @param req 	struct fmapi_msg* holding the decoded request
  * @return 		0 upon success, 1 otherwise
  *
  * STEPS
  *  1: Initialize variables
- *  2: Checkout Response mctp_msg buffer
+ *  2: Verify Response mctp_msg buffer
  *  3: Fill Response MCTP Header
- *  4: Set buffer pointers 
- *  5: Deserialize Request Header
- *  6: Deserialize Request Object 
- *  7: Extract parameters
- *  8: Obtain lock on switch state 
- *  9: Validate Inputs 
- * 10: Perform Action 
- * 11: Prepare Response Object
- * 12: Serialize Response Object
- * 13: Set return code
- * 14: Release lock on switch state 
- * 15: Fill Response Header
- * 16: Serialize Header 
- * 17: Push Response mctp_msg onto Transmit Message Queue 
- * 18: Checkin mctp_msgs 
+ *  4: Set response buffer pointer 
+ *  5: Extract parameters
+ *  6: Obtain lock on switch state 
+ *  7: Validate Inputs 
+ *  8: Perform Action 
+ *  9: Prepare Response Object
+ * 10: Serialize Response Object
+ * 11: Set return code
+ * 12: Release lock on switch state 
+ * 13: Fill Response Header
+ * 14: Serialize Header 
+ * 15: Push Response mctp_msg onto Transmit Message Queue 
+ * 16: Checkin mctp_msgs 
  */
-int fmop_isc_msg_limit_set(struct mctp *m, struct mctp_action *ma)
+int fmop_isc_msg_limit_set(struct mctp *m, struct mctp_action *ma, struct fmapi_msg *req)
 {
 	INIT
-	char now[ISO_TIME_BUF_LEN];
-	struct fmapi_msg req, rsp;
+	struct fmapi_msg rsp;
 	unsigned rc;
 	int rv, len;
 
@@ -466,10 +431,8 @@ int fmop_isc_msg_limit_set(struct mctp *m, struct mctp_action *ma)
 	rv = 1; 
 	len = 0;
 	rc = FMRC_INVALID_INPUT;
-	isotime(now, ISO_TIME_BUF_LEN);
 
-	STEP // 2: Get response mctp_msg buffer
-	ma->rsp = pq_pop(m->msgs, 1);
+	STEP // 2: Verify Response mctp_msg buffer was checked out by the dispatcher
 	if (ma->rsp == NULL)  
 		goto end;
 
@@ -477,58 +440,52 @@ int fmop_isc_msg_limit_set(struct mctp *m, struct mctp_action *ma)
 	mctp_fill_msg_hdr(ma->rsp, ma->req->src, m->state.eid, 0, ma->req->tag);
 	ma->rsp->type = ma->req->type;
 	
-	// 4: Set buffer pointers 
-	req.buf = (struct fmapi_buf*) ma->req->payload;
+	// 4: Set response buffer pointer 
 	rsp.buf = (struct fmapi_buf*) ma->rsp->payload;
 
-	STEP // 5: Deserialize Request Header
-	if ( fmapi_deserialize(&req.hdr, req.buf->hdr, FMOB_HDR, NULL) <= 0 )
-		goto end;
+	STEP // 5: Extract parameters
 
-	STEP // 6: Deserialize Request Object 
-	if ( fmapi_deserialize(&req.obj, req.buf->payload, fmapi_fmob_req(req.hdr.opcode), NULL) < 0 )
-		goto end;
+	IFV(CLVB_COMMANDS) logger_printf("CMD: FM API ISC Set Response Message Limit\n");
 
-	STEP // 7: Extract parameters
+	STEP // 6: Obtain lock on switch state 
+	state_lock_id(1);
 
-	IFV(CLVB_COMMANDS) printf("%s CMD: FM API ISC Set Response Message Limit\n", now);
-
-	STEP // 8: Obtain lock on switch state 
-	pthread_mutex_lock(&cxls->mtx);
-
-	STEP // 9: Validate Inputs 
-	if (req.obj.isc_msg_limit.limit < 8 || req.obj.isc_msg_limit.limit > 20)
+	STEP // 7: Validate Inputs 
+	if (req->obj.isc_msg_limit.limit < 8 || req->obj.isc_msg_limit.limit > 20)
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Requested Message Response Limit outside allowed values. Requested: %d min: 8 max: 20\n", now, req.obj.isc_msg_limit.limit);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Requested Message Response Limit outside allowed values. Requested: %d min: 8 max: 20\n", req->obj.isc_msg_limit.limit);
 		goto send;
 	}
 
-	STEP // 10: Perform Action 
-	cxls->msg_rsp_limit_n = req.obj.isc_msg_limit.limit;
+	STEP // 8: Perform Action 
+	cxls->msg_rsp_limit_n = req->obj.isc_msg_limit.limit;
+	state_gen_bump(STATE_GEN_ID, 0);
 
-	STEP // 11: Prepare Response Object
+	STEP // 9: Prepare Response Object
 	rsp.obj.isc_msg_limit.limit = cxls->msg_rsp_limit_n;
 
-	STEP // 12: Serialize Response Object
-	len = fmapi_serialize(rsp.buf->payload, &rsp.obj, fmapi_fmob_rsp(req.hdr.opcode));
-	if (len < 0)
-		goto end;
+	STEP // 10: Serialize Response Object
+	len = fmapi_serialize(rsp.buf->payload, &rsp.obj, fmapi_fmob_rsp(req->hdr.opcode));
 
-	STEP // 13: Set return code
+	STEP // 11: Set return code
 	rc = FMRC_SUCCESS;
 
 send:
 
-	STEP // 14: Release lock on switch state 
-	pthread_mutex_unlock(&cxls->mtx);
+	STEP // 12: Release lock on switch state 
+	state_unlock_id();
+
+	if (len < 0)
+		goto end;
 
-	STEP // 15: Fill Response Header
-	ma->rsp->len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, req.hdr.tag, req.hdr.opcode, 0, len, rc, 0);
+	STEP // 13: Fill Response Header
+	metrics_rc(rc);
+	ma->rsp->len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, req->hdr.tag, req->hdr.opcode, 0, len, rc, 0);
 
-	STEP // 16: Serialize Header 
+	STEP // 14: Serialize Header 
 	fmapi_serialize(rsp.buf->hdr, &rsp.hdr, FMOB_HDR);
 
-	STEP // 17: Push mctp_action onto queue 
+	STEP // 15: Push mctp_action onto queue 
 	pq_push(m->tmq, ma);
 
 	rv = 0;
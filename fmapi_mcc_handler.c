@@ -42,40 +42,25 @@
  */
 #include <mctp.h>
 #include <ptrqueue.h>
-#include <timeutils.h>
 #include <cxlstate.h>
 #include "signals.h"
 
 #include "options.h"
 
+#include "trace.h"
+
+#include "logger.h"
+
 #include "state.h"
 
+#include "qos.h"
+
 #include <fmapi.h>
 
 #include "fmapi_handler.h"
 
 /* MACROS ====================================================================*/
 
-#ifdef CSE_VERBOSE
- #define INIT 			unsigned step = 0;
- #define ENTER 					if (opts[CLOP_VERBOSITY].u64 & CLVB_CALLSTACK) 	printf("%d:%s Enter\n", 			gettid(), __FUNCTION__);
- #define STEP 			step++; if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u\n", 			gettid(), __FUNCTION__, step);
- #define HEX32(m, i)			if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u %s: 0x%x\n",	gettid(), __FUNCTION__, step, m, i);
- #define INT32(m, i)			if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u %s: %d\n",	gettid(), __FUNCTION__, step, m, i);
- #define EXIT(rc) 				if (opts[CLOP_VERBOSITY].u64 & CLVB_CALLSTACK) 	printf("%d:%s Exit: %d\n", 			gettid(), __FUNCTION__,rc);
-#else
- #define ENTER
- #define EXIT(rc)
- #define STEP
- #define HEX32(m, i)
- #define INT32(m, i)
- #define INIT 
-#endif // CSE_VERBOSE
-
-#define IFV(u) 					if (opts[CLOP_VERBOSITY].u64 & u) 
-
-#define ISO_TIME_BUF_LEN		32
-
 /* ENUMERATIONS ==============================================================*/
 
 /* STRUCTS ===================================================================*/
@@ -91,28 +76,25 @@
  *
  * @param m 	struct mctp* 
  * @param mm 	struct mctp_msg* 
- * @param req 	struct fmapi_msg* 
+ * @param req 	struct fmapi_msg* holding the decoded tunneled request
  * @param rsp   struct fmapi_msg*
  * @return 		length of serialized message (FMLN_HDR + object)
  *
  * STEPS
  *   1: Initialize variables
- *   2: Deserialize Request Header
- *   3: Deserialize Request Object 
- *   4: Extract parameters
- *   5: Validate Inputs 
- *   6: Perform Action 
- *   7: Prepare Response Object
- *   8: Serialize Response Object
- *   9: Set return code
- *  10: Fill Response Header
- *  11: Serialize Response Header 
- *  12: Return length of MF API Message (FMLN_HDR + object)
+ *   2: Extract parameters
+ *   3: Validate Inputs 
+ *   4: Perform Action 
+ *   5: Prepare Response Object
+ *   6: Serialize Response Object
+ *   7: Set return code
+ *   8: Fill Response Header
+ *   9: Serialize Response Header 
+ *  10: Return length of MF API Message (FMLN_HDR + object)
  */
 int fmop_mcc_get_ld_alloc(struct cxl_port *p, struct fmapi_msg *req, struct fmapi_msg *rsp)
 {
 	INIT
-	char now[ISO_TIME_BUF_LEN];
 	unsigned rc;
 	int rv, len;
 
@@ -124,39 +106,30 @@ int fmop_mcc_get_ld_alloc(struct cxl_port *p, struct fmapi_msg *req, struct fmap
 	rv = 0; 
 	len = 0;
 	rc = FMRC_INVALID_INPUT;
-	isotime(now, ISO_TIME_BUF_LEN);
 	
-	STEP // 2: Deserialize Header
-	if ( fmapi_deserialize(&req->hdr, req->buf->hdr, FMOB_HDR, 0) <= 0)
-		goto end;
-
-	STEP // 3: Deserialize Request Object 
-	if ( fmapi_deserialize(&req->obj, req->buf->payload, fmapi_fmob_req(req->hdr.opcode), NULL) < 0 )
-		goto end;
-
-    STEP // 4: Extract parameters
+    STEP // 2: Extract parameters
 
-	IFV(CLVB_COMMANDS) printf("%s CMD: FM API MCC Get LD Allocations. PPID: %d\n", now, p->ppid);
+	IFV(CLVB_COMMANDS) logger_printf("CMD: FM API MCC Get LD Allocations. PPID: %d\n", p->ppid);
 
-	STEP // 5: Validate Inputs 
+	STEP // 3: Validate Inputs 
 	
 	// If port does not have an mld device return invalid
 	if (p->mld == NULL) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Port not connected to an MLD\n", now);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Port not connected to an MLD\n");
 		goto send;
 	}
 
 	// If start num exceeds number of vppbids return invalid 
 	if (req->obj.mcc_alloc_get_req.start > p->mld->num)
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Requested start ldid exceeds number of logical devices on this mld. Start: %d Actual: %d\n", now, req->obj.mcc_alloc_get_req.start, p->mld->num);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Requested start ldid exceeds number of logical devices on this mld. Start: %d Actual: %d\n", req->obj.mcc_alloc_get_req.start, p->mld->num);
 		goto send;
 	}
 
-	STEP // 6: Perform Action 
+	STEP // 4: Perform Action 
 
-	STEP // 7: Prepare Response Object
+	STEP // 5: Prepare Response Object
 	rsp->obj.mcc_alloc_get_rsp.total 		= p->mld->num;
 	rsp->obj.mcc_alloc_get_rsp.granularity 	= p->mld->granularity;
 	rsp->obj.mcc_alloc_get_rsp.start 		= req->obj.mcc_alloc_get_req.start;
@@ -173,25 +146,23 @@ int fmop_mcc_get_ld_alloc(struct cxl_port *p, struct fmapi_msg *req, struct fmap
 		rsp->obj.mcc_alloc_get_rsp.num++;
 	}
 
-	STEP // 8: Serialize Response Object
+	STEP // 6: Serialize Response Object
 	len = fmapi_serialize(rsp->buf->payload, &rsp->obj, fmapi_fmob_rsp(req->hdr.opcode));
 
-	STEP // 9: Set return code
+	STEP // 7: Set return code
 	rc = FMRC_SUCCESS;
 
 send:
 
- 	STEP // 10: Fill Response Header
+ 	STEP // 8: Fill Response Header
 	rv = fmapi_fill_hdr(&rsp->hdr, FMMT_RESP, req->hdr.tag, req->hdr.opcode, 0, len, rc, 0);
 
-	STEP // 11: Serialize Response Header 
+	STEP // 9: Serialize Response Header 
 	fmapi_serialize(rsp->buf->hdr, &rsp->hdr, FMOB_HDR);
 
-end:
-
 	EXIT(rc)
 	
-	STEP // 12: Return length of MF API Message (FMLN_HDR + object)
+	STEP // 10: Return length of MF API Message (FMLN_HDR + object)
 	return rv;
 }
 
@@ -200,28 +171,25 @@ end:
  *
  * @param m 	struct mctp* 
  * @param mm 	struct mctp_msg* 
- * @param req 	struct fmapi_msg* 
+ * @param req 	struct fmapi_msg* holding the decoded tunneled request
  * @param rsp   struct fmapi_msg*
  * @return 		length of serialized message (FMLN_HDR + object)
  *
  * STEPS
  *   1: Initialize variables
- *   2: Deserialize Request Header
- *   3: Deserialize Request Object 
- *   4: Extract parameters
- *   5: Validate Inputs 
- *   6: Perform Action 
- *   7: Prepare Response Object
- *   8: Serialize Response Object
- *   9: Set return code
- *  10: Fill Response Header
- *  11: Serialize Response Header 
- *  12: Return length of MF API Message (FMLN_HDR + object)
+ *   2: Extract parameters
+ *   3: Validate Inputs 
+ *   4: Perform Action 
+ *   5: Prepare Response Object
+ *   6: Serialize Response Object
+ *   7: Set return code
+ *   8: Fill Response Header
+ *   9: Serialize Response Header 
+ *  10: Return length of MF API Message (FMLN_HDR + object)
  */
 int fmop_mcc_get_qos_alloc(struct cxl_port *p, struct fmapi_msg *req, struct fmapi_msg *rsp)
 {
 	INIT
-	char now[ISO_TIME_BUF_LEN];
 	unsigned rc;
 	int rv, len;
 
@@ -233,32 +201,23 @@ int fmop_mcc_get_qos_alloc(struct cxl_port *p, struct fmapi_msg *req, struct fma
 	rv = 0; 
 	len = 0;
 	rc = FMRC_INVALID_INPUT;
-	isotime(now, ISO_TIME_BUF_LEN);
 	
-	STEP // 2: Deserialize Header
-	if ( fmapi_deserialize(&req->hdr, req->buf->hdr, FMOB_HDR, 0) <= 0)
-		goto end;
-
-	STEP // 3: Deserialize Request Object 
-	if ( fmapi_deserialize(&req->obj, req->buf->payload, fmapi_fmob_req(req->hdr.opcode), NULL) < 0 )
-		goto end;
+    STEP // 2: Extract parameters
 
-    STEP // 4: Extract parameters
+	IFV(CLVB_COMMANDS) logger_printf("CMD: FM API MCC Get QoS Allocated. PPID: %d\n", p->ppid);
 
-	IFV(CLVB_COMMANDS) printf("%s CMD: FM API MCC Get QoS Allocated. PPID: %d\n", now, p->ppid);
-
-	STEP // 5: Validate Inputs 
+	STEP // 3: Validate Inputs 
 	
 	// If port does not have an mld device return invalid
 	if (p->mld == NULL) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Port not connected to an MLD\n", now);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Port not connected to an MLD\n");
 		goto send;
 	}
 
-	STEP // 6: Perform Action 
+	STEP // 4: Perform Action 
 
-	STEP // 7: Prepare Response Object
+	STEP // 5: Prepare Response Object
 	rsp->obj.mcc_qos_bw_alloc.num = req->obj.mcc_qos_bw_alloc_get_req.num;
 	rsp->obj.mcc_qos_bw_alloc.start = req->obj.mcc_qos_bw_alloc_get_req.start;
 	if ( (p->mld->num - req->obj.mcc_qos_bw_alloc_get_req.start) < req->obj.mcc_qos_bw_alloc_get_req.num )
@@ -267,25 +226,23 @@ int fmop_mcc_get_qos_alloc(struct cxl_port *p, struct fmapi_msg *req, struct fma
 	for ( i = 0 ; i < rsp->obj.mcc_qos_bw_alloc.num ; i++) 
 		rsp->obj.mcc_qos_bw_alloc.list[i] = p->mld->alloc_bw[i+req->obj.mcc_qos_bw_alloc_get_req.start];
 
-	STEP // 8: Serialize Response Object
+	STEP // 6: Serialize Response Object
 	len = fmapi_serialize(rsp->buf->payload, &rsp->obj, fmapi_fmob_rsp(req->hdr.opcode));
 
-	STEP // 9: Set return code
+	STEP // 7: Set return code
 	rc = FMRC_SUCCESS;
 
 send:
 
- 	STEP // 10: Fill Response Header
+ 	STEP // 8: Fill Response Header
 	rv = fmapi_fill_hdr(&rsp->hdr, FMMT_RESP, req->hdr.tag, req->hdr.opcode, 0, len, rc, 0);
 
-	STEP // 11: Serialize Response Header 
+	STEP // 9: Serialize Response Header 
 	fmapi_serialize(rsp->buf->hdr, &rsp->hdr, FMOB_HDR);
 
-end:
-
 	EXIT(rc)
 	
-	STEP // 12: Return length of MF API Message (FMLN_HDR + object)
+	STEP // 10: Return length of MF API Message (FMLN_HDR + object)
 	return rv;
 }
 
@@ -294,28 +251,25 @@ end:
  *
  * @param m 	struct mctp* 
  * @param mm 	struct mctp_msg* 
- * @param req 	struct fmapi_msg* 
+ * @param req 	struct fmapi_msg* holding the decoded tunneled request
  * @param rsp   struct fmapi_msg*
  * @return 		length of serialized message (FMLN_HDR + object)
  *
  * STEPS
  *   1: Initialize variables
- *   2: Deserialize Request Header
- *   3: Deserialize Request Object 
- *   4: Extract parameters
- *   5: Validate Inputs 
- *   6: Perform Action 
- *   7: Prepare Response Object
- *   8: Serialize Response Object
- *   9: Set return code
- *  10: Fill Response Header
- *  11: Serialize Response Header 
- *  12: Return length of MF API Message (FMLN_HDR + object)
+ *   2: Extract parameters
+ *   3: Validate Inputs 
+ *   4: Perform Action 
+ *   5: Prepare Response Object
+ *   6: Serialize Response Object
+ *   7: Set return code
+ *   8: Fill Response Header
+ *   9: Serialize Response Header 
+ *  10: Return length of MF API Message (FMLN_HDR + object)
  */
 int fmop_mcc_get_qos_ctrl(struct cxl_port *p, struct fmapi_msg *req, struct fmapi_msg *rsp)
 {
 	INIT
-	char now[ISO_TIME_BUF_LEN];
 	unsigned rc;
 	int rv, len;
 
@@ -325,32 +279,23 @@ int fmop_mcc_get_qos_ctrl(struct cxl_port *p, struct fmapi_msg *req, struct fmap
 	rv = 0; 
 	len = 0;
 	rc = FMRC_INVALID_INPUT;
-	isotime(now, ISO_TIME_BUF_LEN);
 	
-	STEP // 2: Deserialize Header
-	if ( fmapi_deserialize(&req->hdr, req->buf->hdr, FMOB_HDR, 0) <= 0)
-		goto end;
-
-	STEP // 3: Deserialize Request Object 
-	if ( fmapi_deserialize(&req->obj, req->buf->payload, fmapi_fmob_req(req->hdr.opcode), NULL) < 0 )
-		goto end;
+    STEP // 2: Extract parameters
 
-    STEP // 4: Extract parameters
+	IFV(CLVB_COMMANDS) logger_printf("CMD: FM API MCC Get QoS Control. PPID: %d\n", p->ppid);
 
-	IFV(CLVB_COMMANDS) printf("%s CMD: FM API MCC Get QoS Control. PPID: %d\n", now, p->ppid);
-
-	STEP // 5: Validate Inputs 
+	STEP // 3: Validate Inputs 
 	
 	// If port does not have an mld device return invalid
 	if (p->mld == NULL) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Port not connected to an MLD\n", now);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Port not connected to an MLD\n");
 		goto send;
 	}
 
-	STEP // 6: Perform Action 
+	STEP // 4: Perform Action 
 
-	STEP // 7: Prepare Response Object
+	STEP // 5: Prepare Response Object
 	
 	rsp->obj.mcc_qos_ctrl.epc_en 			= p->mld->epc_en;
 	rsp->obj.mcc_qos_ctrl.ttr_en 			= p->mld->ttr_en;
@@ -360,25 +305,23 @@ int fmop_mcc_get_qos_ctrl(struct cxl_port *p, struct fmapi_msg *req, struct fmap
 	rsp->obj.mcc_qos_ctrl.rcb 				= p->mld->rcb;
 	rsp->obj.mcc_qos_ctrl.comp_interval 	= p->mld->comp_interval;
 
-	STEP // 8: Serialize Response Object
+	STEP // 6: Serialize Response Object
 	len = fmapi_serialize(rsp->buf->payload, &rsp->obj, fmapi_fmob_rsp(req->hdr.opcode));
 
-	STEP // 9: Set return code
+	STEP // 7: Set return code
 	rc = FMRC_SUCCESS;
 
 send:
 
- 	STEP // 10: Fill Response Header
+ 	STEP // 8: Fill Response Header
 	rv = fmapi_fill_hdr(&rsp->hdr, FMMT_RESP, req->hdr.tag, req->hdr.opcode, 0, len, rc, 0);
 
-	STEP // 11: Serialize Response Header 
+	STEP // 9: Serialize Response Header 
 	fmapi_serialize(rsp->buf->hdr, &rsp->hdr, FMOB_HDR);
 
-end:
-
 	EXIT(rc)
 	
-	STEP // 12: Return length of MF API Message (FMLN_HDR + object)
+	STEP // 10: Return length of MF API Message (FMLN_HDR + object)
 	return rv;
 }
 
@@ -387,28 +330,25 @@ end:
  *
  * @param m 	struct mctp* 
  * @param mm 	struct mctp_msg* 
- * @param req 	struct fmapi_msg* 
+ * @param req 	struct fmapi_msg* holding the decoded tunneled request
  * @param rsp   struct fmapi_msg*
  * @return 		length of serialized message (FMLN_HDR + object)
  *
  * STEPS
  *   1: Initialize variables
- *   2: Deserialize Request Header
- *   3: Deserialize Request Object 
- *   4: Extract parameters
- *   5: Validate Inputs 
- *   6: Perform Action 
- *   7: Prepare Response Object
- *   8: Serialize Response Object
- *   9: Set return code
- *  10: Fill Response Header
- *  11: Serialize Response Header 
- *  12: Return length of MF API Message (FMLN_HDR + object)
+ *   2: Extract parameters
+ *   3: Validate Inputs 
+ *   4: Perform Action 
+ *   5: Prepare Response Object
+ *   6: Serialize Response Object
+ *   7: Set return code
+ *   8: Fill Response Header
+ *   9: Serialize Response Header 
+ *  10: Return length of MF API Message (FMLN_HDR + object)
  */
 int fmop_mcc_get_qos_limit(struct cxl_port *p, struct fmapi_msg *req, struct fmapi_msg *rsp)
 {
 	INIT
-	char now[ISO_TIME_BUF_LEN];
 	unsigned rc;
 	int rv, len;
 
@@ -420,32 +360,23 @@ int fmop_mcc_get_qos_limit(struct cxl_port *p, struct fmapi_msg *req, struct fma
 	rv = 0; 
 	len = 0;
 	rc = FMRC_INVALID_INPUT;
-	isotime(now, ISO_TIME_BUF_LEN);
 	
-	STEP // 2: Deserialize Header
-	if ( fmapi_deserialize(&req->hdr, req->buf->hdr, FMOB_HDR, 0) <= 0)
-		goto end;
-
-	STEP // 3: Deserialize Request Object 
-	if ( fmapi_deserialize(&req->obj, req->buf->payload, fmapi_fmob_req(req->hdr.opcode), NULL) < 0 )
-		goto end;
+    STEP // 2: Extract parameters
 
-    STEP // 4: Extract parameters
+	IFV(CLVB_COMMANDS) logger_printf("CMD: FM API MCC Get QoS Limit. PPID: %d\n", p->ppid);
 
-	IFV(CLVB_COMMANDS) printf("%s CMD: FM API MCC Get QoS Limit. PPID: %d\n", now, p->ppid);
-
-	STEP // 5: Validate Inputs 
+	STEP // 3: Validate Inputs 
 	
 	// If port does not have an mld device return invalid
 	if (p->mld == NULL) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Port not connected to an MLD\n", now);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Port not connected to an MLD\n");
 		goto send;
 	}
 
-	STEP // 6: Perform Action 
+	STEP // 4: Perform Action 
 
-	STEP // 7: Prepare Response Object
+	STEP // 5: Prepare Response Object
 	rsp->obj.mcc_qos_bw_limit.num 	= req->obj.mcc_qos_bw_limit_get_req.num;
 	rsp->obj.mcc_qos_bw_limit.start = req->obj.mcc_qos_bw_limit_get_req.start;
 	if ( (p->mld->num - req->obj.mcc_qos_bw_limit_get_req.start) < req->obj.mcc_qos_bw_limit_get_req.num )
@@ -454,25 +385,23 @@ int fmop_mcc_get_qos_limit(struct cxl_port *p, struct fmapi_msg *req, struct fma
 	for ( i = 0 ; i < rsp->obj.mcc_qos_bw_limit.num ; i++ ) 
 		rsp->obj.mcc_qos_bw_limit.list[i] = p->mld->bw_limit[i+req->obj.mcc_qos_bw_limit_get_req.start];
 
-	STEP // 8: Serialize Response Object
+	STEP // 6: Serialize Response Object
 	len = fmapi_serialize(rsp->buf->payload, &rsp->obj, fmapi_fmob_rsp(req->hdr.opcode));
 
-	STEP // 9: Set return code
+	STEP // 7: Set return code
 	rc = FMRC_SUCCESS;
 
 send:
 
- 	STEP // 10: Fill Response Header
+ 	STEP // 8: Fill Response Header
 	rv = fmapi_fill_hdr(&rsp->hdr, FMMT_RESP, req->hdr.tag, req->hdr.opcode, 0, len, rc, 0);
 
-	STEP // 11: Serialize Response Header 
+	STEP // 9: Serialize Response Header 
 	fmapi_serialize(rsp->buf->hdr, &rsp->hdr, FMOB_HDR);
 
-end:
-
 	EXIT(rc)
 	
-	STEP // 12: Return length of MF API Message (FMLN_HDR + object)
+	STEP // 10: Return length of MF API Message (FMLN_HDR + object)
 	return rv;
 }
 
@@ -481,28 +410,25 @@ end:
  *
  * @param m 	struct mctp* 
  * @param mm 	struct mctp_msg* 
- * @param req 	struct fmapi_msg* 
+ * @param req 	struct fmapi_msg* holding the decoded tunneled request
  * @param rsp   struct fmapi_msg*
  * @return 		length of serialized message (FMLN_HDR + object)
  *
  * STEPS
  *   1: Initialize variables
- *   2: Deserialize Request Header
- *   3: Deserialize Request Object 
- *   4: Extract parameters
- *   5: Validate Inputs 
- *   6: Perform Action 
- *   7: Prepare Response Object
- *   8: Serialize Response Object
- *   9: Set return code
- *  10: Fill Response Header
- *  11: Serialize Response Header 
- *  12: Return length of MF API Message (FMLN_HDR + object)
+ *   2: Extract parameters
+ *   3: Validate Inputs 
+ *   4: Perform Action 
+ *   5: Prepare Response Object
+ *   6: Serialize Response Object
+ *   7: Set return code
+ *   8: Fill Response Header
+ *   9: Serialize Response Header 
+ *  10: Return length of MF API Message (FMLN_HDR + object)
  */
 int fmop_mcc_get_qos_stat(struct cxl_port *p, struct fmapi_msg *req, struct fmapi_msg *rsp)
 {
 	INIT
-	char now[ISO_TIME_BUF_LEN];
 	unsigned rc;
 	int rv, len;
 
@@ -512,53 +438,43 @@ int fmop_mcc_get_qos_stat(struct cxl_port *p, struct fmapi_msg *req, struct fmap
 	rv = 0; 
 	len = 0;
 	rc = FMRC_INVALID_INPUT;
-	isotime(now, ISO_TIME_BUF_LEN);
 	
-	STEP // 2: Deserialize Header
-	if ( fmapi_deserialize(&req->hdr, req->buf->hdr, FMOB_HDR, 0) <= 0)
-		goto end;
-
-	STEP // 3: Deserialize Request Object 
-	if ( fmapi_deserialize(&req->obj, req->buf->payload, fmapi_fmob_req(req->hdr.opcode), NULL) < 0 )
-		goto end;
-
-    STEP // 4: Extract parameters
+    STEP // 2: Extract parameters
 
-	IFV(CLVB_COMMANDS) printf("%s CMD: FM API MCC Get QoS Status. PPID: %d\n", now, p->ppid);
+	IFV(CLVB_COMMANDS) logger_printf("CMD: FM API MCC Get QoS Status. PPID: %d\n", p->ppid);
 
-	STEP // 5: Validate Inputs 
+	STEP // 3: Validate Inputs 
 
 	// If port does not have an mld device return invalid
 	if (p->mld == NULL) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Port not connected to an MLD\n", now);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Port not connected to an MLD\n");
 		goto send;
 	}
 	
-	STEP // 6: Perform Action 
+	STEP // 4: Perform Action 
+	qos_update(p);
 
-	STEP // 7: Prepare Response Object
+	STEP // 5: Prepare Response Object
 	rsp->obj.mcc_qos_stat_rsp.bp_avg_pcnt = p->mld->bp_avg_pcnt;
 
-	STEP // 8: Serialize Response Object
+	STEP // 6: Serialize Response Object
 	len = fmapi_serialize(rsp->buf->payload, &rsp->obj, fmapi_fmob_rsp(req->hdr.opcode));
 
-	STEP // 9: Set return code
+	STEP // 7: Set return code
 	rc = FMRC_SUCCESS;
 
 send:
 
- 	STEP // 10: Fill Response Header
+ 	STEP // 8: Fill Response Header
 	rv = fmapi_fill_hdr(&rsp->hdr, FMMT_RESP, req->hdr.tag, req->hdr.opcode, 0, len, rc, 0);
 
-	STEP // 11: Serialize Response Header 
+	STEP // 9: Serialize Response Header 
 	fmapi_serialize(rsp->buf->hdr, &rsp->hdr, FMOB_HDR);
 
-end:
-
 	EXIT(rc)
 	
-	STEP // 12: Return length of MF API Message (FMLN_HDR + object)
+	STEP // 10: Return length of MF API Message (FMLN_HDR + object)
 	return rv;
 }
 
@@ -567,28 +483,25 @@ end:
  *
  * @param m 	struct mctp* 
  * @param mm 	struct mctp_msg* 
- * @param req 	struct fmapi_msg* 
+ * @param req 	struct fmapi_msg* holding the decoded tunneled request
  * @param rsp   struct fmapi_msg*
  * @return 		length of serialized message (FMLN_HDR + object)
  *
  * STEPS
  *   1: Initialize variables
- *   2: Deserialize Request Header
- *   3: Deserialize Request Object 
- *   4: Extract parameters
- *   5: Validate Inputs 
- *   6: Perform Action 
- *   7: Prepare Response Object
- *   8: Serialize Response Object
- *   9: Set return code
- *  10: Fill Response Header
- *  11: Serialize Response Header 
- *  12: Return length of MF API Message (FMLN_HDR + object)
+ *   2: Extract parameters
+ *   3: Validate Inputs 
+ *   4: Perform Action 
+ *   5: Prepare Response Object
+ *   6: Serialize Response Object
+ *   7: Set return code
+ *   8: Fill Response Header
+ *   9: Serialize Response Header 
+ *  10: Return length of MF API Message (FMLN_HDR + object)
  */
 int fmop_mcc_info(struct cxl_port *p, struct fmapi_msg *req, struct fmapi_msg *rsp)
 {
 	INIT
-	char now[ISO_TIME_BUF_LEN];
 	unsigned rc;
 	int rv, len;
 
@@ -598,56 +511,45 @@ int fmop_mcc_info(struct cxl_port *p, struct fmapi_msg *req, struct fmapi_msg *r
 	rv = 0; 
 	len = 0;
 	rc = FMRC_INVALID_INPUT;
-	isotime(now, ISO_TIME_BUF_LEN);
 	
-	STEP // 2: Deserialize Header
-	if ( fmapi_deserialize(&req->hdr, req->buf->hdr, FMOB_HDR, 0) <= 0)
-		goto end;
-
-	STEP // 3: Deserialize Request Object 
-	if ( fmapi_deserialize(&req->obj, req->buf->payload, fmapi_fmob_req(req->hdr.opcode), NULL) < 0 )
-		goto end;
+    STEP // 2: Extract parameters
 
-    STEP // 4: Extract parameters
+	IFV(CLVB_COMMANDS) logger_printf("CMD: FM API MCC Get LD Info. PPID: %d\n", p->ppid);
 
-	IFV(CLVB_COMMANDS) printf("%s CMD: FM API MCC Get LD Info. PPID: %d\n", now, p->ppid);
-
-	STEP // 5: Validate Inputs 
+	STEP // 3: Validate Inputs 
 	
 	// If port does not have an mld device return invalid
 	if (p->mld == NULL) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Port not connected to an MLD\n", now);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Port not connected to an MLD\n");
 		goto send;
 	}
 
-	STEP // 6: Perform Action 
+	STEP // 4: Perform Action 
 
-	STEP // 7: Prepare Response Object
+	STEP // 5: Prepare Response Object
 	rsp->obj.mcc_info_rsp.size 	= p->mld->memory_size ;
 	rsp->obj.mcc_info_rsp.num 	= p->mld->num;
 	rsp->obj.mcc_info_rsp.epc 	= p->mld->epc;
 	rsp->obj.mcc_info_rsp.ttr 	= p->mld->ttr;
 
-	STEP // 8: Serialize Response Object
+	STEP // 6: Serialize Response Object
 	len = fmapi_serialize(rsp->buf->payload, &rsp->obj, fmapi_fmob_rsp(req->hdr.opcode));
 
-	STEP // 9: Set return code
+	STEP // 7: Set return code
 	rc = FMRC_SUCCESS;
 
 send:
 
- 	STEP // 10: Fill Response Header
+ 	STEP // 8: Fill Response Header
 	rv = fmapi_fill_hdr(&rsp->hdr, FMMT_RESP, req->hdr.tag, req->hdr.opcode, 0, len, rc, 0);
 
-	STEP // 11: Serialize Response Header 
+	STEP // 9: Serialize Response Header 
 	fmapi_serialize(rsp->buf->hdr, &rsp->hdr, FMOB_HDR);
 
-end:
-
 	EXIT(rc)
 	
-	STEP // 12: Return length of MF API Message (FMLN_HDR + object)
+	STEP // 10: Return length of MF API Message (FMLN_HDR + object)
 	return rv;
 }
 
@@ -656,28 +558,25 @@ end:
  *
  * @param m 	struct mctp* 
  * @param mm 	struct mctp_msg* 
- * @param req 	struct fmapi_msg* 
+ * @param req 	struct fmapi_msg* holding the decoded tunneled request
  * @param rsp   struct fmapi_msg*
  * @return 		length of serialized message (FMLN_HDR + object)
  *
  * STEPS
  *   1: Initialize variables
- *   2: Deserialize Request Header
- *   3: Deserialize Request Object 
- *   4: Extract parameters
- *   5: Validate Inputs 
- *   6: Perform Action 
- *   7: Set return code
- *   8: Prepare Response Object
- *   9: Serialize Response Object
- *  10: Fill Response Header
- *  11: Serialize Response Header 
- *  12: Return length of MF API Message (FMLN_HDR + object)
+ *   2: Extract parameters
+ *   3: Validate Inputs 
+ *   4: Perform Action 
+ *   5: Set return code
+ *   6: Prepare Response Object
+ *   7: Serialize Response Object
+ *   8: Fill Response Header
+ *   9: Serialize Response Header 
+ *  10: Return length of MF API Message (FMLN_HDR + object)
  */
 int fmop_mcc_set_ld_alloc(struct cxl_port *p, struct fmapi_msg *req, struct fmapi_msg *rsp)
 {
 	INIT
-	char now[ISO_TIME_BUF_LEN];
 	unsigned rc;
 	int rv, len;
 
@@ -689,53 +588,44 @@ int fmop_mcc_set_ld_alloc(struct cxl_port *p, struct fmapi_msg *req, struct fmap
 	rv = 0; 
 	len = 0;
 	rc = FMRC_INVALID_INPUT;
-	isotime(now, ISO_TIME_BUF_LEN);
 	
-	STEP // 2: Deserialize Header
-	if ( fmapi_deserialize(&req->hdr, req->buf->hdr, FMOB_HDR, 0) <= 0)
-		goto end;
-
-	STEP // 3: Deserialize Request Object 
-	if ( fmapi_deserialize(&req->obj, req->buf->payload, fmapi_fmob_req(req->hdr.opcode), NULL) < 0 )
-		goto end;
+    STEP // 2: Extract parameters
 
-    STEP // 4: Extract parameters
+	IFV(CLVB_COMMANDS) logger_printf("CMD: FM API MCC Set LD Allocations. PPID: %d\n", p->ppid);
 
-	IFV(CLVB_COMMANDS) printf("%s CMD: FM API MCC Set LD Allocations. PPID: %d\n", now, p->ppid);
-
-	STEP // 5: Validate Inputs 
+	STEP // 3: Validate Inputs 
 	
 	// If port does not have an mld device return invalid
 	if (p->mld == NULL) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Port not connected to an MLD\n", now);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Port not connected to an MLD\n");
 		goto send;
 	}
 
 	// Verify requested LD count does not exceed actual LD count
 	if (req->obj.mcc_alloc_set_req.num > p->mld->num)
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Requested number of LD entries exceeds number of LDs present. Requested: %d Present: %d\n", now, req->obj.mcc_alloc_set_req.num, p->mld->num);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Requested number of LD entries exceeds number of LDs present. Requested: %d Present: %d\n", req->obj.mcc_alloc_set_req.num, p->mld->num);
 		goto send;
 	}
 
 	// Verify the start LD ID does not exceed actual LD count 
 	if (req->obj.mcc_alloc_set_req.start > p->mld->num)
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Requested started LD ID exceeds number of LDs present. Start: %d Present: %d\n", now, req->obj.mcc_alloc_set_req.start, p->mld->num);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Requested started LD ID exceeds number of LDs present. Start: %d Present: %d\n", req->obj.mcc_alloc_set_req.start, p->mld->num);
 		goto send;
 	}
 
 	// Verify the final LD ID does not exceed actual LD count 
 	if ((req->obj.mcc_alloc_set_req.start + req->obj.mcc_alloc_set_req.num) > p->mld->num)
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Requested start + num exceeds number of LDs present. End: %d Present: %d\n", now, req->obj.mcc_alloc_set_req.start+req->obj.mcc_alloc_set_req.num, p->mld->num);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Requested start + num exceeds number of LDs present. End: %d Present: %d\n", req->obj.mcc_alloc_set_req.start+req->obj.mcc_alloc_set_req.num, p->mld->num);
 		goto send;
 	}
 
-	STEP // 6: Perform Action 
+	STEP // 4: Perform Action 
 
-	IFV(CLVB_ACTIONS) printf("%s ACT: Setting LD Allocations on PPID: %d\n", now, p->ppid);
+	IFV(CLVB_ACTIONS) logger_printf("ACT: Setting LD Allocations on PPID: %d\n", p->ppid);
 
 	for ( i = 0 ; i < req->obj.mcc_alloc_set_req.num ; i++ ) 
 	{
@@ -743,12 +633,12 @@ int fmop_mcc_set_ld_alloc(struct cxl_port *p, struct fmapi_msg *req, struct fmap
 		p->mld->rng2[i+req->obj.mcc_alloc_set_req.start] = req->obj.mcc_alloc_set_req.list[i].rng2;
 	}
 
-	STEP // 7: Set return code
+	STEP // 5: Set return code
 	rc = FMRC_SUCCESS;
 
 send:
 
-	STEP // 8: Prepare Response Object
+	STEP // 6: Prepare Response Object
 	rsp->obj.mcc_alloc_set_rsp.num = req->obj.mcc_alloc_set_req.num;
 	rsp->obj.mcc_alloc_set_rsp.start = req->obj.mcc_alloc_set_req.start;
 	for ( i = 0 ; i < rsp->obj.mcc_alloc_set_rsp.num ; i++ ) {
@@ -756,20 +646,18 @@ send:
 		rsp->obj.mcc_alloc_set_rsp.list[i].rng2 = p->mld->rng2[i+rsp->obj.mcc_alloc_set_rsp.start];	
 	}
 
-	STEP // 9: Serialize Response Object
+	STEP // 7: Serialize Response Object
 	len = fmapi_serialize(rsp->buf->payload, &rsp->obj, fmapi_fmob_rsp(req->hdr.opcode));
 
- 	STEP // 10: Fill Response Header
+ 	STEP // 8: Fill Response Header
 	rv = fmapi_fill_hdr(&rsp->hdr, FMMT_RESP, req->hdr.tag, req->hdr.opcode, 0, len, rc, 0);
 
-	STEP // 11: Serialize Response Header 
+	STEP // 9: Serialize Response Header 
 	fmapi_serialize(rsp->buf->hdr, &rsp->hdr, FMOB_HDR);
 
-end:
-
 	EXIT(rc)
 	
-	STEP // 12: Return length of MF API Message (FMLN_HDR + object)
+	STEP // 10: Return length of MF API Message (FMLN_HDR + object)
 	return rv;
 }
 
@@ -778,28 +666,25 @@ end:
  *
  * @param m 	struct mctp* 
  * @param mm 	struct mctp_msg* 
- * @param req 	struct fmapi_msg* 
+ * @param req 	struct fmapi_msg* holding the decoded tunneled request
  * @param rsp   struct fmapi_msg*
  * @return 		length of serialized message (FMLN_HDR + object)
  *
  * STEPS
  *   1: Initialize variables
- *   2: Deserialize Request Header
- *   3: Deserialize Request Object 
- *   4: Extract parameters
- *   5: Validate Inputs 
- *   6: Perform Action 
- *   7: Set return code
- *   8: Prepare Response Object
- *   9: Serialize Response Object
- *  10: Fill Response Header
- *  11: Serialize Response Header 
- *  12: Return length of MF API Message (FMLN_HDR + object)
+ *   2: Extract parameters
+ *   3: Validate Inputs 
+ *   4: Perform Action 
+ *   5: Set return code
+ *   6: Prepare Response Object
+ *   7: Serialize Response Object
+ *   8: Fill Response Header
+ *   9: Serialize Response Header 
+ *  10: Return length of MF API Message (FMLN_HDR + object)
  */
 int fmop_mcc_set_qos_alloc(struct cxl_port *p, struct fmapi_msg *req, struct fmapi_msg *rsp)
 {
 	INIT
-	char now[ISO_TIME_BUF_LEN];
 	unsigned rc;
 	int rv, len;
 
@@ -811,74 +696,63 @@ int fmop_mcc_set_qos_alloc(struct cxl_port *p, struct fmapi_msg *req, struct fma
 	rv = 0; 
 	len = 0;
 	rc = FMRC_INVALID_INPUT;
-	isotime(now, ISO_TIME_BUF_LEN);
 	
-	STEP // 2: Deserialize Header
-	if ( fmapi_deserialize(&req->hdr, req->buf->hdr, FMOB_HDR, 0) <= 0)
-		goto end;
-
-	STEP // 3: Deserialize Request Object 
-	if ( fmapi_deserialize(&req->obj, req->buf->payload, fmapi_fmob_req(req->hdr.opcode), NULL) < 0 )
-		goto end;
+    STEP // 2: Extract parameters
 
-    STEP // 4: Extract parameters
+	IFV(CLVB_COMMANDS) logger_printf("CMD: FM API MCC Set QoS Allocated. PPID: %d\n", p->ppid);
 
-	IFV(CLVB_COMMANDS) printf("%s CMD: FM API MCC Set QoS Allocated. PPID: %d\n", now, p->ppid);
-
-	STEP // 5: Validate Inputs 
+	STEP // 3: Validate Inputs 
 	
 	// If port does not have an mld device return invalid
 	if (p->mld == NULL) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Port not connected to an MLD\n", now);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Port not connected to an MLD\n");
 		goto send;
 	}
 
 	// Verify requested LD count does not exceed actual LD count
 	if (req->obj.mcc_qos_bw_alloc.num > p->mld->num)
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Requested number of LD entries exceeds number of LDs present. Requested: %d Present: %d\n", now, req->obj.mcc_qos_bw_alloc.num, p->mld->num);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Requested number of LD entries exceeds number of LDs present. Requested: %d Present: %d\n", req->obj.mcc_qos_bw_alloc.num, p->mld->num);
 		goto send;
 	}
 
 	// Verify requested LD count does not exceed actual LD count
 	if ((req->obj.mcc_qos_bw_alloc.start + req->obj.mcc_qos_bw_alloc.num) > p->mld->num)
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Requested start + number of LD entries exceeds number of LDs present. Requested: %d Present: %d\n", now, req->obj.mcc_qos_bw_alloc.num, p->mld->num);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Requested start + number of LD entries exceeds number of LDs present. Requested: %d Present: %d\n", req->obj.mcc_qos_bw_alloc.num, p->mld->num);
 		goto send;
 	}
-	STEP // 6: Perform Action 
+	STEP // 4: Perform Action 
 
-	IFV(CLVB_ACTIONS) printf("%s ACT: Setting QoS Allocations on PPID: %d\n", now, p->ppid);
+	IFV(CLVB_ACTIONS) logger_printf("ACT: Setting QoS Allocations on PPID: %d\n", p->ppid);
 
 	for ( i = 0 ; i < req->obj.mcc_qos_bw_alloc.num ; i++ ) 
 		p->mld->alloc_bw[i+req->obj.mcc_qos_bw_alloc.start] = req->obj.mcc_qos_bw_alloc.list[i];
 
-	STEP // 7: Set return code
+	STEP // 5: Set return code
 	rc = FMRC_SUCCESS;
 
 send:
 
-	STEP // 8: Prepare Response Object
+	STEP // 6: Prepare Response Object
 	rsp->obj.mcc_qos_bw_alloc.start = req->obj.mcc_qos_bw_alloc.start;
 	rsp->obj.mcc_qos_bw_alloc.num = req->obj.mcc_qos_bw_alloc.num;
 	for ( i = 0 ; i < rsp->obj.mcc_qos_bw_alloc.num ; i++ ) 
 		rsp->obj.mcc_qos_bw_alloc.list[i] = p->mld->alloc_bw[i+rsp->obj.mcc_qos_bw_alloc.start];
 
-	STEP // 9: Serialize Response Object
+	STEP // 7: Serialize Response Object
 	len = fmapi_serialize(rsp->buf->payload, &rsp->obj, fmapi_fmob_rsp(req->hdr.opcode));
 
- 	STEP // 10: Fill Response Header
+ 	STEP // 8: Fill Response Header
 	rv = fmapi_fill_hdr(&rsp->hdr, FMMT_RESP, req->hdr.tag, req->hdr.opcode, 0, len, rc, 0);
 
-	STEP // 11: Serialize Response Header 
+	STEP // 9: Serialize Response Header 
 	fmapi_serialize(rsp->buf->hdr, &rsp->hdr, FMOB_HDR);
 
-end:
-
 	EXIT(rc)
 	
-	STEP // 12: Return length of MF API Message (FMLN_HDR + object)
+	STEP // 10: Return length of MF API Message (FMLN_HDR + object)
 	return rv;
 }
 
@@ -887,28 +761,25 @@ end:
  *
  * @param m 	struct mctp* 
  * @param mm 	struct mctp_msg* 
- * @param req 	struct fmapi_msg* 
+ * @param req 	struct fmapi_msg* holding the decoded tunneled request
  * @param rsp   struct fmapi_msg*
  * @return 		length of serialized message (FMLN_HDR + object)
  *
  * STEPS
  *   1: Initialize variables
- *   2: Deserialize Request Header
- *   3: Deserialize Request Object 
- *   4: Extract parameters
- *   5: Validate Inputs 
- *   6: Perform Action 
- *   7: Set return code
- *   8: Prepare Response Object
- *   9: Serialize Response Object
- *  10: Fill Response Header
- *  11: Serialize Response Header 
- *  12: Return length of MF API Message (FMLN_HDR + object)
+ *   2: Extract parameters
+ *   3: Validate Inputs 
+ *   4: Perform Action 
+ *   5: Set return code
+ *   6: Prepare Response Object
+ *   7: Serialize Response Object
+ *   8: Fill Response Header
+ *   9: Serialize Response Header 
+ *  10: Return length of MF API Message (FMLN_HDR + object)
  */
 int fmop_mcc_set_qos_ctrl(struct cxl_port *p, struct fmapi_msg *req, struct fmapi_msg *rsp)
 {
 	INIT
-	char now[ISO_TIME_BUF_LEN];
 	unsigned rc;
 	int rv, len;
 
@@ -918,32 +789,23 @@ int fmop_mcc_set_qos_ctrl(struct cxl_port *p, struct fmapi_msg *req, struct fmap
 	rv = 0; 
 	len = 0;
 	rc = FMRC_INVALID_INPUT;
-	isotime(now, ISO_TIME_BUF_LEN);
 	
-	STEP // 2: Deserialize Header
-	if ( fmapi_deserialize(&req->hdr, req->buf->hdr, FMOB_HDR, 0) <= 0)
-		goto end;
+    STEP // 2: Extract parameters
 
-	STEP // 3: Deserialize Request Object 
-	if ( fmapi_deserialize(&req->obj, req->buf->payload, fmapi_fmob_req(req->hdr.opcode), NULL) < 0 )
-		goto end;
+	IFV(CLVB_COMMANDS) logger_printf("CMD: FM API MCC Set QoS Control. PPID: %d\n", p->ppid);
 
-    STEP // 4: Extract parameters
-
-	IFV(CLVB_COMMANDS) printf("%s CMD: FM API MCC Set QoS Control. PPID: %d\n", now, p->ppid);
-
-	STEP // 5: Validate Inputs 
+	STEP // 3: Validate Inputs 
 	
 	// If port does not have an mld device return invalid
 	if (p->mld == NULL) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Port not connected to an MLD\n", now);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Port not connected to an MLD\n");
 		goto send;
 	}
 
-	STEP // 6: Perform Action 
+	STEP // 4: Perform Action 
 
-	IFV(CLVB_ACTIONS) printf("%s ACT: Setting QoS Control on PPID: %d\n", now, p->ppid);
+	IFV(CLVB_ACTIONS) logger_printf("ACT: Setting QoS Control on PPID: %d\n", p->ppid);
 
 	p->mld->epc_en 				= req->obj.mcc_qos_ctrl.epc_en;
 	p->mld->ttr_en 				= req->obj.mcc_qos_ctrl.ttr_en;
@@ -953,12 +815,12 @@ int fmop_mcc_set_qos_ctrl(struct cxl_port *p, struct fmapi_msg *req, struct fmap
 	p->mld->rcb 				= req->obj.mcc_qos_ctrl.rcb;
 	p->mld->comp_interval 		= req->obj.mcc_qos_ctrl.comp_interval;
 
-	STEP // 7: Set return code
+	STEP // 5: Set return code
 	rc = FMRC_SUCCESS;
 
 send:
 
-	STEP // 8: Prepare Response Object
+	STEP // 6: Prepare Response Object
 	rsp->obj.mcc_qos_ctrl.epc_en 				= p->mld->epc_en;
 	rsp->obj.mcc_qos_ctrl.ttr_en 				= p->mld->ttr_en;
 	rsp->obj.mcc_qos_ctrl.egress_mod_pcnt 		= p->mld->egress_mod_pcnt;
@@ -967,20 +829,18 @@ send:
 	rsp->obj.mcc_qos_ctrl.rcb 					= p->mld->rcb;
 	rsp->obj.mcc_qos_ctrl.comp_interval			= p->mld->comp_interval;
 
-	STEP // 9: Serialize Response Object
+	STEP // 7: Serialize Response Object
 	len = fmapi_serialize(rsp->buf->payload, &rsp->obj, fmapi_fmob_rsp(req->hdr.opcode));
 
- 	STEP // 10: Fill Response Header
+ 	STEP // 8: Fill Response Header
 	rv = fmapi_fill_hdr(&rsp->hdr, FMMT_RESP, req->hdr.tag, req->hdr.opcode, 0, len, rc, 0);
 
-	STEP // 11: Serialize Response Header 
+	STEP // 9: Serialize Response Header 
 	fmapi_serialize(rsp->buf->hdr, &rsp->hdr, FMOB_HDR);
 
-end:
-
 	EXIT(rc)
 	
-	STEP // 12: Return length of MF API Message (FMLN_HDR + object)
+	STEP // 10: Return length of MF API Message (FMLN_HDR + object)
 	return rv;
 }
 
@@ -989,28 +849,25 @@ end:
  *
  * @param m 	struct mctp* 
  * @param mm 	struct mctp_msg* 
- * @param req 	struct fmapi_msg* 
+ * @param req 	struct fmapi_msg* holding the decoded tunneled request
  * @param rsp   struct fmapi_msg*
  * @return 		length of serialized message (FMLN_HDR + object)
  *
  * STEPS
  *   1: Initialize variables
- *   2: Deserialize Request Header
- *   3: Deserialize Request Object 
- *   4: Extract parameters
- *   5: Validate Inputs 
- *   6: Perform Action 
- *   7: Prepare Response Object
- *   8: Serialize Response Object
- *   9: Set return code
- *  10: Fill Response Header
- *  11: Serialize Response Header 
- *  12: Return length of MF API Message (FMLN_HDR + object)
+ *   2: Extract parameters
+ *   3: Validate Inputs 
+ *   4: Perform Action 
+ *   5: Prepare Response Object
+ *   6: Serialize Response Object
+ *   7: Set return code
+ *   8: Fill Response Header
+ *   9: Serialize Response Header 
+ *  10: Return length of MF API Message (FMLN_HDR + object)
  */
 int fmop_mcc_set_qos_limit(struct cxl_port *p, struct fmapi_msg *req, struct fmapi_msg *rsp)
 {
 	INIT
-	char now[ISO_TIME_BUF_LEN];
 	unsigned rc;
 	int rv, len;
 
@@ -1022,75 +879,64 @@ int fmop_mcc_set_qos_limit(struct cxl_port *p, struct fmapi_msg *req, struct fma
 	rv = 0; 
 	len = 0;
 	rc = FMRC_INVALID_INPUT;
-	isotime(now, ISO_TIME_BUF_LEN);
 	
-	STEP // 2: Deserialize Header
-	if ( fmapi_deserialize(&req->hdr, req->buf->hdr, FMOB_HDR, 0) <= 0)
-		goto end;
-
-	STEP // 3: Deserialize Request Object 
-	if ( fmapi_deserialize(&req->obj, req->buf->payload, fmapi_fmob_req(req->hdr.opcode), NULL) < 0 )
-		goto end;
+    STEP // 2: Extract parameters
 
-    STEP // 4: Extract parameters
+	IFV(CLVB_COMMANDS) logger_printf("CMD: FM API MCC Set QoS Limit. PPID: %d\n", p->ppid);
 
-	IFV(CLVB_COMMANDS) printf("%s CMD: FM API MCC Set QoS Limit. PPID: %d\n", now, p->ppid);
-
-	STEP // 5: Validate Inputs 
+	STEP // 3: Validate Inputs 
 	
 	// If port does not have an mld device return invalid
 	if (p->mld == NULL) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Port not connected to an MLD\n", now);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Port not connected to an MLD\n");
 		goto send;
 	}
 
 	// Verify requested LD count does not exceed actual LD count
 	if (req->obj.mcc_qos_bw_limit.num > p->mld->num)
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Requested number of LD entries exceeds number of LDs present. Requested: %d Present: %d\n", now, req->obj.mcc_qos_bw_limit.num, p->mld->num);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Requested number of LD entries exceeds number of LDs present. Requested: %d Present: %d\n", req->obj.mcc_qos_bw_limit.num, p->mld->num);
 		goto send;
 	}
 
 	// Verify requested LD count does not exceed actual LD count
 	if ((req->obj.mcc_qos_bw_limit.start + req->obj.mcc_qos_bw_limit.num) > p->mld->num)
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Requested start + number of LD entries exceeds number of LDs present. Requested: %d Present: %d\n", now, req->obj.mcc_qos_bw_limit.num, p->mld->num);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Requested start + number of LD entries exceeds number of LDs present. Requested: %d Present: %d\n", req->obj.mcc_qos_bw_limit.num, p->mld->num);
 		goto send;
 	}
 
-	STEP // 6: Perform Action 
+	STEP // 4: Perform Action 
 
-	IFV(CLVB_ACTIONS) printf("%s ACT: Setting QoS Limit on PPID: %d\n", now, p->ppid);
+	IFV(CLVB_ACTIONS) logger_printf("ACT: Setting QoS Limit on PPID: %d\n", p->ppid);
 
 	for ( i = 0 ; i < req->obj.mcc_qos_bw_limit.num ; i++ ) 
 		p->mld->bw_limit[i+req->obj.mcc_qos_bw_limit.start] = req->obj.mcc_qos_bw_limit.list[i];
 
-	STEP // 7: Set return code
+	STEP // 5: Set return code
 	rc = FMRC_SUCCESS;
 
 send:
 
-	STEP // 8: Prepare Response Object
+	STEP // 6: Prepare Response Object
 	rsp->obj.mcc_qos_bw_limit.start = req->obj.mcc_qos_bw_limit.start;
 	rsp->obj.mcc_qos_bw_limit.num = req->obj.mcc_qos_bw_limit.num;
 	for ( i = 0 ; i < rsp->obj.mcc_qos_bw_limit.num ; i++ ) 
 		rsp->obj.mcc_qos_bw_limit.list[i] = p->mld->bw_limit[i+req->obj.mcc_qos_bw_limit.start];
 
-	STEP // 9: Serialize Response Object
+	STEP // 7: Serialize Response Object
 	len = fmapi_serialize(rsp->buf->payload, &rsp->obj, fmapi_fmob_rsp(req->hdr.opcode));
 
- 	STEP // 10: Fill Response Header
+ 	STEP // 8: Fill Response Header
 	rv = fmapi_fill_hdr(&rsp->hdr, FMMT_RESP, req->hdr.tag, req->hdr.opcode, 0, len, rc, 0);
 
-	STEP // 11: Serialize Response Header 
+	STEP // 9: Serialize Response Header 
 	fmapi_serialize(rsp->buf->hdr, &rsp->hdr, FMOB_HDR);
 
-end:
-
 	EXIT(rc)
 	
-	STEP // 12: Return length of MF API Message (FMLN_HDR + object)
+	STEP // 10: Return length of MF API Message (FMLN_HDR + object)
 	return rv;
 }
 
@@ -42,40 +42,41 @@
  */
 #include <mctp.h>
 #include <ptrqueue.h>
-#include <timeutils.h>
 #include <arrayutils.h>
 #include <cxlstate.h>
 #include "signals.h"
 
 #include "options.h"
 
+#include "trace.h"
+
+#include "logger.h"
+
+#include "metrics.h"
+
 #include "state.h"
 
 #include <fmapi.h>
 
 #include "fmapi_handler.h"
 
+#include "memspace.h"
+
+#include "qos.h"
+
 /* MACROS ====================================================================*/
 
-#ifdef CSE_VERBOSE
- #define INIT 			unsigned step = 0;
- #define ENTER 					if (opts[CLOP_VERBOSITY].u64 & CLVB_CALLSTACK) 	printf("%d:%s Enter\n", 			gettid(), __FUNCTION__);
- #define STEP 			step++; if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u\n", 			gettid(), __FUNCTION__, step);
- #define HEX32(m, i)			if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u %s: 0x%x\n",	gettid(), __FUNCTION__, step, m, i);
- #define INT32(m, i)			if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u %s: %d\n",	gettid(), __FUNCTION__, step, m, i);
- #define EXIT(rc) 				if (opts[CLOP_VERBOSITY].u64 & CLVB_CALLSTACK) 	printf("%d:%s Exit: %d\n", 			gettid(), __FUNCTION__,rc);
-#else
- #define ENTER
- #define EXIT(rc)
- #define STEP
- #define HEX32(m, i)
- #define INT32(m, i)
- #define INIT 
-#endif // CSE_VERBOSE
-
-#define IFV(u) 					if (opts[CLOP_VERBOSITY].u64 & u) 
-
-#define ISO_TIME_BUF_LEN		32
+
+/**
+ * Wire layout of the MPC LD CXL.io Memory Request / Response payloads
+ *
+ * Request:  00h PPID, 01h BE / Transaction Type, 04h LD ID, 06h Length, 
+ *           08h Offset, 10h Transaction Data
+ * Response: 00h Return Size, 02h Reserved, 04h Return Data
+ */
+#define CSLN_MPC_MEM_REQ_HDR 	0x10 	//!< Offset of Transaction Data in request
+#define CSLN_MPC_MEM_RSP_HDR 	0x04 	//!< Offset of Return Data in response
+#define CSLN_MPC_MEM_MAX 		4096	//!< Max Transaction Length 
 
 /* ENUMERATIONS ==============================================================*/
 
@@ -83,6 +84,8 @@
 
 /* PROTOTYPES ================================================================*/
 
+static int _parse_mpc_mem_req(struct fmapi_mpc_mem_req *r, __u8 *buf, unsigned len);
+
 int fmop_mcc_get_ld_alloc	(struct cxl_port *p, struct fmapi_msg *req, struct fmapi_msg *rsp);
 int fmop_mcc_get_qos_alloc	(struct cxl_port *p, struct fmapi_msg *req, struct fmapi_msg *rsp);
 int fmop_mcc_get_qos_ctrl	(struct cxl_port *p, struct fmapi_msg *req, struct fmapi_msg *rsp);
@@ -103,50 +106,48 @@ int fmop_mcc_set_qos_limit	(struct cxl_port *p, struct fmapi_msg *req, struct fm
  *
  * @param m 	struct mctp* 
  * @param mm 	struct mctp_msg* 
+ * @param req 	struct fmapi_msg* holding the decoded request
  * @return 		0 upon success, 1 otherwise
  *
  * STEPS
  *  1: Initialize variables
- *  2: Checkout Response mctp_msg buffer
+ *  2: Verify Response mctp_msg buffer
  *  3: Fill Response MCTP Header
- *  4: Set buffer pointers 
- *  5: Deserialize Request Header
- *  6: Deserialize Request Object 
- *  7: Extract parameters
- *  8: Obtain lock on switch state 
- *  9: Validate Inputs 
- * 10: Perform Action 
- * 11: Prepare Response Object
- * 12: Serialize Response Object
- * 13: Set return code
- * 14: Release lock on switch state 
- * 15: Fill Response Header
- * 16: Serialize Header 
- * 17: Push Response mctp_msg onto Transmit Message Queue 
- * 18: Checkin mctp_msgs 
+ *  4: Set response buffer pointer 
+ *  5: Extract parameters
+ *  6: Obtain lock on port 
+ *  7: Validate Inputs 
+ *  8: Perform Action 
+ *  9: Prepare Response Object
+ * 10: Serialize Response Object
+ * 11: Set return code
+ * 12: Release lock on port 
+ * 13: Fill Response Header
+ * 14: Serialize Header 
+ * 15: Push Response mctp_msg onto Transmit Message Queue 
+ * 16: Checkin mctp_msgs 
  */
-int fmop_mpc_cfg(struct mctp *m, struct mctp_action *ma)
+int fmop_mpc_cfg(struct mctp *m, struct mctp_action *ma, struct fmapi_msg *req)
 {
 	INIT
-	char now[ISO_TIME_BUF_LEN];
-	struct fmapi_msg req, rsp;
+	struct fmapi_msg rsp;
 	
 	unsigned rc;
 	int rv, len;
 
 	struct cxl_port *p;
 	__u16 reg; 
+	__u8 *cfg;
 
 	ENTER
 
 	STEP // 1: Initialize variables
+	p = NULL;
 	rv = 1; 
 	len = 0;
 	rc = FMRC_INVALID_INPUT;
-	isotime(now, ISO_TIME_BUF_LEN);
 
-	STEP // 2: Get response mctp_msg buffer
-	ma->rsp = pq_pop(m->msgs, 1);
+	STEP // 2: Verify Response mctp_msg buffer was checked out by the dispatcher
 	if (ma->rsp == NULL)  
 		goto end;
 
@@ -154,119 +155,126 @@ int fmop_mpc_cfg(struct mctp *m, struct mctp_action *ma)
 	mctp_fill_msg_hdr(ma->rsp, ma->req->src, m->state.eid, 0, ma->req->tag);
 	ma->rsp->type = ma->req->type;
 	
-	// 4: Set buffer pointers 
-	req.buf = (struct fmapi_buf*) ma->req->payload;
+	// 4: Set response buffer pointer 
 	rsp.buf = (struct fmapi_buf*) ma->rsp->payload;
 
-	STEP // 5: Deserialize Request Header
-	if ( fmapi_deserialize(&req.hdr, req.buf->hdr, FMOB_HDR, NULL) <= 0 )
-		goto end;
-
-	STEP // 6: Deserialize Request Object 
-	if ( fmapi_deserialize(&req.obj, req.buf->payload, fmapi_fmob_req(req.hdr.opcode), NULL) < 0 )
-		goto end;
-
-	STEP // 7: Extract parameters
+	STEP // 5: Extract parameters
 
-	IFV(CLVB_COMMANDS) printf("%s CMD: FM API MPC LD CXL.io Config. PPID: %d  LDID: %d\n", now, req.obj.mpc_cfg_req.ppid, req.obj.mpc_cfg_req.ldid);
+	IFV(CLVB_COMMANDS) logger_printf("CMD: FM API MPC LD CXL.io Config. PPID: %d  LDID: %d\n", req->obj.mpc_cfg_req.ppid, req->obj.mpc_cfg_req.ldid);
 
-	STEP // 8: Obtain lock on switch state 
-	pthread_mutex_lock(&cxls->mtx);
+	STEP // 6: Obtain lock on port 
+	// Obtained below once the port number has been validated
 
-	STEP // 9: Validate Inputs 
+	STEP // 7: Validate Inputs 
 
 	// Validate port number 
-	if (req.obj.mpc_cfg_req.ppid >= cxls->num_ports) 
+	if (req->obj.mpc_cfg_req.ppid >= cxls->num_ports) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Invalid Port number requested. PPID: %d\n", now, req.obj.mpc_cfg_req.ppid);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Invalid Port number requested. PPID: %d\n", req->obj.mpc_cfg_req.ppid);
 		goto send;
 	}
-	p = &cxls->ports[req.obj.mpc_cfg_req.ppid];
+	p = &cxls->ports[req->obj.mpc_cfg_req.ppid];
+	state_lock_port(req->obj.mpc_cfg_req.ppid);
 
 	// Validate port is not bound 
 	//if ( !(p->state == FMPS_DISABLED) ) 
 	//{ 
-	//	IFV(CLVB_ERRORS) printf("%s ERR: Port is in a bound state. PPID: %d State: %s\n", now, req.obj.mpc_cfg_req.ppid, fmps(p->state));
+	//	IFV(CLVB_ERRORS) logger_printf("ERR: Port is in a bound state. PPID: %d State: %s\n", req->obj.mpc_cfg_req.ppid, fmps(p->state));
 	//	goto send;
 	//}
 
 	// Validate device attached to port is an MLD port
 	if ( !(p->dt == FMDT_CXL_TYPE_3 || p->dt == FMDT_CXL_TYPE_3_POOLED) ) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Port is not Type 3 device: Type: %s\n", now, fmdt(p->dt));
+		IFV(CLVB_ERRORS) logger_printf("ERR: Port is not Type 3 device: Type: %s\n", fmdt(p->dt));
 		goto send;
 	}
 
 	// Validate LDID 
-	if (req.obj.mpc_cfg_req.ldid >= p->ld) 
+	if (req->obj.mpc_cfg_req.ldid >= p->ld) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Requested LD ID exceeds supported LD count of specified port. Requested LDID: %d\n", now, req.obj.mpc_cfg_req.ldid);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Requested LD ID exceeds supported LD count of specified port. Requested LDID: %d\n", req->obj.mpc_cfg_req.ldid);
 		goto send;
 	}
 
-	STEP // 10: Perform Action 
+	STEP // 8: Perform Action 
 
-	STEP // 11: Prepare Response Object
-	switch (req.obj.mpc_cfg_req.type)
+	STEP // 9: Prepare Response Object
+	switch (req->obj.mpc_cfg_req.type)
 	{
 		case FMCT_READ:				// 0x00
 		{
-			IFV(CLVB_ACTIONS) printf("%s ACT: Performing CXL.io Read on PPID: %d LDID: %d\n", now, req.obj.mpc_cfg_req.ppid, req.obj.mpc_cfg_req.ldid);
+			IFV(CLVB_ACTIONS) logger_printf("ACT: Performing CXL.io Read on PPID: %d LDID: %d\n", req->obj.mpc_cfg_req.ppid, req->obj.mpc_cfg_req.ldid);
 
-			reg = (req.obj.mpc_cfg_req.ext << 8) | req.obj.mpc_cfg_req.reg;
+			reg = (req->obj.mpc_cfg_req.ext << 8) | req->obj.mpc_cfg_req.reg;
 
 			rsp.obj.mpc_cfg_rsp.data[0] = 0;
 			rsp.obj.mpc_cfg_rsp.data[1] = 0;
 			rsp.obj.mpc_cfg_rsp.data[2] = 0;
 			rsp.obj.mpc_cfg_rsp.data[3] = 0;
 
-			if (req.obj.mpc_cfg_req.fdbe & 0x01) rsp.obj.mpc_cfg_rsp.data[0] = p->mld->cfgspace[req.obj.mpc_cfg_req.ldid][reg+0];
-			if (req.obj.mpc_cfg_req.fdbe & 0x02) rsp.obj.mpc_cfg_rsp.data[1] = p->mld->cfgspace[req.obj.mpc_cfg_req.ldid][reg+1];
-			if (req.obj.mpc_cfg_req.fdbe & 0x04) rsp.obj.mpc_cfg_rsp.data[2] = p->mld->cfgspace[req.obj.mpc_cfg_req.ldid][reg+2];
-			if (req.obj.mpc_cfg_req.fdbe & 0x08) rsp.obj.mpc_cfg_rsp.data[3] = p->mld->cfgspace[req.obj.mpc_cfg_req.ldid][reg+3];
+			// Config space of an LD that was never written reads as zero 
+			cfg = state_ld_cfgspace(p, req->obj.mpc_cfg_req.ldid, 0);
+			if (cfg == NULL || reg + 4 > CFG_SPACE_SIZE)
+				break;
+
+			if (req->obj.mpc_cfg_req.fdbe & 0x01) rsp.obj.mpc_cfg_rsp.data[0] = cfg[reg+0];
+			if (req->obj.mpc_cfg_req.fdbe & 0x02) rsp.obj.mpc_cfg_rsp.data[1] = cfg[reg+1];
+			if (req->obj.mpc_cfg_req.fdbe & 0x04) rsp.obj.mpc_cfg_rsp.data[2] = cfg[reg+2];
+			if (req->obj.mpc_cfg_req.fdbe & 0x08) rsp.obj.mpc_cfg_rsp.data[3] = cfg[reg+3];
 		}
 			break;
 
 		case FMCT_WRITE:			// 0x01
 		{
-			HEX32("Write Data",  *((int*)req.obj.mpc_cfg_req.data));
-			IFV(CLVB_ACTIONS) printf("%s ACT: Performing CXL.io Write on PPID: %d LDID: %d\n", now, req.obj.mpc_cfg_req.ppid, req.obj.mpc_cfg_req.ldid);
+			HEX32("Write Data",  *((int*)req->obj.mpc_cfg_req.data));
+			IFV(CLVB_ACTIONS) logger_printf("ACT: Performing CXL.io Write on PPID: %d LDID: %d\n", req->obj.mpc_cfg_req.ppid, req->obj.mpc_cfg_req.ldid);
 
-			reg = (req.obj.mpc_cfg_req.ext << 8) | req.obj.mpc_cfg_req.reg;
+			reg = (req->obj.mpc_cfg_req.ext << 8) | req->obj.mpc_cfg_req.reg;
 
-			if (req.obj.mpc_cfg_req.fdbe & 0x01) p->mld->cfgspace[req.obj.mpc_cfg_req.ldid][reg+0] = req.obj.mpc_cfg_req.data[0];
-			if (req.obj.mpc_cfg_req.fdbe & 0x02) p->mld->cfgspace[req.obj.mpc_cfg_req.ldid][reg+1] = req.obj.mpc_cfg_req.data[1];
-			if (req.obj.mpc_cfg_req.fdbe & 0x04) p->mld->cfgspace[req.obj.mpc_cfg_req.ldid][reg+2] = req.obj.mpc_cfg_req.data[2];
-			if (req.obj.mpc_cfg_req.fdbe & 0x08) p->mld->cfgspace[req.obj.mpc_cfg_req.ldid][reg+3] = req.obj.mpc_cfg_req.data[3];
+			if (reg + 4 > CFG_SPACE_SIZE)
+				goto send;
+
+			// Allocate the MLD and the config space of the LD on first write 
+			cfg = state_ld_cfgspace(p, req->obj.mpc_cfg_req.ldid, 1);
+			if (cfg == NULL)
+				goto send;
+
+			if (req->obj.mpc_cfg_req.fdbe & 0x01) cfg[reg+0] = req->obj.mpc_cfg_req.data[0];
+			if (req->obj.mpc_cfg_req.fdbe & 0x02) cfg[reg+1] = req->obj.mpc_cfg_req.data[1];
+			if (req->obj.mpc_cfg_req.fdbe & 0x04) cfg[reg+2] = req->obj.mpc_cfg_req.data[2];
+			if (req->obj.mpc_cfg_req.fdbe & 0x08) cfg[reg+3] = req->obj.mpc_cfg_req.data[3];
 		}
 			break;
 
 		default:  
-			IFV(CLVB_ERRORS) printf("%s ERR: Invalid Action\n", now);
-			goto end;
+			IFV(CLVB_ERRORS) logger_printf("ERR: Invalid Action\n");
+			goto send;
 	}
 
-	STEP // 12: Serialize Response Object
-	len = fmapi_serialize(rsp.buf->payload, &rsp.obj, fmapi_fmob_rsp(req.hdr.opcode));
+	STEP // 10: Serialize Response Object
+	len = fmapi_serialize(rsp.buf->payload, &rsp.obj, fmapi_fmob_rsp(req->hdr.opcode));
 
-	STEP // 13: Set return code
+	STEP // 11: Set return code
 	rc = FMRC_SUCCESS;
 
 send:
 
-	STEP // 14: Release lock on switch state 
-	pthread_mutex_unlock(&cxls->mtx);
+	STEP // 12: Release lock on port 
+	if (p != NULL)
+		state_unlock_port(req->obj.mpc_cfg_req.ppid);
 
 	if (len < 0)
 		goto end;
 
-	STEP // 15: Fill Response Header
-	ma->rsp->len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, req.hdr.tag, req.hdr.opcode, 0, len, rc, 0);
+	STEP // 13: Fill Response Header
+	metrics_rc(rc);
+	ma->rsp->len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, req->hdr.tag, req->hdr.opcode, 0, len, rc, 0);
 
-	STEP // 16: Serialize Header 
+	STEP // 14: Serialize Header 
 	fmapi_serialize(rsp.buf->hdr, &rsp.hdr, FMOB_HDR);
 
-	STEP // 17: Push mctp_action onto queue 
+	STEP // 15: Push mctp_action onto queue 
 	pq_push(m->tmq, ma);
 
 	rv = 0;
@@ -281,52 +289,55 @@ end:
 /**
  * Handler for FM API MPC LD CXL.io Memory Opcode
  *
+ * Transaction data is copied directly between the MCTP payload buffers and 
+ * the LD memory space. Only the fixed fields of the request are decoded and 
+ * the response payload is built in place. 
+ *
  * @param m 	struct mctp* 
  * @param mm 	struct mctp_msg* 
+ * @param req 	struct fmapi_msg* holding the decoded request
  * @return 		0 upon success, 1 otherwise
  *
  * STEPS
  *  1: Initialize variables
- *  2: Checkout Response mctp_msg buffer
+ *  2: Verify Response mctp_msg buffer
  *  3: Fill Response MCTP Header
- *  4: Set buffer pointers 
- *  5: Deserialize Request Header
- *  6: Deserialize Request Object 
- *  7: Extract parameters
- *  8: Obtain lock on switch state 
- *  9: Validate Inputs 
- * 10: Perform Action 
- * 11: Prepare Response Object
- * 12: Serialize Response Object
- * 13: Set return code
- * 14: Release lock on switch state 
- * 15: Fill Response Header
- * 16: Serialize Header 
- * 17: Push Response mctp_msg onto Transmit Message Queue 
- * 18: Checkin mctp_msgs 
+ *  4: Set response buffer pointer 
+ *  5: Decode fixed fields of Request Object 
+ *  6: Extract parameters
+ *  7: Obtain lock on port 
+ *  8: Validate Inputs 
+ *  9: Perform Action 
+ * 10: Prepare Response Object
+ * 11: Serialize Response Object
+ * 12: Set return code
+ * 13: Release lock on port 
+ * 14: Fill Response Header
+ * 15: Serialize Header 
+ * 16: Push Response mctp_msg onto Transmit Message Queue 
+ * 17: Checkin mctp_msgs 
  */
-int fmop_mpc_mem(struct mctp *m, struct mctp_action *ma)
+int fmop_mpc_mem(struct mctp *m, struct mctp_action *ma, struct fmapi_msg *req)
 {
 	INIT
-	char now[ISO_TIME_BUF_LEN];
-	struct fmapi_msg req, rsp;
+	struct fmapi_msg rsp;
 	
 	unsigned rc;
 	int rv, len;
 
 	struct cxl_port *p;
-	__u64 base, max, ld_size, granularity; 
+	__u64 base, ld_size; 
+	__u8 *data;
 
 	ENTER
 
 	STEP // 1: Initialize variables
+	p = NULL;
 	rv = 1; 
 	len = 0;
 	rc = FMRC_INVALID_INPUT;
-	isotime(now, ISO_TIME_BUF_LEN);
 
-	STEP // 2: Get response mctp_msg buffer
-	ma->rsp = pq_pop(m->msgs, 1);
+	STEP // 2: Verify Response mctp_msg buffer was checked out by the dispatcher
 	if (ma->rsp == NULL)  
 		goto end;
 
@@ -334,138 +345,166 @@ int fmop_mpc_mem(struct mctp *m, struct mctp_action *ma)
 	mctp_fill_msg_hdr(ma->rsp, ma->req->src, m->state.eid, 0, ma->req->tag);
 	ma->rsp->type = ma->req->type;
 	
-	// 4: Set buffer pointers 
-	req.buf = (struct fmapi_buf*) ma->req->payload;
+	// 4: Set response buffer pointer 
 	rsp.buf = (struct fmapi_buf*) ma->rsp->payload;
 
-	STEP // 5: Deserialize Request Header
-	if ( fmapi_deserialize(&req.hdr, req.buf->hdr, FMOB_HDR, NULL) <= 0 )
-		goto end;
+	STEP // 5: Decode fixed fields of Request Object 
+
+	// The length in the header comes from the FM, the payload must have been received
+	if (FMLN_HDR + (unsigned) req->hdr.len > ma->req->len)
+	{
+		IFV(CLVB_ERRORS) logger_printf("ERR: Request payload length exceeds message length. Payload: %d Message: %d\n", req->hdr.len, ma->req->len);
+		goto send;
+	}
 
-	STEP // 6: Deserialize Request Object 
-	if ( fmapi_deserialize(&req.obj, req.buf->payload, fmapi_fmob_req(req.hdr.opcode), NULL) < 0 )
+	if ( _parse_mpc_mem_req(&req->obj.mpc_mem_req, req->buf->payload, req->hdr.len) != 0 )
 		goto end;
+	data = &req->buf->payload[CSLN_MPC_MEM_REQ_HDR];
 
-	STEP // 7: Extract parameters
+	STEP // 6: Extract parameters
 
-	IFV(CLVB_COMMANDS) printf("%s CMD: FM API MPC LD CXL.io Mem. PPID: %d  LDID: %d\n", now, req.obj.mpc_mem_req.ppid, req.obj.mpc_mem_req.ldid);
+	IFV(CLVB_COMMANDS) logger_printf("CMD: FM API MPC LD CXL.io Mem. PPID: %d  LDID: %d\n", req->obj.mpc_mem_req.ppid, req->obj.mpc_mem_req.ldid);
 
-	STEP // 8: Obtain lock on switch state 
-	pthread_mutex_lock(&cxls->mtx);
+	STEP // 7: Obtain lock on port 
+	// Obtained below once the port number has been validated
 
-	STEP // 9: Validate Inputs 
+	STEP // 8: Validate Inputs 
 
 	// Validate port number 
-	if (req.obj.mpc_mem_req.ppid >= cxls->num_ports) 
+	if (req->obj.mpc_mem_req.ppid >= cxls->num_ports) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Invalid Port number requested. PPID: %d\n", now, req.obj.mpc_mem_req.ppid);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Invalid Port number requested. PPID: %d\n", req->obj.mpc_mem_req.ppid);
 		goto send;
 	}
-	p = &cxls->ports[req.obj.mpc_mem_req.ppid];
+	p = &cxls->ports[req->obj.mpc_mem_req.ppid];
+	state_lock_port(req->obj.mpc_mem_req.ppid);
 
 	// Validate port is not bound 
 	//if ( !(p->state == FMPS_DISABLED) ) 
 	//{ 
-	//	IFV(CLVB_ERRORS) printf("%s ERR: Port is in a bound state: %s PPID: %d\n", now, fmps(p->state), req.obj.mpc_mem_req.ppid);
+	//	IFV(CLVB_ERRORS) logger_printf("ERR: Port is in a bound state: %s PPID: %d\n", fmps(p->state), req->obj.mpc_mem_req.ppid);
 	//	goto send;
 	//}
 
 	// Validate device attached to port is an MLD port
 	if ( !(p->dt == FMDT_CXL_TYPE_3 || p->dt == FMDT_CXL_TYPE_3_POOLED) ) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Port is not Type 3 device. Requested Type: %s\n", now, fmdt(p->dt));
+		IFV(CLVB_ERRORS) logger_printf("ERR: Port is not Type 3 device. Requested Type: %s\n", fmdt(p->dt));
 		goto send;
 	}
 
 	// Validate LDID 
-	if (req.obj.mpc_mem_req.ldid >= p->ld) 
+	if (req->obj.mpc_mem_req.ldid >= p->ld) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Requested LD ID exceeds supported LD count of specified port. LDID: %d\n", now, req.obj.mpc_mem_req.ldid);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Requested LD ID exceeds supported LD count of specified port. LDID: %d\n", req->obj.mpc_mem_req.ldid);
 		goto send;
 	}
 
-	// Validate memory backed file is mmaped 
-	if (p->mld == NULL || p->mld->memspace == NULL) 
+	// Validate memory backed file is mmaped, mapping it on first access 
+	if (p->mld == NULL || memspace_get(p) == NULL) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Requested port does not have memory space on the specified port. Port: %d\n", now, p->ppid);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Requested port does not have memory space on the specified port. Port: %d\n", p->ppid);
 
 		rc = FMRC_UNSUPPORTED;
 		goto send;
 	}
 
 	// Validate offset & length
-	if (req.obj.mpc_mem_req.len > 4096) 
+	if (req->obj.mpc_mem_req.len > CSLN_MPC_MEM_MAX) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Requested length exceeds maximum length supported (4096B). Requested Len: %d\n", now, req.obj.mpc_mem_req.len);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Requested length exceeds maximum length supported (4096B). Requested Len: %d\n", req->obj.mpc_mem_req.len);
 		goto send;
 	}
 
-	// Get granularity in bytes
-	granularity = 1024*1024;
-	switch (p->mld->granularity)
+	// compute size of requested LD 
+	if (state_ld_memrange(p, req->obj.mpc_mem_req.ldid, &base, &ld_size) != 0)
 	{
-		case FMMG_256MB: 	granularity *= 256; 	break;
-		case FMMG_512MB: 	granularity *= 512; 	break;
-		case FMMG_1GB:   	granularity *= 1024; 	break;
+		IFV(CLVB_ERRORS) logger_printf("ERR: LD range exceeds the memory space of the port. PPID: %d LDID: %d\n", p->ppid, req->obj.mpc_mem_req.ldid);
+		goto send;
 	}
-
-	// compute size of requested LD 
-	base = granularity *  p->mld->rng1[req.obj.mpc_mem_req.ldid]; 		// base is the byte offset into the memspace 
-	max  = granularity * (p->mld->rng2[req.obj.mpc_mem_req.ldid] + 1); // max is the byte offset start of the next LD in the memspace 
-	ld_size = max - base;								// ld size in bytes 
 	
-	// Verify requested offset + len does not exceed the end of the LD 
-	if ( (req.obj.mpc_mem_req.offset + req.obj.mpc_mem_req.len) >= ld_size) 
+	// Verify requested offset + len does not exceed the end of the LD. Compared
+	// without the sum, which can wrap for an offset near the top of the range
+	if ( req->obj.mpc_mem_req.offset > ld_size || req->obj.mpc_mem_req.len > ld_size - req->obj.mpc_mem_req.offset ) 
+	{
+		IFV(CLVB_ERRORS) logger_printf("ERR: Requested offset + length exceeds maximum size of LD. LD Max size (Bytes): %llu. Requested up to Byte: %llu\n", ld_size, req->obj.mpc_mem_req.offset + req->obj.mpc_mem_req.len);
+		goto send;
+	}
+
+	// Throttle traffic beyond the QoS limit or allocation of the LD 
+	if (qos_charge(p, req->obj.mpc_mem_req.ldid, req->obj.mpc_mem_req.len) != 0)
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Requested offset + length exceeds maximum size of LD. LD Max size (Bytes): %llu. Requested up to Byte: %llu\n", now, ld_size, req.obj.mpc_mem_req.offset + req.obj.mpc_mem_req.len);
+		IFV(CLVB_ERRORS) logger_printf("ERR: LD is throttled by QoS. PPID: %d LDID: %d\n", p->ppid, req->obj.mpc_mem_req.ldid);
+		rc = FMRC_BUSY;
 		goto send;
 	}
 
-	STEP // 10: Perform Action 
+	STEP // 9: Perform Action 
 
-	STEP // 11: Prepare Response Object
-	switch (req.obj.mpc_mem_req.type)
+	STEP // 10: Prepare Response Object
+	switch (req->obj.mpc_mem_req.type)
 	{
 		case FMCT_READ:				// 0x00
-			INT32("Request Len", req.obj.mpc_mem_req.len);
-			IFV(CLVB_ACTIONS) printf("%s ACT: Performing CXL.io MEM Read on PPID: %d LDID: %d\n", now, req.obj.mpc_mem_req.ppid, req.obj.mpc_mem_req.ldid);
+			INT32("Request Len", req->obj.mpc_mem_req.len);
+			IFV(CLVB_ACTIONS) logger_printf("ACT: Performing CXL.io MEM Read on PPID: %d LDID: %d\n", req->obj.mpc_mem_req.ppid, req->obj.mpc_mem_req.ldid);
+
+			rsp.obj.mpc_mem_rsp.len = req->obj.mpc_mem_req.len;
+			memcpy(&rsp.buf->payload[CSLN_MPC_MEM_RSP_HDR], &p->mld->memspace[base + req->obj.mpc_mem_req.offset], req->obj.mpc_mem_req.len);
 
-			rsp.obj.mpc_mem_rsp.len = req.obj.mpc_mem_req.len;
-			memcpy(rsp.obj.mpc_mem_rsp.data, &p->mld->memspace[base + req.obj.mpc_mem_req.offset], req.obj.mpc_mem_req.len);
+			IFV(CLVB_PAYLOAD) logger_prnt_buf(&rsp.buf->payload[CSLN_MPC_MEM_RSP_HDR], req->obj.mpc_mem_req.len, 4);
 
 			break;
 
 		case FMCT_WRITE:			// 0x01
-			IFV(CLVB_ACTIONS) printf("%s ACT: Performing CXL.io MEM Write on PPID: %d LDID: %d\n", now, req.obj.mpc_mem_req.ppid, req.obj.mpc_mem_req.ldid);
+			IFV(CLVB_ACTIONS) logger_printf("ACT: Performing CXL.io MEM Write on PPID: %d LDID: %d\n", req->obj.mpc_mem_req.ppid, req->obj.mpc_mem_req.ldid);
 
-			memcpy(&p->mld->memspace[base + req.obj.mpc_mem_req.offset], req.obj.mpc_mem_req.data, req.obj.mpc_mem_req.len);
+			// Validate the request carried the transaction data 
+			if (  req->hdr.len < (CSLN_MPC_MEM_REQ_HDR + (__u32) req->obj.mpc_mem_req.len)
+				||FMLN_HDR + CSLN_MPC_MEM_REQ_HDR + (__u32) req->obj.mpc_mem_req.len > ma->req->len)
+			{
+				IFV(CLVB_ERRORS) logger_printf("ERR: Request payload shorter than transaction length. Payload: %d Len: %d\n", req->hdr.len, req->obj.mpc_mem_req.len);
+				goto send;
+			}
 
-			autl_prnt_buf(req.obj.mpc_mem_req.data, req.obj.mpc_mem_req.len, 4, 0);
+			rsp.obj.mpc_mem_rsp.len = 0;
+			memcpy(&p->mld->memspace[base + req->obj.mpc_mem_req.offset], data, req->obj.mpc_mem_req.len);
+
+			IFV(CLVB_PAYLOAD) logger_prnt_buf(data, req->obj.mpc_mem_req.len, 4);
 
 			break;
+
+		default:
+			IFV(CLVB_ERRORS) logger_printf("ERR: Invalid transaction type. Type: %d\n", req->obj.mpc_mem_req.type);
+			goto send;
 	}
 
-	STEP // 12: Serialize Response Object
-	len = fmapi_serialize(rsp.buf->payload, &rsp.obj, fmapi_fmob_rsp(req.hdr.opcode));
+	STEP // 11: Serialize Response Object
+	rsp.buf->payload[0] = rsp.obj.mpc_mem_rsp.len & 0xFF;
+	rsp.buf->payload[1] = (rsp.obj.mpc_mem_rsp.len >> 8) & 0xFF;
+	rsp.buf->payload[2] = 0;
+	rsp.buf->payload[3] = 0;
+	len = CSLN_MPC_MEM_RSP_HDR + rsp.obj.mpc_mem_rsp.len;
 
-	STEP // 13: Set return code
+	STEP // 12: Set return code
 	rc = FMRC_SUCCESS;
 
 send:
 
-	STEP // 14: Release lock on switch state 
-	pthread_mutex_unlock(&cxls->mtx);
+	STEP // 13: Release lock on port 
+	if (p != NULL)
+		state_unlock_port(req->obj.mpc_mem_req.ppid);
 
 	if (len < 0)
 		goto end;
 
-	STEP // 15: Fill Response Header
-	ma->rsp->len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, req.hdr.tag, req.hdr.opcode, 0, len, rc, 0);
+	STEP // 14: Fill Response Header
+	metrics_rc(rc);
+	ma->rsp->len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, req->hdr.tag, req->hdr.opcode, 0, len, rc, 0);
 
-	STEP // 16: Serialize Header 
+	STEP // 15: Serialize Header 
 	fmapi_serialize(rsp.buf->hdr, &rsp.hdr, FMOB_HDR);
 
-	STEP // 17: Push mctp_action onto queue 
+	STEP // 16: Push mctp_action onto queue 
 	pq_push(m->tmq, ma);
 
 	rv = 0;
@@ -480,32 +519,35 @@ end:
 /**
  * Handler for FM API MPC Tunnel Management Command Opcode
  *
- * @param hdr	fmapi_hdr* 
- * @param src	__u8* to Request FM API Message Payload in serialized form
- * @param dst 	__u8* to Respnse FM API Message Payload in serialized form 
- * @return 		1 to send reponse back to requestor, 0 to not send it
+ * The tunneled header and object are deserialized here once and the decoded
+ * message is handed to the fmop_mcc_* handler
+ *
+ * @param m 	struct mctp* 
+ * @param mm 	struct mctp_msg* 
+ * @param req 	struct fmapi_msg* holding the decoded request
+ * @return 		0 upon success, 1 otherwise
  *
  * STEPS
- * 1: Deserialize FM API Request Payload 
- * 2: Validate port number 
- * 3: Validate device attached to port is an MLD port
- * 4: Confirm MCTP Message Type 
- * 5: Extract FM API HDR and switch on mesage opcode
- * 6: Verify FM API Message is a request
- * 7: Deserialize payload into buffer 
- * 8: Perform Requested Action
- * 9: Serialize FM API Payload 
- * 10: Fill Response FM API HDR 
- * 11: Serialize FM API Header 
- * 12: Set MCTP Type 
- * 13: Serialize FM API Response Payload 
- * 14: Set return code
+ *  1: Initialize variables
+ *  2: Verify Response mctp_msg buffer
+ *  3: Fill Response MCTP Header
+ *  4: Set response buffer pointer 
+ *  5: Extract parameters
+ *  6: Obtain lock on port 
+ *  7: Validate Inputs 
+ *  8: Perform Action 
+ *  9: Prepare Response Object (decode and handle tunneled message)
+ * 10: Serialize Response Object
+ * 11: Set return code
+ * 12: Release lock on port 
+ * 13: Fill Response Header
+ * 14: Serialize Header 
+ * 15: Push Response mctp_msg onto Transmit Message Queue 
  */
-int fmop_mpc_tmc(struct mctp *m, struct mctp_action *ma)
+int fmop_mpc_tmc(struct mctp *m, struct mctp_action *ma, struct fmapi_msg *req)
 {
 	INIT
-	char now[ISO_TIME_BUF_LEN];
-	struct fmapi_msg req, rsp;
+	struct fmapi_msg rsp;
 	
 	unsigned rc;
 	int rv, len;
@@ -514,13 +556,12 @@ int fmop_mpc_tmc(struct mctp *m, struct mctp_action *ma)
 	ENTER
 
 	STEP // 1: Initialize variables
+	p = NULL;
 	rv = 1; 
 	len = 0;
 	rc = FMRC_INVALID_INPUT;
-	isotime(now, ISO_TIME_BUF_LEN);
 
-	STEP // 2: Get response mctp_msg buffer
-	ma->rsp = pq_pop(m->msgs, 1);
+	STEP // 2: Verify Response mctp_msg buffer was checked out by the dispatcher
 	if (ma->rsp == NULL)  
 		goto end;
 
@@ -528,57 +569,49 @@ int fmop_mpc_tmc(struct mctp *m, struct mctp_action *ma)
 	mctp_fill_msg_hdr(ma->rsp, ma->req->src, m->state.eid, 0, ma->req->tag);
 	ma->rsp->type = ma->req->type;
 	
-	// 4: Set buffer pointers 
-	req.buf = (struct fmapi_buf*) ma->req->payload;
+	// 4: Set response buffer pointer 
 	rsp.buf = (struct fmapi_buf*) ma->rsp->payload;
 
-	STEP // 5: Deserialize Request Header
-	if ( fmapi_deserialize(&req.hdr, req.buf->hdr, FMOB_HDR, NULL) <= 0 )
-		goto end;
-
-	STEP // 6: Deserialize Request Object 
-	if ( fmapi_deserialize(&req.obj, req.buf->payload, fmapi_fmob_req(req.hdr.opcode), NULL) < 0 )
-		goto end;
-
-	STEP // 7: Extract parameters
+	STEP // 5: Extract parameters
 
-	IFV(CLVB_COMMANDS) printf("%s CMD: FM API MPC Tunneled Management Command. PPID: %d\n", now, req.obj.mpc_tmc_req.ppid);
+	IFV(CLVB_COMMANDS) logger_printf("CMD: FM API MPC Tunneled Management Command. PPID: %d\n", req->obj.mpc_tmc_req.ppid);
 
-	STEP // 8: Obtain lock on switch state 
-	pthread_mutex_lock(&cxls->mtx);
+	STEP // 6: Obtain lock on port 
+	// Obtained below once the port number has been validated
 
-	STEP // 9: Validate Inputs 
+	STEP // 7: Validate Inputs 
 
 	// Validate MCTP Message Type 
-	if (req.obj.mpc_tmc_req.type != MCMT_CXLCCI) 
+	if (req->obj.mpc_tmc_req.type != MCMT_CXLCCI) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Tunneled command did not have a CXL CCI MCTP Type code. Tunneled MCTP Type code: %d\n", now, req.obj.mpc_tmc_req.type);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Tunneled command did not have a CXL CCI MCTP Type code. Tunneled MCTP Type code: %d\n", req->obj.mpc_tmc_req.type);
 		goto send;
 	}
 
 	// Validate port number 
-	if (req.obj.mpc_tmc_req.ppid >= cxls->num_ports) 
+	if (req->obj.mpc_tmc_req.ppid >= cxls->num_ports) 
 	{
-		IFV(CLVB_ERRORS) printf("%s Invalid Port number requested. PPID: %d\n", now, req.obj.mpc_tmc_req.ppid);
+		IFV(CLVB_ERRORS) logger_printf("Invalid Port number requested. PPID: %d\n", req->obj.mpc_tmc_req.ppid);
 		goto send;
 	}
-	p = &cxls->ports[req.obj.mpc_tmc_req.ppid];
+	p = &cxls->ports[req->obj.mpc_tmc_req.ppid];
+	state_lock_port(req->obj.mpc_tmc_req.ppid);
 
 	// Validate device attached to port is an MLD port
 	if ( !(p->dt == FMDT_CXL_TYPE_3 || p->dt == FMDT_CXL_TYPE_3_POOLED) ) 
 	{
-		IFV(CLVB_ERRORS) printf("%s Port is not Type 3 device. Type: %s\n", now, fmdt(p->dt));
+		IFV(CLVB_ERRORS) logger_printf("Port is not Type 3 device. Type: %s\n", fmdt(p->dt));
 		goto send;
 	}
 
-	STEP // 10: Perform Action 
+	STEP // 8: Perform Action 
 
-	STEP // 11: Prepare Response Object
+	STEP // 9: Prepare Response Object
 	{
 		struct fmapi_msg src, dst;
 
 		// Configure Buffer pointers
-		src.buf = (struct fmapi_buf*) req.obj.mpc_tmc_req.msg;
+		src.buf = (struct fmapi_buf*) req->obj.mpc_tmc_req.msg;
 		dst.buf = (struct fmapi_buf*) rsp.obj.mpc_tmc_rsp.msg;
 
 		// Deserialize Sub Header
@@ -587,10 +620,24 @@ int fmop_mpc_tmc(struct mctp *m, struct mctp_action *ma)
 		// Verify sub message is a request
 		if (src.hdr.category != FMMT_REQ) 
 		{
-			IFV(CLVB_ERRORS) printf("%s ERR: Tunneled FM API Message Category is not a request. Tunneled FM API Message Category: %d\n", now, src.hdr.category);
+			IFV(CLVB_ERRORS) logger_printf("ERR: Tunneled FM API Message Category is not a request. Tunneled FM API Message Category: %d\n", src.hdr.category);
 
 			// Fill Sub Header 
-			len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, src.hdr.tag, src.hdr.opcode, 0, 0, FMRC_INVALID_INPUT, 0);
+			len = fmapi_fill_hdr(&dst.hdr, FMMT_RESP, src.hdr.tag, src.hdr.opcode, 0, 0, FMRC_INVALID_INPUT, 0);
+
+			// Serialize Sub Header 
+			fmapi_serialize(dst.buf->hdr, &dst.hdr, FMOB_HDR);
+
+			goto sub;
+		}
+
+		// Deserialize Sub Request Object once for the MCC handler 
+		if ( fmapi_deserialize(&src.obj, src.buf->payload, fmapi_fmob_req(src.hdr.opcode), NULL) < 0 )
+		{
+			IFV(CLVB_ERRORS) logger_printf("ERR: Could not deserialize tunneled FM API Message. Tunneled FM API Message Opcode %d\n", src.hdr.opcode);
+
+			// Fill Sub Header 
+			len = fmapi_fill_hdr(&dst.hdr, FMMT_RESP, src.hdr.tag, src.hdr.opcode, 0, 0, FMRC_INVALID_INPUT, 0);
 
 			// Serialize Sub Header 
 			fmapi_serialize(dst.buf->hdr, &dst.hdr, FMOB_HDR);
@@ -612,10 +659,10 @@ int fmop_mpc_tmc(struct mctp *m, struct mctp_action *ma)
 			case FMOP_MCC_QOS_BW_LIMIT_GET: len = fmop_mcc_get_qos_limit(p, &src, &dst); break; // 0x5408
 			case FMOP_MCC_QOS_BW_LIMIT_SET: len = fmop_mcc_set_qos_limit(p, &src, &dst); break; // 0x5409
 			default:  
-				IFV(CLVB_ERRORS) printf("%s ERR: Tunneled FM API Mesage has an invalid opcode. Tunneled FM API Message Opcode %d\n", now, src.hdr.opcode);
+				IFV(CLVB_ERRORS) logger_printf("ERR: Tunneled FM API Mesage has an invalid opcode. Tunneled FM API Message Opcode %d\n", src.hdr.opcode);
 				
 				// Fill Sub Header 
-				len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, src.hdr.tag, src.hdr.opcode, 0, 0, FMRC_UNSUPPORTED, 0);
+				len = fmapi_fill_hdr(&dst.hdr, FMMT_RESP, src.hdr.tag, src.hdr.opcode, 0, 0, FMRC_UNSUPPORTED, 0);
 
 				// Serialize Sub Header 
 				fmapi_serialize(dst.buf->hdr, &dst.hdr, FMOB_HDR);
@@ -626,30 +673,32 @@ sub:
 
 		// Fill Response Object
 		rsp.obj.mpc_tmc_rsp.len = len;
-		rsp.obj.mpc_tmc_rsp.type = req.obj.mpc_tmc_req.type;
+		rsp.obj.mpc_tmc_rsp.type = req->obj.mpc_tmc_req.type;
 	}
 
-	STEP // 12: Serialize Response Object
-	len = fmapi_serialize(rsp.buf->payload, &rsp.obj, fmapi_fmob_rsp(req.hdr.opcode));
+	STEP // 10: Serialize Response Object
+	len = fmapi_serialize(rsp.buf->payload, &rsp.obj, fmapi_fmob_rsp(req->hdr.opcode));
 
-	STEP // 13: Set return code
+	STEP // 11: Set return code
 	rc = FMRC_SUCCESS;
 
 send:
 
-	STEP // 14: Release lock on switch state 
-	pthread_mutex_unlock(&cxls->mtx);
+	STEP // 12: Release lock on port 
+	if (p != NULL)
+		state_unlock_port(req->obj.mpc_tmc_req.ppid);
 
 	if (len < 0)
 		goto end;
 
-	STEP // 15: Fill Response Header
-	ma->rsp->len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, req.hdr.tag, req.hdr.opcode, 0, len, rc, 0);
+	STEP // 13: Fill Response Header
+	metrics_rc(rc);
+	ma->rsp->len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, req->hdr.tag, req->hdr.opcode, 0, len, rc, 0);
 
-	STEP // 16: Serialize Header 
+	STEP // 14: Serialize Header 
 	fmapi_serialize(rsp.buf->hdr, &rsp.hdr, FMOB_HDR);
 
-	STEP // 17: Push mctp_action onto queue 
+	STEP // 15: Push mctp_action onto queue 
 	pq_push(m->tmq, ma);
 
 	rv = 0;
@@ -661,3 +710,31 @@ end:
 	return rv;
 }
 
+/**
+ * Decode the fixed fields of an MPC LD CXL.io Memory Request 
+ *
+ * The Transaction Data is not copied. It is left in the request buffer at 
+ * offset CSLN_MPC_MEM_REQ_HDR
+ *
+ * @param r 	struct fmapi_mpc_mem_req* to fill (data[] is not touched)
+ * @param buf 	__u8* to the serialized request payload 
+ * @param len 	Length of the serialized request payload in bytes
+ * @return 		0 upon success, 1 otherwise
+ */
+static int _parse_mpc_mem_req(struct fmapi_mpc_mem_req *r, __u8 *buf, unsigned len)
+{
+	if (len < CSLN_MPC_MEM_REQ_HDR)
+		return 1;
+
+	r->ppid 	= buf[0];
+	r->fdbe 	= buf[1] & 0x0F;
+	r->ldbe 	= (buf[1] >> 4) & 0x0F;
+	r->type 	= (buf[3] >> 7) & 0x01;
+	r->ldid 	= (__u16) buf[4] | ((__u16) buf[5] << 8);
+	r->len 		= (__u16) buf[6] | ((__u16) buf[7] << 8);
+	r->offset 	= 0;
+	for ( int i = 7 ; i >= 0 ; i-- ) 
+		r->offset = (r->offset << 8) | buf[8 + i];
+
+	return 0;
+}
@@ -34,10 +34,6 @@
  */
 #include <time.h>
 
-/* system()
- */
-#include <stdlib.h>
-
 /* autl_prnt_buf()
  */
 #include <arrayutils.h>
@@ -48,40 +44,31 @@
  */
 #include <mctp.h>
 #include <ptrqueue.h>
-#include <timeutils.h>
 #include <cxlstate.h>
 #include "signals.h"
 
 #include "options.h"
 
+#include "trace.h"
+
+#include "logger.h"
+
+#include "metrics.h"
+
 #include "state.h"
 
+#include "bgop.h"
+
+#include "events.h"
+
+#include "cache.h"
+
 #include <fmapi.h>
 
 #include "fmapi_handler.h"
 
 /* MACROS ====================================================================*/
 
-#ifdef CSE_VERBOSE
- #define INIT 			unsigned step = 0;
- #define ENTER 					if (opts[CLOP_VERBOSITY].u64 & CLVB_CALLSTACK) 	printf("%d:%s Enter\n", 			gettid(), __FUNCTION__);
- #define STEP 			step++; if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u\n", 			gettid(), __FUNCTION__, step);
- #define HEX32(m, i)			if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u %s: 0x%x\n",	gettid(), __FUNCTION__, step, m, i);
- #define INT32(m, i)			if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u %s: %d\n",	gettid(), __FUNCTION__, step, m, i);
- #define EXIT(rc) 				if (opts[CLOP_VERBOSITY].u64 & CLVB_CALLSTACK) 	printf("%d:%s Exit: %d\n", 			gettid(), __FUNCTION__,rc);
-#else
- #define ENTER
- #define EXIT(rc)
- #define STEP
- #define HEX32(m, i)
- #define INT32(m, i)
- #define INIT 
-#endif // CSE_VERBOSE
-
-#define IFV(u) 					if (opts[CLOP_VERBOSITY].u64 & u) 
-
-#define ISO_TIME_BUF_LEN		32
-
 /* ENUMERATIONS ==============================================================*/
 
 /* STRUCTS ===================================================================*/
@@ -97,50 +84,48 @@
  *
  * @param m 	struct mctp* 
  * @param mm 	struct mctp_msg* 
+ * @param req 	struct fmapi_msg* holding the decoded request
  * @return 		0 upon success, 1 otherwise
  *
  * STEPS
  *  1: Initialize variables
- *  2: Checkout Response mctp_msg buffer
+ *  2: Verify Response mctp_msg buffer
  *  3: Fill Response MCTP Header
- *  4: Set buffer pointers 
- *  5: Deserialize Request Header
- *  6: Deserialize Request Object 
- *  7: Extract parameters
- *  8: Obtain lock on switch state 
- *  9: Validate Inputs 
- * 10: Perform Action 
- * 11: Prepare Response Object
- * 12: Serialize Response Object
- * 13: Set return code
- * 14: Release lock on switch state 
- * 15: Fill Response Header
- * 16: Serialize Header 
- * 17: Push Response mctp_msg onto Transmit Message Queue 
- * 18: Checkin mctp_msgs 
+ *  4: Set response buffer pointer 
+ *  5: Extract parameters
+ *  6: Obtain lock on port 
+ *  7: Validate Inputs 
+ *  8: Perform Action 
+ *  9: Prepare Response Object
+ * 10: Serialize Response Object
+ * 11: Set return code
+ * 12: Release lock on port 
+ * 13: Fill Response Header
+ * 14: Serialize Header 
+ * 15: Push Response mctp_msg onto Transmit Message Queue 
+ * 16: Checkin mctp_msgs 
  */
-int fmop_psc_cfg(struct mctp *m, struct mctp_action *ma)
+int fmop_psc_cfg(struct mctp *m, struct mctp_action *ma, struct fmapi_msg *req)
 {
 	INIT
-	char now[ISO_TIME_BUF_LEN];
-	struct fmapi_msg req, rsp;
+	struct fmapi_msg rsp;
 	
 	unsigned rc;
 	int rv, len;
 
 	struct cxl_port *p; 
 	__u16 reg; 
+	__u8 *cfg;
 
 	ENTER
 
 	STEP // 1: Initialize variables
+	p = NULL;
 	rv = 1; 
 	len = 0;
 	rc = FMRC_INVALID_INPUT;
-	isotime(now, ISO_TIME_BUF_LEN);
 
-	STEP // 2: Get response mctp_msg buffer
-	ma->rsp = pq_pop(m->msgs, 1);
+	STEP // 2: Verify Response mctp_msg buffer was checked out by the dispatcher
 	if (ma->rsp == NULL)  
 		goto end;
 
@@ -148,48 +133,39 @@ int fmop_psc_cfg(struct mctp *m, struct mctp_action *ma)
 	mctp_fill_msg_hdr(ma->rsp, ma->req->src, m->state.eid, 0, ma->req->tag);
 	ma->rsp->type = ma->req->type;
 	
-	// 4: Set buffer pointers 
-	req.buf = (struct fmapi_buf*) ma->req->payload;
+	// 4: Set response buffer pointer 
 	rsp.buf = (struct fmapi_buf*) ma->rsp->payload;
 
-	STEP // 5: Deserialize Request Header
-	if ( fmapi_deserialize(&req.hdr, req.buf->hdr, FMOB_HDR, NULL) <= 0 )
-		goto end;
-
-	STEP // 6: Deserialize Request Object 
-	if ( fmapi_deserialize(&req.obj, req.buf->payload, fmapi_fmob_req(req.hdr.opcode), NULL) < 0 )
-		goto end;
-
-	STEP // 7: Extract parameters
-
-	IFV(CLVB_COMMANDS) printf("%s CMD: FM API PSC CXL.io Config. PPID: %d\n", now, req.obj.psc_cfg_req.ppid);
+	STEP // 5: Extract parameters
 
-	STEP // 8: Obtain lock on switch state 
-	pthread_mutex_lock(&cxls->mtx);
+	IFV(CLVB_COMMANDS) logger_printf("CMD: FM API PSC CXL.io Config. PPID: %d\n", req->obj.psc_cfg_req.ppid);
 
-	STEP // 9: Validate Inputs 
-	if (req.obj.psc_cfg_req.ppid >= cxls->num_ports) 
+	STEP // 6: Obtain lock on port 
+	if (req->obj.psc_cfg_req.ppid >= cxls->num_ports) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Requested PPDI exceeds number of ports present. Requested PPID: %d Present: %d\n", now, req.obj.psc_cfg_req.ppid, cxls->num_ports);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Requested PPDI exceeds number of ports present. Requested PPID: %d Present: %d\n", req->obj.psc_cfg_req.ppid, cxls->num_ports);
 		goto send;
 	}
-	p = &cxls->ports[req.obj.psc_cfg_req.ppid];
+	p = &cxls->ports[req->obj.psc_cfg_req.ppid];
+	state_lock_port(req->obj.psc_cfg_req.ppid);
+
+	STEP // 7: Validate Inputs 
 
 	// Validate port is not bound or is an MLD port 
 	//if ( !(p->state == FMPS_DISABLED || p->ld > 0) ) 
 	//{
-	//	IFV(CLVB_ERRORS) printf("%s Port is not unbound or is not an MLD Port. PPID: %d Port State: %s Num LD: %d\n", now, req.obj.psc_cfg_req.ppid, fmps(p->state), p->ld);
+	//	IFV(CLVB_ERRORS) logger_printf("Port is not unbound or is not an MLD Port. PPID: %d Port State: %s Num LD: %d\n", req->obj.psc_cfg_req.ppid, fmps(p->state), p->ld);
 	//	goto send;
 	//}
 
-	STEP // 10: Perform Action 
-	switch (req.obj.psc_cfg_req.type)
+	STEP // 8: Perform Action 
+	switch (req->obj.psc_cfg_req.type)
 	{
 		case FMCT_READ:				// 0x00
 		{
-			IFV(CLVB_ACTIONS) printf("%s ACT: Performing CXL.io Read on PPID: %d\n", now, req.obj.psc_cfg_req.ppid);
+			IFV(CLVB_ACTIONS) logger_printf("ACT: Performing CXL.io Read on PPID: %d\n", req->obj.psc_cfg_req.ppid);
 
-			reg = (req.obj.psc_cfg_req.ext << 8) | req.obj.psc_cfg_req.reg;
+			reg = (req->obj.psc_cfg_req.ext << 8) | req->obj.psc_cfg_req.reg;
 
 			rsp.obj.psc_cfg_rsp.data[0] = 0;
 			rsp.obj.psc_cfg_rsp.data[1] = 0;
@@ -198,7 +174,7 @@ int fmop_psc_cfg(struct mctp *m, struct mctp_action *ma)
 			
 			if (opts[CLOP_QEMU].set == 1)
 			{
-				switch(req.obj.psc_cfg_req.fdbe)
+				switch(req->obj.psc_cfg_req.fdbe)
 				{
 					case 0x01: 
 					{
@@ -239,28 +215,33 @@ int fmop_psc_cfg(struct mctp *m, struct mctp_action *ma)
 			} 
 			else 
 			{
-				if (req.obj.psc_cfg_req.fdbe & 0x01) rsp.obj.psc_cfg_rsp.data[0] = p->cfgspace[reg+0];  
-				if (req.obj.psc_cfg_req.fdbe & 0x02) rsp.obj.psc_cfg_rsp.data[1] = p->cfgspace[reg+1];
-				if (req.obj.psc_cfg_req.fdbe & 0x04) rsp.obj.psc_cfg_rsp.data[2] = p->cfgspace[reg+2]; 
-				if (req.obj.psc_cfg_req.fdbe & 0x08) rsp.obj.psc_cfg_rsp.data[3] = p->cfgspace[reg+3];
+				// Config space that was never written reads as zero 
+				cfg = state_port_cfgspace(p, 0);
+				if (cfg == NULL || reg + 4 > CFG_SPACE_SIZE)
+					break;
+
+				if (req->obj.psc_cfg_req.fdbe & 0x01) rsp.obj.psc_cfg_rsp.data[0] = cfg[reg+0];  
+				if (req->obj.psc_cfg_req.fdbe & 0x02) rsp.obj.psc_cfg_rsp.data[1] = cfg[reg+1];
+				if (req->obj.psc_cfg_req.fdbe & 0x04) rsp.obj.psc_cfg_rsp.data[2] = cfg[reg+2]; 
+				if (req->obj.psc_cfg_req.fdbe & 0x08) rsp.obj.psc_cfg_rsp.data[3] = cfg[reg+3];
 			}
 		}
 			break;
 
 		case FMCT_WRITE:			// 0x01
 		{
-			HEX32("Write Data", *((int*)req.obj.psc_cfg_req.data));
-			IFV(CLVB_ACTIONS) printf("%s ACT: Performing CXL.io Write on PPID: %d\n", now, req.obj.psc_cfg_req.ppid);
+			HEX32("Write Data", *((int*)req->obj.psc_cfg_req.data));
+			IFV(CLVB_ACTIONS) logger_printf("ACT: Performing CXL.io Write on PPID: %d\n", req->obj.psc_cfg_req.ppid);
 
-			reg = (req.obj.psc_cfg_req.ext << 8) | req.obj.psc_cfg_req.reg;
+			reg = (req->obj.psc_cfg_req.ext << 8) | req->obj.psc_cfg_req.reg;
 
 			if (opts[CLOP_QEMU].set == 1)
 			{
-				switch(req.obj.psc_cfg_req.fdbe)
+				switch(req->obj.psc_cfg_req.fdbe)
 				{
 					case 0x01:
 					{
-						pci_write_byte(p->dev, reg, req.obj.psc_cfg_req.data[0]);
+						pci_write_byte(p->dev, reg, req->obj.psc_cfg_req.data[0]);
 					} break;
 
 					case 0x03:
@@ -269,8 +250,8 @@ int fmop_psc_cfg(struct mctp *m, struct mctp_action *ma)
 						if ((reg & 0x1) != 0)
 							goto send;
 
-						__u16 w =  (req.obj.psc_cfg_req.data[1] << 8) 
-						          | req.obj.psc_cfg_req.data[0];
+						__u16 w =  (req->obj.psc_cfg_req.data[1] << 8) 
+						          | req->obj.psc_cfg_req.data[0];
 
 						pci_write_word(p->dev, reg, w);
 					} break;
@@ -281,10 +262,10 @@ int fmop_psc_cfg(struct mctp *m, struct mctp_action *ma)
 						if ((reg & 0x3) != 0)
 							goto send;
 
-						__u32 l = (req.obj.psc_cfg_req.data[3] << 24) 
-						         |(req.obj.psc_cfg_req.data[2] << 16)
-						         |(req.obj.psc_cfg_req.data[1] <<  8)
-						         |(req.obj.psc_cfg_req.data[0]      );
+						__u32 l = (req->obj.psc_cfg_req.data[3] << 24) 
+						         |(req->obj.psc_cfg_req.data[2] << 16)
+						         |(req->obj.psc_cfg_req.data[1] <<  8)
+						         |(req->obj.psc_cfg_req.data[0]      );
 
 						pci_write_long(p->dev, reg, l);
 					} break;
@@ -295,38 +276,48 @@ int fmop_psc_cfg(struct mctp *m, struct mctp_action *ma)
 			}
 			else
 			{
-				if (req.obj.psc_cfg_req.fdbe & 0x01) p->cfgspace[reg+0] = req.obj.psc_cfg_req.data[0];
-				if (req.obj.psc_cfg_req.fdbe & 0x02) p->cfgspace[reg+1] = req.obj.psc_cfg_req.data[1];
-				if (req.obj.psc_cfg_req.fdbe & 0x04) p->cfgspace[reg+2] = req.obj.psc_cfg_req.data[2];
-				if (req.obj.psc_cfg_req.fdbe & 0x08) p->cfgspace[reg+3] = req.obj.psc_cfg_req.data[3];
+				if (reg + 4 > CFG_SPACE_SIZE)
+					goto send;
+
+				// Allocate config space on first write 
+				cfg = state_port_cfgspace(p, 1);
+				if (cfg == NULL)
+					goto send;
+
+				if (req->obj.psc_cfg_req.fdbe & 0x01) cfg[reg+0] = req->obj.psc_cfg_req.data[0];
+				if (req->obj.psc_cfg_req.fdbe & 0x02) cfg[reg+1] = req->obj.psc_cfg_req.data[1];
+				if (req->obj.psc_cfg_req.fdbe & 0x04) cfg[reg+2] = req->obj.psc_cfg_req.data[2];
+				if (req->obj.psc_cfg_req.fdbe & 0x08) cfg[reg+3] = req->obj.psc_cfg_req.data[3];
 			}
 		}
 			break;
 	}
 
-	STEP // 11: Prepare Response Object
+	STEP // 9: Prepare Response Object
 
-	STEP // 12: Serialize Response Object
-	len = fmapi_serialize(rsp.buf->payload, &rsp.obj, fmapi_fmob_rsp(req.hdr.opcode));
+	STEP // 10: Serialize Response Object
+	len = fmapi_serialize(rsp.buf->payload, &rsp.obj, fmapi_fmob_rsp(req->hdr.opcode));
 
-	STEP // 13: Set return code
+	STEP // 11: Set return code
 	rc = FMRC_SUCCESS;
 
 send:
 
-	STEP // 14: Release lock on switch state 
-	pthread_mutex_unlock(&cxls->mtx);
+	STEP // 12: Release lock on port 
+	if (p != NULL)
+		state_unlock_port(req->obj.psc_cfg_req.ppid);
 
 	if (len < 0)
 		goto end;
 
-	STEP // 15: Fill Response Header
-	ma->rsp->len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, req.hdr.tag, req.hdr.opcode, 0, len, rc, 0);
+	STEP // 13: Fill Response Header
+	metrics_rc(rc);
+	ma->rsp->len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, req->hdr.tag, req->hdr.opcode, 0, len, rc, 0);
 
-	STEP // 16: Serialize Header 
+	STEP // 14: Serialize Header 
 	fmapi_serialize(rsp.buf->hdr, &rsp.hdr, FMOB_HDR);
 
-	STEP // 17: Push mctp_action onto queue 
+	STEP // 15: Push mctp_action onto queue 
 	pq_push(m->tmq, ma);
 
 	rv = 0;
@@ -343,47 +334,45 @@ end:
  *
  * @param m 	struct mctp* 
  * @param mm 	struct mctp_msg* 
+ * @param req 	struct fmapi_msg* holding the decoded request
  * @return 		0 upon success, 1 otherwise
  *
  * STEPS
  *  1: Initialize variables
- *  2: Checkout Response mctp_msg buffer
+ *  2: Verify Response mctp_msg buffer
  *  3: Fill Response MCTP Header
- *  4: Set buffer pointers 
- *  5: Deserialize Request Header
- *  6: Deserialize Request Object 
- *  7: Extract parameters
- *  8: Obtain lock on switch state 
- *  9: Validate Inputs 
- * 10: Perform Action 
- * 11: Prepare Response Object
- * 12: Serialize Response Object
- * 13: Set return code
- * 14: Release lock on switch state 
- * 15: Fill Response Header
- * 16: Serialize Header 
- * 17: Push Response mctp_msg onto Transmit Message Queue 
- * 18: Checkin mctp_msgs 
+ *  4: Set response buffer pointer 
+ *  5: Extract parameters
+ *  6: Obtain lock on switch state 
+ *  7: Validate Inputs 
+ *  8: Perform Action 
+ *  9: Prepare Response Object
+ * 10: Serialize Response Object
+ * 11: Set return code
+ * 12: Release lock on switch state 
+ * 13: Fill Response Header
+ * 14: Serialize Header 
+ * 15: Push Response mctp_msg onto Transmit Message Queue 
+ * 16: Checkin mctp_msgs 
  */
-int fmop_psc_id(struct mctp *m, struct mctp_action *ma)
+int fmop_psc_id(struct mctp *m, struct mctp_action *ma, struct fmapi_msg *req)
 {
 	INIT
-	char now[ISO_TIME_BUF_LEN];
-	struct fmapi_msg req, rsp;
+	struct fmapi_msg rsp;
 	
 	unsigned rc;
 	int rv, len;
 
+	__u64 gen;
+
 	ENTER
 
 	STEP // 1: Initialize variables
 	rv = 1; 
 	len = 0;
 	rc = FMRC_INVALID_INPUT;
-	isotime(now, ISO_TIME_BUF_LEN);
 
-	STEP // 2: Get response mctp_msg buffer
-	ma->rsp = pq_pop(m->msgs, 1);
+	STEP // 2: Verify Response mctp_msg buffer was checked out by the dispatcher
 	if (ma->rsp == NULL)  
 		goto end;
 
@@ -391,30 +380,32 @@ int fmop_psc_id(struct mctp *m, struct mctp_action *ma)
 	mctp_fill_msg_hdr(ma->rsp, ma->req->src, m->state.eid, 0, ma->req->tag);
 	ma->rsp->type = ma->req->type;
 	
-	// 4: Set buffer pointers 
-	req.buf = (struct fmapi_buf*) ma->req->payload;
+	// 4: Set response buffer pointer 
 	rsp.buf = (struct fmapi_buf*) ma->rsp->payload;
 
-	STEP // 5: Deserialize Request Header
-	if ( fmapi_deserialize(&req.hdr, req.buf->hdr, FMOB_HDR, NULL) <= 0 )
-		goto end;
-
-	STEP // 6: Deserialize Request Object 
-	if ( fmapi_deserialize(&req.obj, req.buf->payload, fmapi_fmob_req(req.hdr.opcode), NULL) < 0 )
-		goto end;
+	STEP // 5: Extract parameters
 
-	STEP // 7: Extract parameters
+	IFV(CLVB_COMMANDS) logger_printf("CMD: FM API PSC Identify Switch Device\n");
 
-	IFV(CLVB_COMMANDS) printf("%s CMD: FM API PSC Identify Switch Device\n", now);
+	// Reuse the last response if nothing in the switch changed since
+	gen = state_gen(STATE_GEN_ALL, 0);
+	len = cache_get(CAAPI_FM, req->hdr.opcode, NULL, 0, gen, rsp.buf->payload, NULL);
+	if (len >= 0)
+	{
+		rc = FMRC_SUCCESS;
+		goto cached;
+	}
+	len = 0;
 
-	STEP // 8: Obtain lock on switch state 
-	pthread_mutex_lock(&cxls->mtx);
+	STEP // 6: Obtain lock on switch state 
+	state_lock_topology();
+	state_lock_id(0);
 
-	STEP // 9: Validate Inputs 
+	STEP // 7: Validate Inputs 
 
-	STEP // 10: Perform Action 
+	STEP // 8: Perform Action 
 
-	STEP // 11: Prepare Response Object
+	STEP // 9: Prepare Response Object
 	{
 		struct cxl_switch *cs 		= cxls;
 		struct fmapi_psc_id_rsp *fi = &rsp.obj.psc_id_rsp;
@@ -431,44 +422,49 @@ int fmop_psc_id(struct mctp *m, struct mctp_action *ma)
 	
 		// Compute dynamic information 
 		for ( int i = 0 ; i < cs->num_ports ; i++ ) {
+			state_lock_port(i);
 			if ( cs->ports[i].state != FMPS_DISABLED ) 
 				fi->active_ports[i/8] |= (0x01 << (i % 8));
+			state_unlock_port(i);
 		}
 	
 		for ( int i = 0 ; i < cs->num_vcss ; i++ ) {
+			state_lock_vcs(i);
 			if ( cs->vcss[i].state == FMVS_ENABLED) 
 				fi->active_vcss[i/8] |= (0x01 << (i % 8));
+			state_unlock_vcs(i);
 		}
-	
-		for ( int i = 0 ; i < cs->num_vcss ; i++ ) {
-			for ( int j = 0 ; j < cs->vcss[i].num ; j++ ) {
-				if ( cs->vcss[i].vppbs[j].bind_status != FMBS_UNBOUND ) 
-					fi->active_vppbs++;
-			}
-		}
+
+		fi->active_vppbs = state_binds_num();
 	}
 
-	STEP // 12: Serialize Response Object
-	len = fmapi_serialize(rsp.buf->payload, &rsp.obj, fmapi_fmob_rsp(req.hdr.opcode));
+	STEP // 10: Serialize Response Object
+	len = fmapi_serialize(rsp.buf->payload, &rsp.obj, fmapi_fmob_rsp(req->hdr.opcode));
+	if (len >= 0)
+		cache_put(CAAPI_FM, req->hdr.opcode, NULL, 0, gen, rsp.buf->payload, len, 0);
 
-	STEP // 13: Set return code
+	STEP // 11: Set return code
 	rc = FMRC_SUCCESS;
 
 //send:
 
-	STEP // 14: Release lock on switch state 
-	pthread_mutex_unlock(&cxls->mtx);
+	STEP // 12: Release lock on switch state 
+	state_unlock_id();
+	state_unlock_topology();
+
+cached:
 
 	if (len < 0)
 		goto end;
 
-	STEP // 15: Fill Response Header
-	ma->rsp->len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, req.hdr.tag, req.hdr.opcode, 0, len, rc, 0);
+	STEP // 13: Fill Response Header
+	metrics_rc(rc);
+	ma->rsp->len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, req->hdr.tag, req->hdr.opcode, 0, len, rc, 0);
 
-	STEP // 16: Serialize Header 
+	STEP // 14: Serialize Header 
 	fmapi_serialize(rsp.buf->hdr, &rsp.hdr, FMOB_HDR);
 
-	STEP // 17: Push mctp_action onto queue 
+	STEP // 15: Push mctp_action onto queue 
 	pq_push(m->tmq, ma);
 
 	rv = 0;
@@ -485,39 +481,40 @@ end:
  *
  * @param m 	struct mctp* 
  * @param mm 	struct mctp_msg* 
+ * @param req 	struct fmapi_msg* holding the decoded request
  * @return 		0 upon success, 1 otherwise
  *
  * STEPS
  *  1: Initialize variables
- *  2: Checkout Response mctp_msg buffer
+ *  2: Verify Response mctp_msg buffer
  *  3: Fill Response MCTP Header
- *  4: Set buffer pointers 
- *  5: Deserialize Request Header
- *  6: Deserialize Request Object 
- *  7: Extract parameters
- *  8: Obtain lock on switch state 
- *  9: Validate Inputs 
- * 10: Perform Action 
- * 11: Prepare Response Object
- * 12: Serialize Response Object
- * 13: Set return code
- * 14: Release lock on switch state 
- * 15: Fill Response Header
- * 16: Serialize Header 
- * 17: Push Response mctp_msg onto Transmit Message Queue 
- * 18: Checkin mctp_msgs 
+ *  4: Set response buffer pointer 
+ *  5: Extract parameters
+ *  6: Obtain lock on switch state 
+ *  7: Validate Inputs 
+ *  8: Perform Action 
+ *  9: Prepare Response Object
+ * 10: Serialize Response Object
+ * 11: Set return code
+ * 12: Release lock on switch state 
+ * 13: Fill Response Header
+ * 14: Serialize Header 
+ * 15: Push Response mctp_msg onto Transmit Message Queue 
+ * 16: Checkin mctp_msgs 
  */
-int fmop_psc_port(struct mctp *m, struct mctp_action *ma)
+int fmop_psc_port(struct mctp *m, struct mctp_action *ma, struct fmapi_msg *req)
 {
 	INIT
-	char now[ISO_TIME_BUF_LEN];
-	struct fmapi_msg req, rsp;
+	struct fmapi_msg rsp;
 	
 	unsigned rc;
 	int rv, len;
 
 	int i;
 	__u8 id;
+	__u64 gen;
+	__u8 *key;
+	unsigned keylen;
 
 	ENTER
 
@@ -525,10 +522,8 @@ int fmop_psc_port(struct mctp *m, struct mctp_action *ma)
 	rv = 1; 
 	len = 0;
 	rc = FMRC_INVALID_INPUT;
-	isotime(now, ISO_TIME_BUF_LEN);
 
-	STEP // 2: Get response mctp_msg buffer
-	ma->rsp = pq_pop(m->msgs, 1);
+	STEP // 2: Verify Response mctp_msg buffer was checked out by the dispatcher
 	if (ma->rsp == NULL)  
 		goto end;
 
@@ -536,33 +531,38 @@ int fmop_psc_port(struct mctp *m, struct mctp_action *ma)
 	mctp_fill_msg_hdr(ma->rsp, ma->req->src, m->state.eid, 0, ma->req->tag);
 	ma->rsp->type = ma->req->type;
 	
-	// 4: Set buffer pointers 
-	req.buf = (struct fmapi_buf*) ma->req->payload;
+	// 4: Set response buffer pointer 
 	rsp.buf = (struct fmapi_buf*) ma->rsp->payload;
 
-	STEP // 5: Deserialize Request Header
-	if ( fmapi_deserialize(&req.hdr, req.buf->hdr, FMOB_HDR, NULL) <= 0 )
-		goto end;
+	STEP // 5: Extract parameters
 
-	STEP // 6: Deserialize Request Object 
-	if ( fmapi_deserialize(&req.obj, req.buf->payload, fmapi_fmob_req(req.hdr.opcode), NULL) < 0 )
-		goto end;
+	IFV(CLVB_COMMANDS) logger_printf("CMD: FM API PSC Get Physical Port Status. Num: %d\n", req->obj.psc_port_req.num);
 
-	STEP // 7: Extract parameters
+	// Reuse the last response to the same request if none of its ports changed
+	key = ((struct fmapi_buf*) ma->req->payload)->payload;
+	keylen = req->hdr.len;
+	for ( i = 0, gen = 0 ; i < req->obj.psc_port_req.num ; i++ ) 
+		gen += state_gen(STATE_GEN_PORT, req->obj.psc_port_req.ports[i]);
 
-	IFV(CLVB_COMMANDS) printf("%s CMD: FM API PSC Get Physical Port Status. Num: %d\n", now, req.obj.psc_port_req.num);
+	len = cache_get(CAAPI_FM, req->hdr.opcode, key, keylen, gen, rsp.buf->payload, NULL);
+	if (len >= 0)
+	{
+		rc = FMRC_SUCCESS;
+		goto cached;
+	}
+	len = 0;
 
-	STEP // 8: Obtain lock on switch state 
-	pthread_mutex_lock(&cxls->mtx);
+	STEP // 6: Obtain lock on switch state 
+	// Port locks are obtained one at a time in step 11 
 
-	STEP // 9: Validate Inputs 
+	STEP // 7: Validate Inputs 
 
-	STEP // 10: Perform Action 
+	STEP // 8: Perform Action 
 
-	STEP // 11: Prepare Response Object
-	for ( i = 0, rsp.obj.psc_port_rsp.num = 0 ; i < req.obj.psc_port_req.num ; i++ ) 
+	STEP // 9: Prepare Response Object
+	for ( i = 0, rsp.obj.psc_port_rsp.num = 0 ; i < req->obj.psc_port_req.num ; i++ ) 
 	{
-		id = req.obj.psc_port_req.ports[i];
+		id = req->obj.psc_port_req.ports[i];
 		
 		// Validate portid 
 		if (id >= cxls->num_ports)
@@ -572,6 +572,8 @@ int fmop_psc_port(struct mctp *m, struct mctp_action *ma)
 		struct cxl_port *src 			= &cxls->ports[id];
 		struct fmapi_psc_port_info *dst = &rsp.obj.psc_port_rsp.list[i];
 
+		state_lock_port(id);
+
 		// Zero out destination
 		memset(dst, 0, sizeof(*dst));
 
@@ -594,30 +596,35 @@ int fmop_psc_port(struct mctp *m, struct mctp_action *ma)
 		dst->pwrctrl 	= src->pwrctrl;	//!< Link State Flags [FMLF] and [FMLO]
 		dst->num_ld	= src->ld;			//!< Supported Logical Device (LDs) count 
 
+		state_unlock_port(id);
+
 		rsp.obj.psc_port_rsp.num++;
 	}
 
-	STEP // 12: Serialize Response Object
-	len = fmapi_serialize(rsp.buf->payload, &rsp.obj, fmapi_fmob_rsp(req.hdr.opcode));
+	STEP // 10: Serialize Response Object
+	len = fmapi_serialize(rsp.buf->payload, &rsp.obj, fmapi_fmob_rsp(req->hdr.opcode));
+	if (len >= 0)
+		cache_put(CAAPI_FM, req->hdr.opcode, key, keylen, gen, rsp.buf->payload, len, 0);
 
-	STEP // 13: Set return code
+	STEP // 11: Set return code
 	rc = FMRC_SUCCESS;
 
-//send:
+cached:
 
-	STEP // 14: Release lock on switch state 
-	pthread_mutex_unlock(&cxls->mtx);
+	STEP // 12: Release lock on switch state 
+	// Port locks were released in step 11 
 
 	if (len < 0)
 		goto end;
 
-	STEP // 15: Fill Response Header
-	ma->rsp->len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, req.hdr.tag, req.hdr.opcode, 0, len, rc, 0);
+	STEP // 13: Fill Response Header
+	metrics_rc(rc);
+	ma->rsp->len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, req->hdr.tag, req->hdr.opcode, 0, len, rc, 0);
 
-	STEP // 16: Serialize Header 
+	STEP // 14: Serialize Header 
 	fmapi_serialize(rsp.buf->hdr, &rsp.hdr, FMOB_HDR);
 
-	STEP // 17: Push mctp_action onto queue 
+	STEP // 15: Push mctp_action onto queue 
 	pq_push(m->tmq, ma);
 
 	rv = 0;
@@ -634,49 +641,49 @@ end:
  *
  * @param m 	struct mctp* 
  * @param mm 	struct mctp_msg* 
+ * @param req 	struct fmapi_msg* holding the decoded request
  * @return 		0 upon success, 1 otherwise
  *
  * STEPS
  *  1: Initialize variables
- *  2: Checkout Response mctp_msg buffer
+ *  2: Verify Response mctp_msg buffer
  *  3: Fill Response MCTP Header
- *  4: Set buffer pointers 
- *  5: Deserialize Request Header
- *  6: Deserialize Request Object 
- *  7: Extract parameters
- *  8: Obtain lock on switch state 
- *  9: Validate Inputs 
- * 10: Perform Action 
- * 11: Prepare Response Object
- * 12: Serialize Response Object
- * 13: Set return code
- * 14: Release lock on switch state 
- * 15: Fill Response Header
- * 16: Serialize Header 
- * 17: Push Response mctp_msg onto Transmit Message Queue 
- * 18: Checkin mctp_msgs 
+ *  4: Set response buffer pointer 
+ *  5: Extract parameters
+ *  6: Obtain lock on port 
+ *  7: Validate Inputs 
+ *  8: Perform Action 
+ *  9: Prepare Response Object
+ * 10: Serialize Response Object
+ * 11: Set return code
+ * 12: Release lock on port 
+ * 13: Fill Response Header
+ * 14: Serialize Header 
+ * 15: Push Response mctp_msg onto Transmit Message Queue 
+ * 16: Checkin mctp_msgs 
  */
-int fmop_psc_port_ctrl(struct mctp *m, struct mctp_action *ma)
+int fmop_psc_port_ctrl(struct mctp *m, struct mctp_action *ma, struct fmapi_msg *req)
 {
 	INIT
-	char now[ISO_TIME_BUF_LEN];
-	struct fmapi_msg req, rsp;
+	struct fmapi_msg rsp;
 	
 	unsigned rc;
 	int rv, len;
 
 	struct cxl_port *p;
+	struct bgop op;
+	int qemu;
 
 	ENTER
 
 	STEP // 1: Initialize variables
+	p = NULL;
+	qemu = 0;
 	rv = 1; 
 	len = 0;
 	rc = FMRC_INVALID_INPUT;
-	isotime(now, ISO_TIME_BUF_LEN);
 
-	STEP // 2: Get response mctp_msg buffer
-	ma->rsp = pq_pop(m->msgs, 1);
+	STEP // 2: Verify Response mctp_msg buffer was checked out by the dispatcher
 	if (ma->rsp == NULL)  
 		goto end;
 
@@ -684,98 +691,124 @@ int fmop_psc_port_ctrl(struct mctp *m, struct mctp_action *ma)
 	mctp_fill_msg_hdr(ma->rsp, ma->req->src, m->state.eid, 0, ma->req->tag);
 	ma->rsp->type = ma->req->type;
 	
-	// 4: Set buffer pointers 
-	req.buf = (struct fmapi_buf*) ma->req->payload;
+	// 4: Set response buffer pointer 
 	rsp.buf = (struct fmapi_buf*) ma->rsp->payload;
 
-	STEP // 5: Deserialize Request Header
-	if ( fmapi_deserialize(&req.hdr, req.buf->hdr, FMOB_HDR, NULL) <= 0 )
-		goto end;
-
-	STEP // 6: Deserialize Request Object 
-	if ( fmapi_deserialize(&req.obj, req.buf->payload, fmapi_fmob_req(req.hdr.opcode), NULL) < 0 )
-		goto end;
-
-	STEP // 7: Extract parameters
-
-	IFV(CLVB_COMMANDS) printf("%s CMD: FM API PSC Physical Port Control. PPID: %d Opcode: %d\n", now, req.obj.psc_port_ctrl_req.ppid, req.obj.psc_port_ctrl_req.opcode);
+	STEP // 5: Extract parameters
 
-	STEP // 8: Obtain lock on switch state 
-	pthread_mutex_lock(&cxls->mtx);
+	IFV(CLVB_COMMANDS) logger_printf("CMD: FM API PSC Physical Port Control. PPID: %d Opcode: %d\n", req->obj.psc_port_ctrl_req.ppid, req->obj.psc_port_ctrl_req.opcode);
 
-	STEP // 9: Validate Inputs 
-	if (req.obj.psc_port_ctrl_req.ppid >= cxls->num_ports) 
+	STEP // 6: Obtain lock on port 
+	if (req->obj.psc_port_ctrl_req.ppid >= cxls->num_ports) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Requested PPID exceeds number of ports present. Requested PPID: %d Present: %d\n", now, req.obj.psc_port_ctrl_req.ppid, cxls->num_ports);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Requested PPID exceeds number of ports present. Requested PPID: %d Present: %d\n", req->obj.psc_port_ctrl_req.ppid, cxls->num_ports);
 		goto send;
 	}
-	p = &cxls->ports[req.obj.psc_port_ctrl_req.ppid];
+	p = &cxls->ports[req->obj.psc_port_ctrl_req.ppid];
+
+	// Slot power changes in QEMU run as a background operation, whose status is guarded by the id lock
+	qemu = (opts[CLOP_QEMU].set == 1);
+	if (qemu)
+		state_lock_id(1);
+	state_lock_port(req->obj.psc_port_ctrl_req.ppid);
+
+	STEP // 7: Validate Inputs 
 
-	STEP // 10: Perform Action 
-	switch (req.obj.psc_port_ctrl_req.opcode)
+	STEP // 8: Perform Action 
+	rc = FMRC_SUCCESS;
+	op.opcode = req->hdr.opcode;
+	op.ppid = p->ppid;
+	op.set_state = 0;
+	op.state = 0;
+	op.event = EVTY_PORT;
+	op.undo = 0;
+
+	switch (req->obj.psc_port_ctrl_req.opcode)
 	{
 		case FMPO_ASSERT_PERST:			// 0x00
 		{
-			char cmd[64];
-			sprintf(cmd, "echo 0 > /sys/bus/pci/slots/%d/power", p->ppid);
+			// Disable the device 
+			if (qemu)
+			{
+				op.power = BGPW_OFF;
+				rc = bgop_start(&op);
+				if (rc != FMRC_BACKGROUND_OP_STARTED)
+				{
+					IFV(CLVB_ERRORS) logger_printf("ERR: Could not start background operation. RC: %d\n", rc);
+					goto send;
+				}
+			}
 
-			IFV(CLVB_ACTIONS) printf("%s ACT: Asserting PERST on PPID: %d\n", now, req.obj.psc_port_ctrl_req.ppid);
+			IFV(CLVB_ACTIONS) logger_printf("ACT: Asserting PERST on PPID: %d\n", req->obj.psc_port_ctrl_req.ppid);
 
-			// Disable the device 
-			if ( opts[CLOP_QEMU].set == 1 )
-				rv = system(cmd);
-			
 			// Set PERST bit 
 			p->perst = 0x1;
+			state_gen_bump(STATE_GEN_PORT, p->ppid);
 		} break;
 
 		case FMPO_DEASSERT_PERST:		// 0x01
 		{
-			char cmd[64];
-			sprintf(cmd, "echo 1 > /sys/bus/pci/slots/%d/power", p->ppid);
-
-			IFV(CLVB_ACTIONS) printf("%s ACT: Deasserting PERST on PPID: %d\n", now, req.obj.psc_port_ctrl_req.ppid);
-
 			// Enable the device 
-			if ( opts[CLOP_QEMU].set == 1 )
-				rv = system(cmd);
+			if (qemu)
+			{
+				op.power = BGPW_ON;
+				rc = bgop_start(&op);
+				if (rc != FMRC_BACKGROUND_OP_STARTED)
+				{
+					IFV(CLVB_ERRORS) logger_printf("ERR: Could not start background operation. RC: %d\n", rc);
+					goto send;
+				}
+			}
+
+			IFV(CLVB_ACTIONS) logger_printf("ACT: Deasserting PERST on PPID: %d\n", req->obj.psc_port_ctrl_req.ppid);
 
 			p->perst = 0x0;
+			state_gen_bump(STATE_GEN_PORT, p->ppid);
 		} break;
 
 		case FMPO_RESET_PPB:			// 0x02
-			IFV(CLVB_ACTIONS) printf("%s ACT: Resetting PPID: %d\n", now, req.obj.psc_port_ctrl_req.ppid);
+			IFV(CLVB_ACTIONS) logger_printf("ACT: Resetting PPID: %d\n", req->obj.psc_port_ctrl_req.ppid);
 
 			break;
 
 		default:  
-			IFV(CLVB_ERRORS) printf("%s ERR: Invalid port control action Opcode. Opcode: 0x%04x\n", now, req.obj.psc_port_ctrl_req.opcode);
-			goto end;
+			IFV(CLVB_ERRORS) logger_printf("ERR: Invalid port control action Opcode. Opcode: 0x%04x\n", req->obj.psc_port_ctrl_req.opcode);
+			rc = FMRC_INVALID_INPUT;
+			goto send;
 	}
 
-	STEP // 11: Prepare Response Object
+	// A background operation posts the event when the slot power has changed
+	if (rc == FMRC_SUCCESS && req->obj.psc_port_ctrl_req.opcode != FMPO_RESET_PPB)
+		events_post(EVTY_PORT, p->ppid);
 
-	STEP // 12: Serialize Response Object
-	len = fmapi_serialize(rsp.buf->payload, &rsp.obj, fmapi_fmob_rsp(req.hdr.opcode));
+	STEP // 9: Prepare Response Object
 
-	STEP // 13: Set return code
-	rc = FMRC_SUCCESS;
+	STEP // 10: Serialize Response Object
+	len = fmapi_serialize(rsp.buf->payload, &rsp.obj, fmapi_fmob_rsp(req->hdr.opcode));
+
+	STEP // 11: Set return code
 
 send:
 
-	STEP // 14: Release lock on switch state 
-	pthread_mutex_unlock(&cxls->mtx);
+	STEP // 12: Release lock on port 
+	if (p != NULL)
+	{
+		state_unlock_port(req->obj.psc_port_ctrl_req.ppid);
+		if (qemu)
+			state_unlock_id();
+	}
 
 	if (len < 0)
 		goto end;
 
-	STEP // 15: Fill Response Header
-	ma->rsp->len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, req.hdr.tag, req.hdr.opcode, 0, len, rc, 0);
+	STEP // 13: Fill Response Header
+	metrics_rc(rc);
+	ma->rsp->len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, req->hdr.tag, req->hdr.opcode, 0, len, rc, 0);
 
-	STEP // 16: Serialize Header 
+	STEP // 14: Serialize Header 
 	fmapi_serialize(rsp.buf->hdr, &rsp.hdr, FMOB_HDR);
 
-	STEP // 17: Push mctp_action onto queue 
+	STEP // 15: Push mctp_action onto queue 
 	pq_push(m->tmq, ma);
 
 	rv = 0;
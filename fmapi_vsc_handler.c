@@ -22,9 +22,6 @@
  */
 #include <stdio.h>
 
-/* system()
- */
-#include <stdlib.h>
 /* memset()
  */
 #include <string.h>
@@ -45,40 +42,31 @@
  */
 #include <mctp.h>
 #include <ptrqueue.h>
-#include <timeutils.h>
 #include <cxlstate.h>
 #include "signals.h"
 
 #include "options.h"
 
+#include "trace.h"
+
+#include "logger.h"
+
+#include "metrics.h"
+
 #include "state.h"
 
+#include "bgop.h"
+
+#include "events.h"
+
+#include "cache.h"
+
 #include <fmapi.h>
 
 #include "fmapi_handler.h"
 
 /* MACROS ====================================================================*/
 
-#ifdef CSE_VERBOSE
- #define INIT 			unsigned step = 0;
- #define ENTER 					if (opts[CLOP_VERBOSITY].u64 & CLVB_CALLSTACK) 	printf("%d:%s Enter\n", 			gettid(), __FUNCTION__);
- #define STEP 			step++; if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u\n", 			gettid(), __FUNCTION__, step);
- #define HEX32(m, i)			if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u %s: 0x%x\n",	gettid(), __FUNCTION__, step, m, i);
- #define INT32(m, i)			if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u %s: %d\n",	gettid(), __FUNCTION__, step, m, i);
- #define EXIT(rc) 				if (opts[CLOP_VERBOSITY].u64 & CLVB_CALLSTACK) 	printf("%d:%s Exit: %d\n", 			gettid(), __FUNCTION__,rc);
-#else
- #define ENTER
- #define EXIT(rc)
- #define STEP
- #define HEX32(m, i)
- #define INT32(m, i)
- #define INIT 
-#endif // CSE_VERBOSE
-
-#define IFV(u) 					if (opts[CLOP_VERBOSITY].u64 & u) 
-
-#define ISO_TIME_BUF_LEN		32
-
 /* ENUMERATIONS ==============================================================*/
 
 /* STRUCTS ===================================================================*/
@@ -94,33 +82,31 @@
  *
  * @param m 	struct mctp* 
  * @param mm 	struct mctp_msg* 
+ * @param req 	struct fmapi_msg* holding the decoded request
  * @return 		0 upon success, 1 otherwise
  *
  * STEPS
  *  1: Initialize variables
- *  2: Checkout Response mctp_msg buffer
+ *  2: Verify Response mctp_msg buffer
  *  3: Fill Response MCTP Header
- *  4: Set buffer pointers 
- *  5: Deserialize Request Header
- *  6: Deserialize Request Object 
- *  7: Extract parameters
- *  8: Obtain lock on switch state 
- *  9: Validate Inputs 
- * 10: Perform Action 
- * 11: Prepare Response Object
- * 12: Serialize Response Object
- * 13: Set return code
- * 14: Release lock on switch state 
- * 15: Fill Response Header
- * 16: Serialize Header 
- * 17: Push Response mctp_msg onto Transmit Message Queue 
- * 18: Checkin mctp_msgs 
+ *  4: Set response buffer pointer 
+ *  5: Extract parameters
+ *  6: Obtain lock on VCS 
+ *  7: Validate Inputs 
+ *  8: Perform Action 
+ *  9: Prepare Response Object
+ * 10: Serialize Response Object
+ * 11: Set return code
+ * 12: Release lock on VCS 
+ * 13: Fill Response Header
+ * 14: Serialize Header 
+ * 15: Push Response mctp_msg onto Transmit Message Queue 
+ * 16: Checkin mctp_msgs 
  */
-int fmop_vsc_aer(struct mctp *m, struct mctp_action *ma)
+int fmop_vsc_aer(struct mctp *m, struct mctp_action *ma, struct fmapi_msg *req)
 {
 	INIT
-	char now[ISO_TIME_BUF_LEN];
-	struct fmapi_msg req, rsp;
+	struct fmapi_msg rsp;
 	
 	unsigned rc;
 	int rv, len;
@@ -130,13 +116,12 @@ int fmop_vsc_aer(struct mctp *m, struct mctp_action *ma)
 	ENTER
 
 	STEP // 1: Initialize variables
+	v = NULL;
 	rv = 1; 
 	len = 0;
 	rc = FMRC_INVALID_INPUT;
-	isotime(now, ISO_TIME_BUF_LEN);
 
-	STEP // 2: Get response mctp_msg buffer
-	ma->rsp = pq_pop(m->msgs, 1);
+	STEP // 2: Verify Response mctp_msg buffer was checked out by the dispatcher
 	if (ma->rsp == NULL)  
 		goto end;
 
@@ -144,66 +129,59 @@ int fmop_vsc_aer(struct mctp *m, struct mctp_action *ma)
 	mctp_fill_msg_hdr(ma->rsp, ma->req->src, m->state.eid, 0, ma->req->tag);
 	ma->rsp->type = ma->req->type;
 	
-	// 4: Set buffer pointers 
-	req.buf = (struct fmapi_buf*) ma->req->payload;
+	// 4: Set response buffer pointer 
 	rsp.buf = (struct fmapi_buf*) ma->rsp->payload;
 
-	STEP // 5: Deserialize Request Header
-	if ( fmapi_deserialize(&req.hdr, req.buf->hdr, FMOB_HDR, NULL) <= 0 )
-		goto end;
-
-	STEP // 6: Deserialize Request Object 
-	if ( fmapi_deserialize(&req.obj, req.buf->payload, fmapi_fmob_req(req.hdr.opcode), NULL) < 0 )
-		goto end;
-
-	STEP // 7: Extract parameters
-
-	IFV(CLVB_COMMANDS) printf("%s CMD: FM API VSC Generate AER Event. VCSID: %d vPPBID: %d\n", now, req.obj.vsc_aer_req.vcsid, req.obj.vsc_aer_req.vppbid);
+	STEP // 5: Extract parameters
 
-	STEP // 8: Obtain lock on switch state 
-	pthread_mutex_lock(&cxls->mtx);
+	IFV(CLVB_COMMANDS) logger_printf("CMD: FM API VSC Generate AER Event. VCSID: %d vPPBID: %d\n", req->obj.vsc_aer_req.vcsid, req->obj.vsc_aer_req.vppbid);
 
-	STEP // 9: Validate Inputs 
-	if (req.obj.vsc_aer_req.vcsid >= cxls->num_vcss) 
+	STEP // 6: Obtain lock on VCS 
+	if (req->obj.vsc_aer_req.vcsid >= cxls->num_vcss) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Requested VCSID exceeds number of VCSs present. Requested VCSID: %d Present: %d\n", now, req.obj.vsc_aer_req.vcsid, cxls->num_vcss);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Requested VCSID exceeds number of VCSs present. Requested VCSID: %d Present: %d\n", req->obj.vsc_aer_req.vcsid, cxls->num_vcss);
 		goto send;
 	}
-	v = &cxls->vcss[req.obj.vsc_aer_req.vcsid];
+	v = &cxls->vcss[req->obj.vsc_aer_req.vcsid];
+	state_lock_vcs(req->obj.vsc_aer_req.vcsid);
+
+	STEP // 7: Validate Inputs 
 
 	// Validate vppbid 
-	if (req.obj.vsc_aer_req.vppbid >= v->num) 
+	if (req->obj.vsc_aer_req.vppbid >= v->num) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Requested vPPBID exceeds number of vPPBs present in requested VCS. Requested vPPBID: %d Present: %d\n", now, req.obj.vsc_aer_req.vppbid, v->num);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Requested vPPBID exceeds number of vPPBs present in requested VCS. Requested vPPBID: %d Present: %d\n", req->obj.vsc_aer_req.vppbid, v->num);
 		goto send;
 	}
 
-	STEP // 10: Perform Action 
-	IFV(CLVB_ACTIONS) printf("%s ACT: Generating AER on VSCID: %d vPPBID: %d Error: 0x%08x\n", now, req.obj.vsc_aer_req.vcsid, req.obj.vsc_aer_req.vppbid, req.obj.vsc_aer_req.error_type);
+	STEP // 8: Perform Action 
+	IFV(CLVB_ACTIONS) logger_printf("ACT: Generating AER on VSCID: %d vPPBID: %d Error: 0x%08x\n", req->obj.vsc_aer_req.vcsid, req->obj.vsc_aer_req.vppbid, req->obj.vsc_aer_req.error_type);
 
-	STEP // 11: Prepare Response Object
+	STEP // 9: Prepare Response Object
 
-	STEP // 12: Serialize Response Object
-	len = fmapi_serialize(rsp.buf->payload, &rsp.obj, fmapi_fmob_rsp(req.hdr.opcode));
+	STEP // 10: Serialize Response Object
+	len = fmapi_serialize(rsp.buf->payload, &rsp.obj, fmapi_fmob_rsp(req->hdr.opcode));
 
-	STEP // 13: Set return code
+	STEP // 11: Set return code
 	rc = FMRC_SUCCESS;
 
 send:
 
-	STEP // 14: Release lock on switch state 
-	pthread_mutex_unlock(&cxls->mtx);
+	STEP // 12: Release lock on VCS 
+	if (v != NULL)
+		state_unlock_vcs(req->obj.vsc_aer_req.vcsid);
 
 	if (len < 0)
 		goto end;
 
-	STEP // 15: Fill Response Header
-	ma->rsp->len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, req.hdr.tag, req.hdr.opcode, 0, len, rc, 0);
+	STEP // 13: Fill Response Header
+	metrics_rc(rc);
+	ma->rsp->len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, req->hdr.tag, req->hdr.opcode, 0, len, rc, 0);
 
-	STEP // 16: Serialize Header 
+	STEP // 14: Serialize Header 
 	fmapi_serialize(rsp.buf->hdr, &rsp.hdr, FMOB_HDR);
 
-	STEP // 17: Push mctp_action onto queue 
+	STEP // 15: Push mctp_action onto queue 
 	pq_push(m->tmq, ma);
 
 	rv = 0;
@@ -220,33 +198,31 @@ end:
  *
  * @param m 	struct mctp* 
  * @param mm 	struct mctp_msg* 
+ * @param req 	struct fmapi_msg* holding the decoded request
  * @return 		0 upon success, 1 otherwise
  *
  * STEPS
  *  1: Initialize variables
- *  2: Checkout Response mctp_msg buffer
+ *  2: Verify Response mctp_msg buffer
  *  3: Fill Response MCTP Header
- *  4: Set buffer pointers 
- *  5: Deserialize Request Header
- *  6: Deserialize Request Object 
- *  7: Extract parameters
- *  8: Obtain lock on switch state 
- *  9: Validate Inputs 
- * 10: Perform Action 
- * 11: Prepare Response Object
- * 12: Serialize Response Object
- * 13: Set return code
- * 14: Release lock on switch state 
- * 15: Fill Response Header
- * 16: Serialize Header 
- * 17: Push Response mctp_msg onto Transmit Message Queue 
- * 18: Checkin mctp_msgs 
+ *  4: Set response buffer pointer 
+ *  5: Extract parameters
+ *  6: Obtain lock on switch state 
+ *  7: Validate Inputs 
+ *  8: Perform Action 
+ *  9: Prepare Response Object
+ * 10: Serialize Response Object
+ * 11: Set return code
+ * 12: Release lock on switch state 
+ * 13: Fill Response Header
+ * 14: Serialize Header 
+ * 15: Push Response mctp_msg onto Transmit Message Queue 
+ * 16: Checkin mctp_msgs 
  */
-int fmop_vsc_bind(struct mctp *m, struct mctp_action *ma)
+int fmop_vsc_bind(struct mctp *m, struct mctp_action *ma, struct fmapi_msg *req)
 {
 	INIT
-	char now[ISO_TIME_BUF_LEN];
-	struct fmapi_msg req, rsp;
+	struct fmapi_msg rsp;
 	
 	unsigned rc;
 	int rv, len;
@@ -254,17 +230,18 @@ int fmop_vsc_bind(struct mctp *m, struct mctp_action *ma)
 	struct cxl_vcs *v;
 	struct cxl_vppb *b;
 	struct cxl_port *p;
+	struct bgop op;
 
 	ENTER
 
 	STEP // 1: Initialize variables
+	v = NULL;
+	p = NULL;
 	rv = 1; 
 	len = 0;
 	rc = FMRC_INVALID_INPUT;
-	isotime(now, ISO_TIME_BUF_LEN);
 
-	STEP // 2: Get response mctp_msg buffer
-	ma->rsp = pq_pop(m->msgs, 1);
+	STEP // 2: Verify Response mctp_msg buffer was checked out by the dispatcher
 	if (ma->rsp == NULL)  
 		goto end;
 
@@ -272,161 +249,165 @@ int fmop_vsc_bind(struct mctp *m, struct mctp_action *ma)
 	mctp_fill_msg_hdr(ma->rsp, ma->req->src, m->state.eid, 0, ma->req->tag);
 	ma->rsp->type = ma->req->type;
 	
-	// 4: Set buffer pointers 
-	req.buf = (struct fmapi_buf*) ma->req->payload;
+	// 4: Set response buffer pointer 
 	rsp.buf = (struct fmapi_buf*) ma->rsp->payload;
 
-	STEP // 5: Deserialize Request Header
-	if ( fmapi_deserialize(&req.hdr, req.buf->hdr, FMOB_HDR, NULL) <= 0 )
-		goto end;
-
-	STEP // 6: Deserialize Request Object 
-	if ( fmapi_deserialize(&req.obj, req.buf->payload, fmapi_fmob_req(req.hdr.opcode), NULL) < 0 )
-		goto end;
-
-	STEP // 7: Extract parameters
+	STEP // 5: Extract parameters
 
-	IFV(CLVB_COMMANDS) printf("%s CMD: FM API VSC Bind vPPB. VCSID: %d vPPBID: %d PPID: %d LDID: 0x%04x\n", now, req.obj.vsc_bind_req.vcsid, req.obj.vsc_bind_req.vppbid, req.obj.vsc_bind_req.ppid, req.obj.vsc_bind_req.ldid);
+	IFV(CLVB_COMMANDS) logger_printf("CMD: FM API VSC Bind vPPB. VCSID: %d vPPBID: %d PPID: %d LDID: 0x%04x\n", req->obj.vsc_bind_req.vcsid, req->obj.vsc_bind_req.vppbid, req->obj.vsc_bind_req.ppid, req->obj.vsc_bind_req.ldid);
 
-	STEP // 8: Obtain lock on switch state 
-	pthread_mutex_lock(&cxls->mtx);
+	STEP // 6: Obtain lock on switch state 
+	state_lock_topology();
+	state_lock_id(1);
 
-	STEP // 9: Validate Inputs 
+	STEP // 7: Validate Inputs 
 
 	// Validate vcsid
-	if (req.obj.vsc_bind_req.vcsid >= cxls->num_vcss) 
+	if (req->obj.vsc_bind_req.vcsid >= cxls->num_vcss) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: VCS ID out of range. VCSID: %d\n", now, req.obj.vsc_bind_req.vcsid);
+		IFV(CLVB_ERRORS) logger_printf("ERR: VCS ID out of range. VCSID: %d\n", req->obj.vsc_bind_req.vcsid);
 		goto send; 
 	}
-	v = &cxls->vcss[req.obj.vsc_bind_req.vcsid];
+	v = &cxls->vcss[req->obj.vsc_bind_req.vcsid];
+	state_lock_vcs(req->obj.vsc_bind_req.vcsid);
 	
 	// Validate vppbid 
-	if (req.obj.vsc_bind_req.vppbid >= cxls->vcss[req.obj.vsc_bind_req.vcsid].num) 
+	if (req->obj.vsc_bind_req.vppbid >= cxls->vcss[req->obj.vsc_bind_req.vcsid].num) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: vPPB ID out of range. vPPBID: %d\n", now, req.obj.vsc_bind_req.vppbid);
+		IFV(CLVB_ERRORS) logger_printf("ERR: vPPB ID out of range. vPPBID: %d\n", req->obj.vsc_bind_req.vppbid);
 		goto send;
 	}
-	b = &v->vppbs[req.obj.vsc_bind_req.vppbid];
+	b = &v->vppbs[req->obj.vsc_bind_req.vppbid];
 
 	// Validate port id 
-	if (req.obj.vsc_bind_req.ppid >= cxls->num_ports)
+	if (req->obj.vsc_bind_req.ppid >= cxls->num_ports)
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: PPID ID out of range. PPID: %d\n", now, req.obj.vsc_bind_req.ppid);
+		IFV(CLVB_ERRORS) logger_printf("ERR: PPID ID out of range. PPID: %d\n", req->obj.vsc_bind_req.ppid);
 		goto send;
 	}
-	p = &cxls->ports[req.obj.vsc_bind_req.ppid];	
+	p = &cxls->ports[req->obj.vsc_bind_req.ppid];	
+	state_lock_port(p->ppid);
 
 	// Check bindability to this port 
 
 	// Check state of port
 	if (p->state == FMPS_DISABLED)
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Port is in a disabled state. PPID: %d State: %s\n", now, req.obj.vsc_bind_req.ppid, fmps(p->state));
+		IFV(CLVB_ERRORS) logger_printf("ERR: Port is in a disabled state. PPID: %d State: %s\n", req->obj.vsc_bind_req.ppid, fmps(p->state));
 		goto send;
 	}
 
 	// If an LD is specified, check if the port is connected to a Type-3 Devices 
-	if (req.obj.vsc_bind_req.ldid != 0xFFFF && !(p->dt == FMDT_CXL_TYPE_3 || p->dt == FMDT_CXL_TYPE_3_POOLED) ) 
+	if (req->obj.vsc_bind_req.ldid != 0xFFFF && !(p->dt == FMDT_CXL_TYPE_3 || p->dt == FMDT_CXL_TYPE_3_POOLED) ) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Bind to an MLD LD requested and specified port is not attached to a Type 3 Device\n", now);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Bind to an MLD LD requested and specified port is not attached to a Type 3 Device\n");
 		goto send;
 	}
 
 	// If port is an MLD port, an LDID must be specified 
-	if (p->ld > 0 && req.obj.vsc_bind_req.ldid == 0xFFFF)
+	if (p->ld > 0 && req->obj.vsc_bind_req.ldid == 0xFFFF)
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Cannot bind to the physical port of an MLD device\n", now);
+		IFV(CLVB_ERRORS) logger_printf("ERR: Cannot bind to the physical port of an MLD device\n");
 		goto send;
 	}
 
 	// If an LD is specified, check if the port can support multiple LDs 
-	if (req.obj.vsc_bind_req.ldid != 0xFFFF && p->ld == 0) 
+	if (req->obj.vsc_bind_req.ldid != 0xFFFF && p->ld == 0) 
+	{
+		IFV(CLVB_ERRORS) logger_printf("ERR: Specified port does not support multiple Logical Devices: \n");
+		goto send;
+	}
+
+	// If an LD is specified, check it exists on the port 
+	if (req->obj.vsc_bind_req.ldid != 0xFFFF && req->obj.vsc_bind_req.ldid >= p->ld) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Specified port does not support multiple Logical Devices: \n", now);
+		IFV(CLVB_ERRORS) logger_printf("ERR: LD ID out of range. LDID: %d Total: %d\n", req->obj.vsc_bind_req.ldid, p->ld);
 		goto send;
 	}
 
 	// Check if vPPB is aleady bound
 	if (b->bind_status != FMBS_UNBOUND) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Specified vPPB is not available to be bound. vPPBID: %d STATUS: %s\n", now, req.obj.vsc_bind_req.vppbid, fmbs(b->bind_status));
+		IFV(CLVB_ERRORS) logger_printf("ERR: Specified vPPB is not available to be bound. vPPBID: %d STATUS: %s\n", req->obj.vsc_bind_req.vppbid, fmbs(b->bind_status));
 		goto send;
 	}
 
-	// Check if this physical port is already bound to a vppb
-	for ( int i = 0 ; i < cxls->num_vcss ; i++ )
+	// Check if this physical port or LD is already bound to a vppb
+	if (state_binds_busy(p->ppid, req->obj.vsc_bind_req.ldid))
 	{
-		struct cxl_vcs *vcs = &cxls->vcss[i];
-		for ( int k = 0 ; k < vcs->num ; k++ )
-		{
-			struct cxl_vppb *vppb = &vcs->vppbs[k];
-			if ( vppb->ppid == p->ppid )
-			{
-				IFV(CLVB_ERRORS) printf("%s ERR: Specified PPID is already bound. PPBID: %d\n", now, req.obj.vsc_bind_req.ppid);
-				goto send;
-			}
-		}
+		IFV(CLVB_ERRORS) logger_printf("ERR: Specified PPID is already bound. PPBID: %d\n", req->obj.vsc_bind_req.ppid);
+		goto send;
 	}
 
-	STEP // 10: Perform Action 
+	STEP // 8: Perform Action 
+
+	// Start the background operation, the port becomes a DSP once the slot is powered
+	op.opcode = req->hdr.opcode;
+	op.ppid = p->ppid;
+	op.power = (opts[CLOP_QEMU].set == 1) ? BGPW_ON : BGPW_NONE;
+	op.set_state = 1;
+	op.state = FMPS_DSP;
+	op.event = EVTY_BIND;
+	op.undo = 1;
+	op.vcsid = v->vcsid;
+	op.vppbid = req->obj.vsc_bind_req.vppbid;
+	op.prev = p->state;
+	rc = bgop_start(&op);
+	if (rc != FMRC_BACKGROUND_OP_STARTED)
+	{
+		IFV(CLVB_ERRORS) logger_printf("ERR: Could not start background operation. RC: %d\n", rc);
+		goto send;
+	}
 
-	IFV(CLVB_ACTIONS) printf("%s ACT: Binding VCSID: %d vPPBID: %d PPID: %d LDID: 0x%04x\n", now, req.obj.vsc_bind_req.vcsid, req.obj.vsc_bind_req.vppbid, req.obj.vsc_bind_req.ppid, req.obj.vsc_bind_req.ldid);
+	IFV(CLVB_ACTIONS) logger_printf("ACT: Binding VCSID: %d vPPBID: %d PPID: %d LDID: 0x%04x\n", req->obj.vsc_bind_req.vcsid, req->obj.vsc_bind_req.vppbid, req->obj.vsc_bind_req.ppid, req->obj.vsc_bind_req.ldid);
 
-	if (req.obj.vsc_bind_req.ldid != 0xFFFF) 
+	if (req->obj.vsc_bind_req.ldid != 0xFFFF) 
 	{
 		b->bind_status = FMBS_BOUND_LD;
-		b->ppid = req.obj.vsc_bind_req.ppid;
-		b->ldid = req.obj.vsc_bind_req.ldid;
+		b->ppid = req->obj.vsc_bind_req.ppid;
+		b->ldid = req->obj.vsc_bind_req.ldid;
 	}
 	else 
 	{
 		b->bind_status = FMBS_BOUND_PORT;
-		b->ppid = req.obj.vsc_bind_req.ppid;
+		b->ppid = req->obj.vsc_bind_req.ppid;
 		b->ldid = 0;
 	}
+	state_binds_add(v->vcsid, b);
 
-	STEP // 6: Set port state to be a downstream port
-	p->state = FMPS_DSP;
+	// Port is binding until the background operation completes
+	p->state = FMPS_BINDING;
+	state_gen_bump(STATE_GEN_PORT, p->ppid);
+	state_gen_bump(STATE_GEN_VCS, v->vcsid);
 
-	// Update Background Operation Status
-	cxls->bos_running = 0;
-	cxls->bos_pcnt = 100;
-	cxls->bos_opcode = req.hdr.opcode;
-	cxls->bos_rc = FMRC_SUCCESS;
-	cxls->bos_ext = 0;
+	STEP // 9: Prepare Response Object
 
-	// If QEMU, enable power to physical device 
-	if ( opts[CLOP_QEMU].set == 1 )
-	{
-		char cmd[64];
-		sprintf(cmd, "echo 1 > /sys/bus/pci/slots/%d/power", p->ppid);
-		rv = system(cmd);
-	}
+	STEP // 10: Serialize Response Object
+	len = fmapi_serialize(rsp.buf->payload, &rsp.obj, fmapi_fmob_rsp(req->hdr.opcode));
 
-	STEP // 11: Prepare Response Object
-
-	STEP // 12: Serialize Response Object
-	len = fmapi_serialize(rsp.buf->payload, &rsp.obj, fmapi_fmob_rsp(req.hdr.opcode));
-
-	STEP // 13: Set return code
-	rc = FMRC_BACKGROUND_OP_STARTED;
+	STEP // 11: Set return code
 
 send:
 
-	STEP // 14: Release lock on switch state 
-	pthread_mutex_unlock(&cxls->mtx);
+	STEP // 12: Release lock on switch state 
+	if (p != NULL)
+		state_unlock_port(p->ppid);
+	if (v != NULL)
+		state_unlock_vcs(v->vcsid);
+	state_unlock_id();
+	state_unlock_topology();
 
 	if (len < 0)
 		goto end;
 
-	STEP // 15: Fill Response Header
-	ma->rsp->len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, req.hdr.tag, req.hdr.opcode, 0, len, rc, 0);
+	STEP // 13: Fill Response Header
+	metrics_rc(rc);
+	ma->rsp->len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, req->hdr.tag, req->hdr.opcode, 0, len, rc, 0);
 
-	STEP // 16: Serialize Header 
+	STEP // 14: Serialize Header 
 	fmapi_serialize(rsp.buf->hdr, &rsp.hdr, FMOB_HDR);
 
-	STEP // 17: Push mctp_action onto queue 
+	STEP // 15: Push mctp_action onto queue 
 	pq_push(m->tmq, ma);
 
 	rv = 0;
@@ -443,33 +424,31 @@ end:
  *
  * @param m 	struct mctp* 
  * @param mm 	struct mctp_msg* 
+ * @param req 	struct fmapi_msg* holding the decoded request
  * @return 		0 upon success, 1 otherwise
  *
  * STEPS
  *  1: Initialize variables
- *  2: Checkout Response mctp_msg buffer
+ *  2: Verify Response mctp_msg buffer
  *  3: Fill Response MCTP Header
- *  4: Set buffer pointers 
- *  5: Deserialize Request Header
- *  6: Deserialize Request Object 
- *  7: Extract parameters
- *  8: Obtain lock on switch state 
- *  9: Validate Inputs 
- * 10: Perform Action 
- * 11: Prepare Response Object
- * 12: Serialize Response Object
- * 13: Set return code
- * 14: Release lock on switch state 
- * 15: Fill Response Header
- * 16: Serialize Header 
- * 17: Push Response mctp_msg onto Transmit Message Queue 
- * 18: Checkin mctp_msgs 
+ *  4: Set response buffer pointer 
+ *  5: Extract parameters
+ *  6: Obtain lock on switch state 
+ *  7: Validate Inputs 
+ *  8: Perform Action 
+ *  9: Prepare Response Object
+ * 10: Serialize Response Object
+ * 11: Set return code
+ * 12: Release lock on switch state 
+ * 13: Fill Response Header
+ * 14: Serialize Header 
+ * 15: Push Response mctp_msg onto Transmit Message Queue 
+ * 16: Checkin mctp_msgs 
  */
-int fmop_vsc_info(struct mctp *m, struct mctp_action *ma)
+int fmop_vsc_info(struct mctp *m, struct mctp_action *ma, struct fmapi_msg *req)
 {
 	INIT
-	char now[ISO_TIME_BUF_LEN];
-	struct fmapi_msg req, rsp;
+	struct fmapi_msg rsp;
 	
 	unsigned rc;
 	int rv, len;
@@ -478,6 +457,9 @@ int fmop_vsc_info(struct mctp *m, struct mctp_action *ma)
 	unsigned i, k, stop, vppbid_start, vppbid_limit;
 	struct fmapi_vsc_info_blk *blk;
 	__u8 id;
+	__u64 gen;
+	__u8 *key;
+	unsigned keylen;
 
 	ENTER
 
@@ -485,10 +467,8 @@ int fmop_vsc_info(struct mctp *m, struct mctp_action *ma)
 	rv = 1; 
 	len = 0;
 	rc = FMRC_INVALID_INPUT;
-	isotime(now, ISO_TIME_BUF_LEN);
 
-	STEP // 2: Get response mctp_msg buffer
-	ma->rsp = pq_pop(m->msgs, 1);
+	STEP // 2: Verify Response mctp_msg buffer was checked out by the dispatcher
 	if (ma->rsp == NULL)  
 		goto end;
 
@@ -496,36 +476,41 @@ int fmop_vsc_info(struct mctp *m, struct mctp_action *ma)
 	mctp_fill_msg_hdr(ma->rsp, ma->req->src, m->state.eid, 0, ma->req->tag);
 	ma->rsp->type = ma->req->type;
 	
-	// 4: Set buffer pointers 
-	req.buf = (struct fmapi_buf*) ma->req->payload;
+	// 4: Set response buffer pointer 
 	rsp.buf = (struct fmapi_buf*) ma->rsp->payload;
 
-	STEP // 5: Deserialize Request Header
-	if ( fmapi_deserialize(&req.hdr, req.buf->hdr, FMOB_HDR, NULL) <= 0 )
-		goto end;
+	STEP // 5: Extract parameters
 
-	STEP // 6: Deserialize Request Object 
-	if ( fmapi_deserialize(&req.obj, req.buf->payload, fmapi_fmob_req(req.hdr.opcode), NULL) < 0 )
-		goto end;
+	IFV(CLVB_COMMANDS) logger_printf("CMD: FM API VSC Get Virtual Switch Info. Num: %d\n", req->obj.vsc_info_req.num);
 
-	STEP // 7: Extract parameters
+	// Reuse the last response to the same request if none of its VCSs changed
+	key = ((struct fmapi_buf*) ma->req->payload)->payload;
+	keylen = req->hdr.len;
+	for ( i = 0, gen = 0 ; i < req->obj.vsc_info_req.num ; i++ ) 
+		gen += state_gen(STATE_GEN_VCS, req->obj.vsc_info_req.vcss[i]);
 
-	IFV(CLVB_COMMANDS) printf("%s CMD: FM API VSC Get Virtual Switch Info. Num: %d\n", now, req.obj.vsc_info_req.num);
+	len = cache_get(CAAPI_FM, req->hdr.opcode, key, keylen, gen, rsp.buf->payload, NULL);
+	if (len >= 0)
+	{
+		rc = FMRC_SUCCESS;
+		goto cached;
+	}
+	len = 0;
 
-	STEP // 8: Obtain lock on switch state 
-	pthread_mutex_lock(&cxls->mtx);
+	STEP // 6: Obtain lock on switch state 
+	// VCS locks are obtained one at a time in step 11 
 
-	STEP // 9: Validate Inputs 
+	STEP // 7: Validate Inputs 
 
-	STEP // 10: Perform Action 
+	STEP // 8: Perform Action 
 
-	STEP // 11: Prepare Response Object
+	STEP // 9: Prepare Response Object
 	rsp.obj.vsc_info_rsp.num = 0;
-	vppbid_start = req.obj.vsc_info_req.vppbid_start;
-	vppbid_limit = req.obj.vsc_info_req.vppbid_limit; 
-	for ( i = 0 ; i < req.obj.vsc_info_req.num ; i++ ) 
+	vppbid_start = req->obj.vsc_info_req.vppbid_start;
+	vppbid_limit = req->obj.vsc_info_req.vppbid_limit; 
+	for ( i = 0 ; i < req->obj.vsc_info_req.num ; i++ ) 
 	{
-		id = req.obj.vsc_info_req.vcss[i];
+		id = req->obj.vsc_info_req.vcss[i];
 
 		// Break, if we have reached the maximum number of VCS entities that can be returned 
 		if (i >= FM_MAX_VCS_PER_RSP)
@@ -539,6 +524,8 @@ int fmop_vsc_info(struct mctp *m, struct mctp_action *ma)
 		v = &cxls->vcss[id];	// The struct vcs to copy from 
 		blk = &rsp.obj.vsc_info_rsp.list[i];			// The struct fmapi_vcs_info_blk to copy into
 
+		state_lock_vcs(id);
+
 		// Zero out destination
 		memset(blk, 0, sizeof(*blk));
 	
@@ -556,35 +543,41 @@ int fmop_vsc_info(struct mctp *m, struct mctp_action *ma)
 
 		// Variable array of PPB Status Blocks
 		for ( k = vppbid_start ; k < stop ; k++ ) {
-			blk->list[k].status 	= v->vppbs[k].bind_status;
-			blk->list[k].ppid 		= v->vppbs[k].ppid;
-			blk->list[k].ldid 		= v->vppbs[k].ldid;
+			blk->list[blk->num].status 	= v->vppbs[k].bind_status;
+			blk->list[blk->num].ppid 	= v->vppbs[k].ppid;
+			blk->list[blk->num].ldid 	= v->vppbs[k].ldid;
 			blk->num++;
 		}
+
+		state_unlock_vcs(id);
+
 		rsp.obj.vsc_info_rsp.num++;
 	}
 
-	STEP // 12: Serialize Response Object
-	len = fmapi_serialize(rsp.buf->payload, &rsp.obj, fmapi_fmob_rsp(req.hdr.opcode));
+	STEP // 10: Serialize Response Object
+	len = fmapi_serialize(rsp.buf->payload, &rsp.obj, fmapi_fmob_rsp(req->hdr.opcode));
+	if (len >= 0)
+		cache_put(CAAPI_FM, req->hdr.opcode, key, keylen, gen, rsp.buf->payload, len, 0);
 
-	STEP // 13: Set return code
+	STEP // 11: Set return code
 	rc = FMRC_SUCCESS;
 
-//send:
+cached:
 
-	STEP // 14: Release lock on switch state 
-	pthread_mutex_unlock(&cxls->mtx);
+	STEP // 12: Release lock on switch state 
+	// VCS locks were released in step 11 
 
 	if (len < 0)
 		goto end;
 
-	STEP // 15: Fill Response Header
-	ma->rsp->len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, req.hdr.tag, req.hdr.opcode, 0, len, rc, 0);
+	STEP // 13: Fill Response Header
+	metrics_rc(rc);
+	ma->rsp->len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, req->hdr.tag, req->hdr.opcode, 0, len, rc, 0);
 
-	STEP // 16: Serialize Header 
+	STEP // 14: Serialize Header 
 	fmapi_serialize(rsp.buf->hdr, &rsp.hdr, FMOB_HDR);
 
-	STEP // 17: Push mctp_action onto queue 
+	STEP // 15: Push mctp_action onto queue 
 	pq_push(m->tmq, ma);
 
 	rv = 0;
@@ -601,33 +594,31 @@ end:
  *
  * @param m 	struct mctp* 
  * @param mm 	struct mctp_msg* 
+ * @param req 	struct fmapi_msg* holding the decoded request
  * @return 		0 upon success, 1 otherwise
  *
  * STEPS
  *  1: Initialize variables
- *  2: Checkout Response mctp_msg buffer
+ *  2: Verify Response mctp_msg buffer
  *  3: Fill Response MCTP Header
- *  4: Set buffer pointers 
- *  5: Deserialize Request Header
- *  6: Deserialize Request Object 
- *  7: Extract parameters
- *  8: Obtain lock on switch state 
- *  9: Validate Inputs 
- * 10: Perform Action 
- * 11: Prepare Response Object
- * 12: Serialize Response Object
- * 13: Set return code
- * 14: Release lock on switch state 
- * 15: Fill Response Header
- * 16: Serialize Header 
- * 17: Push Response mctp_msg onto Transmit Message Queue 
- * 18: Checkin mctp_msgs 
+ *  4: Set response buffer pointer 
+ *  5: Extract parameters
+ *  6: Obtain lock on switch state 
+ *  7: Validate Inputs 
+ *  8: Perform Action 
+ *  9: Prepare Response Object
+ * 10: Serialize Response Object
+ * 11: Set return code
+ * 12: Release lock on switch state 
+ * 13: Fill Response Header
+ * 14: Serialize Header 
+ * 15: Push Response mctp_msg onto Transmit Message Queue 
+ * 16: Checkin mctp_msgs 
  */
-int fmop_vsc_unbind(struct mctp *m, struct mctp_action *ma)
+int fmop_vsc_unbind(struct mctp *m, struct mctp_action *ma, struct fmapi_msg *req)
 {
 	INIT
-	char now[ISO_TIME_BUF_LEN];
-	struct fmapi_msg req, rsp;
+	struct fmapi_msg rsp;
 	
 	unsigned rc;
 	int rv, len;
@@ -635,17 +626,18 @@ int fmop_vsc_unbind(struct mctp *m, struct mctp_action *ma)
 	struct cxl_vcs *v;
 	struct cxl_vppb *b;
 	struct cxl_port *p;
+	struct bgop op;
 
 	ENTER
 
 	STEP // 1: Initialize variables
+	v = NULL;
+	p = NULL;
 	rv = 1; 
 	len = 0;
 	rc = FMRC_INVALID_INPUT;
-	isotime(now, ISO_TIME_BUF_LEN);
 
-	STEP // 2: Get response mctp_msg buffer
-	ma->rsp = pq_pop(m->msgs, 1);
+	STEP // 2: Verify Response mctp_msg buffer was checked out by the dispatcher
 	if (ma->rsp == NULL)  
 		goto end;
 
@@ -653,114 +645,119 @@ int fmop_vsc_unbind(struct mctp *m, struct mctp_action *ma)
 	mctp_fill_msg_hdr(ma->rsp, ma->req->src, m->state.eid, 0, ma->req->tag);
 	ma->rsp->type = ma->req->type;
 	
-	// 4: Set buffer pointers 
-	req.buf = (struct fmapi_buf*) ma->req->payload;
+	// 4: Set response buffer pointer 
 	rsp.buf = (struct fmapi_buf*) ma->rsp->payload;
 
-	STEP // 5: Deserialize Request Header
-	if ( fmapi_deserialize(&req.hdr, req.buf->hdr, FMOB_HDR, NULL) <= 0 )
-		goto end;
-
-	STEP // 6: Deserialize Request Object 
-	if ( fmapi_deserialize(&req.obj, req.buf->payload, fmapi_fmob_req(req.hdr.opcode), NULL) < 0 )
-		goto end;
-
-	STEP // 7: Extract parameters
+	STEP // 5: Extract parameters
 
-	IFV(CLVB_COMMANDS) printf("%s CMD: FM API VSC Unbind vPPB. VCSID: %d vPPBID: %d\n", now, req.obj.vsc_unbind_req.vcsid, req.obj.vsc_unbind_req.vppbid);
+	IFV(CLVB_COMMANDS) logger_printf("CMD: FM API VSC Unbind vPPB. VCSID: %d vPPBID: %d\n", req->obj.vsc_unbind_req.vcsid, req->obj.vsc_unbind_req.vppbid);
 
-	STEP // 8: Obtain lock on switch state 
-	pthread_mutex_lock(&cxls->mtx);
+	STEP // 6: Obtain lock on switch state 
+	state_lock_topology();
+	state_lock_id(1);
 
-	STEP // 9: Validate Inputs 
+	STEP // 7: Validate Inputs 
 
 	// Validate vcsid
-	if (req.obj.vsc_unbind_req.vcsid >= cxls->num_vcss) 
+	if (req->obj.vsc_unbind_req.vcsid >= cxls->num_vcss) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: VCS ID out of range. VCSID: %d\n", now, req.obj.vsc_unbind_req.vcsid);
+		IFV(CLVB_ERRORS) logger_printf("ERR: VCS ID out of range. VCSID: %d\n", req->obj.vsc_unbind_req.vcsid);
 		goto send; 
 	}
-	v = &cxls->vcss[req.obj.vsc_unbind_req.vcsid];
+	v = &cxls->vcss[req->obj.vsc_unbind_req.vcsid];
+	state_lock_vcs(req->obj.vsc_unbind_req.vcsid);
 	
 	// Validate vppbid 
-	if (req.obj.vsc_unbind_req.vppbid >= cxls->vcss[req.obj.vsc_unbind_req.vcsid].num) 
+	if (req->obj.vsc_unbind_req.vppbid >= cxls->vcss[req->obj.vsc_unbind_req.vcsid].num) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: vPPB ID out of range. vPPBID: %d\n", now, req.obj.vsc_unbind_req.vppbid);
+		IFV(CLVB_ERRORS) logger_printf("ERR: vPPB ID out of range. vPPBID: %d\n", req->obj.vsc_unbind_req.vppbid);
 		goto send;
 	}
-	b = &v->vppbs[req.obj.vsc_unbind_req.vppbid];
+	b = &v->vppbs[req->obj.vsc_unbind_req.vppbid];
 
 	// Validate bind status of vppb
 	if (b->bind_status == FMBS_UNBOUND || b->bind_status == FMBS_INPROGRESS) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: vPPB was not bound. vPPBID %d\n", now, req.obj.vsc_unbind_req.vppbid);
+		IFV(CLVB_ERRORS) logger_printf("ERR: vPPB was not bound. vPPBID %d\n", req->obj.vsc_unbind_req.vppbid);
 		goto send;
 	}
 
 	// Validate port id that the vppb was bound to  
 	if (b->ppid >= cxls->num_ports) 
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: PPID of bound port out of range. PPID: %d\n", now, b->ppid);
+		IFV(CLVB_ERRORS) logger_printf("ERR: PPID of bound port out of range. PPID: %d\n", b->ppid);
 		b->bind_status = FMBS_UNBOUND;
 		goto send;
 	}
 	p = &cxls->ports[b->ppid];	
+	state_lock_port(p->ppid);
 
 	// Check bindability to this port 
 
 	// Check state of port
 	if ( !(p->state == FMPS_BINDING || p->state == FMPS_UNBINDING || p->state == FMPS_USP || p->state == FMPS_DSP) )
 	{
-		IFV(CLVB_ERRORS) printf("%s ERR: Port is not in a bound state. PPID: %d State: %s\n", now, b->ppid, fmps(p->state));
+		IFV(CLVB_ERRORS) logger_printf("ERR: Port is not in a bound state. PPID: %d State: %s\n", b->ppid, fmps(p->state));
 		goto send;
 	}
 
-	STEP // 10: Perform Action 
+	STEP // 8: Perform Action 
+
+	// Start the background operation, the port returns to its state once the slot is powered off
+	op.opcode = req->hdr.opcode;
+	op.ppid = p->ppid;
+	op.power = (opts[CLOP_QEMU].set == 1) ? BGPW_OFF : BGPW_NONE;
+	op.set_state = 1;
+	op.state = p->state;
+	op.event = EVTY_UNBIND;
+	op.undo = 0;
+	rc = bgop_start(&op);
+	if (rc != FMRC_BACKGROUND_OP_STARTED)
+	{
+		IFV(CLVB_ERRORS) logger_printf("ERR: Could not start background operation. RC: %d\n", rc);
+		goto send;
+	}
 
-	IFV(CLVB_ACTIONS) printf("%s ACT: Unbinding VCSID: %d vPPBID: %d\n", now, req.obj.vsc_unbind_req.vcsid, req.obj.vsc_unbind_req.vppbid);
+	IFV(CLVB_ACTIONS) logger_printf("ACT: Unbinding VCSID: %d vPPBID: %d\n", req->obj.vsc_unbind_req.vcsid, req->obj.vsc_unbind_req.vppbid);
 
+	state_binds_remove(b);
 	b->bind_status = FMBS_UNBOUND;	
 	b->ppid = 0;
 	b->ldid = 0;
-	
-	// Update Background Operation Status
-	cxls->bos_running = 0;
-	cxls->bos_pcnt = 100;
-	cxls->bos_opcode = req.hdr.opcode;
-	cxls->bos_rc = FMRC_SUCCESS;
-	cxls->bos_ext = 0;
-
-	// If QEMU, disable power to physical device 
-	if ( opts[CLOP_QEMU].set == 1 )
-	{
-		char cmd[64];
-		sprintf(cmd, "echo 0 > /sys/bus/pci/slots/%d/power", p->ppid);
-		rv = system(cmd);
-	}
 
-	STEP // 11: Prepare Response Object
+	// Port is unbinding until the background operation completes
+	p->state = FMPS_UNBINDING;
+	state_gen_bump(STATE_GEN_PORT, p->ppid);
+	state_gen_bump(STATE_GEN_VCS, req->obj.vsc_unbind_req.vcsid);
+
+	STEP // 9: Prepare Response Object
 
-	STEP // 12: Serialize Response Object
-	len = fmapi_serialize(rsp.buf->payload, &rsp.obj, fmapi_fmob_rsp(req.hdr.opcode));
+	STEP // 10: Serialize Response Object
+	len = fmapi_serialize(rsp.buf->payload, &rsp.obj, fmapi_fmob_rsp(req->hdr.opcode));
 
-	STEP // 13: Set return code
-	rc = FMRC_BACKGROUND_OP_STARTED;
+	STEP // 11: Set return code
 
 send:
 
-	STEP // 14: Release lock on switch state 
-	pthread_mutex_unlock(&cxls->mtx);
+	STEP // 12: Release lock on switch state 
+	if (p != NULL)
+		state_unlock_port(p->ppid);
+	if (v != NULL)
+		state_unlock_vcs(v->vcsid);
+	state_unlock_id();
+	state_unlock_topology();
 
 	if (len < 0)
 		goto end;
 
-	STEP // 15: Fill Response Header
-	ma->rsp->len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, req.hdr.tag, req.hdr.opcode, 0, len, rc, 0);
+	STEP // 13: Fill Response Header
+	metrics_rc(rc);
+	ma->rsp->len = fmapi_fill_hdr(&rsp.hdr, FMMT_RESP, req->hdr.tag, req->hdr.opcode, 0, len, rc, 0);
 
-	STEP // 16: Serialize Header 
+	STEP // 14: Serialize Header 
 	fmapi_serialize(rsp.buf->hdr, &rsp.hdr, FMOB_HDR);
 
-	STEP // 17: Push mctp_action onto queue 
+	STEP // 15: Push mctp_action onto queue 
 	pq_push(m->tmq, ma);
 
 	rv = 0;
@@ -0,0 +1,803 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		harness.c
+ *
+ * @brief 		In-process microbenchmark of the FM API and EM API handlers
+ *
+ * @details 	Links the cse handler objects and calls fmapi_handler() and
+ * 				emapi_handler() directly with pre-built requests, with no TCP
+ * 				connection and no MCTP threads. Each harness thread gets its
+ * 				own struct mctp from mctp_init() that is never run, so the
+ * 				transmit and completion queues it owns are only filled by the
+ * 				handlers and drained by the thread right after each call. No
+ * 				worker threads are started so every request is serviced on
+ * 				the calling thread and the time measured is the handler path
+ * 				alone.
+ *
+ * 				The switch is loaded from a config file, or generated with a
+ * 				given number of ports, and several threads can run the same
+ * 				case at once on shared or separate ports to measure lock
+ * 				contention. For each case the client side latency is printed
+ * 				together with the lock wait and service time the dispatcher
+ * 				recorded for the opcode.
+ *
+ * 				Build with: make harness
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ */
+/* INCLUDES ==================================================================*/
+
+/* printf()
+ */
+#include <stdio.h>
+
+/* memset()
+ * strcmp()
+ */
+#include <string.h>
+
+/* calloc()
+ * free()
+ * strtoul()
+ * rand_r()
+ */
+#include <stdlib.h>
+
+/* struct argp
+ * argp_parse()
+ */
+#include <argp.h>
+
+/* clock_gettime()
+ */
+#include <time.h>
+
+/* pthread_create()
+ * pthread_barrier_wait()
+ */
+#include <pthread.h>
+
+/* sched_yield()
+ */
+#include <sched.h>
+
+/* mctp_init()
+ * mctp_free()
+ */
+#include <mctp.h>
+
+/* pq_pop()
+ * pq_push()
+ */
+#include <ptrqueue.h>
+
+#include <fmapi.h>
+#include <emapi.h>
+#include <cxlstate.h>
+
+#include "options.h"
+
+#include "state.h"
+
+#include "dispatch.h"
+
+#include "fmapi_handler.h"
+#include "emapi_handler.h"
+
+#include "metrics.h"
+
+#include "memspace.h"
+
+#include "bgop.h"
+
+#include "events.h"
+
+#include "cache.h"
+
+/* switches_add()
+ * switches_attach()
+ */
+#include "switches.h"
+
+/* MACROS ====================================================================*/
+
+#define HALN_THREADS 		64 		//!< Max number of harness threads
+#define HALN_ITERATIONS 	10000 	//!< Default requests per thread per case
+#define HALN_MIN_PORTS 		32 		//!< Smallest generated switch
+#define HALN_VCSS 			16 		//!< VCSs of a generated switch
+#define HALN_VPPBS 			256 	//!< vPPBs per VCS of a generated switch
+#define HALN_MPC_MEM 		4096 	//!< Length of an MPC Memory transaction
+#define HALN_MPC_MEM_HDR 	0x10 	//!< Offset of Transaction Data in an MPC Memory request
+#define HALN_RANGE 			(256 << 10) 	//!< LD range MPC Memory requests are spread over
+#define HALN_PSC_PORT_MAX 	255 	//!< Max ports in one Get Physical Port State request
+
+#define HA_NS 				1000000000ULL
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+struct hthread;
+
+/**
+ * A request path to time
+ */
+struct hcase
+{
+	char *name;
+	__u8 type; 				//!< MCTP message type: MCMT_CXLFMAPI or MCMT_CSE
+	__u16 opcode; 			//!< Opcode of the request, used to find the dispatcher statistics
+	int (*build)(struct hthread *t, __u8 *payload); 	//!< Returns the message length or < 0
+};
+
+/**
+ * One harness thread
+ */
+struct hthread
+{
+	unsigned id;
+	pthread_t thread;
+	struct mctp *m;
+	struct mctp_action ma;
+	struct mctp_msg req;
+	struct hcase *c;
+
+	__u8 ppid; 				//!< Port the requests of this thread target
+	__u8 tag;
+	unsigned seed;
+	int bound; 				//!< Bind case: next request is an unbind
+
+	struct hist lat; 		//!< Handler call to response popped (ns)
+	__u64 count;
+	__u64 errors; 			//!< Responses with a return code other than Success or Background Operation Started
+	__u64 failed; 			//!< Requests the dispatcher failed without a response
+};
+
+/**
+ * Harness configuration
+ */
+struct haconf
+{
+	char *config; 			//!< Config file, NULL to generate the switch
+	unsigned ports; 		//!< Ports of the generated switch, 0 to keep the config size
+	unsigned threads;
+	unsigned iterations;
+	char *only; 			//!< Run only the case of this name
+	int spread; 			//!< Give each thread its own port
+	int nocache; 			//!< Do not start the response cache
+	__u8 ppid;
+	__u16 ldid;
+	__u8 vcsid;
+	__u8 vppbid;
+	__u64 verbosity;
+};
+
+/* PROTOTYPES ================================================================*/
+
+static int pr_harness(int key, char *arg, struct argp_state *state);
+
+static int ha_isc_id(struct hthread *t, __u8 *payload);
+static int ha_psc_id(struct hthread *t, __u8 *payload);
+static int ha_psc_port(struct hthread *t, __u8 *payload);
+static int ha_psc_port_all(struct hthread *t, __u8 *payload);
+static int ha_vsc_info(struct hthread *t, __u8 *payload);
+static int ha_vsc_bind(struct hthread *t, __u8 *payload);
+static int ha_mpc_mem_read(struct hthread *t, __u8 *payload);
+static int ha_mpc_mem_write(struct hthread *t, __u8 *payload);
+static int ha_mpc_tmc(struct hthread *t, __u8 *payload);
+static int ha_em_list_dev(struct hthread *t, __u8 *payload);
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/**
+ * Cases in the order they are run
+ */
+static struct hcase cases[] = {
+	{ "isc_id", 		MCMT_CXLFMAPI, 	FMOP_ISC_ID, 	ha_isc_id },
+	{ "psc_id", 		MCMT_CXLFMAPI, 	FMOP_PSC_ID, 	ha_psc_id },
+	{ "psc_port", 		MCMT_CXLFMAPI, 	FMOP_PSC_PORT, 	ha_psc_port },
+	{ "psc_port_all", 	MCMT_CXLFMAPI, 	FMOP_PSC_PORT, 	ha_psc_port_all },
+	{ "vsc_info", 		MCMT_CXLFMAPI, 	FMOP_VSC_INFO, 	ha_vsc_info },
+	{ "vsc_bind", 		MCMT_CXLFMAPI, 	FMOP_VSC_BIND, 	ha_vsc_bind },
+	{ "mpc_mem_read", 	MCMT_CXLFMAPI, 	FMOP_MPC_MEM, 	ha_mpc_mem_read },
+	{ "mpc_mem_write", 	MCMT_CXLFMAPI, 	FMOP_MPC_MEM, 	ha_mpc_mem_write },
+	{ "mpc_tmc", 		MCMT_CXLFMAPI, 	FMOP_MPC_TMC, 	ha_mpc_tmc },
+	{ "em_list_dev", 	MCMT_CSE, 		EMOP_LIST_DEV, 	ha_em_list_dev },
+};
+
+static struct haconf conf;
+
+static pthread_barrier_t barrier;
+
+static struct argp_option ao_harness[] =
+{
+	{"config", 			'c', "FILE", 0, "Config file to load the switch and device catalog from", 0},
+	{"ports", 			'N', "INT", 0, "Generate a switch with this many ports (32 to 256)", 0},
+	{"threads", 		't', "INT", 0, "Threads running each case at once (default 1)", 0},
+	{"iterations", 		'i', "INT", 0, "Requests per thread per case (default 10000)", 0},
+	{"case", 			'k', "NAME", 0, "Run only this case", 0},
+	{"spread", 			's', NULL, 0, "Give each thread its own port instead of sharing one", 0},
+	{"no-cache", 		'C', NULL, 0, "Do not start the response cache", 0},
+	{"ppid", 			'p', "INT", 0, "Port targeted by all threads, first port with --spread (default 1)", 0},
+	{"ldid", 			'l', "INT", 0, "LD used by bind and MPC cases (default 0)", 0},
+	{"vcsid", 			'v', "INT", 0, "VCS used by the bind case (default 0)", 0},
+	{"vppbid", 			'b', "INT", 0, "vPPB used by the bind case (default 1)", 0},
+	{"verbosity-hex", 	'X', "HEX", 0, "cse verbosity bitfield (in hex)", 0},
+	{0,0,0,0,0,0}
+};
+
+static struct argp argp_harness = { ao_harness, pr_harness, NULL, "In-process microbenchmark of the cse handlers", NULL, NULL, NULL };
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Handle each option based on the key
+ */
+static int pr_harness(int key, char *arg, struct argp_state *state)
+{
+	switch (key)
+	{
+		case 'c': conf.config 		= arg; break;
+		case 'N': conf.ports 		= strtoul(arg, NULL, 0); break;
+		case 't': conf.threads 		= strtoul(arg, NULL, 0); break;
+		case 'i': conf.iterations 	= strtoul(arg, NULL, 0); break;
+		case 'k': conf.only 		= arg; break;
+		case 's': conf.spread 		= 1; break;
+		case 'C': conf.nocache 		= 1; break;
+		case 'p': conf.ppid 		= strtoul(arg, NULL, 0); break;
+		case 'l': conf.ldid 		= strtoul(arg, NULL, 0); break;
+		case 'v': conf.vcsid 		= strtoul(arg, NULL, 0); break;
+		case 'b': conf.vppbid 		= strtoul(arg, NULL, 0); break;
+		case 'X': conf.verbosity 	= strtoull(arg, NULL, 16); break;
+
+		case ARGP_KEY_ARG:
+			argp_failure(state, 1, 0, "too many arguments");
+			break;
+
+		case ARGP_KEY_END:
+			if (conf.threads == 0 || conf.threads > HALN_THREADS)
+				argp_failure(state, 1, 0, "threads must be 1 to %d", HALN_THREADS);
+			if (conf.ports != 0 && (conf.ports < HALN_MIN_PORTS || conf.ports > MAX_PORTS))
+				argp_failure(state, 1, 0, "ports must be %d to %d", HALN_MIN_PORTS, MAX_PORTS);
+			break;
+
+		default:
+			return ARGP_ERR_UNKNOWN;
+	}
+
+	return 0;
+}
+
+/**
+ * Fill the FM API header in front of a serialized request object
+ *
+ * @return 	Length of the FM API message
+ */
+static int ha_fm_hdr(struct hthread *t, __u8 *payload, __u16 opcode, int len)
+{
+	struct fmapi_hdr hdr;
+
+	if (len < 0)
+		return len;
+
+	len = fmapi_fill_hdr(&hdr, FMMT_REQ, t->tag, opcode, 0, len, 0, 0);
+	fmapi_serialize(((struct fmapi_buf*) payload)->hdr, &hdr, FMOB_HDR);
+
+	return len;
+}
+
+static int ha_isc_id(struct hthread *t, __u8 *payload)
+{
+	return ha_fm_hdr(t, payload, FMOP_ISC_ID, 0);
+}
+
+static int ha_psc_id(struct hthread *t, __u8 *payload)
+{
+	return ha_fm_hdr(t, payload, FMOP_PSC_ID, 0);
+}
+
+static int ha_psc_port(struct hthread *t, __u8 *payload)
+{
+	union fmapi_obj obj;
+	struct fmapi_buf *b = (struct fmapi_buf*) payload;
+
+	memset(&obj, 0, sizeof(obj));
+	obj.psc_port_req.num = 1;
+	obj.psc_port_req.ports[0] = t->ppid;
+
+	return ha_fm_hdr(t, payload, FMOP_PSC_PORT, fmapi_serialize(b->payload, &obj, fmapi_fmob_req(FMOP_PSC_PORT)));
+}
+
+static int ha_psc_port_all(struct hthread *t, __u8 *payload)
+{
+	union fmapi_obj obj;
+	struct fmapi_buf *b = (struct fmapi_buf*) payload;
+	unsigned i;
+
+	memset(&obj, 0, sizeof(obj));
+	obj.psc_port_req.num = (cxls->num_ports < HALN_PSC_PORT_MAX) ? cxls->num_ports : HALN_PSC_PORT_MAX;
+	for ( i = 0 ; i < obj.psc_port_req.num ; i++ )
+		obj.psc_port_req.ports[i] = i;
+
+	return ha_fm_hdr(t, payload, FMOP_PSC_PORT, fmapi_serialize(b->payload, &obj, fmapi_fmob_req(FMOP_PSC_PORT)));
+}
+
+static int ha_vsc_info(struct hthread *t, __u8 *payload)
+{
+	union fmapi_obj obj;
+	struct fmapi_buf *b = (struct fmapi_buf*) payload;
+	unsigned i;
+
+	memset(&obj, 0, sizeof(obj));
+	obj.vsc_info_req.vppbid_start = 0;
+	obj.vsc_info_req.vppbid_limit = 255;
+	obj.vsc_info_req.num = (cxls->num_vcss < FM_MAX_VCS_PER_RSP) ? cxls->num_vcss : FM_MAX_VCS_PER_RSP;
+	for ( i = 0 ; i < obj.vsc_info_req.num ; i++ )
+		obj.vsc_info_req.vcss[i] = i;
+
+	return ha_fm_hdr(t, payload, FMOP_VSC_INFO, fmapi_serialize(b->payload, &obj, fmapi_fmob_req(FMOP_VSC_INFO)));
+}
+
+/**
+ * Alternate Bind and Unbind of one vPPB
+ */
+static int ha_vsc_bind(struct hthread *t, __u8 *payload)
+{
+	union fmapi_obj obj;
+	struct fmapi_buf *b = (struct fmapi_buf*) payload;
+
+	memset(&obj, 0, sizeof(obj));
+
+	if (t->bound)
+	{
+		obj.vsc_unbind_req.vcsid 	= conf.vcsid;
+		obj.vsc_unbind_req.vppbid 	= conf.vppbid + t->id;
+		obj.vsc_unbind_req.option 	= 0;
+		return ha_fm_hdr(t, payload, FMOP_VSC_UNBIND, fmapi_serialize(b->payload, &obj, fmapi_fmob_req(FMOP_VSC_UNBIND)));
+	}
+
+	obj.vsc_bind_req.vcsid 	= conf.vcsid;
+	obj.vsc_bind_req.vppbid = conf.vppbid + t->id;
+	obj.vsc_bind_req.ppid 	= t->ppid;
+	obj.vsc_bind_req.ldid 	= conf.ldid;
+	return ha_fm_hdr(t, payload, FMOP_VSC_BIND, fmapi_serialize(b->payload, &obj, fmapi_fmob_req(FMOP_VSC_BIND)));
+}
+
+/**
+ * MPC LD CXL.io Memory request in the layout decoded by _parse_mpc_mem_req()
+ */
+static int ha_mpc_mem(struct hthread *t, __u8 *payload, int write)
+{
+	struct fmapi_buf *b = (struct fmapi_buf*) payload;
+	__u64 offset;
+	int i, len;
+
+	offset = (rand_r(&t->seed) % (HALN_RANGE / HALN_MPC_MEM)) * (__u64) HALN_MPC_MEM;
+
+	memset(b->payload, 0, HALN_MPC_MEM_HDR);
+	b->payload[0] = t->ppid;
+	b->payload[1] = 0xFF;
+	b->payload[3] = write << 7;
+	b->payload[4] = conf.ldid & 0xFF;
+	b->payload[5] = (conf.ldid >> 8) & 0xFF;
+	b->payload[6] = HALN_MPC_MEM & 0xFF;
+	b->payload[7] = (HALN_MPC_MEM >> 8) & 0xFF;
+	for ( i = 0 ; i < 8 ; i++ )
+		b->payload[8 + i] = (offset >> (8 * i)) & 0xFF;
+	len = HALN_MPC_MEM_HDR;
+
+	if (write)
+	{
+		memset(&b->payload[HALN_MPC_MEM_HDR], t->tag, HALN_MPC_MEM);
+		len += HALN_MPC_MEM;
+	}
+
+	return ha_fm_hdr(t, payload, FMOP_MPC_MEM, len);
+}
+
+static int ha_mpc_mem_read(struct hthread *t, __u8 *payload)
+{
+	return ha_mpc_mem(t, payload, 0);
+}
+
+static int ha_mpc_mem_write(struct hthread *t, __u8 *payload)
+{
+	return ha_mpc_mem(t, payload, 1);
+}
+
+/**
+ * MPC Tunnel of an MCC Get QoS Status, which has no request payload
+ */
+static int ha_mpc_tmc(struct hthread *t, __u8 *payload)
+{
+	union fmapi_obj obj;
+	struct fmapi_hdr sub;
+	struct fmapi_buf *b = (struct fmapi_buf*) payload;
+
+	memset(&obj, 0, sizeof(obj));
+	obj.mpc_tmc_req.ppid = t->ppid;
+	obj.mpc_tmc_req.type = MCMT_CXLCCI;
+	obj.mpc_tmc_req.len = fmapi_fill_hdr(&sub, FMMT_REQ, t->tag, FMOP_MCC_QOS_STAT, 0, 0, 0, 0);
+	fmapi_serialize(((struct fmapi_buf*) obj.mpc_tmc_req.msg)->hdr, &sub, FMOB_HDR);
+
+	return ha_fm_hdr(t, payload, FMOP_MPC_TMC, fmapi_serialize(b->payload, &obj, fmapi_fmob_req(FMOP_MPC_TMC)));
+}
+
+/**
+ * EM API List Devices of the whole catalog
+ */
+static int ha_em_list_dev(struct hthread *t, __u8 *payload)
+{
+	struct emapi_hdr hdr;
+
+	emapi_fill_hdr(&hdr, EMMT_REQ, t->tag, 0, EMOP_LIST_DEV, 0, 0, 0);
+	emapi_serialize(((struct emapi_buf*) payload)->hdr, &hdr, EMOB_HDR, NULL);
+
+	return EMLN_HDR;
+}
+
+/**
+ * Return the FM API or EM API return code of a response
+ */
+static unsigned ha_rc(struct hthread *t, struct mctp_msg *mm)
+{
+	struct fmapi_hdr fh;
+	struct emapi_hdr eh;
+
+	if (t->c->type == MCMT_CSE)
+	{
+		memset(&eh, 0, sizeof(eh));
+		emapi_deserialize(&eh, ((struct emapi_buf*) mm->payload)->hdr, EMOB_HDR, NULL);
+		return eh.rc;
+	}
+
+	memset(&fh, 0, sizeof(fh));
+	fmapi_deserialize(&fh, ((struct fmapi_buf*) mm->payload)->hdr, FMOB_HDR, NULL);
+	return fh.return_code;
+}
+
+/**
+ * Call the handler with one request and collect its result
+ *
+ * STEPS
+ * 1: Call the handler
+ * 2: Pop the action from the transmit queue or the completion queue
+ * 3: Return the response buffer to the pool
+ */
+static void ha_call(struct hthread *t, int len)
+{
+	struct timespec start, end;
+	struct mctp_action *ma;
+	unsigned rc;
+	int ok;
+
+	memset(&t->ma, 0, sizeof(t->ma));
+	t->ma.req = &t->req;
+	t->req.type = t->c->type;
+	t->req.tag = t->tag;
+	t->req.len = len;
+
+	// STEP 1: Call the handler
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (t->c->type == MCMT_CSE)
+		emapi_handler(t->m, &t->ma);
+	else
+		fmapi_handler(t->m, &t->ma);
+
+	// STEP 2: Pop the action from the transmit queue or the completion queue
+	ok = 1;
+	ma = pq_pop(t->m->tmq, 0);
+	if (ma == NULL)
+	{
+		ma = pq_pop(t->m->acq, 0);
+		ok = 0;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	metrics_hist_add(&t->lat, (end.tv_sec - start.tv_sec) * HA_NS + end.tv_nsec - start.tv_nsec);
+	t->count++;
+
+	if (!ok || ma == NULL || ma->rsp == NULL)
+		t->failed++;
+	else
+	{
+		rc = ha_rc(t, ma->rsp);
+		if (rc == FMRC_SUCCESS || rc == FMRC_BACKGROUND_OP_STARTED)
+			t->bound = !t->bound;
+		else
+			t->errors++;
+	}
+
+	// STEP 3: Return the response buffer to the pool
+	if (ma != NULL && ma->rsp != NULL)
+	{
+		pq_push(t->m->msgs, ma->rsp);
+		ma->rsp = NULL;
+	}
+}
+
+/**
+ * Harness thread. Runs the current case conf.iterations times
+ */
+static void *ha_run(void *arg)
+{
+	struct hthread *t;
+	unsigned i;
+	int len;
+
+	t = (struct hthread*) arg;
+
+	pthread_barrier_wait(&barrier);
+
+	for ( i = 0 ; i < conf.iterations ; i++ )
+	{
+		t->tag++;
+		len = t->c->build(t, t->req.payload);
+		if (len < 0)
+		{
+			t->failed++;
+			continue;
+		}
+
+		ha_call(t, len);
+
+		// A bind or unbind starts a background operation, let it finish untimed
+		if (t->c->opcode == FMOP_VSC_BIND)
+			while (__atomic_load_n(&cxls->bos_running, __ATOMIC_ACQUIRE))
+				sched_yield();
+	}
+
+	return NULL;
+}
+
+/**
+ * Build the switch to run against
+ *
+ * A generated switch is sized to conf.ports. When a config file is also given
+ * its device catalog is connected round robin to every port but port 0
+ *
+ * @return 	0 upon success. Non zero otherwise
+ */
+static int ha_state()
+{
+	unsigned i;
+
+	if (conf.config == NULL)
+		cxls = cxls_init(conf.ports ? conf.ports : HALN_MIN_PORTS, HALN_VCSS, HALN_VPPBS);
+	else
+		cxls = cxls_init(1, 1, 1);
+	if (cxls == NULL)
+		return 1;
+
+	if (switches_add(cxls, NULL) == NULL)
+		return 1;
+
+	if (conf.config != NULL && state_load(cxls, conf.config) < 0)
+	{
+		printf("Error: could not load config file %s\n", conf.config);
+		return 1;
+	}
+
+	if (conf.config != NULL && conf.ports != 0)
+	{
+		if (cxls_init_ports(cxls, conf.ports) != 0)
+			return 1;
+
+		for ( i = 1 ; i < cxls->num_ports && cxls->num_devices > 0 ; i++ )
+			memspace_connect(&cxls->ports[i], &cxls->devices[(i - 1) % cxls->num_devices], cxls->dir);
+	}
+
+	if (state_locks_init(cxls) != 0)
+		return 1;
+
+	if (state_binds_init(cxls) != 0)
+		return 1;
+
+	return 0;
+}
+
+/**
+ * Run one case on all threads and print its results
+ *
+ * STEPS
+ * 1: Clear the dispatcher statistics of the opcode
+ * 2: Run the threads
+ * 3: Merge and print the results
+ */
+static void ha_case(struct hthread *ts, struct hcase *c)
+{
+	struct timespec start, end;
+	struct opcode *op;
+	struct hist lat;
+	__u64 count, errors, failed;
+	unsigned i, k, num;
+	double secs;
+
+	// STEP 1: Clear the dispatcher statistics of the opcode
+	if (c->type == MCMT_CSE)
+		op = opcode_find(emapi_opcodes(&num), num, c->opcode);
+	else
+		op = opcode_find(fmapi_opcodes(&num), num, c->opcode);
+	if (op != NULL)
+		memset(&op->stats, 0, sizeof(op->stats));
+
+	for ( i = 0 ; i < conf.threads ; i++ )
+	{
+		ts[i].c = c;
+		ts[i].bound = 0;
+		ts[i].count = ts[i].errors = ts[i].failed = 0;
+		memset(&ts[i].lat, 0, sizeof(ts[i].lat));
+	}
+
+	// STEP 2: Run the threads
+	pthread_barrier_init(&barrier, NULL, conf.threads + 1);
+	for ( i = 0 ; i < conf.threads ; i++ )
+		pthread_create(&ts[i].thread, NULL, ha_run, &ts[i]);
+
+	pthread_barrier_wait(&barrier);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for ( i = 0 ; i < conf.threads ; i++ )
+		pthread_join(ts[i].thread, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	pthread_barrier_destroy(&barrier);
+
+	// STEP 3: Merge and print the results
+	memset(&lat, 0, sizeof(lat));
+	count = errors = failed = 0;
+	for ( i = 0 ; i < conf.threads ; i++ )
+	{
+		count 	+= ts[i].count;
+		errors 	+= ts[i].errors;
+		failed 	+= ts[i].failed;
+		lat.sum += ts[i].lat.sum;
+		if (ts[i].lat.max > lat.max)
+			lat.max = ts[i].lat.max;
+		for ( k = 0 ; k < MTLN_BUCKETS ; k++ )
+			lat.bucket[k] += ts[i].lat.bucket[k];
+	}
+
+	secs = ((end.tv_sec - start.tv_sec) * HA_NS + end.tv_nsec - start.tv_nsec) / (double) HA_NS;
+
+	printf("%-14s %9llu %11.0f %7llu %7llu %8.2f %8.2f %8.2f %8.2f", c->name, count, count / secs, errors, failed,
+		metrics_hist_pct(&lat, 500) / 1000.0,
+		metrics_hist_pct(&lat, 990) / 1000.0,
+		metrics_hist_pct(&lat, 999) / 1000.0,
+		lat.max / 1000.0);
+
+	if (op != NULL)
+		printf(" %8.2f %8.2f", metrics_hist_pct(&op->stats.wait, 990) / 1000.0, metrics_hist_pct(&op->stats.svc, 990) / 1000.0);
+
+	printf("\n");
+}
+
+/**
+ * harness main
+ *
+ * STEPS
+ * 1: Parse CLI options
+ * 2: Build the switch state
+ * 3: Start the services the handlers rely on
+ * 4: Create the threads and their MCTP queues
+ * 5: Run the cases
+ * 6: Free everything
+ */
+int main(int argc, char *argv[])
+{
+	struct hthread *ts;
+	unsigned i, ran;
+	int rv;
+
+	rv = 1;
+	ts = NULL;
+
+	// STEP 1: Parse CLI options
+	memset(&conf, 0, sizeof(conf));
+	conf.threads 	= 1;
+	conf.iterations = HALN_ITERATIONS;
+	conf.ppid 		= 1;
+	conf.vppbid 	= 1;
+	argp_parse(&argp_harness, argc, argv, 0, 0, NULL);
+
+	// The handlers read their verbosity from the cse options array
+	opts = calloc(CLOP_MAX, sizeof(struct opt));
+	if (opts == NULL)
+		goto end;
+	opts[CLOP_VERBOSITY].set = (conf.verbosity != 0);
+	opts[CLOP_VERBOSITY].u64 = conf.verbosity;
+
+	// STEP 2: Build the switch state
+	if (ha_state() != 0)
+	{
+		printf("Error: could not build the switch state\n");
+		goto end_state;
+	}
+
+	// STEP 3: Start the services the handlers rely on
+	if (bgop_init() != 0 || events_init() != 0)
+	{
+		printf("Error: could not start the background operation and event threads\n");
+		goto end_services;
+	}
+
+	if (!conf.nocache)
+		cache_init();
+
+	// STEP 4: Create the threads and their MCTP queues
+	ts = calloc(conf.threads, sizeof(struct hthread));
+	if (ts == NULL)
+		goto end_services;
+
+	for ( i = 0 ; i < conf.threads ; i++ )
+	{
+		ts[i].id = i;
+		ts[i].seed = i + 1;
+		ts[i].ppid = conf.spread ? (conf.ppid + i) % cxls->num_ports : conf.ppid;
+		ts[i].m = mctp_init();
+		if (ts[i].m == NULL)
+		{
+			printf("Error: mctp init failed\n");
+			goto end_threads;
+		}
+		switches_attach(ts[i].m, 0);
+	}
+
+	// STEP 5: Run the cases
+	printf("Ports: %u VCSs: %u Devices: %u Threads: %u Iterations: %u Ports per thread: %s Cache: %s\n",
+		cxls->num_ports, cxls->num_vcss, cxls->num_devices, conf.threads, conf.iterations,
+		conf.spread ? "separate" : "shared", conf.nocache ? "off" : "on");
+	printf("%-14s %9s %11s %7s %7s %8s %8s %8s %8s %8s %8s\n", "case", "count", "ops/s", "errors", "failed",
+		"p50(us)", "p99(us)", "p999(us)", "max(us)", "wait99", "svc99");
+
+	for ( i = 0, ran = 0 ; i < sizeof(cases) / sizeof(cases[0]) ; i++ )
+	{
+		if (conf.only != NULL && strcmp(conf.only, cases[i].name))
+			continue;
+		ha_case(ts, &cases[i]);
+		ran++;
+	}
+
+	if (ran == 0)
+		printf("Error: no case named %s\n", conf.only);
+	else
+		rv = 0;
+
+end_threads:
+
+	// STEP 6: Free everything
+	for ( i = 0 ; i < conf.threads ; i++ )
+		if (ts[i].m != NULL)
+		{
+			switches_detach(ts[i].m);
+			mctp_free(ts[i].m);
+		}
+	free(ts);
+
+end_services:
+
+	cache_free();
+	events_free();
+	bgop_free();
+	state_binds_free();
+	state_locks_free();
+
+end_state:
+
+	if (cxls != NULL)
+	{
+		memspace_free(cxls);
+		state_devices_free();
+		cxls_free(cxls);
+		switches_free();
+	}
+
+end:
+
+	free(opts);
+
+	return rv;
+}
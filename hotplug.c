@@ -0,0 +1,435 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		hotplug.c
+ *
+ * @brief 		Code file for the PCI hot plug listener used in a QEMU
+ * 				environment
+ *
+ * @details 	When the switch state is loaded from the PCI bus of a QEMU
+ * 				guest, devices added or removed by the hypervisor afterwards
+ * 				are reported by the kernel as uevents on a netlink socket.
+ * 				Rather than rescanning the whole bus, the listener reads only
+ * 				the device named in the event and updates the one port and
+ * 				vPPB it maps to under that port's lock.
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ */
+/* INCLUDES ==================================================================*/
+
+/* gettid()
+ */
+#define _GNU_SOURCE
+
+/* close()
+ */
+#include <unistd.h>
+
+/* sscanf()
+ */
+#include <stdio.h>
+
+/* strcmp()
+ * strncmp()
+ * strnlen()
+ */
+#include <string.h>
+
+/* socket()
+ * bind()
+ * recv()
+ */
+#include <sys/socket.h>
+
+/* struct sockaddr_nl
+ * NETLINK_KOBJECT_UEVENT
+ */
+#include <linux/netlink.h>
+
+/* poll()
+ */
+#include <poll.h>
+
+/* pthread_create()
+ * pthread_join()
+ */
+#include <pthread.h>
+
+/* pci_get_dev()
+ * pci_free_dev()
+ */
+#include <pci/pci.h>
+
+#include <cxlstate.h>
+
+#include "options.h"
+
+#include "trace.h"
+
+#include "state.h"
+
+#include "events.h"
+
+/* logger_printf()
+ */
+#include "logger.h"
+
+/* switches_select()
+ */
+#include "switches.h"
+
+#include "hotplug.h"
+
+/* MACROS ====================================================================*/
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/**
+ * Fields of a kernel uevent used by the listener
+ */
+struct uevent
+{
+	char *action;
+	char *subsystem;
+	char *slot; 		//!< PCI_SLOT_NAME, e.g. 0000:0d:00.0
+};
+
+/* PROTOTYPES ================================================================*/
+
+static void *hotplug_run(void *arg);
+static void hotplug_add(int domain, int bus, int dev, int func);
+static void hotplug_remove(int domain, int bus, int dev, int func);
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/**
+ * Switch state the listener updates and its index, selected by the thread
+ */
+static struct cxl_switch *state = NULL;
+static unsigned state_id = 0;
+
+/**
+ * Netlink socket the uevents are received on, -1 if not open
+ */
+static int sock = -1;
+
+/**
+ * Listener thread and the flag that requests it to exit
+ */
+static pthread_t thread;
+static volatile int stop = 0;
+static int running = 0;
+
+/**
+ * PCI devices allocated by the listener, indexed by PPID. Devices found by the
+ * initial bus scan belong to the pci_access list and are not tracked here
+ */
+static struct pci_dev *owned[MAX_PORTS];
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Start listening for PCI hot plug events
+ *
+ * @param s 	struct cxl_switch that was loaded with state_load_from_pci(), 
+ * 				the switch selected by the calling thread
+ * @return 		0 upon success. Non zero otherwise
+ *
+ * STEPS
+ * 1: Validate inputs
+ * 2: Open the netlink socket and join the kernel uevent group
+ * 3: Start the listener thread
+ */
+int hotplug_init(struct cxl_switch *s)
+{
+	INIT
+	int rv;
+	struct sockaddr_nl addr;
+
+	ENTER
+
+	// Initialize variables
+	rv = 1;
+
+	STEP // 1: Validate inputs
+	if (s == NULL || s->pacc == NULL || s->num_vcss == 0)
+		goto end;
+
+	state = s;
+	state_id = cxls_id;
+	stop = 0;
+
+	STEP // 2: Open the netlink socket and join the kernel uevent group
+	sock = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+	if (sock < 0)
+	{
+		IFV(CLVB_ERRORS) logger_printf("%d:%s ERR: Could not open uevent socket\n", gettid(), __FUNCTION__);
+		goto end;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = HPLN_UEVENT_GROUP;
+	if (bind(sock, (struct sockaddr*) &addr, sizeof(addr)) != 0)
+	{
+		IFV(CLVB_ERRORS) logger_printf("%d:%s ERR: Could not bind uevent socket\n", gettid(), __FUNCTION__);
+		goto end_sock;
+	}
+
+	STEP // 3: Start the listener thread
+	if (pthread_create(&thread, NULL, hotplug_run, NULL) != 0)
+	{
+		IFV(CLVB_ERRORS) logger_printf("%d:%s ERR: Could not start hot plug thread\n", gettid(), __FUNCTION__);
+		goto end_sock;
+	}
+	running = 1;
+
+	IFV(CLVB_GENERAL) logger_printf("%d:%s Listening for PCI hot plug events\n", gettid(), __FUNCTION__);
+
+	rv = 0;
+
+	goto end;
+
+end_sock:
+
+	close(sock);
+	sock = -1;
+
+end:
+
+	EXIT(rv)
+
+	return rv;
+}
+
+/**
+ * Stop the listener and free the PCI devices it allocated
+ *
+ * Call before the switch state is freed
+ */
+void hotplug_free()
+{
+	unsigned i;
+
+	if (running)
+	{
+		stop = 1;
+		pthread_join(thread, NULL);
+		running = 0;
+	}
+
+	if (sock >= 0)
+		close(sock);
+	sock = -1;
+
+	for ( i = 0 ; i < MAX_PORTS ; i++ )
+	{
+		if (owned[i] == NULL)
+			continue;
+
+		// Do not leave a dangling pointer in the port
+		if (state != NULL && i < state->num_ports && state->ports[i].dev == owned[i])
+			state->ports[i].dev = NULL;
+
+		pci_free_dev(owned[i]);
+		owned[i] = NULL;
+	}
+
+	state = NULL;
+}
+
+/**
+ * Split a uevent into its fields
+ *
+ * A kernel uevent is a "ACTION@DEVPATH" header followed by NUL terminated
+ * KEY=VALUE strings
+ *
+ * @return 	0 if the event carries all the fields used, 1 otherwise
+ */
+static int hotplug_parse(char *buf, size_t len, struct uevent *ev)
+{
+	size_t i, n;
+	char *str;
+
+	memset(ev, 0, sizeof(*ev));
+
+	for ( i = 0 ; i < len ; i += n + 1 )
+	{
+		str = &buf[i];
+		n = strnlen(str, len - i);
+
+		if 		(strncmp(str, "ACTION=", 7) == 0) 			ev->action = str + 7;
+		else if (strncmp(str, "SUBSYSTEM=", 10) == 0) 		ev->subsystem = str + 10;
+		else if (strncmp(str, "PCI_SLOT_NAME=", 14) == 0) 	ev->slot = str + 14;
+	}
+
+	if (ev->action == NULL || ev->subsystem == NULL || ev->slot == NULL)
+		return 1;
+
+	return 0;
+}
+
+/**
+ * Listener thread main loop
+ *
+ * STEPS
+ * 1: Wait for an event or the poll timeout
+ * 2: Receive and parse the event
+ * 3: Update the port the device maps to
+ */
+static void *hotplug_run(void *arg)
+{
+	char buf[HPLN_BUF];
+	struct pollfd pfd;
+	struct uevent ev;
+	ssize_t len;
+	int domain, bus, dev, func;
+
+	(void) arg;
+
+	// The state lock functions act on the switch selected by this thread
+	switches_select(state_id);
+
+	pfd.fd = sock;
+	pfd.events = POLLIN;
+
+	while (stop == 0)
+	{
+		// STEP 1: Wait for an event or the poll timeout
+		if (poll(&pfd, 1, HPLN_POLL_MS) <= 0)
+			continue;
+
+		// STEP 2: Receive and parse the event
+		len = recv(sock, buf, sizeof(buf) - 1, 0);
+		if (len <= 0)
+			continue;
+		buf[len] = 0;
+
+		if (hotplug_parse(buf, len, &ev) != 0 || strcmp(ev.subsystem, "pci") != 0)
+			continue;
+
+		if (sscanf(ev.slot, "%x:%x:%x.%x", &domain, &bus, &dev, &func) != 4)
+			continue;
+
+		IFV(CLVB_GENERAL) logger_printf("%d:%s PCI %s %s\n", gettid(), __FUNCTION__, ev.action, ev.slot);
+
+		// STEP 3: Update the port the device maps to
+		if (strcmp(ev.action, "add") == 0)
+			hotplug_add(domain, bus, dev, func);
+		else if (strcmp(ev.action, "remove") == 0)
+			hotplug_remove(domain, bus, dev, func);
+	}
+
+	return NULL;
+}
+
+/**
+ * Load the port described by a PCI device that was added
+ *
+ * STEPS
+ * 1: Read the device
+ * 2: Lock the state the port maps to
+ * 3: Update the port and its vPPB
+ * 4: Unlock and free the device the port referred to before
+ */
+static void hotplug_add(int domain, int bus, int dev, int func)
+{
+	struct pci_dev *pd, *old;
+	struct cxl_port cp;
+	unsigned vppbid;
+	int usp;
+
+	// STEP 1: Read the device
+	pd = pci_get_dev(state->pacc, domain, bus, dev, func);
+	if (pd == NULL)
+		return;
+
+	if (state_pci_read(state, pd, &cp, &vppbid) != 0)
+	{
+		pci_free_dev(pd);
+		return;
+	}
+
+	usp = (cp.state == FMPS_USP);
+
+	// STEP 2: Lock the state the port maps to
+	state_lock_topology();
+	if (usp)
+		state_lock_id(1);
+	state_lock_vcs(0);
+	state_lock_port(cp.ppid);
+
+	// STEP 3: Update the port and its vPPB
+	state_pci_apply(state, &cp, vppbid);
+	state_gen_bump(STATE_GEN_PORT, cp.ppid);
+	state_gen_bump(STATE_GEN_VCS, 0);
+	if (usp)
+		state_gen_bump(STATE_GEN_ID, 0);
+	old = owned[cp.ppid];
+	owned[cp.ppid] = pd;
+
+	// STEP 4: Unlock and free the device the port referred to before
+	state_unlock_port(cp.ppid);
+	state_unlock_vcs(0);
+	if (usp)
+		state_unlock_id();
+	state_unlock_topology();
+
+	if (old != NULL)
+		pci_free_dev(old);
+
+	events_post(EVTY_CONNECT, cp.ppid);
+
+	IFV(CLVB_GENERAL) logger_printf("%d:%s Loaded PPID %u bound to vPPB %u\n", gettid(), __FUNCTION__, cp.ppid, vppbid);
+}
+
+/**
+ * Clear the port a removed PCI device was loaded into
+ *
+ * STEPS
+ * 1: Find the port
+ * 2: Clear the port and unbind it
+ * 3: Unlock and free the device
+ */
+static void hotplug_remove(int domain, int bus, int dev, int func)
+{
+	struct pci_dev *old;
+	int ppid;
+
+	// STEP 1: Find the port
+	state_lock_topology();
+
+	ppid = state_pci_find(state, domain, bus, dev, func);
+	if (ppid < 0)
+	{
+		state_unlock_topology();
+		return;
+	}
+
+	// STEP 2: Clear the port and unbind it
+	state_lock_vcs(0);
+	state_lock_port(ppid);
+
+	state_pci_clear(state, ppid);
+	state_gen_bump(STATE_GEN_PORT, ppid);
+	state_gen_bump(STATE_GEN_VCS, 0);
+	old = owned[ppid];
+	owned[ppid] = NULL;
+
+	// STEP 3: Unlock and free the device
+	state_unlock_port(ppid);
+	state_unlock_vcs(0);
+	state_unlock_topology();
+
+	if (old != NULL)
+		pci_free_dev(old);
+
+	events_post(EVTY_DISCONNECT, ppid);
+
+	IFV(CLVB_GENERAL) logger_printf("%d:%s Cleared PPID %d\n", gettid(), __FUNCTION__, ppid);
+}
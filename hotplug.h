@@ -0,0 +1,40 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		hotplug.h
+ *
+ * @brief 		Header file for the PCI hot plug listener used in a QEMU
+ * 				environment
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ * Macro / Enumeration Prefixes (HP)
+ * HPLN	- Hot Plug Length (LN)
+ */
+#ifndef _HOTPLUG_H
+#define _HOTPLUG_H
+
+/* INCLUDES ==================================================================*/
+
+#include <cxlstate.h>
+
+/* MACROS ====================================================================*/
+
+#define HPLN_BUF 			8192 	//!< Receive buffer for one kernel uevent
+#define HPLN_POLL_MS 		1000 	//!< Interval at which the listener checks for a stop request
+#define HPLN_UEVENT_GROUP 	1 		//!< Netlink multicast group of kernel uevents
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/* PROTOTYPES ================================================================*/
+
+int hotplug_init(struct cxl_switch *s);
+void hotplug_free();
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+#endif //_HOTPLUG_H
@@ -0,0 +1,611 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		local.c
+ *
+ * @brief 		Code file for the AF_UNIX transport of co-located Fabric
+ * 				Managers
+ *
+ * @details 	A Fabric Manager on the same host can connect to a unix
+ * 				socket instead of going through the TCP loopback stack and
+ * 				the MCTP transport threads. Each accepted connection gets its
+ * 				own struct mctp from mctp_init(), which is never run. It only
+ * 				provides the message buffer pool and the transmit and
+ * 				completion queues the handlers already use. A reader thread
+ * 				receives one request per packet and calls fmapi_handler() or
+ * 				emapi_handler(), which service it inline or on a worker
+ * 				thread as for a TCP connection. A writer thread sends each
+ * 				response the handlers push to the transmit queue. Each switch
+ * 				of the process can have a socket of its own. Connections
+ * 				accepted on it are attached to that switch.
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ */
+/* INCLUDES ==================================================================*/
+
+/* gettid()
+ */
+#define _GNU_SOURCE
+
+/* close()
+ * unlink()
+ */
+#include <unistd.h>
+
+/* printf()
+ */
+#include <stdio.h>
+
+/* memset()
+ * strlen()
+ */
+#include <string.h>
+
+/* calloc()
+ * free()
+ */
+#include <stdlib.h>
+
+/* socket()
+ * sendmsg()
+ * recvmsg()
+ */
+#include <sys/socket.h>
+
+/* struct sockaddr_un
+ */
+#include <sys/un.h>
+
+/* lstat()
+ */
+#include <sys/stat.h>
+
+/* clock_gettime()
+ */
+#include <time.h>
+
+/* pthread_create()
+ * pthread_mutex_t
+ * pthread_cond_t
+ */
+#include <pthread.h>
+
+/* mctp_init()
+ * mctp_free()
+ */
+#include <mctp.h>
+
+/* pq_pop()
+ * pq_push()
+ */
+#include <ptrqueue.h>
+
+#include "options.h"
+
+#include "trace.h"
+
+#include "logger.h"
+
+#include "fmapi_handler.h"
+#include "emapi_handler.h"
+
+/* switches_attach()
+ * switches_detach()
+ */
+#include "switches.h"
+
+/* respool_init()
+ * respool_free()
+ */
+#include "respool.h"
+
+#include "local.h"
+
+/* MACROS ====================================================================*/
+
+#define LOLN_INFLIGHT 		32 		//!< Max requests of one connection in the handlers at once
+#define LOLN_POLL_MS 		1 		//!< Interval the reader checks the completion queue while it waits
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/**
+ * Listening socket of one switch
+ */
+struct llisten
+{
+	int fd;
+	char *path;
+	unsigned id; 				//!< Switch the accepted connections are attached to
+	pthread_t acceptor;
+};
+
+/**
+ * One accepted connection
+ */
+struct lconn
+{
+	int used; 					//!< Slot holds a connection, protected by mtx
+	int done; 					//!< Reader thread finished and can be joined
+	int fd;
+	struct llisten *l; 			//!< Socket the connection was accepted on
+	struct mctp *m;
+	pthread_t reader;
+	pthread_t writer;
+
+	pthread_mutex_t mtx;
+	pthread_cond_t cond; 		//!< Signaled when inflight drops
+	unsigned inflight; 			//!< Requests handed to a handler without a response sent yet
+
+	struct mctp_action stop; 	//!< Pushed to the transmit queue to stop the writer
+};
+
+/* PROTOTYPES ================================================================*/
+
+static void *local_accept(void *arg);
+static void *local_read(void *arg);
+static void *local_write(void *arg);
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/**
+ * Listening sockets, one per switch with a local socket
+ */
+static struct llisten listeners[SWLN_SWITCHES];
+static unsigned num_listeners = 0;
+static int stopping = 0;
+
+/**
+ * Connection slots, protected by mtx
+ */
+static struct lconn conns[LOLN_CONNECTIONS];
+static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Create the socket of a switch and start accepting connections
+ *
+ * A stale socket file left by an earlier run is removed. Any other file at
+ * the path is left alone and the transport fails to start
+ *
+ * @param path 	File system path of the socket
+ * @param id 	Switch the connections are attached to
+ * @return 		0 upon success. Non zero otherwise
+ *
+ * STEPS
+ * 1: Remove a stale socket file
+ * 2: Create, bind and listen on the socket
+ * 3: Start the accept thread
+ */
+int local_init(char *path, unsigned id)
+{
+	INIT
+	struct sockaddr_un addr;
+	struct llisten *l;
+	struct stat st;
+	int rv;
+
+	ENTER
+
+	// Initialize variables
+	rv = 1;
+
+	if (path == NULL || strlen(path) >= sizeof(addr.sun_path) || num_listeners >= SWLN_SWITCHES)
+		goto end;
+
+	l = &listeners[num_listeners];
+	l->id = id;
+
+	STEP // 1: Remove a stale socket file
+	if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+		unlink(path);
+
+	STEP // 2: Create, bind and listen on the socket
+	l->fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (l->fd < 0)
+		goto end;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	if (bind(l->fd, (struct sockaddr*) &addr, sizeof(addr)) != 0)
+		goto end_socket;
+
+	if (listen(l->fd, LOLN_BACKLOG) != 0)
+		goto end_unlink;
+
+	l->path = strdup(path);
+	stopping = 0;
+
+	STEP // 3: Start the accept thread
+	if (pthread_create(&l->acceptor, NULL, local_accept, l) != 0)
+		goto end_unlink;
+
+	num_listeners++;
+
+	rv = 0;
+
+	goto end;
+
+end_unlink:
+
+	unlink(path);
+	free(l->path);
+	l->path = NULL;
+
+end_socket:
+
+	close(l->fd);
+	l->fd = -1;
+
+end:
+
+	EXIT(rv)
+
+	return rv;
+}
+
+/**
+ * Stop accepting, close all connections and remove the socket files
+ *
+ * Call after events_free() and before workers_free() so the requests still
+ * in the handlers are answered or dropped before the connections close
+ */
+void local_free()
+{
+	unsigned i;
+
+	if (num_listeners == 0)
+		return;
+
+	// Wake the accept threads
+	__atomic_store_n(&stopping, 1, __ATOMIC_RELEASE);
+	for ( i = 0 ; i < num_listeners ; i++ )
+	{
+		shutdown(listeners[i].fd, SHUT_RDWR);
+		pthread_join(listeners[i].acceptor, NULL);
+	}
+
+	// Wake each reader, it waits for its requests and stops its writer
+	pthread_mutex_lock(&mtx);
+	for ( i = 0 ; i < LOLN_CONNECTIONS ; i++ )
+		if (conns[i].used)
+			shutdown(conns[i].fd, SHUT_RDWR);
+	pthread_mutex_unlock(&mtx);
+
+	for ( i = 0 ; i < LOLN_CONNECTIONS ; i++ )
+	{
+		if (!conns[i].used)
+			continue;
+
+		pthread_join(conns[i].reader, NULL);
+		conns[i].used = 0;
+	}
+
+	for ( i = 0 ; i < num_listeners ; i++ )
+	{
+		close(listeners[i].fd);
+		unlink(listeners[i].path);
+		free(listeners[i].path);
+		memset(&listeners[i], 0, sizeof(struct llisten));
+	}
+	num_listeners = 0;
+}
+
+/**
+ * Return the buffers of an action to the pool and free it
+ */
+static void local_retire(struct lconn *c, struct mctp_action *ma)
+{
+	if (ma->req != NULL)
+		pq_push(c->m->msgs, ma->req);
+	if (ma->rsp != NULL)
+		pq_push(c->m->msgs, ma->rsp);
+	free(ma);
+
+	pthread_mutex_lock(&c->mtx);
+	c->inflight--;
+	pthread_cond_signal(&c->cond);
+	pthread_mutex_unlock(&c->mtx);
+}
+
+/**
+ * Retire the requests the handlers failed without a response
+ */
+static void local_drain(struct lconn *c)
+{
+	struct mctp_action *ma;
+
+	while ((ma = pq_pop(c->m->acq, 0)) != NULL)
+		local_retire(c, ma);
+}
+
+/**
+ * Wait until at most max requests of a connection are in the handlers
+ */
+static void local_wait(struct lconn *c, unsigned max)
+{
+	struct timespec ts;
+
+	pthread_mutex_lock(&c->mtx);
+	while (c->inflight > max)
+	{
+		pthread_mutex_unlock(&c->mtx);
+		local_drain(c);
+		pthread_mutex_lock(&c->mtx);
+
+		if (c->inflight <= max)
+			break;
+
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_nsec += LOLN_POLL_MS * 1000000;
+		if (ts.tv_nsec >= 1000000000)
+		{
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000;
+		}
+		pthread_cond_timedwait(&c->cond, &c->mtx, &ts);
+	}
+	pthread_mutex_unlock(&c->mtx);
+}
+
+/**
+ * Accept thread. Starts a reader and writer for each new connection
+ *
+ * STEPS
+ * 1: Accept a connection
+ * 2: Join connections that have closed and find a free slot
+ * 3: Create the mctp instance of the connection and attach it to the switch
+ * 4: Set aside busy response buffers and start the reader of the connection
+ */
+static void *local_accept(void *arg)
+{
+	struct llisten *l;
+	struct cse_switch *sw;
+	struct lconn *c;
+	unsigned i;
+	int fd;
+
+	l = (struct llisten*) arg;
+	sw = switches_get(l->id);
+
+	for (;;)
+	{
+		// STEP 1: Accept a connection
+		fd = accept4(l->fd, NULL, NULL, SOCK_CLOEXEC);
+		if (__atomic_load_n(&stopping, __ATOMIC_ACQUIRE))
+		{
+			if (fd >= 0)
+				close(fd);
+			break;
+		}
+		if (fd < 0)
+			continue;
+
+		// STEP 2: Join connections that have closed and find a free slot
+		c = NULL;
+		pthread_mutex_lock(&mtx);
+		for ( i = 0 ; i < LOLN_CONNECTIONS ; i++ )
+		{
+			if (conns[i].used && __atomic_load_n(&conns[i].done, __ATOMIC_ACQUIRE))
+			{
+				pthread_join(conns[i].reader, NULL);
+				conns[i].used = 0;
+			}
+			if (!conns[i].used && c == NULL)
+				c = &conns[i];
+		}
+
+		if (c == NULL)
+		{
+			pthread_mutex_unlock(&mtx);
+			IFV(CLVB_ERRORS) logger_printf("ERR: Local FM connection refused, all %d slots in use\n", LOLN_CONNECTIONS);
+			close(fd);
+			continue;
+		}
+
+		// STEP 3: Create the mctp instance of the connection and attach it to the switch
+		memset(c, 0, sizeof(*c));
+		c->fd = fd;
+		c->l = l;
+		c->m = mctp_init();
+		pthread_mutex_init(&c->mtx, NULL);
+		pthread_cond_init(&c->cond, NULL);
+
+		if (c->m != NULL && sw != NULL && sw->eid != 0)
+			c->m->state.eid = sw->eid;
+
+		// STEP 4: Set aside busy response buffers and start the reader of the connection
+		if (c->m == NULL || switches_attach(c->m, l->id) != 0 || respool_init(c->m) != 0 || pthread_create(&c->reader, NULL, local_read, c) != 0)
+		{
+			if (c->m != NULL)
+			{
+				respool_free(c->m);
+				switches_detach(c->m);
+				mctp_free(c->m);
+			}
+			close(fd);
+			pthread_mutex_unlock(&mtx);
+			continue;
+		}
+		c->used = 1;
+		pthread_mutex_unlock(&mtx);
+
+		IFV(CLVB_GENERAL) printf("Accepted local FM connection on %s\n", l->path);
+	}
+
+	return NULL;
+}
+
+/**
+ * Reader thread of a connection. Hands each request to its handler
+ *
+ * STEPS
+ * 1: Start the writer
+ * 2: Check out a request buffer and an action
+ * 3: Receive one request packet
+ * 4: Call the handler of the message type
+ * 5: Wait for the requests in the handlers and stop the writer
+ */
+static void *local_read(void *arg)
+{
+	struct lconn *c;
+	struct mctp_action *ma;
+	struct mctp_msg *mm;
+	struct local_hdr hdr;
+	struct iovec iov[2];
+	struct msghdr msg;
+	ssize_t n;
+
+	c = (struct lconn*) arg;
+
+	// STEP 1: Start the writer
+	if (pthread_create(&c->writer, NULL, local_write, c) != 0)
+		goto end;
+
+	for (;;)
+	{
+		// STEP 2: Check out a request buffer and an action
+		local_wait(c, LOLN_INFLIGHT - 1);
+
+		mm = pq_pop(c->m->msgs, 1);
+		ma = calloc(1, sizeof(struct mctp_action));
+		if (mm == NULL || ma == NULL)
+		{
+			if (mm != NULL)
+				pq_push(c->m->msgs, mm);
+			free(ma);
+			break;
+		}
+
+		// STEP 3: Receive one request packet
+		iov[0].iov_base = &hdr;
+		iov[0].iov_len 	= LOLN_HDR;
+		iov[1].iov_base = mm->payload;
+		iov[1].iov_len 	= MCLN_BTU;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov 	= iov;
+		msg.msg_iovlen 	= 2;
+
+		n = recvmsg(c->fd, &msg, 0);
+		if (n <= 0)
+		{
+			pq_push(c->m->msgs, mm);
+			free(ma);
+			break;
+		}
+
+		if (n < LOLN_HDR || (msg.msg_flags & MSG_TRUNC))
+		{
+			IFV(CLVB_ERRORS) logger_printf("ERR: Dropped malformed local FM packet of %zd bytes\n", n);
+			pq_push(c->m->msgs, mm);
+			free(ma);
+			continue;
+		}
+
+		mm->type 	= hdr.type;
+		mm->tag 	= hdr.tag;
+		mm->dst 	= hdr.dst;
+		mm->src 	= hdr.src;
+		mm->owner 	= 0;
+		mm->len 	= n - LOLN_HDR;
+		ma->req 	= mm;
+
+		// STEP 4: Call the handler of the message type
+		pthread_mutex_lock(&c->mtx);
+		c->inflight++;
+		pthread_mutex_unlock(&c->mtx);
+
+		switch (hdr.type)
+		{
+			case MCMT_CXLFMAPI:
+				fmapi_handler(c->m, ma);
+				break;
+
+			case MCMT_CSE:
+				emapi_handler(c->m, ma);
+				break;
+
+			default:
+				IFV(CLVB_ERRORS) logger_printf("ERR: Unsupported MCTP message type on local FM connection: 0x%02x\n", hdr.type);
+				local_retire(c, ma);
+				break;
+		}
+
+		local_drain(c);
+	}
+
+	// STEP 5: Wait for the requests in the handlers and stop the writer
+	local_wait(c, 0);
+	pq_push(c->m->tmq, &c->stop);
+	pthread_join(c->writer, NULL);
+
+end:
+
+	close(c->fd);
+	respool_free(c->m);
+	switches_detach(c->m);
+	mctp_free(c->m);
+	c->m = NULL;
+	pthread_cond_destroy(&c->cond);
+	pthread_mutex_destroy(&c->mtx);
+
+	IFV(CLVB_GENERAL) printf("Closed local FM connection on %s\n", c->l->path);
+
+	__atomic_store_n(&c->done, 1, __ATOMIC_RELEASE);
+
+	return NULL;
+}
+
+/**
+ * Writer thread of a connection. Sends each response the handlers queue
+ */
+static void *local_write(void *arg)
+{
+	struct lconn *c;
+	struct mctp_action *ma;
+	struct local_hdr hdr;
+	struct iovec iov[2];
+	struct msghdr msg;
+
+	c = (struct lconn*) arg;
+
+	for (;;)
+	{
+		ma = pq_pop(c->m->tmq, 1);
+		if (ma == &c->stop)
+			break;
+		if (ma == NULL)
+			continue;
+
+		if (ma->rsp != NULL)
+		{
+			hdr.type 	= ma->req->type;
+			hdr.tag 	= ma->req->tag;
+			hdr.dst 	= ma->req->src;
+			hdr.src 	= c->m->state.eid;
+
+			iov[0].iov_base = &hdr;
+			iov[0].iov_len 	= LOLN_HDR;
+			iov[1].iov_base = ma->rsp->payload;
+			iov[1].iov_len 	= ma->rsp->len;
+			memset(&msg, 0, sizeof(msg));
+			msg.msg_iov 	= iov;
+			msg.msg_iovlen 	= 2;
+
+			// A closed connection is noticed by the reader
+			sendmsg(c->fd, &msg, MSG_NOSIGNAL);
+		}
+
+		local_retire(c, ma);
+		local_drain(c);
+	}
+
+	return NULL;
+}
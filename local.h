@@ -0,0 +1,66 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		local.h
+ *
+ * @brief 		Header file for the AF_UNIX transport of co-located Fabric
+ * 				Managers
+ *
+ * @details 	The socket is SOCK_SEQPACKET so each packet carries exactly one
+ * 				MCTP message and needs no further framing. A packet is a
+ * 				struct local_hdr followed by the MCTP message body, the same
+ * 				bytes the handlers see in struct mctp_msg payload. The length
+ * 				of the body is the length of the packet less LOLN_HDR. The
+ * 				response to a request is sent with the tag and message type of
+ * 				the request.
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ * Macro / Enumeration Prefixes (LO)
+ * LOLN	- Local Transport Length (LN)
+ */
+#ifndef _LOCAL_H
+#define _LOCAL_H
+
+/* INCLUDES ==================================================================*/
+
+/* __u8
+ */
+#include <linux/types.h>
+
+/* MCLN_BTU
+ */
+#include <mctp.h>
+
+/* MACROS ====================================================================*/
+
+#define LOLN_HDR 			4 		//!< Length of struct local_hdr
+#define LOLN_PACKET 		(LOLN_HDR + MCLN_BTU) 	//!< Max length of a packet
+#define LOLN_CONNECTIONS 	8 		//!< Max simultaneous local FM connections
+#define LOLN_BACKLOG 		4 		//!< Listen backlog of the socket
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/**
+ * Header of each packet on the local socket
+ */
+struct __attribute__((__packed__)) local_hdr
+{
+	__u8 type; 			//!< MCTP message type e.g. MCMT_CXLFMAPI
+	__u8 tag; 			//!< MCTP message tag, echoed in the response
+	__u8 dst; 			//!< Destination EID
+	__u8 src; 			//!< Source EID
+};
+
+/* PROTOTYPES ================================================================*/
+
+int local_init(char *path, unsigned id);
+void local_free();
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+#endif //_LOCAL_H
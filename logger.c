@@ -0,0 +1,364 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		logger.c
+ *
+ * @brief 		Code file for the asynchronous ring buffer logger
+ *
+ * @details 	Command handlers format log messages into a fixed size ring
+ * 				buffer and return immediately. A background thread drains the
+ * 				ring to stdout. If the ring is full the message is dropped and
+ * 				counted rather than blocking the caller.
+ *
+ * 				Each message records a raw CLOCK_MONOTONIC timestamp when it is
+ * 				queued. The timestamp is only converted to an ISO 8601 wall
+ * 				clock string by the drain thread when the message is written.
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ */
+/* INCLUDES ==================================================================*/
+
+/* gettid()
+ */
+#define _GNU_SOURCE
+
+#include <unistd.h>
+
+/* printf()
+ * vsnprintf()
+ * fwrite()
+ */
+#include <stdio.h>
+
+/* va_list
+ */
+#include <stdarg.h>
+
+/* clock_gettime()
+ * localtime_r()
+ * strftime()
+ */
+#include <time.h>
+
+/* memcpy()
+ */
+#include <string.h>
+
+/* pthread_create()
+ * pthread_mutex_t
+ * pthread_cond_t
+ */
+#include <pthread.h>
+
+#include "logger.h"
+
+/* MACROS ====================================================================*/
+
+#define LGLN_TIME 			40 		//!< Length of formatted timestamp prefix
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/**
+ * A single formatted log message
+ */
+struct log_msg
+{
+	struct timespec ts; 		//!< CLOCK_MONOTONIC time the message was queued
+	int stamped; 				//!< Prefix the message with a timestamp 
+	unsigned len;
+	char str[LGLN_MSG];
+};
+
+/**
+ * Ring of log messages waiting to be written
+ */
+struct log_ring
+{
+	pthread_t thread;
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;
+	struct log_msg msgs[LGLN_RING];
+	unsigned head; 			//!< Index of next message to write out
+	unsigned count;			//!< Number of messages in the ring
+	__u64 dropped; 			//!< Messages discarded because the ring was full
+	struct timespec mono; 	//!< CLOCK_MONOTONIC at logger_init()
+	struct timespec real; 	//!< CLOCK_REALTIME at logger_init()
+	int running; 			//!< Drain thread has been started
+	int stop; 				//!< Set to 1 to request the drain thread to exit
+};
+
+/* PROTOTYPES ================================================================*/
+
+static void *logger_run(void *arg);
+static void logger_push(const char *str, unsigned len, struct timespec *ts);
+static void logger_write(struct log_msg *msg);
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+static struct log_ring ring = {
+	.mtx = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Start the log drain thread
+ *
+ * Until this is called messages are written directly to stdout
+ *
+ * @return 	0 upon success, 1 otherwise
+ */
+int logger_init()
+{
+	if (ring.running)
+		return 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &ring.mono);
+	clock_gettime(CLOCK_REALTIME, &ring.real);
+
+	ring.stop = 0;
+	if (pthread_create(&ring.thread, NULL, logger_run, NULL) != 0)
+		return 1;
+
+	ring.running = 1;
+
+	return 0;
+}
+
+/**
+ * Flush the remaining messages and stop the drain thread
+ */
+void logger_free()
+{
+	if (!ring.running)
+		return;
+
+	pthread_mutex_lock(&ring.mtx);
+	ring.stop = 1;
+	pthread_cond_signal(&ring.cond);
+	pthread_mutex_unlock(&ring.mtx);
+
+	pthread_join(ring.thread, NULL);
+	ring.running = 0;
+
+	if (ring.dropped > 0)
+		printf("Logger dropped %llu messages\n", ring.dropped);
+}
+
+/**
+ * Return the number of messages discarded because the ring was full
+ */
+__u64 logger_dropped()
+{
+	__u64 rv;
+
+	pthread_mutex_lock(&ring.mtx);
+	rv = ring.dropped;
+	pthread_mutex_unlock(&ring.mtx);
+
+	return rv;
+}
+
+/**
+ * Format a message and queue it to be written out
+ *
+ * Messages longer than LGLN_MSG are truncated
+ */
+void logger_printf(const char *fmt, ...)
+{
+	char str[LGLN_MSG];
+	struct timespec ts;
+	va_list args;
+	int len;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	va_start(args, fmt);
+	len = vsnprintf(str, LGLN_MSG, fmt, args);
+	va_end(args);
+
+	if (len < 0)
+		return;
+	if (len >= LGLN_MSG)
+		len = LGLN_MSG - 1;
+
+	logger_push(str, len, &ts);
+}
+
+/**
+ * Queue a hex dump of a buffer to be written out
+ *
+ * @param buf 		Buffer to dump
+ * @param len 		Number of bytes
+ * @param width 	Number of bytes to group together on each line
+ */
+void logger_prnt_buf(void *buf, unsigned len, unsigned width)
+{
+	static const char hex[] = "0123456789abcdef";
+	char str[LGLN_MSG];
+	__u8 *b;
+	unsigned i, k, n;
+
+	b = (__u8*) buf;
+	if (width == 0)
+		width = 1;
+
+	for ( i = 0 ; i < len ; i += LGLN_BUF_LINE )
+	{
+		n = snprintf(str, LGLN_MSG, "%04x:", i);
+
+		for ( k = i ; k < len && k < i + LGLN_BUF_LINE ; k++ )
+		{
+			if ( (k - i) % width == 0 )
+				str[n++] = ' ';
+			str[n++] = hex[b[k] >> 4];
+			str[n++] = hex[b[k] & 0x0F];
+		}
+		str[n++] = '\n';
+
+		logger_push(str, n, NULL);
+	}
+}
+
+/**
+ * Copy a formatted message into the ring
+ *
+ * Never blocks on output. If the ring is full the message is dropped
+ *
+ * @param ts 	Time the message was created or NULL for no timestamp prefix
+ */
+static void logger_push(const char *str, unsigned len, struct timespec *ts)
+{
+	struct log_msg *msg, tmp;
+
+	if (!ring.running)
+	{
+		tmp.stamped = (ts != NULL);
+		if (ts != NULL)
+			tmp.ts = *ts;
+		tmp.len = len;
+		memcpy(tmp.str, str, len);
+		logger_write(&tmp);
+		return;
+	}
+
+	pthread_mutex_lock(&ring.mtx);
+
+	if (ring.count >= LGLN_RING)
+	{
+		ring.dropped++;
+		pthread_mutex_unlock(&ring.mtx);
+		return;
+	}
+
+	msg = &ring.msgs[(ring.head + ring.count) % LGLN_RING];
+	memcpy(msg->str, str, len);
+	msg->len = len;
+	msg->stamped = (ts != NULL);
+	if (ts != NULL)
+		msg->ts = *ts;
+	ring.count++;
+
+	pthread_cond_signal(&ring.cond);
+	pthread_mutex_unlock(&ring.mtx);
+}
+
+/**
+ * Drain thread main loop
+ *
+ * STEPS
+ * 1: Wait for messages
+ * 2: Copy out the oldest message
+ * 3: Write the message
+ */
+static void *logger_run(void *arg)
+{
+	struct log_msg msg;
+
+	(void) arg;
+
+	while (1)
+	{
+		// STEP 1: Wait for messages
+		pthread_mutex_lock(&ring.mtx);
+		while (ring.count == 0 && ring.stop == 0)
+		{
+			fflush(stdout);
+			pthread_cond_wait(&ring.cond, &ring.mtx);
+		}
+
+		if (ring.count == 0 && ring.stop)
+		{
+			pthread_mutex_unlock(&ring.mtx);
+			break;
+		}
+
+		// STEP 2: Copy out the oldest message
+		msg = ring.msgs[ring.head];
+		ring.head = (ring.head + 1) % LGLN_RING;
+		ring.count--;
+
+		pthread_mutex_unlock(&ring.mtx);
+
+		// STEP 3: Write the message
+		logger_write(&msg);
+	}
+
+	fflush(stdout);
+
+	return NULL;
+}
+
+/**
+ * Write a message to stdout, prefixed by its ISO 8601 timestamp
+ *
+ * The monotonic timestamp is converted to wall clock time relative to the 
+ * time pair captured by logger_init()
+ */
+static void logger_write(struct log_msg *msg)
+{
+	char prefix[LGLN_TIME];
+	struct timespec ts;
+	struct tm tm;
+	time_t sec;
+	long nsec;
+	size_t n;
+
+	if (msg->stamped)
+	{
+		if (ring.running)
+		{
+			sec  = ring.real.tv_sec  + (msg->ts.tv_sec  - ring.mono.tv_sec);
+			nsec = ring.real.tv_nsec + (msg->ts.tv_nsec - ring.mono.tv_nsec);
+			while (nsec < 0)
+			{
+				nsec += 1000000000L;
+				sec--;
+			}
+			while (nsec >= 1000000000L)
+			{
+				nsec -= 1000000000L;
+				sec++;
+			}
+		}
+		else 
+		{
+			clock_gettime(CLOCK_REALTIME, &ts);
+			sec = ts.tv_sec;
+			nsec = ts.tv_nsec;
+		}
+
+		localtime_r(&sec, &tm);
+		n = strftime(prefix, sizeof(prefix), "%Y-%m-%dT%H:%M:%S", &tm);
+		snprintf(&prefix[n], sizeof(prefix) - n, ".%06ld ", nsec / 1000);
+		fputs(prefix, stdout);
+	}
+
+	fwrite(msg->str, 1, msg->len, stdout);
+}
@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		logger.h
+ *
+ * @brief 		Header file for the asynchronous ring buffer logger
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ * Macro / Enumeration Prefixes (LG)
+ * LGLN	- Logger Length (LN)
+ */
+#ifndef _LOGGER_H
+#define _LOGGER_H
+
+/* INCLUDES ==================================================================*/
+
+/* __u64
+ */
+#include <linux/types.h>
+
+/* MACROS ====================================================================*/
+
+#define LGLN_RING 			4096	//!< Number of messages the ring can hold
+#define LGLN_MSG 			256		//!< Max length of a single message
+#define LGLN_BUF_LINE 		32		//!< Bytes per line of a buffer dump
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/* PROTOTYPES ================================================================*/
+
+int logger_init();
+void logger_free();
+__u64 logger_dropped();
+
+void logger_printf(const char *fmt, ...) __attribute__ ((format (printf, 1, 2)));
+void logger_prnt_buf(void *buf, unsigned len, unsigned width);
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+#endif //_LOGGER_H
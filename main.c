@@ -41,34 +41,44 @@
 
 #include "options.h"
 
+#include "trace.h"
+
 #include "state.h"
 
 #include "fmapi_handler.h"
 #include "emapi_handler.h"
 
+#include "logger.h"
+
+#include "workers.h"
+
+#include "respool.h"
+
+#include "snapshot.h"
+
+#include "memspace.h"
+
+#include "hotplug.h"
+
+#include "bgop.h"
+
+#include "events.h"
+
+#include "cache.h"
+
+#include "local.h"
+
+#include "numa.h"
+
+#include "switches.h"
+
 /* MACROS ====================================================================*/
 
-#ifdef CSE_VERBOSE
- #define INIT 			unsigned step = 0;
- #define ENTER 					if (opts[CLOP_VERBOSITY].u64 & CLVB_CALLSTACK) 	printf("%d:%s Enter\n", 			gettid(), __FUNCTION__);
- #define STEP 			step++; if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u\n", 			gettid(), __FUNCTION__, step);
- #define HEX32(m, i)			if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u %s: 0x%x\n",	gettid(), __FUNCTION__, step, m, i);
- #define INT32(m, i)			if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u %s: %d\n",	gettid(), __FUNCTION__, step, m, i);
- #define EXIT(rc) 				if (opts[CLOP_VERBOSITY].u64 & CLVB_CALLSTACK) 	printf("%d:%s Exit: %d\n", 			gettid(), __FUNCTION__,rc);
-#else
- #define ENTER
- #define EXIT(rc)
- #define STEP
- #define HEX32(m, i)
- #define INT32(m, i)
- #define INIT 
-#endif // CSE_VERBOSE
-
-#define IFV(u) 							if (opts[CLOP_VERBOSITY].u64 & u) 
-
-#define CSLN_PORTS 		32
+#define CSLN_PORTS 		32 		//!< Number of ports when no config file is loaded
 #define CSLN_VCSS 		16
 #define CSLN_VPPBS 		256
+#define CSLN_MIN 		1 		//!< Initial size when a config file sizes the switch
+#define CSLN_PATH 		1024 	//!< Max length of the snapshot file of a switch
 
 /* ENUMERATIONS ==============================================================*/
 
@@ -78,32 +88,114 @@ struct devices * qemu_devices;
 
 /* PROTOTYPES ================================================================*/
 
+static char *cse_path(char *path, char *filename, unsigned id);
+static int cse_load(char *filename);
+
 /* GLOBAL VARIABLES ==========================================================*/
 
 /* FUNCTIONS =================================================================*/
 
+/**
+ * Return the snapshot file of a switch
+ *
+ * The first switch is kept in filename. The others are kept in filename.N
+ * where N is the index of the switch
+ *
+ * @param path 	Buffer of CSLN_PATH bytes the name of switch N is written to
+ * @return 		filename or path
+ */
+static char *cse_path(char *path, char *filename, unsigned id)
+{
+	if (id == 0)
+		return filename;
+
+	snprintf(path, CSLN_PATH, "%s.%u", filename, id);
+	return path;
+}
+
+/**
+ * Add a switch for each filename.N snapshot
+ *
+ * The first switch is loaded by the caller. The listeners of a switch are not
+ * part of its snapshot, so the added switches listen on the TCP ports that 
+ * follow the previous switch. The calling thread is left on the first switch
+ *
+ * @return 	0 upon success. Non zero otherwise
+ */
+static int cse_load(char *filename)
+{
+	char path[CSLN_PATH];
+	struct cxl_switch *s;
+	struct cse_switch *sw;
+	unsigned id;
+	int rv;
+
+	rv = 0;
+	for ( id = 1 ; id < SWLN_SWITCHES ; id++ )
+	{
+		if (access(cse_path(path, filename, id), F_OK) != 0)
+			break;
+
+		s = cxls_init(CSLN_MIN, CSLN_MIN, CSLN_MIN);
+		if (s == NULL) 
+		{
+			rv = 1;
+			break;
+		}
+
+		sw = switches_add(s, NULL);
+		if (sw == NULL)
+		{
+			cxls_free(s);
+			rv = 1;
+			break;
+		}
+		sw->connections = 1;
+
+		rv = snapshot_load(s, path);
+		if (rv != 0)
+		{
+			printf("Error: state load snapshot file %s failed \n", path);
+			break;
+		}
+	}
+
+	switches_select(0);
+
+	return rv;
+}
+
 /**
  * cse main
  *
  * STEPS 
  *  0: Parse CLI options
- *  1: Register Signal Handlers
- *  2: Initialize global state array 
- *  3: Load state file 
- *  4: Print the state 
- *  5: MCTP Init
- *  6: Run MCTP
- *  7: While loop 
- *  8: Stop MCTP
- *  9: Free memory
+ *  1: Register Signal Handlers and start the logger
+ *  2: Initialize the state of the first switch
+ *  3: Load state snapshot or state file and the switches it lists, or the
+ *     snapshots of the other switches
+ *  4: Open memory spaces, save snapshot if requested, initialize fine grained
+ *     state locks and the vPPB binding index of each switch
+ *  5: Print the state 
+ *  6: MCTP Init, one mctp session per FM connection of each switch
+ *  7: Start worker threads
+ *  8: Run MCTP, one listener per FM connection on consecutive TCP ports
+ *  9: While loop 
+ * 10: Stop MCTP
+ * 11: Free memory
  */
 int main(int argc, char* argv[]) 
 {
 	INIT
 	int rv;
-	struct mctp *m;
+	unsigned i, j, locked, bound;
+	__u16 port;
+	struct cse_switch *sw;
+	char path[CSLN_PATH];
 
 	// Initialize varaibles
+	locked = 0;
+	bound = 0;
 	cxls = NULL;
 	stop_requested = 0;
 	rv = 1;
@@ -116,19 +208,49 @@ int main(int argc, char* argv[])
 		goto end;
 	}
 
-	STEP // 1: Register Signal Handlers
+	STEP // 1: Register Signal Handlers and start the logger
 	signals_register();
-
-	STEP // 2: Initialize global state array 
-	cxls = cxls_init(CSLN_PORTS, CSLN_VCSS, CSLN_VPPBS);
+	if (logger_init() != 0) 
+		printf("Warning: logger thread failed to start. Logging directly to stdout\n");
+
+	// Read the NUMA nodes before the config file places ports on them
+	numa_setup();
+
+	STEP // 2: Initialize the state of the first switch
+	// When a config or snapshot file is loaded it sets the number of ports and 
+	// VCSs, so start from the minimum rather than allocating the defaults twice
+	if (opts[CLOP_CONFIG_FILE].set || opts[CLOP_LOAD_STATE].set)
+		cxls = cxls_init(CSLN_MIN, CSLN_MIN, CSLN_MIN);
+	else 
+		cxls = cxls_init(CSLN_PORTS, CSLN_VCSS, CSLN_VPPBS);
 	if (cxls == NULL) 
 	{
 		printf("Error: state init failed \n");
 		goto end_options;		
 	}
 
-	STEP // 3: Load state file 
-	if (opts[CLOP_CONFIG_FILE].set) 
+	if (switches_add(cxls, NULL) == NULL)
+	{
+		printf("Error: switch init failed \n");
+		cxls_free(cxls);
+		goto end_options;		
+	}
+
+	STEP // 3: Load state snapshot or state file and the switches it lists
+	if (opts[CLOP_LOAD_STATE].set) 
+	{
+		rv = snapshot_load(cxls, opts[CLOP_LOAD_STATE].str);
+		if (rv != 0) 
+		{
+			printf("Error: state load snapshot file failed \n");
+			goto end_state;		
+		}
+
+		rv = cse_load(opts[CLOP_LOAD_STATE].str);
+		if (rv != 0) 
+			goto end_state;		
+	}
+	else if (opts[CLOP_CONFIG_FILE].set) 
 	{
 		rv = state_load(cxls, opts[CLOP_CONFIG_FILE].str);
 		if (rv < 0) 
@@ -136,80 +258,314 @@ int main(int argc, char* argv[])
 			printf("Error: state load config file  failed \n");
 			goto end_state;		
 		}
+
+		rv = state_load_switches(cxls, opts[CLOP_CONFIG_FILE].str);
+		if (rv != 0) 
+		{
+			printf("Error: state load switches section failed \n");
+			goto end_state;		
+		}
 	}
-	
-	STEP // 5: Print the state 
-	if (opts[CLOP_PRINT_STATE].set) 
-		cxls_prnt(cxls);
 
-	STEP // 6: MCTP Init
-	m = mctp_init();
-	if (m == NULL) 
-		goto end_state;
+	// The CLI options and the emulator section set the listeners of the first switch
+	sw = switches_get(0);
+	sw->tcp_port = opts[CLOP_TCP_PORT].u16;
+	sw->connections = opts[CLOP_CONNECTIONS].set ? opts[CLOP_CONNECTIONS].u16 : 1;
+	if (opts[CLOP_UNIX_SOCKET].set) 
+		sw->unix_socket = strdup(opts[CLOP_UNIX_SOCKET].str);
+	if (opts[CLOP_EID].set) 
+		sw->eid = opts[CLOP_EID].u8;
+
+	STEP // 4: Open memory spaces, save snapshot, initialize locks and the vPPB binding index
+	for ( i = 0 ; i < switches_num() ; i++ )
+	{
+		switches_select(i);
+
+		// Create the memory backing files of connected MLDs, they are mapped on first access
+		if (memspace_open_all(cxls) != 0)
+			printf("Warning: memory backing files of switch %u could not all be opened \n", i);
+
+		if (opts[CLOP_LOAD_STATE].set) 
+			if (snapshot_load_memory(cxls, cse_path(path, opts[CLOP_LOAD_STATE].str, i)) != 0)
+				printf("Warning: state load LD memory image of switch %u failed \n", i);
+
+		if (opts[CLOP_SAVE_STATE].set) 
+			if (snapshot_save(cxls, cse_path(path, opts[CLOP_SAVE_STATE].str, i)) != 0)
+				printf("Warning: state save snapshot file of switch %u failed \n", i);
+
+		rv = state_locks_init(cxls);
+		if (rv != 0) 
+		{
+			printf("Error: state lock init failed \n");
+			goto end_locks;		
+		}
+		locked++;
+
+		rv = state_binds_init(cxls);
+		if (rv != 0) 
+		{
+			printf("Error: state binding index init failed \n");
+			goto end_locks;		
+		}
+		bound++;
+
+		STEP // 5: Print the state 
+		if (opts[CLOP_PRINT_STATE].set) 
+			cxls_prnt(cxls);
+	}
+
+	// Follow PCI hot plug events instead of rescanning the bus
+	switches_select(0);
+	if (opts[CLOP_QEMU].set) 
+		if (hotplug_init(cxls) != 0)
+			printf("Warning: PCI hot plug listener failed to start \n");
+
+	STEP // 6: MCTP Init, one mctp session per FM connection of each switch
+	for ( i = 0 ; i < switches_num() ; i++ )
+	{
+		sw = switches_get(i);
+		if (sw->connections == 0)
+			sw->connections = 1;
+		if (sw->connections > CLMR_MAX_CONNECTIONS)
+			sw->connections = CLMR_MAX_CONNECTIONS;
+
+		for ( j = 0 ; j < sw->connections ; j++ )
+		{
+			sw->m[j] = mctp_init();
+			if (sw->m[j] == NULL) 
+				goto end_mctp;
+
+			// Set supported MCTP Message Versions
+			mctp_set_version(sw->m[j], MCMT_CXLFMAPI,	0xF2,0xF1,0xFF,0x00);
+			mctp_set_version(sw->m[j], MCMT_CXLCCI,		0xF2,0xF1,0xFF,0x00);
 
-	// Set supported MCTP Message Versions
-	mctp_set_version(m, MCMT_CXLFMAPI,	0xF2,0xF1,0xFF,0x00);
-	mctp_set_version(m, MCMT_CXLCCI,	0xF2,0xF1,0xFF,0x00);
+			// Set Message handler functions
+			mctp_set_handler(sw->m[j], MCMT_CXLFMAPI, fmapi_handler);
+			mctp_set_handler(sw->m[j], MCMT_CSE, emapi_handler);
 
-	// Set Message handler functions
-	mctp_set_handler(m, MCMT_CXLFMAPI, fmapi_handler);
-	mctp_set_handler(m, MCMT_CSE, emapi_handler);
+			// Set MCTP verbosity levels
+			mctp_set_verbosity(sw->m[j], opts[CLOP_MCTP_VERBOSITY].u64);
 
-	// Set MCTP verbosity levels
-	mctp_set_verbosity(m, opts[CLOP_MCTP_VERBOSITY].u64);
+			// Each switch answers as its own endpoint
+			if (sw->eid != 0)
+				sw->m[j]->state.eid = sw->eid;
 
-	STEP // 7: Run MCTP
-	rv = mctp_run(m, opts[CLOP_TCP_PORT].u16, opts[CLOP_TCP_ADDRESS].u32, MCRM_SERVER, 1, 1);
-	if (rv != 0)
+			// Route the requests of the connection to its switch
+			if (switches_attach(sw->m[j], i) != 0)
+				goto end_mctp;
+
+			// Set aside response buffers to respond busy when the pool is empty
+			respool_init(sw->m[j]);
+		}
+	}
+
+	STEP // 7: Start worker threads and the background operation executor
+	rv = workers_init(opts[CLOP_THREADS].u32);
+	if (rv != 0) 
+	{
+		printf("Error: worker thread init failed \n");
+		goto end_mctp;		
+	}
+
+	rv = bgop_init();
+	if (rv != 0) 
 	{
-		switch (rv)
+		printf("Error: background operation thread init failed \n");
+		workers_free();
+		goto end_mctp;		
+	}
+
+	rv = events_init();
+	if (rv != 0) 
+	{
+		printf("Error: event thread init failed \n");
+		bgop_free();
+		workers_free();
+		goto end_mctp;		
+	}
+
+	// Queries are answered from the state directly if the cache is unavailable
+	if (cache_init() != 0)
+		printf("Warning: response cache init failed \n");
+
+	STEP // 8: Run MCTP, one listener per FM connection on consecutive TCP ports
+	// A switch without a TCP port follows the ports of the previous switch
+	port = 0;
+	for ( i = 0 ; i < switches_num() ; i++ )
+	{
+		sw = switches_get(i);
+		if (sw->tcp_port != 0)
+			port = sw->tcp_port;
+
+		for ( j = 0 ; j < sw->connections ; j++, port++ )
 		{
-			case -1: 
-				printf("Socket create failed\n");
-				break;
-			case -2: 
-				printf("Socket bind failed\n");
-				break;
-			case -3:
-				printf("Socket connect failed");
-				break;
-			case 1:
-				printf("Could not create Connection Handler Thread\n");
-				break;
-			case 2:
-				printf("MCTP threads failed to start\n");
-				break;
+			rv = mctp_run(sw->m[j], port, opts[CLOP_TCP_ADDRESS].u32, MCRM_SERVER, 1, 1);
+			if (rv != 0)
+			{
+				switch (rv)
+				{
+					case -1: 
+						printf("Socket create failed\n");
+						break;
+					case -2: 
+						printf("Socket bind failed\n");
+						break;
+					case -3:
+						printf("Socket connect failed");
+						break;
+					case 1:
+						printf("Could not create Connection Handler Thread\n");
+						break;
+					case 2:
+						printf("MCTP threads failed to start\n");
+						break;
+				}
+				goto end_run;
+			}
+			sw->running++;
+
+			IFV(CLVB_GENERAL) printf("Listening for FM connection %u of switch %u on TCP port %u\n", j, i, port);
+		}
+
+		// Co-located FMs can skip the TCP loopback stack
+		if (sw->unix_socket != NULL) 
+		{
+			if (local_init(sw->unix_socket, i) != 0)
+				printf("Warning: local FM socket %s could not be created \n", sw->unix_socket);
+			else 
+				IFV(CLVB_GENERAL) printf("Listening for local FM connections of switch %u on %s\n", i, sw->unix_socket);
 		}
-		goto end_mctp;
 	}
 
-	STEP // 8: While loop 
+	STEP // 9: While loop 
 	while ( stop_requested == 0 ) 
 	{
 		sleep(1);
+
+		// Apply changes to the config file on SIGHUP
+		if (reload_requested) 
+		{
+			reload_requested = 0;
+
+			// A state that no config file described is never reloaded from one
+			if (!opts[CLOP_CONFIG_FILE].set)
+				printf("Warning: SIGHUP ignored, no config file was given \n");
+			else 
+			{
+				for ( i = 0 ; i < switches_num() ; i++ )
+				{
+					switches_select(i);
+					if (state_reload(cxls, opts[CLOP_CONFIG_FILE].str) != 0)
+						printf("Warning: state reload config file failed for switch %u \n", i);
+				}
+			}
+		}
+
+		// Print the trace buffers of all threads on SIGUSR1
+		if (dump_requested) 
+		{
+			dump_requested = 0;
+			trace_dump(stdout);
+		}
 	}
 
-	STEP // 9: Stop MCTP
-	mctp_stop(m);
+end_run:
+
+	STEP // 10: Stop MCTP
+	// Answer waiting event requests while the connections are still up
+	events_free();
+
+	local_free();
+
+	for ( i = 0 ; i < switches_num() ; i++ )
+	{
+		sw = switches_get(i);
+		for ( j = 0 ; j < sw->running ; j++ )
+			mctp_stop(sw->m[j]);
+	}
+
+	workers_free();
+
+	bgop_free();
+
+	IFV(CLVB_GENERAL)
+	{
+		struct cache_stats cs;
+		cache_stats(&cs);
+		printf("Response cache: %llu hits %llu misses %llu stores\n", cs.hits, cs.misses, cs.stores);
+	}
+	cache_free();
 
 end_mctp:
 
-	mctp_free(m);
+	for ( i = 0 ; i < switches_num() ; i++ )
+	{
+		sw = switches_get(i);
+		for ( j = 0 ; j < CLMR_MAX_CONNECTIONS ; j++ )
+		{
+			if (sw->m[j] != NULL)
+			{
+				respool_free(sw->m[j]);
+				switches_detach(sw->m[j]);
+				mctp_free(sw->m[j]);
+				sw->m[j] = NULL;
+			}
+		}
+	}
 
 	rv = 0;
 
+	if (opts[CLOP_SAVE_STATE].set) 
+	{
+		for ( i = 0 ; i < switches_num() ; i++ )
+		{
+			switches_select(i);
+			if (snapshot_save(cxls, cse_path(path, opts[CLOP_SAVE_STATE].str, i)) != 0)
+				printf("Warning: state save snapshot file of switch %u failed \n", i);
+		}
+	}
+
+	hotplug_free();
+
+end_locks:
+
+	STEP // 11: Free memory
+	for ( i = 0 ; i < bound ; i++ )
+	{
+		switches_select(i);
+		state_binds_free();
+	}
+
+	for ( i = 0 ; i < locked ; i++ )
+	{
+		switches_select(i);
+		state_locks_free();
+	}
+
 end_state:
 	
-	cxls_free(cxls);
+	for ( i = 0 ; i < switches_num() ; i++ )
+	{
+		switches_select(i);
+		memspace_free(cxls);
+		cxls_free(cxls);
+	}
+
+	state_devices_free();
+
+	switches_free();
 
 end_options:
 
+	logger_free();
+
 	options_free(opts);
 
 end:
 
 	EXIT(rv)
 
+	trace_free();
+
 	return rv;
 };
-
@@ -0,0 +1,560 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		memspace.c
+ *
+ * @brief 		Code file for the memory mapped backing files of MLD ports
+ *
+ * @details 	Devices with `mmap: 1` in their profile are backed by a sparse
+ * 				file in the directory set by the `dir` key of the config file.
+ * 				Creating and mapping these files in cxls_connect() serializes
+ * 				startup and stalls other FM traffic while a connect holds the
+ * 				topology lock. Here the backing file of a port is recorded at
+ * 				connect time, created by a small pool of threads at startup
+ * 				and only mapped on the first MPC memory access to the port.
+ *
+ * 				The memory space can be backed by transparent huge pages or by
+ * 				files on a hugetlbfs mount, selected with the `hugepages` key of
+ * 				the emulator section or the --hugepages option. When the
+ * 				requested backing is not available the next smaller one is used
+ * 				and the backing actually used is reported when the port is
+ * 				mapped.
+ *
+ * 				Each entry of spaces[] is protected by the lock of its port.
+ * 				Each switch has its own row of spaces[] and the backing files
+ * 				of a switch other than the first are named after the switch.
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ */
+/* INCLUDES ==================================================================*/
+
+/* gettid()
+ */
+#define _GNU_SOURCE
+
+#include <unistd.h>
+
+/* snprintf()
+ */
+#include <stdio.h>
+
+/* calloc()
+ * free()
+ */
+#include <stdlib.h>
+
+/* memset()
+ */
+#include <string.h>
+
+/* open()
+ */
+#include <fcntl.h>
+
+/* errno
+ */
+#include <errno.h>
+
+/* mmap()
+ * munmap()
+ * madvise()
+ */
+#include <sys/mman.h>
+
+/* fstatfs()
+ */
+#include <sys/vfs.h>
+
+/* HUGETLBFS_MAGIC
+ * TMPFS_MAGIC
+ */
+#include <linux/magic.h>
+
+/* pthread_create()
+ */
+#include <pthread.h>
+
+#include <cxlstate.h>
+
+#include "options.h"
+
+#include "trace.h"
+
+#include "state.h"
+
+#include "numa.h"
+
+/* logger_printf()
+ */
+#include "logger.h"
+
+/* SWLN_SWITCHES
+ */
+#include "switches.h"
+
+#include "memspace.h"
+
+/* MACROS ====================================================================*/
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/**
+ * Backing file of one port
+ */
+struct backing
+{
+	char path[MSLN_PATH];
+	__u64 len; 				//!< Size of the memory space of the device
+	__u64 map_len; 			//!< Size of the file and of the mapping, huge page aligned
+	int fd;
+	int mode; 				//!< Backing to use [CLHP]
+	int anon; 				//!< Mapping fell back to anonymous memory
+	int deferred; 			//!< The backing file is managed here, not by cxlstate
+	int opened; 			//!< fd is valid
+	int mapped; 			//!< mld->memspace was mapped here
+	int node; 				//!< NUMA node the mapping is bound to, -1 for none
+};
+
+/**
+ * Work shared by the threads of memspace_open_all()
+ */
+struct open_work
+{
+	struct backing *spaces; //!< Backing files of the switch
+	unsigned *ppids; 		//!< Ports to open
+	unsigned num; 			//!< Number of entries in ppids[]
+	unsigned next; 			//!< Next entry to open
+	unsigned failed; 		//!< Number of files that could not be opened
+};
+
+/* PROTOTYPES ================================================================*/
+
+static int _ms_open(struct backing *b);
+static int _ms_thp_enabled();
+static void *_ms_map(struct backing *b);
+static void _ms_release(struct backing *b, struct cxl_port *p);
+static void *_ms_open_run(void *arg);
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/**
+ * Backing file of each physical port of each switch. MAX_PORTS covers every 
+ * value of the __u8 ppid of a port, so a ppid needs no range check
+ */
+static struct backing spaces[SWLN_SWITCHES][MAX_PORTS];
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Connect a device to a port without creating its backing file
+ *
+ * The mmap flag of the device profile is cleared while cxls_connect() runs so
+ * the library does not create and map the file. The file is recorded to be
+ * opened by memspace_open_all() or on first access by memspace_get().
+ * Caller must hold the topology lock and the port lock once running
+ *
+ * @param p 	struct cxl_port to connect
+ * @param d 	struct cxl_device profile from the device catalog
+ * @param dir 	Directory of the backing files
+ * @return 		Return value of cxls_connect()
+ *
+ * STEPS
+ * 1: Validate inputs
+ * 2: Release the backing file of a previously connected device
+ * 3: Connect the device with mmap disabled
+ * 4: Record the backing file of the port
+ */
+int memspace_connect(struct cxl_port *p, struct cxl_device *d, char *dir)
+{
+	INIT
+	struct backing *b;
+	int rv, flag;
+
+	ENTER
+
+	STEP // 1: Validate inputs
+	if (d->mld == NULL || !d->mld->mmap || dir == NULL)
+	{
+		rv = cxls_connect(p, d, dir);
+		goto end;
+	}
+	b = &spaces[cxls_id][p->ppid];
+
+	STEP // 2: Release the backing file of a previously connected device
+	_ms_release(b, p);
+
+	STEP // 3: Connect the device with mmap disabled
+	flag = d->mld->mmap;
+	d->mld->mmap = 0;
+	rv = cxls_connect(p, d, dir);
+	d->mld->mmap = flag;
+
+	if (p->mld == NULL)
+		goto end;
+	p->mld->mmap = flag;
+
+	STEP // 4: Record the backing file of the port
+	if (cxls_id == 0)
+		snprintf(b->path, MSLN_PATH, "%s/port%u", dir, p->ppid);
+	else 
+		snprintf(b->path, MSLN_PATH, "%s/switch%u-port%u", dir, cxls_id, p->ppid);
+	b->len = p->mld->memory_size;
+	b->mode = opts[CLOP_HUGEPAGES].u8;
+	b->node = numa_connect(p->ppid, d->name);
+	b->deferred = 1;
+
+end:
+
+	EXIT(rv)
+
+	return rv;
+}
+
+/**
+ * Disconnect the device of a port and release its backing file
+ *
+ * Caller must hold the port lock
+ */
+void memspace_disconnect(struct cxl_port *p)
+{
+	_ms_release(&spaces[cxls_id][p->ppid], p);
+
+	cxls_disconnect(p);
+}
+
+/**
+ * Create and open the backing files of all connected ports in parallel
+ *
+ * The files are not mapped. Called once at startup before requests are
+ * serviced
+ *
+ * @param s 	struct cxl_switch, the switch selected by the calling thread
+ * @return 		0 upon success, number of files that could not be opened otherwise
+ *
+ * STEPS
+ * 1: Collect ports with a backing file that is not open
+ * 2: Start threads
+ * 3: Wait for threads to complete
+ */
+int memspace_open_all(struct cxl_switch *s)
+{
+	INIT
+	pthread_t threads[MSLN_THREADS];
+	struct open_work w;
+	unsigned i, num;
+	int rv;
+
+	ENTER
+
+	// Initialize variables
+	rv = 0;
+	memset(&w, 0, sizeof(w));
+	w.spaces = spaces[cxls_id];
+
+	STEP // 1: Collect ports with a backing file that is not open
+	w.ppids = calloc(MAX_PORTS, sizeof(unsigned));
+	if (w.ppids == NULL)
+		goto end;
+
+	for ( i = 0 ; i < s->num_ports && i < MAX_PORTS ; i++ )
+		if (spaces[cxls_id][i].deferred && !spaces[cxls_id][i].opened)
+			w.ppids[w.num++] = i;
+
+	if (w.num == 0)
+		goto end_ppids;
+
+	STEP // 2: Start threads
+	for ( num = 0 ; num < MSLN_THREADS && num < w.num ; num++ )
+		if (pthread_create(&threads[num], NULL, _ms_open_run, &w) != 0)
+			break;
+
+	// Open the remaining files on this thread if no thread could be started
+	if (num == 0)
+		_ms_open_run(&w);
+
+	STEP // 3: Wait for threads to complete
+	for ( i = 0 ; i < num ; i++ )
+		pthread_join(threads[i], NULL);
+
+	IFV(CLVB_GENERAL) logger_printf("%d:%s Opened %u backing files, huge pages: %s\n", gettid(), __FUNCTION__, w.num - w.failed, clhp(opts[CLOP_HUGEPAGES].u8));
+
+	rv = w.failed;
+
+end_ppids:
+
+	free(w.ppids);
+
+end:
+
+	EXIT(rv)
+
+	return rv;
+}
+
+/**
+ * Return the memory space of a port, mapping the backing file on first access
+ *
+ * Caller must hold the port lock
+ *
+ * @return 	Pointer to the memory space or NULL if the port has none
+ */
+__u8 *memspace_get(struct cxl_port *p)
+{
+	struct backing *b;
+	void *ptr;
+
+	if (p->mld == NULL)
+		return NULL;
+
+	if (p->mld->memspace != NULL)
+		return p->mld->memspace;
+
+	b = &spaces[cxls_id][p->ppid];
+	if (!b->deferred || b->len == 0)
+		return NULL;
+
+	if (!b->opened && _ms_open(b) != 0)
+		return NULL;
+
+	ptr = _ms_map(b);
+	if (ptr == NULL)
+	{
+		IFV(CLVB_ERRORS) logger_printf("%d:%s ERR: Could not map backing file %s\n", gettid(), __FUNCTION__, b->path);
+		return NULL;
+	}
+
+	// Bind before the first touch so every page is allocated on the node
+	if (b->node >= 0 && numa_membind(ptr, b->map_len, b->node) == 0)
+		IFV(CLVB_GENERAL) logger_printf("%d:%s Port %u memory space bound to NUMA node %d\n", gettid(), __FUNCTION__, p->ppid, b->node);
+
+	IFV(CLVB_GENERAL) logger_printf("%d:%s Port %u memory space backed by %s%s\n", gettid(), __FUNCTION__, p->ppid, b->anon ? "anonymous " : "", b->mode == CLHP_NONE ? "regular pages" : b->mode == CLHP_THP ? "transparent huge pages" : "hugetlbfs pages");
+
+	p->mld->memspace = ptr;
+	b->mapped = 1;
+
+	return p->mld->memspace;
+}
+
+/**
+ * Return the file descriptor of the backing file of a port, opening it if needed
+ *
+ * Caller must hold the port lock
+ *
+ * @return 	File descriptor or -1 if the memory space of the port is not file backed
+ */
+int memspace_fd(struct cxl_port *p)
+{
+	struct backing *b;
+
+	b = &spaces[cxls_id][p->ppid];
+	if (!b->deferred || b->anon)
+		return -1;
+
+	if (!b->opened && _ms_open(b) != 0)
+		return -1;
+
+	return b->fd;
+}
+
+/**
+ * Unmap and close the backing files of the switch selected by the calling thread
+ */
+void memspace_free(struct cxl_switch *s)
+{
+	unsigned i;
+
+	for ( i = 0 ; i < s->num_ports && i < MAX_PORTS ; i++ )
+		_ms_release(&spaces[cxls_id][i], &s->ports[i]);
+}
+
+/**
+ * Create the backing file of a port if needed and open it
+ *
+ * @return 	0 upon success, 1 otherwise
+ */
+static int _ms_open(struct backing *b)
+{
+	struct statfs sfs;
+
+	b->fd = open(b->path, O_RDWR | O_CREAT, 0644);
+	if (b->fd < 0)
+	{
+		IFV(CLVB_ERRORS) logger_printf("%d:%s ERR: Could not open backing file %s\n", gettid(), __FUNCTION__, b->path);
+		return 1;
+	}
+
+	b->map_len = b->len;
+	if (fstatfs(b->fd, &sfs) != 0)
+		sfs.f_type = 0;
+
+	// hugetlbfs files must be sized in whole huge pages
+	if (b->mode == CLHP_HUGETLB)
+	{
+		if (sfs.f_type == HUGETLBFS_MAGIC && sfs.f_bsize > 0)
+			b->map_len = (b->len + sfs.f_bsize - 1) / sfs.f_bsize * sfs.f_bsize;
+		else
+		{
+			IFV(CLVB_ERRORS) logger_printf("%d:%s WARN: %s is not on hugetlbfs, using transparent huge pages\n", gettid(), __FUNCTION__, b->path);
+			b->mode = CLHP_THP;
+		}
+	}
+
+	// Writable file pages can only be huge on tmpfs with shmem THP allowed
+	if (b->mode == CLHP_THP && (sfs.f_type != TMPFS_MAGIC || !_ms_thp_enabled()))
+	{
+		IFV(CLVB_ERRORS) logger_printf("%d:%s WARN: Transparent huge pages not available for %s, using regular pages\n", gettid(), __FUNCTION__, b->path);
+		b->mode = CLHP_NONE;
+	}
+
+	// The file is sparse so this does not allocate any storage
+	if (ftruncate(b->fd, b->map_len) != 0)
+	{
+		IFV(CLVB_ERRORS) logger_printf("%d:%s ERR: Could not size backing file %s\n", gettid(), __FUNCTION__, b->path);
+		close(b->fd);
+		return 1;
+	}
+
+	b->opened = 1;
+
+	return 0;
+}
+
+/**
+ * Unmap and close the backing file of a port
+ */
+static void _ms_release(struct backing *b, struct cxl_port *p)
+{
+	if (b->mapped && p->mld != NULL && p->mld->memspace != NULL)
+	{
+		munmap(p->mld->memspace, b->map_len);
+		p->mld->memspace = NULL;
+	}
+
+	if (b->opened)
+		close(b->fd);
+
+	memset(b, 0, sizeof(*b));
+}
+
+/**
+ * Return 1 if shmem transparent huge pages can be enabled with madvise()
+ *
+ * Kernels without THP or with shmem_enabled set to never or deny ignore
+ * MADV_HUGEPAGE on tmpfs mappings
+ */
+static int _ms_thp_enabled()
+{
+	char buf[128];
+	FILE *fp;
+	int rv;
+
+	fp = fopen(MSFN_SHMEM_THP, "r");
+	if (fp == NULL)
+		return 0;
+
+	rv = 0;
+	if (fgets(buf, sizeof(buf), fp) != NULL)
+		rv = strstr(buf, "[never]") == NULL && strstr(buf, "[deny]") == NULL;
+
+	fclose(fp);
+
+	return rv;
+}
+
+/**
+ * Map the backing file of a port using the selected backing
+ *
+ * A THP mapping is placed at a huge page aligned address so the whole range
+ * can be backed by huge pages. If huge pages cannot be reserved for a
+ * hugetlbfs file the memory space falls back to anonymous regular pages whose
+ * contents are not visible in the file
+ *
+ * @return 	Address of the mapping, NULL upon failure
+ */
+static void *_ms_map(struct backing *b)
+{
+	__u8 *ptr, *addr;
+	__u64 head;
+
+	if (b->mode == CLHP_THP)
+	{
+		// Reserve an address range with room to align the start
+		ptr = mmap(NULL, b->map_len + MSLN_HUGE_ALIGN, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (ptr == MAP_FAILED)
+			goto regular;
+
+		addr = (__u8*) (((unsigned long) ptr + MSLN_HUGE_ALIGN - 1) & ~((unsigned long) MSLN_HUGE_ALIGN - 1));
+		head = addr - ptr;
+
+		if (mmap(addr, b->map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, b->fd, 0) == MAP_FAILED)
+		{
+			munmap(ptr, b->map_len + MSLN_HUGE_ALIGN);
+			goto regular;
+		}
+
+		// Release the unused ends of the reservation
+		if (head > 0)
+			munmap(ptr, head);
+		munmap(addr + b->map_len, MSLN_HUGE_ALIGN - head);
+
+		if (madvise(addr, b->map_len, MADV_HUGEPAGE) != 0)
+		{
+			IFV(CLVB_ERRORS) logger_printf("%d:%s WARN: madvise(MADV_HUGEPAGE) failed for %s: %d\n", gettid(), __FUNCTION__, b->path, errno);
+			b->mode = CLHP_NONE;
+		}
+
+		return addr;
+	}
+
+	ptr = mmap(NULL, b->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, b->fd, 0);
+	if (ptr != MAP_FAILED)
+		return ptr;
+
+	if (b->mode == CLHP_HUGETLB)
+	{
+		IFV(CLVB_ERRORS) logger_printf("%d:%s WARN: Could not reserve huge pages for %s: %d, using anonymous regular pages\n", gettid(), __FUNCTION__, b->path, errno);
+
+		ptr = mmap(NULL, b->map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (ptr == MAP_FAILED)
+			return NULL;
+
+		b->mode = CLHP_NONE;
+		b->anon = 1;
+		return ptr;
+	}
+
+	return NULL;
+
+regular:
+
+	IFV(CLVB_ERRORS) logger_printf("%d:%s WARN: Could not place huge page aligned mapping for %s, using regular pages\n", gettid(), __FUNCTION__, b->path);
+
+	b->mode = CLHP_NONE;
+	ptr = mmap(NULL, b->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, b->fd, 0);
+	if (ptr == MAP_FAILED)
+		return NULL;
+
+	return ptr;
+}
+
+/**
+ * Thread of memspace_open_all() that opens files until none are left
+ */
+static void *_ms_open_run(void *arg)
+{
+	struct open_work *w;
+	unsigned i;
+
+	w = (struct open_work*) arg;
+
+	while ( (i = __atomic_fetch_add(&w->next, 1, __ATOMIC_RELAXED)) < w->num )
+		if (_ms_open(&w->spaces[w->ppids[i]]) != 0)
+			__atomic_fetch_add(&w->failed, 1, __ATOMIC_RELAXED);
+
+	return NULL;
+}
@@ -0,0 +1,49 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		memspace.h
+ *
+ * @brief 		Header file for the memory mapped backing files of MLD ports
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ * Macro / Enumeration Prefixes (MS)
+ * MSFN	- Memory Space File Name (FN)
+ * MSLN	- Memory Space Length (LN)
+ */
+#ifndef _MEMSPACE_H
+#define _MEMSPACE_H
+
+/* INCLUDES ==================================================================*/
+
+/* __u8
+ */
+#include <linux/types.h>
+
+#include <cxlstate.h>
+
+/* MACROS ====================================================================*/
+
+#define MSLN_THREADS 		8 		//!< Threads used to open backing files at startup
+#define MSLN_PATH 			256 	//!< Max length of the path of a backing file
+#define MSLN_HUGE_ALIGN 	(2 << 20) 	//!< Alignment of a transparent huge page mapping
+#define MSFN_SHMEM_THP 		"/sys/kernel/mm/transparent_hugepage/shmem_enabled"
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/* PROTOTYPES ================================================================*/
+
+int memspace_connect(struct cxl_port *p, struct cxl_device *d, char *dir);
+void memspace_disconnect(struct cxl_port *p);
+int memspace_open_all(struct cxl_switch *s);
+__u8 *memspace_get(struct cxl_port *p);
+int memspace_fd(struct cxl_port *p);
+void memspace_free(struct cxl_switch *s);
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+#endif //_MEMSPACE_H
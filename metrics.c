@@ -0,0 +1,275 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		metrics.c
+ *
+ * @brief 		Code file for per opcode latency histograms and counters
+ *
+ * @details 	The dispatcher calls metrics_begin() before running a handler and
+ * 				metrics_end() after it. In between, the state lock wrappers 
+ * 				report any time spent blocked on a lock with metrics_wait() and
+ * 				the handler reports its return code with metrics_rc(). The
+ * 				in-flight values are kept per thread so no locking is needed 
+ * 				until the totals are added to the opcode with relaxed atomics.
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ */
+/* INCLUDES ==================================================================*/
+
+/* clock_gettime()
+ */
+#include <time.h>
+
+#include "metrics.h"
+
+/* MACROS ====================================================================*/
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/**
+ * Measurements of the request the current thread is servicing
+ */
+struct inflight
+{
+	struct timespec start; 	//!< Time metrics_begin() was called
+	__u64 wait; 			//!< Time blocked on state locks (ns)
+	unsigned rc; 			//!< Return code reported by the handler
+	int has_rc; 			//!< metrics_rc() was called 
+};
+
+/* PROTOTYPES ================================================================*/
+
+static __u64 elapsed(struct timespec *a, struct timespec *b);
+static int put64(__u8 *buf, __u64 v);
+static int put32(__u8 *buf, __u32 v);
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+static __thread struct inflight cur;
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Start measuring a request on the current thread
+ */
+void metrics_begin()
+{
+	clock_gettime(CLOCK_MONOTONIC, &cur.start);
+	cur.wait = 0;
+	cur.has_rc = 0;
+}
+
+/**
+ * Account for time spent blocked on a lock 
+ *
+ * @param start 	CLOCK_MONOTONIC time the caller started waiting
+ */
+void metrics_wait(struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	cur.wait += elapsed(start, &now);
+}
+
+/**
+ * Record the return code of the request on the current thread
+ */
+void metrics_rc(unsigned rc)
+{
+	cur.rc = rc;
+	cur.has_rc = 1;
+}
+
+/**
+ * Finish measuring a request on the current thread and add it to an opcode
+ *
+ * @param s 	struct opstats* of the opcode
+ * @param rv 	Return value of the handler
+ */
+void metrics_end(struct opstats *s, int rv)
+{
+	struct timespec now;
+	__u64 total, svc;
+	unsigned rc;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	total = elapsed(&cur.start, &now);
+	svc = (total > cur.wait) ? total - cur.wait : 0;
+
+	__atomic_add_fetch(&s->count, 1, __ATOMIC_RELAXED);
+	if (rv != 0)
+		__atomic_add_fetch(&s->errors, 1, __ATOMIC_RELAXED);
+
+	if (cur.has_rc)
+	{
+		rc = (cur.rc < MTLN_RC) ? cur.rc : MTLN_RC - 1;
+		__atomic_add_fetch(&s->rc[rc], 1, __ATOMIC_RELAXED);
+	}
+
+	metrics_hist_add(&s->wait, cur.wait);
+	metrics_hist_add(&s->svc, svc);
+}
+
+/**
+ * Return the histogram bucket a value in nanoseconds falls in
+ */
+unsigned metrics_bucket(__u64 ns)
+{
+	unsigned msb, sub, i;
+
+	if (ns < (1ULL << MTLN_MIN_BITS))
+		return 0;
+
+	msb = 63 - __builtin_clzll(ns);
+	sub = (ns >> (msb - MTLN_SUB_BITS)) & ((1 << MTLN_SUB_BITS) - 1);
+	i = 1 + ((msb - MTLN_MIN_BITS) << MTLN_SUB_BITS) + sub;
+
+	if (i >= MTLN_BUCKETS)
+		i = MTLN_BUCKETS - 1;
+
+	return i;
+}
+
+/**
+ * Return the smallest value in nanoseconds that falls in a histogram bucket
+ */
+__u64 metrics_bucket_min(unsigned i)
+{
+	unsigned msb, sub;
+
+	if (i == 0)
+		return 0;
+
+	i--;
+	msb = MTLN_MIN_BITS + (i >> MTLN_SUB_BITS);
+	sub = i & ((1 << MTLN_SUB_BITS) - 1);
+
+	return (1ULL << msb) + ((__u64) sub << (msb - MTLN_SUB_BITS));
+}
+
+/**
+ * Return the upper bound of the bucket holding a percentile of a histogram
+ *
+ * @param h 	struct hist* to read
+ * @param pct 	Percentile in tenths of a percent, e.g. 999 for p99.9
+ * @return 		Value in ns, capped at the largest recorded value
+ */
+__u64 metrics_hist_pct(struct hist *h, unsigned pct)
+{
+	__u64 count, target, sum;
+	unsigned i;
+
+	for ( i = 0, count = 0 ; i < MTLN_BUCKETS ; i++ )
+		count += h->bucket[i];
+
+	if (count == 0)
+		return 0;
+
+	target = (count * pct + 999) / 1000;
+	for ( i = 0, sum = 0 ; i < MTLN_BUCKETS - 1 ; i++ )
+	{
+		sum += h->bucket[i];
+		if (sum >= target)
+			break;
+	}
+
+	if (i == MTLN_BUCKETS - 1 || metrics_bucket_min(i + 1) > h->max)
+		return h->max;
+
+	return metrics_bucket_min(i + 1);
+}
+
+/** 
+ * Serialize the statistics of an opcode in little endian byte order 
+ *
+ * Layout: 
+ * 00h count, 08h errors, 10h wait sum, 18h wait max, 20h service sum, 
+ * 28h service max (all __u64, ns), 30h return code counts (MTLN_RC x __u32),
+ * then wait and service histogram buckets (MTLN_BUCKETS x __u32 each)
+ *
+ * @param buf 	__u8* to write at least MTLN_RECORD bytes to
+ * @param s 	struct opstats* to serialize 
+ * @return 		Number of bytes written 
+ */
+int metrics_serialize(__u8 *buf, struct opstats *s)
+{
+	int len, i;
+
+	len = 0;
+	len += put64(&buf[len], __atomic_load_n(&s->count, 		__ATOMIC_RELAXED));
+	len += put64(&buf[len], __atomic_load_n(&s->errors, 	__ATOMIC_RELAXED));
+	len += put64(&buf[len], __atomic_load_n(&s->wait.sum, 	__ATOMIC_RELAXED));
+	len += put64(&buf[len], __atomic_load_n(&s->wait.max, 	__ATOMIC_RELAXED));
+	len += put64(&buf[len], __atomic_load_n(&s->svc.sum, 	__ATOMIC_RELAXED));
+	len += put64(&buf[len], __atomic_load_n(&s->svc.max, 	__ATOMIC_RELAXED));
+
+	for ( i = 0 ; i < MTLN_RC ; i++ )
+		len += put32(&buf[len], __atomic_load_n(&s->rc[i], __ATOMIC_RELAXED));
+
+	for ( i = 0 ; i < MTLN_BUCKETS ; i++ )
+		len += put32(&buf[len], __atomic_load_n(&s->wait.bucket[i], __ATOMIC_RELAXED));
+
+	for ( i = 0 ; i < MTLN_BUCKETS ; i++ )
+		len += put32(&buf[len], __atomic_load_n(&s->svc.bucket[i], __ATOMIC_RELAXED));
+
+	return len;
+}
+
+/**
+ * Return the number of nanoseconds from a to b
+ */
+static __u64 elapsed(struct timespec *a, struct timespec *b)
+{
+	__s64 ns;
+
+	ns = (__s64) (b->tv_sec - a->tv_sec) * 1000000000LL + (b->tv_nsec - a->tv_nsec);
+	return (ns > 0) ? (__u64) ns : 0;
+}
+
+/**
+ * Add a value to a histogram 
+ */
+void metrics_hist_add(struct hist *h, __u64 ns)
+{
+	__u64 max;
+
+	__atomic_add_fetch(&h->bucket[metrics_bucket(ns)], 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&h->sum, ns, __ATOMIC_RELAXED);
+
+	max = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+	while (ns > max)
+		if (__atomic_compare_exchange_n(&h->max, &max, ns, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			break;
+}
+
+/**
+ * Write a __u64 in little endian byte order
+ */
+static int put64(__u8 *buf, __u64 v)
+{
+	int i;
+
+	for ( i = 0 ; i < 8 ; i++ )
+		buf[i] = (v >> (8*i)) & 0xFF;
+
+	return 8;
+}
+
+/**
+ * Write a __u32 in little endian byte order
+ */
+static int put32(__u8 *buf, __u32 v)
+{
+	int i;
+
+	for ( i = 0 ; i < 4 ; i++ )
+		buf[i] = (v >> (8*i)) & 0xFF;
+
+	return 4;
+}
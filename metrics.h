@@ -0,0 +1,82 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		metrics.h
+ *
+ * @brief 		Header file for per opcode latency histograms and counters
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ * Macro / Enumeration Prefixes (MT)
+ * MTLN	- Metrics Length (LN)
+ */
+#ifndef _METRICS_H
+#define _METRICS_H
+
+/* INCLUDES ==================================================================*/
+
+/* __u8
+ * __u32
+ * __u64
+ */
+#include <linux/types.h>
+
+/* struct timespec
+ */
+#include <time.h>
+
+/* MACROS ====================================================================*/
+
+#define MTLN_SUB_BITS 		2 		//!< Linear sub buckets per power of 2 (log2)
+#define MTLN_MIN_BITS 		6 		//!< Values below 2^MTLN_MIN_BITS ns share bucket 0
+#define MTLN_BUCKETS 		128		//!< Number of histogram buckets 
+#define MTLN_RC 			32 		//!< Number of return codes counted individually
+#define MTLN_RECORD 		(48 + 4*MTLN_RC + 8*MTLN_BUCKETS) //!< Serialized size of struct opstats
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/**
+ * Log-linear latency histogram in nanoseconds
+ *
+ * Bucket boundaries are powers of 2 split into 2^MTLN_SUB_BITS linear steps
+ * so the relative error of any bucket stays below 25%
+ */
+struct hist
+{
+	__u64 sum; 						//!< Total of all recorded values (ns)
+	__u64 max; 						//!< Largest recorded value (ns)
+	__u32 bucket[MTLN_BUCKETS];
+};
+
+/**
+ * Statistics kept for each opcode 
+ */
+struct opstats
+{
+	__u64 count; 					//!< Number of requests dispatched
+	__u64 errors; 					//!< Number of requests whose handler failed
+	__u32 rc[MTLN_RC]; 				//!< Count of each return code. Last entry counts all codes >= MTLN_RC-1
+	struct hist wait; 				//!< Time spent waiting on state locks 
+	struct hist svc; 				//!< Time spent servicing the request excluding lock waits 
+};
+
+/* PROTOTYPES ================================================================*/
+
+void metrics_begin();
+void metrics_wait(struct timespec *start);
+void metrics_rc(unsigned rc);
+void metrics_end(struct opstats *s, int rv);
+
+int metrics_serialize(__u8 *buf, struct opstats *s);
+unsigned metrics_bucket(__u64 ns);
+__u64 metrics_bucket_min(unsigned i);
+void metrics_hist_add(struct hist *h, __u64 ns);
+__u64 metrics_hist_pct(struct hist *h, unsigned pct);
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+#endif //_METRICS_H
@@ -0,0 +1,395 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		numa.c
+ *
+ * @brief 		Code file for NUMA placement of MLD memory spaces and worker
+ * 				threads
+ *
+ * @details 	A port or a device profile can be given a NUMA node with the
+ * 				`numa` key of its entry in the `ports` section or of its `mld`
+ * 				block in the `devices` section. The port setting wins. When a
+ * 				device is connected the node of the port is resolved and kept
+ * 				here, as neither struct cxl_port nor struct cxl_device has a
+ * 				field for it. Port settings are kept per switch. memspace.c
+ * 				binds the mapping of the memory space to that node before it
+ * 				is first touched, and workers.c pins its threads to nodes and
+ * 				routes MPC memory requests for a port to a worker on the node
+ * 				of the port.
+ *
+ * 				The nodes and their CPUs are read from sysfs and memory is
+ * 				bound with the mbind() system call, so no NUMA library is
+ * 				needed. On a host with a single node every call here is a
+ * 				no-op.
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ */
+/* INCLUDES ==================================================================*/
+
+/* gettid()
+ * cpu_set_t
+ */
+#define _GNU_SOURCE
+
+/* syscall()
+ */
+#include <unistd.h>
+
+/* printf()
+ * fopen()
+ */
+#include <stdio.h>
+
+/* strcmp()
+ * strncpy()
+ */
+#include <string.h>
+
+/* strtoul()
+ */
+#include <stdlib.h>
+
+/* errno
+ */
+#include <errno.h>
+
+/* SYS_mbind
+ */
+#include <sys/syscall.h>
+
+/* MPOL_BIND
+ * MPOL_MF_MOVE
+ */
+#include <linux/mempolicy.h>
+
+/* pthread_setaffinity_np()
+ */
+#include <pthread.h>
+
+/* CPU_SET()
+ */
+#include <sched.h>
+
+#include <cxlstate.h>
+
+#include "options.h"
+
+#include "trace.h"
+
+/* MAX_PORTS
+ * cxls_id
+ */
+#include "state.h"
+
+/* SWLN_SWITCHES
+ */
+#include "switches.h"
+
+#include "numa.h"
+
+/* MACROS ====================================================================*/
+
+#define NULN_NAME 			64 		//!< Max length of a device profile name
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/**
+ * NUMA node of a device profile
+ */
+struct nudev
+{
+	char name[NULN_NAME];
+	int node;
+};
+
+/* PROTOTYPES ================================================================*/
+
+static int _numa_cpulist(const char *str, cpu_set_t *set);
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/**
+ * CPUs of each node and whether the node exists
+ */
+static cpu_set_t cpus[NULN_NODES];
+static int present[NULN_NODES];
+static unsigned num_nodes = 0;
+
+/**
+ * Node set for each port of each switch in the config file, plus 1 so 0 
+ * means not set
+ */
+static int port_cfg[SWLN_SWITCHES][MAX_PORTS];
+
+/**
+ * Node of the device connected to each port of each switch, plus 1 so 0 
+ * means none
+ */
+static int port_node[SWLN_SWITCHES][MAX_PORTS];
+
+/**
+ * Node set for each device profile
+ */
+static struct nudev devs[NULN_DEVICES];
+static unsigned num_devs = 0;
+
+/**
+ * 1 once any port or device has a node
+ */
+static int used = 0;
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Read the NUMA nodes of the host and the CPUs of each
+ *
+ * @return 	Number of nodes found, 0 if the host does not report any
+ *
+ * STEPS
+ * 1: Read the cpulist of each node
+ */
+int numa_setup()
+{
+	INIT
+	char path[NULN_PATH];
+	char *buf;
+	FILE *fp;
+	unsigned i;
+
+	ENTER
+
+	num_nodes = 0;
+
+	buf = malloc(NULN_CPULIST);
+	if (buf == NULL)
+		goto end;
+
+	STEP // 1: Read the cpulist of each node
+	for ( i = 0 ; i < NULN_NODES ; i++ )
+	{
+		present[i] = 0;
+		CPU_ZERO(&cpus[i]);
+
+		snprintf(path, NULN_PATH, NUFN_CPULIST, i);
+		fp = fopen(path, "r");
+		if (fp == NULL)
+			continue;
+
+		if (fgets(buf, NULN_CPULIST, fp) != NULL && _numa_cpulist(buf, &cpus[i]) == 0)
+		{
+			present[i] = 1;
+			num_nodes++;
+		}
+		fclose(fp);
+	}
+
+	free(buf);
+
+	IFV(CLVB_GENERAL) printf("%d:%s Found %u NUMA nodes\n", gettid(), __FUNCTION__, num_nodes);
+
+end:
+
+	EXIT(num_nodes)
+
+	return num_nodes;
+}
+
+/**
+ * Return the number of NUMA nodes of the host
+ */
+unsigned numa_nodes()
+{
+	return num_nodes;
+}
+
+/**
+ * Return 1 if any port or device profile has a node and the host has more than one
+ */
+int numa_used()
+{
+	return used && num_nodes > 1;
+}
+
+/**
+ * Return 1 if node exists on this host
+ */
+int numa_present(int node)
+{
+	return node >= 0 && node < NULN_NODES && present[node];
+}
+
+/**
+ * Record the node given to a port in the config file
+ *
+ * @param node 	NUMA node, < 0 to clear
+ */
+void numa_set_port(unsigned ppid, int node)
+{
+	if (ppid >= MAX_PORTS)
+		return;
+
+	port_cfg[cxls_id][ppid] = (node < 0) ? 0 : node + 1;
+	if (node >= 0)
+		used = 1;
+}
+
+/**
+ * Record the node given to a device profile in the config file
+ *
+ * @param name 	Name of the device profile
+ * @param node 	NUMA node, < 0 to clear
+ */
+void numa_set_device(char *name, int node)
+{
+	unsigned i;
+
+	if (name == NULL)
+		return;
+
+	for ( i = 0 ; i < num_devs ; i++ )
+		if (!strcmp(devs[i].name, name))
+			break;
+
+	if (i == num_devs)
+	{
+		if (num_devs >= NULN_DEVICES)
+			return;
+		strncpy(devs[i].name, name, NULN_NAME - 1);
+		num_devs++;
+	}
+
+	devs[i].node = node;
+	if (node >= 0)
+		used = 1;
+}
+
+/**
+ * Resolve the node of a port a device is being connected to
+ *
+ * The node of the port wins over the node of the device profile. A node the
+ * host does not have is ignored with a warning
+ *
+ * @param ppid 	Port the device is connected to
+ * @param name 	Name of the device profile
+ * @return 		NUMA node, -1 if the port has none
+ */
+int numa_connect(unsigned ppid, char *name)
+{
+	unsigned i;
+	int node;
+
+	if (ppid >= MAX_PORTS)
+		return -1;
+
+	node = port_cfg[cxls_id][ppid] - 1;
+	if (node < 0 && name != NULL)
+		for ( i = 0 ; i < num_devs ; i++ )
+			if (!strcmp(devs[i].name, name))
+				node = devs[i].node;
+
+	if (node >= 0 && !numa_present(node))
+	{
+		IFV(CLVB_ERRORS) printf("%d:%s WARN: Port %u NUMA node %d does not exist on this host\n", gettid(), __FUNCTION__, ppid, node);
+		node = -1;
+	}
+
+	__atomic_store_n(&port_node[cxls_id][ppid], node + 1, __ATOMIC_RELAXED);
+
+	return node;
+}
+
+/**
+ * Return the node of the device connected to a port
+ *
+ * Called without the port lock by the worker pool
+ *
+ * @return 	NUMA node, -1 if the port has none
+ */
+int numa_port(unsigned ppid)
+{
+	if (ppid >= MAX_PORTS)
+		return -1;
+
+	return __atomic_load_n(&port_node[cxls_id][ppid], __ATOMIC_RELAXED) - 1;
+}
+
+/**
+ * Bind a mapping to a node
+ *
+ * Pages faulted in afterwards are allocated on the node. Pages already
+ * present that this process maps alone are moved
+ *
+ * @return 	0 upon success. Non zero otherwise
+ */
+int numa_membind(void *addr, __u64 len, int node)
+{
+	unsigned long mask[NULN_NODES / (8 * sizeof(unsigned long))];
+
+	if (!numa_present(node) || num_nodes < 2)
+		return 1;
+
+	memset(mask, 0, sizeof(mask));
+	mask[node / (8 * sizeof(unsigned long))] = 1UL << (node % (8 * sizeof(unsigned long)));
+
+	// maxnode is one more than the number of bits the kernel reads
+	if (syscall(SYS_mbind, addr, len, MPOL_BIND, mask, NULN_NODES + 1, MPOL_MF_MOVE) != 0)
+	{
+		IFV(CLVB_ERRORS) printf("%d:%s WARN: mbind() to NUMA node %d failed: %d\n", gettid(), __FUNCTION__, node, errno);
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Pin the calling thread to the CPUs of a node
+ *
+ * @return 	0 upon success. Non zero otherwise
+ */
+int numa_pin(int node)
+{
+	if (!numa_present(node))
+		return 1;
+
+	return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus[node]);
+}
+
+/**
+ * Parse a sysfs cpulist such as "0-7,16-23"
+ *
+ * @return 	0 upon success, 1 if the list names no CPU
+ */
+static int _numa_cpulist(const char *str, cpu_set_t *set)
+{
+	char *end;
+	unsigned long a, b, n;
+
+	n = 0;
+	while (*str != 0 && *str != '\n')
+	{
+		a = strtoul(str, &end, 10);
+		if (end == str)
+			break;
+		b = a;
+		str = end;
+
+		if (*str == '-')
+		{
+			b = strtoul(str + 1, &end, 10);
+			str = end;
+		}
+
+		for ( ; a <= b && a < CPU_SETSIZE ; a++, n++ )
+			CPU_SET(a, set);
+
+		if (*str == ',')
+			str++;
+	}
+
+	return n == 0;
+}
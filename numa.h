@@ -0,0 +1,53 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		numa.h
+ *
+ * @brief 		Header file for NUMA placement of MLD memory spaces and worker
+ * 				threads
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ * Macro / Enumeration Prefixes (NU)
+ * NUFN	- NUMA File Name (FN)
+ * NULN	- NUMA Length (LN)
+ */
+#ifndef _NUMA_H
+#define _NUMA_H
+
+/* INCLUDES ==================================================================*/
+
+/* __u64
+ */
+#include <linux/types.h>
+
+/* MACROS ====================================================================*/
+
+#define NUFN_CPULIST 		"/sys/devices/system/node/node%u/cpulist" 	//!< CPUs of a node
+#define NULN_NODES 			64 		//!< Max number of NUMA nodes
+#define NULN_DEVICES 		64 		//!< Max number of device profiles with a node
+#define NULN_PATH 			64 		//!< Max length of a sysfs path
+#define NULN_CPULIST 		4096 	//!< Max length of a node cpulist
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/* PROTOTYPES ================================================================*/
+
+int numa_setup();
+unsigned numa_nodes();
+int numa_used();
+int numa_present(int node);
+void numa_set_port(unsigned ppid, int node);
+void numa_set_device(char *name, int node);
+int numa_connect(unsigned ppid, char *name);
+int numa_port(unsigned ppid);
+int numa_membind(void *addr, __u64 len, int node);
+int numa_pin(int node);
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+#endif //_NUMA_H
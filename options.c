@@ -75,7 +75,25 @@ char *STR_CLOP[] = {
 	"CONFIG_FILE",	
 	"TCP_PORT",
 	"TCP_ADDRESS",
-	"QEMU"
+	"QEMU",
+	"THREADS",
+	"CONNECTIONS",
+	"LOAD_STATE",
+	"SAVE_STATE",
+	"HUGEPAGES",
+	"PORT_BW",
+	"UNIX_SOCKET",
+	"EID",
+	"XFER_DIR"
+};
+
+/**
+ * String representation of CLHP Enumeration 
+ */ 
+char *STR_CLHP[] = {
+	"none", 					// CLHP_NONE 		= 0
+	"thp",						// CLHP_THP 		= 1
+	"hugetlb" 					// CLHP_HUGETLB 	= 2
 };
 
 /**
@@ -88,7 +106,8 @@ char *STR_CLVO[] = {
 	"Parsing",					// CVSO_PARSE 		= 3 
 	"Actions",					// CVSO_ACTIONS 	= 4 
 	"Commands",					// CVSO_COMMANDS	= 5 
-	"Errors"					// CVSO_ERRORS 		= 6 
+	"Errors",					// CVSO_ERRORS 		= 6 
+	"Payload dumps"				// CVSO_PAYLOAD		= 7 
 };
 
 /**
@@ -118,11 +137,22 @@ struct argp_option ao_main[] =
 {	
 	{0,0,0,0, "File Options",1},						
   	{"config",  			'c', "FILE", 0, "File name of CXL switch config file", 0},
+  	{"load-state", 			'L', "FILE", 0, "Load binary state snapshot instead of the config file", 0},
+  	{"save-state", 			'S', "FILE", 0, "Save binary state snapshot after loading and on exit", 0},
+  	{"xfer-dir", 			'D', "DIR", 0, "Directory of EM API LD memory load and save files. Loads and saves are rejected without it", 0},
 	{"qemu-sim", 			'q', NULL, OPTION_HIDDEN, "Enable control qemu devices, cse must be run as root", 0}
 	,	
 	{0,0,0,0, "Networking Options",2},
   	{"tcp-port", 			'P', "INT", 0, "Server TCP Port", 0},
-  	{"tcp-address", 		'T', "INT", 0, "Server TCP Address", 0}
+  	{"tcp-address", 		'T', "INT", 0, "Server TCP Address", 0},
+  	{"connections", 		'n', "INT", 0, "Number of simultaneous FM connections. Each listens on the next TCP port", 0},
+  	{"unix-socket", 		'U', "PATH", 0, "Also accept co-located FM connections on this AF_UNIX socket", 0},
+  	{"eid", 				'E', "INT", 0, "MCTP endpoint ID of the switch", 0}
+	,	
+	{0,0,0,0, "Performance Options",3},
+  	{"threads", 			't', "INT", 0, "Number of worker threads (0 to service requests inline)", 0},
+  	{"hugepages", 			'H', "MODE", 0, "Huge page backing of MLD memory: none, thp or hugetlb", 0},
+  	{"port-bw", 			'B', "MBPS", 0, "Emulated bandwidth of an MLD port in MB/s used for QoS, 0 disables QoS", 0}
 	,	
 	{0,0,0,0, "Verbosity Options",8}, 
   	{"print-options",		706,  NULL, OPTION_HIDDEN, "Print the initial State", 0},
@@ -168,6 +198,39 @@ char *clop(int u)
 	return STR_CLOP[u];
 }
 
+/**
+ * Return a string representation of Huge Page backing modes [CLHP]
+ *
+ * @param u CLI Huge Page Enumeration value [CLHP]
+ */
+char *clhp(int u)
+{
+	if (u >= CLHP_MAX) 
+		return NULL;
+	return STR_CLHP[u];
+}
+
+/**
+ * Convert a huge page backing mode name or number to a [CLHP] value
+ *
+ * @return 	CLHP value or -1 if the string is not a valid mode
+ */
+int clhp_parse(const char *str)
+{
+	char *end;
+	int i;
+
+	for ( i = 0 ; i < CLHP_MAX ; i++ )
+		if (!strcmp(str, STR_CLHP[i]))
+			return i;
+
+	i = strtol(str, &end, 0);
+	if (end == str || *end != 0 || i < 0 || i >= CLHP_MAX)
+		return -1;
+
+	return i;
+}
+
 /** 
  * Parse function called by parse args for each parameter passed in on the command line
  *
@@ -197,6 +260,20 @@ static int pr_main (
 			o->str = strndup(arg, CLMR_MAX_ARG_STR_LEN);
 			break;
 			
+		// load-state
+		case 'L': 
+			o = &opts[CLOP_LOAD_STATE];
+			o->set = 1;
+			o->str = strndup(arg, CLMR_MAX_ARG_STR_LEN);
+			break;
+
+		// save-state
+		case 'S': 
+			o = &opts[CLOP_SAVE_STATE];
+			o->set = 1;
+			o->str = strndup(arg, CLMR_MAX_ARG_STR_LEN);
+			break;
+
 		// qemu-sim
 		case 'q':
 			if(!getuid())
@@ -234,6 +311,61 @@ static int pr_main (
 			o->u16 = strtoul(arg, NULL, 0);
 			break;
 
+		// connections
+		case 'n': 
+			o = &opts[CLOP_CONNECTIONS];
+			o->set = 1;
+			o->u16 = strtoul(arg, NULL, 0);
+			break;
+
+		// threads
+		case 't': 
+			o = &opts[CLOP_THREADS];
+			o->set = 1;
+			o->u32 = strtoul(arg, NULL, 0);
+			break;
+
+		// port-bw
+		case 'B': 
+			o = &opts[CLOP_PORT_BW];
+			o->set = 1;
+			o->u32 = strtoul(arg, NULL, 0);
+			break;
+
+		// unix-socket
+		case 'U': 
+			o = &opts[CLOP_UNIX_SOCKET];
+			o->set = 1;
+			o->str = strndup(arg, CLMR_MAX_ARG_STR_LEN);
+			break;
+
+		// xfer-dir
+		case 'D': 
+			o = &opts[CLOP_XFER_DIR];
+			o->set = 1;
+			o->str = strndup(arg, CLMR_MAX_ARG_STR_LEN);
+			break;
+
+		// eid
+		case 'E': 
+			o = &opts[CLOP_EID];
+			o->set = 1;
+			o->u8 = strtoul(arg, NULL, 0);
+			break;
+
+		// hugepages
+		case 'H': 
+			o = &opts[CLOP_HUGEPAGES];
+			rv = clhp_parse(arg);
+			if (rv < 0)
+			{
+				printf("Invalid huge page mode: %s\n", arg);
+				exit(1);
+			}
+			o->set = 1;
+			o->u8 = rv;
+			break;
+
 		// TCP Address
 		case 'T': 
 			o = &opts[CLOP_TCP_ADDRESS];
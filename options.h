@@ -10,13 +10,21 @@
  * @author 		Barrett Edwards <code@jrlabs.io>
  * 
  * Macro / Enumeration Prefixes (CL)
+ * CLHP	- CLI Huge Page backing (HP)
  * CLOP	- CLI Option (OP)
  * CLVB - CLI Verbosity Bit Field (VB)
  * CLVO - CLI Verbosity Options (VO)
  *
  * Standard key mapping 
+ * -B --port-bw 		Emulated bandwidth of an MLD port in MB/s
+ * -D --xfer-dir 		Directory of LD memory load and save files
+ * -E --eid 			MCTP endpoint ID of the switch
  * -h --help 			Display Help
+ * -H --hugepages 		Huge page backing of MLD memory space
+ * -n --connections 	Number of simultaneous FM connections
+ * -t --threads 		Number of worker threads
  * -T --tcp-port 		Server TCP Port
+ * -U --unix-socket 	Path of the local FM socket
  * -V --verbosity 		Set Verbosity Flag
  * -X --verbosity-hex	Set all Verbosity Flags with hex value
  *
@@ -45,6 +53,7 @@
 #define CLMR_HELP_COLUMN 			30
 #define CLMR_MAX_HELP_WIDTH 		100
 #define CLMR_MAX_ARG_STR_LEN 		256
+#define CLMR_MAX_CONNECTIONS 		16
 
 /* ENUMERATIONS ==============================================================*/
 
@@ -60,6 +69,7 @@ enum _CLVO
 	CLVO_ACTIONS	= 4,
 	CLVO_COMMANDS   = 5,
 	CLVO_ERRORS 	= 6,
+	CLVO_PAYLOAD 	= 7,
 	CLVO_MAX
 };
 
@@ -75,6 +85,18 @@ enum _CLVB
 	CLVB_ACTIONS	= (0x01 << 4),
 	CLVB_COMMANDS	= (0x01 << 5),
 	CLVB_ERRORS		= (0x01 << 6),
+	CLVB_PAYLOAD	= (0x01 << 7),
+};
+
+/**
+ * CLI Huge Page backing of MLD memory space (HP)
+ */
+enum _CLHP
+{
+	CLHP_NONE		= 0, 	//!< Regular pages
+	CLHP_THP		= 1, 	//!< Transparent huge pages (madvise)
+	CLHP_HUGETLB	= 2, 	//!< hugetlbfs backing files
+	CLHP_MAX
 };
 
 /**
@@ -90,6 +112,15 @@ enum _CLOP
 	CLOP_TCP_PORT,			//!< TCP Port to listen on for connections <u16>
 	CLOP_TCP_ADDRESS,		//!< TCP Address to listen on for connections <u32>
 	CLOP_QEMU,				//!< qemu switches, no emulation (for now) 
+	CLOP_THREADS,			//!< Number of worker threads servicing requests <u32>
+	CLOP_CONNECTIONS,		//!< Number of simultaneous FM connections <u16>
+	CLOP_LOAD_STATE,		//!< Binary snapshot file to load instead of the config file <str>
+	CLOP_SAVE_STATE,		//!< Binary snapshot file to write the state to <str>
+	CLOP_HUGEPAGES,			//!< Huge page backing of MLD memory space [CLHP] <u8>
+	CLOP_PORT_BW,			//!< Emulated bandwidth of an MLD port in MB/s <u32>
+	CLOP_UNIX_SOCKET,		//!< Path of the AF_UNIX socket co-located FMs connect to <str>
+	CLOP_EID,				//!< MCTP endpoint ID of the switch <u8>
+	CLOP_XFER_DIR,			//!< Directory of LD memory load and save files, unset disables them <str>
 	CLOP_MAX
 };
 
@@ -125,6 +156,8 @@ extern struct opt *opts;
 /* PROTOTYPES ================================================================*/
 
 char *clop(int u);
+char *clhp(int u);
+int clhp_parse(const char *str);
 
 /**
  * Free allocated memory by option parsing proceedure
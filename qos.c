@@ -0,0 +1,302 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		qos.c
+ *
+ * @brief 		Code file for the QoS and backpressure model of MLD ports
+ *
+ * @details 	Every MLD port is modeled as a link of a fixed bandwidth
+ * 				(--port-bw, default 64 MB/s). Each LD has a token bucket that
+ * 				refills at its QoS BW Limit fraction of the port bandwidth and
+ * 				the port has a bucket that refills at the full bandwidth.
+ * 				Memory traffic from the FM API MPC Memory command and the EM
+ * 				API LD transfer command is charged against both. A request is
+ * 				throttled when its LD is over its limit, or when the port is
+ * 				congested and the LD has already received its QoS Allocated BW
+ * 				fraction of the current sample. The bytes requested during
+ * 				each sample, throttled or not, give a backpressure percentage
+ * 				that is averaged over the QoS control sample interval and
+ * 				reported by Get QoS Status.
+ *
+ * 				The model state of a port is protected by the port lock
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ */
+/* INCLUDES ==================================================================*/
+
+/* gettid()
+ */
+#define _GNU_SOURCE
+
+#include <unistd.h>
+
+/* printf()
+ */
+#include <stdio.h>
+
+/* memset()
+ */
+#include <string.h>
+
+/* clock_gettime()
+ */
+#include <time.h>
+
+#include <fmapi.h>
+#include <cxlstate.h>
+
+#include "options.h"
+
+#include "trace.h"
+
+#include "logger.h"
+
+#include "state.h"
+
+/* SWLN_SWITCHES
+ */
+#include "switches.h"
+
+#include "qos.h"
+
+/* MACROS ====================================================================*/
+
+#define QOS_NS 			1000000000ULL 	//!< Nanoseconds per second
+#define QOS_SAMPLE_NS 	(QOLN_SAMPLE_MS * 1000000ULL)
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/**
+ * QoS model state of one port
+ */
+struct qos_port
+{
+	struct cxl_mld *mld; 			//!< MLD the state was built for, NULL if not yet used
+	__u64 last; 					//!< Time of the last refill in ns
+	__u64 start; 					//!< Start of the current sample in ns
+	__u64 demand; 					//!< Bytes requested during the current sample
+	__s64 tokens; 					//!< Port bucket in bytes, negative when congested
+	__s64 ld_tokens[FM_MAX_NUM_LD]; //!< LD buckets in bytes, negative when over the limit
+	__u64 granted[FM_MAX_NUM_LD]; 	//!< Bytes admitted per LD during the current sample
+};
+
+/* PROTOTYPES ================================================================*/
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/**
+ * Model state of each switch indexed by PPID. MAX_PORTS covers every value of
+ * the __u8 ppid of a port
+ */
+static struct qos_port ports[SWLN_SWITCHES][MAX_PORTS];
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Monotonic time in ns
+ */
+static __u64 _qos_now()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * QOS_NS + ts.tv_nsec;
+}
+
+/**
+ * Emulated port bandwidth in bytes per second
+ *
+ * @return 	0 if no port bandwidth is configured and the model is disabled
+ */
+static __u64 _qos_port_rate()
+{
+	if (!opts[CLOP_PORT_BW].set)
+		return 0;
+
+	return (__u64) opts[CLOP_PORT_BW].u32 * 1000000ULL;
+}
+
+/**
+ * Bandwidth of an LD in bytes per second
+ *
+ * The QoS BW Limit is a fraction of the port bandwidth in 1/256 units. A
+ * limit of 0 is treated as no limit, which is what an unconfigured MLD reports.
+ * The bucket of an LD without a limit is kept but never throttles it
+ */
+static __u64 _qos_ld_rate(struct cxl_mld *mld, unsigned ldid, __u64 rate)
+{
+	if (mld->bw_limit[ldid] == 0)
+		return rate;
+
+	return rate * mld->bw_limit[ldid] / 256;
+}
+
+/**
+ * Add the tokens earned in dt ns to a bucket, capped at QOLN_BURST_MS of traffic
+ */
+static __s64 _qos_refill(__s64 tokens, __u64 rate, __u64 dt)
+{
+	__s64 depth;
+
+	depth = rate * QOLN_BURST_MS / 1000;
+
+	// Split the scaling so a high rate does not overflow over a long dt
+	tokens += (rate / 1000) * (dt / 1000) / 1000;
+	if (tokens > depth)
+		tokens = depth;
+
+	return tokens;
+}
+
+/**
+ * Bring the model state of a port up to date
+ *
+ * STEPS
+ * 1: Reset the state if the port was not used yet or the device changed
+ * 2: Refill the buckets
+ * 3: Fold each elapsed sample into the moving average
+ */
+static void _qos_advance(struct cxl_port *p, struct qos_port *q, __u64 now)
+{
+	struct cxl_mld *mld;
+	__u64 rate, cap, dt, pcnt;
+	unsigned i, n;
+
+	mld = p->mld;
+	rate = _qos_port_rate();
+
+	// STEP 1: Reset the state if the port was not used yet or the device changed
+	if (q->mld != mld)
+	{
+		memset(q, 0, sizeof(*q));
+		q->mld = mld;
+		q->last = now;
+		q->start = now;
+		q->tokens = _qos_refill(0, rate, QOS_NS);
+		for ( i = 0 ; i < FM_MAX_NUM_LD ; i++ )
+			q->ld_tokens[i] = _qos_refill(0, _qos_ld_rate(mld, i, rate), QOS_NS);
+		return;
+	}
+
+	// STEP 2: Refill the buckets
+	dt = now - q->last;
+	if (dt > QOS_NS)
+		dt = QOS_NS;
+	q->last = now;
+
+	q->tokens = _qos_refill(q->tokens, rate, dt);
+	for ( i = 0 ; i < FM_MAX_NUM_LD ; i++ )
+		q->ld_tokens[i] = _qos_refill(q->ld_tokens[i], _qos_ld_rate(mld, i, rate), dt);
+
+	// STEP 3: Fold each elapsed sample into the moving average
+	cap = rate * QOLN_SAMPLE_MS / 1000;
+	n = mld->sample_interval ? mld->sample_interval : QOLN_SAMPLES;
+	for ( i = 0 ; now - q->start >= QOS_SAMPLE_NS ; i++ )
+	{
+		// A long idle period has decayed the average, skip the idle samples
+		if (i >= QOLN_MAX_SAMPLES)
+		{
+			mld->bp_avg_pcnt = 0;
+			q->start = now;
+			break;
+		}
+
+		pcnt = q->demand * 100 / cap;
+		if (pcnt > 100)
+			pcnt = 100;
+
+		mld->bp_avg_pcnt = (mld->bp_avg_pcnt * (n - 1) + pcnt + n / 2) / n;
+
+		q->demand = 0;
+		memset(q->granted, 0, sizeof(q->granted));
+		q->start += QOS_SAMPLE_NS;
+	}
+}
+
+/**
+ * Charge memory traffic of an LD against the QoS model of its port
+ *
+ * Call with the port lock held
+ *
+ * @param p 		struct cxl_port* the traffic is on
+ * @param ldid 		LD the traffic targets
+ * @param bytes 	Length of the transfer
+ * @return 			0 if the transfer may proceed, 1 if it is throttled
+ *
+ * The model is off until a port bandwidth is configured, and an LD is only
+ * throttled by a QoS BW Limit or Allocated BW that is not 0
+ *
+ * STEPS
+ * 1: Bring the model up to date
+ * 2: Throttle an LD that is over its bandwidth limit
+ * 3: Throttle an LD that is over its allocation while the port is congested
+ * 4: Admit the transfer
+ */
+int qos_charge(struct cxl_port *p, unsigned ldid, __u64 bytes)
+{
+	INIT
+	struct qos_port *q;
+	__u64 share;
+	int rv;
+
+	ENTER
+
+	// Initialize variables
+	rv = 0;
+
+	if (p->mld == NULL || ldid >= FM_MAX_NUM_LD || _qos_port_rate() == 0)
+		goto end;
+
+	q = &ports[cxls_id][p->ppid];
+
+	STEP // 1: Bring the model up to date
+	_qos_advance(p, q, _qos_now());
+	q->demand += bytes;
+
+	STEP // 2: Throttle an LD that is over its bandwidth limit
+	if (p->mld->bw_limit[ldid] != 0 && q->ld_tokens[ldid] < 0)
+	{
+		IFV(CLVB_ACTIONS) logger_printf("ACT: Throttled PPID %u LDID %u over its bandwidth limit\n", p->ppid, ldid);
+		rv = 1;
+		goto end;
+	}
+
+	STEP // 3: Throttle an LD that is over its allocation while the port is congested
+	share = _qos_port_rate() * QOLN_SAMPLE_MS / 1000 * p->mld->alloc_bw[ldid] / 256;
+	if (p->mld->alloc_bw[ldid] != 0 && q->tokens < 0 && q->granted[ldid] >= share)
+	{
+		IFV(CLVB_ACTIONS) logger_printf("ACT: Throttled PPID %u LDID %u over its allocation\n", p->ppid, ldid);
+		rv = 1;
+		goto end;
+	}
+
+	STEP // 4: Admit the transfer
+	q->ld_tokens[ldid] -= bytes;
+	q->tokens -= bytes;
+	q->granted[ldid] += bytes;
+
+end:
+
+	EXIT(rv)
+
+	return rv;
+}
+
+/**
+ * Bring the backpressure average of a port up to date before it is reported
+ *
+ * Call with the port lock held
+ */
+void qos_update(struct cxl_port *p)
+{
+	if (p->mld == NULL || _qos_port_rate() == 0)
+		return;
+
+	_qos_advance(p, &ports[cxls_id][p->ppid], _qos_now());
+}
@@ -0,0 +1,46 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		qos.h
+ *
+ * @brief 		Header file for the QoS and backpressure model of MLD ports
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ * Macro / Enumeration Prefixes (QO)
+ * QOLN	- QoS Length (LN)
+ */
+#ifndef _QOS_H
+#define _QOS_H
+
+/* INCLUDES ==================================================================*/
+
+/* __u64
+ */
+#include <linux/types.h>
+
+/* struct cxl_port
+ */
+#include <cxlstate.h>
+
+/* MACROS ====================================================================*/
+
+#define QOLN_SAMPLE_MS 		100 	//!< Length of one backpressure sample
+#define QOLN_BURST_MS 		10 		//!< Traffic a token bucket can accumulate while idle
+#define QOLN_SAMPLES 		8 		//!< Samples averaged when the QoS control sample interval is 0
+#define QOLN_MAX_SAMPLES 	64 		//!< Max idle samples applied at once before the average is cleared
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/* PROTOTYPES ================================================================*/
+
+int qos_charge(struct cxl_port *p, unsigned ldid, __u64 bytes);
+void qos_update(struct cxl_port *p);
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+#endif //_QOS_H
@@ -0,0 +1,305 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		respool.c
+ *
+ * @brief 		Code file for non-blocking checkout of response buffers
+ *
+ * @details 	Response mctp_msg buffers come from the pool each mctp instance
+ * 				owns (m->msgs). Rather than blocking a handler thread when that
+ * 				pool is empty, buffers are checked out without waiting. A small 
+ * 				reserve is held back for each connection so that a busy 
+ * 				response can still be sent when the pool is exhausted. The 
+ * 				reserve is topped back up from the pool whenever a checkout 
+ * 				succeeds. The reserve is per connection rather than per 
+ * 				worker because the buffers belong to the pool of the mctp
+ * 				instance the response is sent on, which a worker serving 
+ * 				several connections could not refill from.
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ */
+/* INCLUDES ==================================================================*/
+
+/* NULL
+ */
+#include <stddef.h>
+
+/* pthread_mutex_t
+ */
+#include <pthread.h>
+
+#include <mctp.h>
+#include <ptrqueue.h>
+
+#include "options.h"
+
+/* SWLN_SWITCHES
+ */
+#include "switches.h"
+
+/* LOLN_CONNECTIONS
+ */
+#include "local.h"
+
+#include "respool.h"
+
+/* MACROS ====================================================================*/
+
+#define RPLN_POOLS 		(SWLN_SWITCHES * CLMR_MAX_CONNECTIONS + LOLN_CONNECTIONS) 	//!< Max connections with a reserve, TCP and local
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/**
+ * Reserve of response buffers for one mctp instance
+ */
+struct respool
+{
+	struct mctp *m; 				//!< NULL if the slot is free
+	pthread_mutex_t mtx;
+	struct mctp_msg *reserve[RPLN_RESERVE];
+	struct respool_stats stats;
+};
+
+/* PROTOTYPES ================================================================*/
+
+static struct respool *respool_find(struct mctp *m);
+static void respool_refill(struct respool *p);
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/**
+ * One slot per mctp instance, TCP connections of each switch and local FM 
+ * connections. Local connections come and go while requests are serviced, 
+ * so a slot is published by an atomic store of m after it is set up and freed
+ * slots are reused. Lookups need no lock. num_pools is the high water mark of
+ * used slots
+ */
+static struct respool pools[RPLN_POOLS];
+static unsigned num_pools = 0;
+static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Slot last found by the calling thread. A handler thread serves one 
+ * connection, so this saves the scan of pools[] on nearly every request
+ */
+static __thread struct respool *last = NULL;
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Set aside the reserve of response buffers for an mctp instance
+ *
+ * Must be called after mctp_init() and before the instance receives requests
+ *
+ * @return 	0 upon success, 1 otherwise
+ */
+int respool_init(struct mctp *m)
+{
+	struct respool *p;
+	unsigned i;
+
+	if (m == NULL)
+		return 1;
+
+	pthread_mutex_lock(&mtx);
+	for ( i = 0 ; i < RPLN_POOLS ; i++ )
+		if (__atomic_load_n(&pools[i].m, __ATOMIC_RELAXED) == NULL)
+			break;
+
+	if (i == RPLN_POOLS)
+	{
+		pthread_mutex_unlock(&mtx);
+		return 1;
+	}
+
+	// A reused slot keeps its mutex, respool_stats() may be holding it
+	p = &pools[i];
+	if (i >= num_pools)
+		pthread_mutex_init(&p->mtx, NULL);
+
+	pthread_mutex_lock(&p->mtx);
+	p->stats = (struct respool_stats) { 0 };
+	while (p->stats.num < RPLN_RESERVE)
+	{
+		p->reserve[p->stats.num] = pq_pop(m->msgs, 0);
+		if (p->reserve[p->stats.num] == NULL)
+			break;
+		p->stats.num++;
+	}
+	p->stats.min = p->stats.num;
+	pthread_mutex_unlock(&p->mtx);
+
+	__atomic_store_n(&p->m, m, __ATOMIC_RELEASE);
+	if (i >= num_pools)
+		__atomic_store_n(&num_pools, i + 1, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&mtx);
+
+	return 0;
+}
+
+/**
+ * Return the reserved buffers of an mctp instance to its pool and free its
+ * slot
+ *
+ * Must be called before mctp_free(), once no thread services requests of m
+ */
+void respool_free(struct mctp *m)
+{
+	struct respool *p;
+
+	p = respool_find(m);
+	if (p == NULL) 
+		return;
+
+	pthread_mutex_lock(&p->mtx);
+	while (p->stats.num > 0)
+		pq_push(m->msgs, p->reserve[--p->stats.num]);
+	pthread_mutex_unlock(&p->mtx);
+
+	pthread_mutex_lock(&mtx);
+	__atomic_store_n(&p->m, NULL, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&mtx);
+
+	if (last == p)
+		last = NULL;
+}
+
+/**
+ * Check out a response buffer without blocking 
+ *
+ * @return 	struct mctp_msg* or NULL if the pool is empty 
+ */
+struct mctp_msg *respool_get(struct mctp *m)
+{
+	struct respool *p;
+	struct mctp_msg *mm;
+
+	p = respool_find(m);
+
+	mm = pq_pop(m->msgs, 0);
+	if (p == NULL)
+		return mm;
+
+	if (mm == NULL) 
+	{
+		__atomic_add_fetch(&p->stats.exhausted, 1, __ATOMIC_RELAXED);
+		return NULL;
+	}
+
+	__atomic_add_fetch(&p->stats.acquired, 1, __ATOMIC_RELAXED);
+
+	if (__atomic_load_n(&p->stats.num, __ATOMIC_RELAXED) < RPLN_RESERVE)
+	{
+		pthread_mutex_lock(&p->mtx);
+		respool_refill(p);
+		pthread_mutex_unlock(&p->mtx);
+	}
+
+	return mm;
+}
+
+/**
+ * Check out a buffer from the reserve to send a busy response 
+ *
+ * @return 	struct mctp_msg* or NULL if the reserve is empty too 
+ */
+struct mctp_msg *respool_get_reserve(struct mctp *m)
+{
+	struct respool *p;
+	struct mctp_msg *mm;
+
+	p = respool_find(m);
+	if (p == NULL)
+		return NULL;
+
+	mm = NULL;
+
+	pthread_mutex_lock(&p->mtx);
+	if (p->stats.num > 0)
+	{
+		mm = p->reserve[--p->stats.num];
+		if (p->stats.num < p->stats.min)
+			p->stats.min = p->stats.num;
+		p->stats.busy++;
+	}
+	else 
+		p->stats.dropped++;
+	pthread_mutex_unlock(&p->mtx);
+
+	return mm;
+}
+
+/**
+ * Return the number of slots that have held a reserve
+ */
+unsigned respool_num()
+{
+	return __atomic_load_n(&num_pools, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Copy the accounting of one mctp instance 
+ *
+ * A slot freed by a closed local connection keeps its accounting until it
+ * is reused
+ *
+ * @param i 	Index of the slot, TCP connections in the order they started
+ * @return 		0 upon success, 1 if i is out of range
+ */
+int respool_stats(unsigned i, struct respool_stats *s)
+{
+	if (i >= respool_num())
+		return 1;
+
+	pthread_mutex_lock(&pools[i].mtx);
+	*s = pools[i].stats;
+	pthread_mutex_unlock(&pools[i].mtx);
+
+	return 0;
+}
+
+/**
+ * Find the reserve of an mctp instance 
+ */
+static struct respool *respool_find(struct mctp *m)
+{
+	struct respool *p;
+	unsigned i, num;
+
+	p = last;
+	if (p != NULL && __atomic_load_n(&p->m, __ATOMIC_ACQUIRE) == m)
+		return p;
+
+	num = __atomic_load_n(&num_pools, __ATOMIC_ACQUIRE);
+	for ( i = 0 ; i < num ; i++ )
+	{
+		if (__atomic_load_n(&pools[i].m, __ATOMIC_ACQUIRE) == m)
+		{
+			last = &pools[i];
+			return last;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Top the reserve back up from the pool without blocking. Caller holds p->mtx
+ */
+static void respool_refill(struct respool *p)
+{
+	struct mctp_msg *mm;
+
+	while (p->stats.num < RPLN_RESERVE)
+	{
+		mm = pq_pop(p->m->msgs, 0);
+		if (mm == NULL)
+			break;
+		p->reserve[p->stats.num++] = mm;
+	}
+}
@@ -0,0 +1,61 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		respool.h
+ *
+ * @brief 		Header file for non-blocking checkout of response buffers
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ * Macro / Enumeration Prefixes (RP)
+ * RPLN	- Response Pool Length (LN)
+ */
+#ifndef _RESPOOL_H
+#define _RESPOOL_H
+
+/* INCLUDES ==================================================================*/
+
+/* __u64
+ */
+#include <linux/types.h>
+
+/* struct mctp
+ * struct mctp_msg
+ */
+#include <mctp.h>
+
+/* MACROS ====================================================================*/
+
+#define RPLN_RESERVE 		4 		//!< Buffers held back per connection to send busy responses
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/**
+ * Response buffer accounting of one MCTP connection
+ */
+struct respool_stats
+{
+	unsigned num; 					//!< Buffers currently in the reserve
+	unsigned min; 					//!< Low water mark of num
+	__u64 acquired; 				//!< Buffers checked out from the mctp pool
+	__u64 exhausted; 				//!< Times the mctp pool was empty 
+	__u64 busy; 					//!< Busy responses sent from the reserve
+	__u64 dropped; 					//!< Requests failed because the reserve was also empty
+};
+
+/* PROTOTYPES ================================================================*/
+
+int respool_init(struct mctp *m);
+void respool_free(struct mctp *m);
+struct mctp_msg *respool_get(struct mctp *m);
+struct mctp_msg *respool_get_reserve(struct mctp *m);
+unsigned respool_num();
+int respool_stats(unsigned i, struct respool_stats *s);
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+#endif //_RESPOOL_H
@@ -33,28 +33,12 @@
 
 #include "options.h"
 
+#include "trace.h"
+
 #include "signals.h"
 
 /* MACROS ====================================================================*/
 
-#ifdef CSE_VERBOSE
- #define INIT 			unsigned step = 0;
- #define ENTER 					if (opts[CLOP_VERBOSITY].u64 & CLVB_CALLSTACK) 	printf("%d:%s Enter\n", 			gettid(), __FUNCTION__);
- #define STEP 			step++; if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u\n", 			gettid(), __FUNCTION__, step);
- #define HEX32(m, i)			if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u %s: 0x%x\n",	gettid(), __FUNCTION__, step, m, i);
- #define INT32(m, i)			if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u %s: %d\n",	gettid(), __FUNCTION__, step, m, i);
- #define EXIT(rc) 				if (opts[CLOP_VERBOSITY].u64 & CLVB_CALLSTACK) 	printf("%d:%s Exit: %d\n", 			gettid(), __FUNCTION__,rc);
-#else
- #define ENTER
- #define EXIT(rc)
- #define STEP
- #define HEX32(m, i)
- #define INT32(m, i)
- #define INIT 
-#endif // CSE_VERBOSE
-
-#define IFV(u) 							if (opts[CLOP_VERBOSITY].u64 & u) 
-
 /* ENUMERATIONS ==============================================================*/
 
 /* STRUCTS ===================================================================*/
@@ -68,6 +52,18 @@
  */
 int stop_requested = 0;
 
+/**
+ * Global variable used for the signal handlers to tell the main loop to reload
+ * the config file
+ */
+int reload_requested = 0;
+
+/**
+ * Global variable used for the signal handlers to tell the main loop to dump
+ * the trace buffers
+ */
+int dump_requested = 0;
+
 /* FUNCTIONS =================================================================*/
 
 /**
@@ -78,6 +74,8 @@ void signals_register()
 	ENTER
 
 	signal(SIGINT, signals_sigint);
+	signal(SIGHUP, signals_sighup);
+	signal(SIGUSR1, signals_sigusr1);
 
 	EXIT(0)
 }
@@ -96,3 +94,29 @@ void signals_sigint(int sig)
 	EXIT(0)
 }
 
+/**
+ * Handler for SIGHUP
+ */
+void signals_sighup(int sig)
+{
+	ENTER
+
+	IFV(CLVB_CALLSTACK) printf("Caught Signal: %d - %s\n",  sig, strsignal(sig));
+
+	reload_requested = 1;	
+
+	EXIT(0)
+}
+
+/**
+ * Handler for SIGUSR1
+ *
+ * No ENTER / EXIT here, the signal may have interrupted a trace record of
+ * the same thread and the dump should show the trace as it was
+ */
+void signals_sigusr1(int sig)
+{
+	IFV(CLVB_CALLSTACK) printf("Caught Signal: %d - %s\n",  sig, strsignal(sig));
+
+	dump_requested = 1;
+}
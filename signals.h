@@ -33,8 +33,20 @@ void signals_register();
  */
 void signals_sigint(int sig);
 
+/**
+ * Handler for SIGHUP (reload config file)
+ */
+void signals_sighup(int sig);
+
+/**
+ * Handler for SIGUSR1 (dump trace buffers)
+ */
+void signals_sigusr1(int sig);
+
 /* GLOBAL VARIABLES ==========================================================*/
 
 extern int stop_requested;
+extern int reload_requested;
+extern int dump_requested;
 
 #endif //ifndef _SIGNALS_H
@@ -0,0 +1,1223 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		snapshot.c
+ *
+ * @brief 		Code file for the binary switch state snapshot
+ *
+ * @details 	The YAML config file remains the authoring format. Parsing it
+ * 				walks nested hash tables and converts every value from a string
+ * 				which is slow for large configurations. A snapshot stores the
+ * 				loaded struct cxl_switch as arrays of fixed size records so it
+ * 				can be mapped, validated in a single pass and copied into the
+ * 				switch state without any parsing.
+ *
+ * 				The snapshot records the switch identity, the device catalog,
+ * 				ports, VCSs and vPPB bindings, config space and the MLD
+ * 				allocations. Devices are reconnected to their ports when the
+ * 				snapshot is loaded and the saved port state is then restored
+ * 				over the freshly connected device. The snapshot uses host byte
+ * 				order and is not intended to be moved between machines.
+ *
+ * 				The memory space of file backed ports is saved to an image
+ * 				file next to the snapshot. Only the populated extents of each
+ * 				sparse backing file are found with SEEK_DATA / SEEK_HOLE and
+ * 				copied, so saving and restoring the memory of a test fabric
+ * 				costs what was written rather than the size of the devices.
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ */
+/* INCLUDES ==================================================================*/
+
+/* gettid()
+ * lseek()
+ * copy_file_range()
+ */
+#define _GNU_SOURCE
+
+#include <unistd.h>
+
+/* printf()
+ * snprintf()
+ * rename()
+ */
+#include <stdio.h>
+
+/* calloc()
+ * realloc()
+ * free()
+ */
+#include <stdlib.h>
+
+/* memcpy()
+ * memcmp()
+ * strdup()
+ */
+#include <string.h>
+
+/* errno
+ */
+#include <errno.h>
+
+/* open()
+ * fallocate()
+ */
+#include <fcntl.h>
+
+/* fstat()
+ */
+#include <sys/stat.h>
+
+/* mmap()
+ * munmap()
+ */
+#include <sys/mman.h>
+
+#include <fmapi.h>
+#include <cxlstate.h>
+
+#include "options.h"
+
+#include "trace.h"
+
+#include "state.h"
+
+#include "snapshot.h"
+
+#include "memspace.h"
+
+/* MACROS ====================================================================*/
+
+#define SSLN_ALIGN 			8 				//!< Alignment of each section in the file
+#define SSLN_GROW 			4096 			//!< Minimum growth of a section buffer
+#define SSLN_COPY 			(1 << 20) 		//!< Buffer size of a copy between files
+
+#define SS_FNV_BASIS 		0xcbf29ce484222325ULL
+#define SS_FNV_PRIME 		0x100000001b3ULL
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/**
+ * Growable buffer used to build a section of the snapshot
+ */
+struct ss_buf
+{
+	__u8 *data;
+	size_t len;
+	size_t cap;
+	int err; 				//!< Set to 1 if an allocation failed
+};
+
+/* PROTOTYPES ================================================================*/
+
+static size_t _ss_append(struct ss_buf *b, const void *ptr, size_t len);
+static __u32 _ss_str(struct ss_buf *strs, const char *str);
+static __u32 _ss_blob(struct ss_buf *blobs, __u8 *cfgspace);
+static __u32 _ss_mld(struct ss_buf *mlds, struct ss_buf *blobs, struct cxl_mld *mld);
+static void _ss_restore_mld(struct cxl_mld *mld, struct ss_mld *r, __u8 *blobs);
+static int _ss_save_memory(struct cxl_port *p, int img, __u64 *img_len, struct ss_buf *exts);
+static int _ss_copy(int in, __u64 in_off, int out, __u64 out_off, __u64 len);
+static __u8 *_ss_map(char *filename, size_t *len, int *rv);
+static int _ss_section_ok(__u64 off, __u64 count, __u64 size, size_t len);
+static int _ss_str_ok(struct ss_hdr *h, __u32 off);
+static int _ss_idx_ok(__u32 idx, __u32 num);
+static int _ss_validate(__u8 *base, size_t len);
+static __u64 _ss_hash(__u8 *buf, size_t len);
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Write the switch state to a snapshot file
+ *
+ * The file is written to a temporary name and renamed into place so an
+ * existing snapshot is never left partially written
+ *
+ * @param s 		struct cxl_switch to save
+ * @param filename 	Path of the snapshot file
+ * @return 			0 upon success. Non zero otherwise
+ *
+ * STEPS
+ * 1: Validate inputs
+ * 2: Serialize switch record
+ * 3: Serialize device catalog
+ * 4: Serialize ports and copy their memory to the image file
+ * 5: Serialize VCSs and vPPBs
+ * 6: Assemble sections into one buffer and fill header
+ * 7: Write file
+ * 8: Move image file and snapshot into place
+ */
+int snapshot_save(struct cxl_switch *s, char *filename)
+{
+	INIT
+	int rv, fd, imgfd;
+	unsigned i, k;
+	size_t off;
+	ssize_t n;
+	char tmp[MAX_FILE_NAME_LEN];
+	char img[MAX_FILE_NAME_LEN];
+	char dst[MAX_FILE_NAME_LEN];
+	__u64 img_len;
+	__u8 *file;
+	struct ss_hdr hdr;
+	struct ss_switch sw;
+	struct ss_device dev;
+	struct ss_port port;
+	struct ss_vcs vcs;
+	struct ss_vppb vppb;
+	struct ss_buf devs, ports, vcss, vppbs, mlds, blobs, strs, exts;
+	struct cxl_port *p;
+	struct cxl_device *d;
+	struct cxl_vppb *v;
+
+	ENTER
+
+	// Initialize variables
+	rv = 1;
+	file = NULL;
+	imgfd = -1;
+	img_len = 0;
+	memset(&hdr, 0, sizeof(hdr));
+	memset(&devs, 0, sizeof(devs));
+	memset(&ports, 0, sizeof(ports));
+	memset(&vcss, 0, sizeof(vcss));
+	memset(&vppbs, 0, sizeof(vppbs));
+	memset(&mlds, 0, sizeof(mlds));
+	memset(&blobs, 0, sizeof(blobs));
+	memset(&strs, 0, sizeof(strs));
+	memset(&exts, 0, sizeof(exts));
+
+	STEP // 1: Validate inputs
+	if (s == NULL || filename == NULL)
+	{
+		rv = EINVAL;
+		goto end;
+	}
+	snprintf(tmp, sizeof(tmp), "%s.tmp", filename);
+	snprintf(img, sizeof(img), "%s%s.tmp", filename, SSFN_IMAGE);
+
+	// Offset 0 of the string section is the empty string
+	_ss_append(&strs, "", 1);
+
+	STEP // 2: Serialize switch record
+	memset(&sw, 0, sizeof(sw));
+	sw.sn 				= s->sn;
+	sw.dir 				= _ss_str(&strs, s->dir);
+	sw.vid 				= s->vid;
+	sw.did 				= s->did;
+	sw.svid 			= s->svid;
+	sw.ssid 			= s->ssid;
+	sw.bos_opcode 		= s->bos_opcode;
+	sw.bos_rc 			= s->bos_rc;
+	sw.bos_ext 			= s->bos_ext;
+	sw.version 			= s->version;
+	sw.max_msg_size_n 	= s->max_msg_size_n;
+	sw.msg_rsp_limit_n 	= s->msg_rsp_limit_n;
+	sw.bos_running 		= s->bos_running;
+	sw.bos_pcnt 		= s->bos_pcnt;
+	sw.ingress_port 	= s->ingress_port;
+	sw.num_decoders 	= s->num_decoders;
+	sw.mlw 				= s->mlw;
+	sw.speeds 			= s->speeds;
+	sw.mls 				= s->mls;
+
+	STEP // 3: Serialize device catalog
+	for ( i = 0 ; i < s->num_devices ; i++ )
+	{
+		d = &s->devices[i];
+
+		memset(&dev, 0, sizeof(dev));
+		dev.name 		= _ss_str(&strs, d->name);
+		dev.cfgspace 	= _ss_blob(&blobs, d->cfgspace);
+		dev.mld 		= _ss_mld(&mlds, &blobs, d->mld);
+		dev.rootport 	= d->rootport;
+		dev.dv 			= d->dv;
+		dev.dt 			= d->dt;
+		dev.cv 			= d->cv;
+		dev.mlw 		= d->mlw;
+		dev.mls 		= d->mls;
+		_ss_append(&devs, &dev, sizeof(dev));
+	}
+
+	STEP // 4: Serialize ports and copy their memory to the image file
+	for ( i = 0 ; i < s->num_ports ; i++ )
+	{
+		p = &s->ports[i];
+
+		memset(&port, 0, sizeof(port));
+		port.device_name 	= _ss_str(&strs, p->device_name);
+		port.cfgspace 		= _ss_blob(&blobs, p->cfgspace);
+		port.mld 			= _ss_mld(&mlds, &blobs, p->mld);
+		port.ppid 			= p->ppid;
+		port.state 			= p->state;
+		port.dv 			= p->dv;
+		port.dt 			= p->dt;
+		port.cv 			= p->cv;
+		port.mlw 			= p->mlw;
+		port.nlw 			= p->nlw;
+		port.speeds 		= p->speeds;
+		port.mls 			= p->mls;
+		port.cls 			= p->cls;
+		port.ltssm 			= p->ltssm;
+		port.lane 			= p->lane;
+		port.lane_rev 		= p->lane_rev;
+		port.perst 			= p->perst;
+		port.prsnt 			= p->prsnt;
+		port.pwrctrl 		= p->pwrctrl;
+		port.ld 			= p->ld;
+
+		if (p->mld != NULL && memspace_fd(p) >= 0)
+		{
+			if (imgfd < 0)
+			{
+				imgfd = open(img, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+				if (imgfd < 0)
+				{
+					rv = errno;
+					IFV(CLVB_ERRORS) printf("%d:%s ERR: Could not open image file %s\n", gettid(), __FUNCTION__, img);
+					goto free;
+				}
+			}
+
+			if (_ss_save_memory(p, imgfd, &img_len, &exts) != 0)
+			{
+				rv = EIO;
+				IFV(CLVB_ERRORS) printf("%d:%s ERR: Could not save memory of port %u\n", gettid(), __FUNCTION__, i);
+				goto free;
+			}
+			port.memimg = 1;
+		}
+
+		_ss_append(&ports, &port, sizeof(port));
+	}
+
+	STEP // 5: Serialize VCSs and vPPBs
+	for ( i = 0 ; i < s->num_vcss ; i++ )
+	{
+		vcs.vcsid 	= s->vcss[i].vcsid;
+		vcs.state 	= s->vcss[i].state;
+		vcs.uspid 	= s->vcss[i].uspid;
+		vcs.num 	= s->vcss[i].num;
+		_ss_append(&vcss, &vcs, sizeof(vcs));
+
+		for ( k = 0 ; k < s->num_vppbs ; k++ )
+		{
+			v = &s->vcss[i].vppbs[k];
+			vppb.vppbid 		= v->vppbid;
+			vppb.ldid 			= v->ldid;
+			vppb.bind_status 	= v->bind_status;
+			vppb.ppid 			= v->ppid;
+			_ss_append(&vppbs, &vppb, sizeof(vppb));
+		}
+	}
+
+	if (strs.err || devs.err || ports.err || vcss.err || vppbs.err || mlds.err || blobs.err || exts.err)
+	{
+		rv = ENOMEM;
+		goto free;
+	}
+
+	STEP // 6: Assemble sections into one buffer and fill header
+	memcpy(hdr.magic, SS_MAGIC, SSLN_MAGIC);
+	hdr.version 	= SS_VERSION;
+	hdr.hdr_len 	= sizeof(hdr);
+	hdr.num_ports 	= s->num_ports;
+	hdr.num_vcss 	= s->num_vcss;
+	hdr.num_vppbs 	= s->num_vppbs;
+	hdr.num_devices = s->num_devices;
+	hdr.num_mlds 	= mlds.len / sizeof(struct ss_mld);
+	hdr.num_blobs 	= blobs.len / CFG_SPACE_SIZE;
+	hdr.len_strings = strs.len;
+	hdr.num_extents = exts.len / sizeof(struct ss_extent);
+	hdr.len_image 	= img_len;
+
+	off = (sizeof(hdr) + SSLN_ALIGN - 1) & ~(SSLN_ALIGN - 1);
+	hdr.off_switch 	= off; 	off += (sizeof(sw) + SSLN_ALIGN - 1) & ~(SSLN_ALIGN - 1);
+	hdr.off_devices = off; 	off += (devs.len   + SSLN_ALIGN - 1) & ~(SSLN_ALIGN - 1);
+	hdr.off_ports 	= off; 	off += (ports.len  + SSLN_ALIGN - 1) & ~(SSLN_ALIGN - 1);
+	hdr.off_vcss 	= off; 	off += (vcss.len   + SSLN_ALIGN - 1) & ~(SSLN_ALIGN - 1);
+	hdr.off_vppbs 	= off; 	off += (vppbs.len  + SSLN_ALIGN - 1) & ~(SSLN_ALIGN - 1);
+	hdr.off_mlds 	= off; 	off += (mlds.len   + SSLN_ALIGN - 1) & ~(SSLN_ALIGN - 1);
+	hdr.off_blobs 	= off; 	off += (blobs.len  + SSLN_ALIGN - 1) & ~(SSLN_ALIGN - 1);
+	hdr.off_extents = off; 	off += (exts.len   + SSLN_ALIGN - 1) & ~(SSLN_ALIGN - 1);
+	hdr.off_strings = off; 	off += strs.len;
+	hdr.file_len 	= off;
+
+	file = calloc(1, hdr.file_len);
+	if (file == NULL)
+	{
+		rv = ENOMEM;
+		goto free;
+	}
+
+	memcpy(&file[hdr.off_switch], &sw, sizeof(sw));
+	if (devs.len)	memcpy(&file[hdr.off_devices], 	devs.data, 	devs.len);
+	if (ports.len)	memcpy(&file[hdr.off_ports], 	ports.data, ports.len);
+	if (vcss.len)	memcpy(&file[hdr.off_vcss], 	vcss.data, 	vcss.len);
+	if (vppbs.len)	memcpy(&file[hdr.off_vppbs], 	vppbs.data, vppbs.len);
+	if (mlds.len)	memcpy(&file[hdr.off_mlds], 	mlds.data, 	mlds.len);
+	if (blobs.len)	memcpy(&file[hdr.off_blobs], 	blobs.data, blobs.len);
+	if (exts.len)	memcpy(&file[hdr.off_extents], 	exts.data, 	exts.len);
+	memcpy(&file[hdr.off_strings], strs.data, strs.len);
+
+	hdr.checksum = _ss_hash(&file[sizeof(hdr)], hdr.file_len - sizeof(hdr));
+	memcpy(file, &hdr, sizeof(hdr));
+
+	STEP // 7: Write file
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+	{
+		rv = errno;
+		IFV(CLVB_ERRORS) printf("%d:%s ERR: Could not open snapshot file %s\n", gettid(), __FUNCTION__, tmp);
+		goto free;
+	}
+
+	errno = 0;
+	for ( off = 0 ; off < hdr.file_len ; off += n )
+	{
+		n = write(fd, &file[off], hdr.file_len - off);
+		if (n <= 0)
+			break;
+	}
+
+	if (off < hdr.file_len || fsync(fd) != 0)
+	{
+		rv = errno ? errno : EIO;
+		close(fd);
+		unlink(tmp);
+		goto free;
+	}
+	close(fd);
+
+	STEP // 8: Move image file and snapshot into place
+	// The image is renamed first so a snapshot never refers to a missing image
+	snprintf(dst, sizeof(dst), "%s%s", filename, SSFN_IMAGE);
+	if (imgfd >= 0)
+	{
+		if (fsync(imgfd) != 0 || rename(img, dst) != 0)
+		{
+			rv = errno;
+			unlink(tmp);
+			goto free;
+		}
+		close(imgfd);
+		imgfd = -1;
+	}
+	else
+		unlink(dst);
+
+	if (rename(tmp, filename) != 0)
+	{
+		rv = errno;
+		unlink(tmp);
+		goto free;
+	}
+
+	IFV(CLVB_GENERAL) printf("%d:%s Saved state snapshot %s: %llu bytes, %llu bytes of LD memory in %llu extents\n", gettid(), __FUNCTION__, filename, hdr.file_len, hdr.len_image, hdr.num_extents);
+
+	rv = 0;
+
+free:
+
+	if (imgfd >= 0)
+	{
+		close(imgfd);
+		unlink(img);
+	}
+
+	free(file);
+	free(exts.data);
+	free(devs.data);
+	free(ports.data);
+	free(vcss.data);
+	free(vppbs.data);
+	free(mlds.data);
+	free(blobs.data);
+	free(strs.data);
+
+end:
+
+	EXIT(rv)
+
+	return rv;
+}
+
+/**
+ * Load the switch state from a snapshot file
+ *
+ * The whole file is validated before the switch state is modified
+ *
+ * @param s 		struct cxl_switch to fill
+ * @param filename 	Path of the snapshot file
+ * @return 			0 upon success. Non zero otherwise
+ *
+ * STEPS
+ * 1: Validate inputs
+ * 2: Map and validate the file
+ * 3: Size ports and VCSs
+ * 4: Restore switch record
+ * 5: Restore device catalog
+ * 6: Restore ports and reconnect devices
+ * 7: Restore VCSs and vPPBs
+ * 8: Unmap the file
+ */
+int snapshot_load(struct cxl_switch *s, char *filename)
+{
+	INIT
+	int rv, id;
+	unsigned i, k;
+	size_t len;
+	__u8 *base, *blobs;
+	char *strs;
+	struct ss_hdr *hdr;
+	struct ss_switch *sw;
+	struct ss_device *dev;
+	struct ss_port *port;
+	struct ss_vcs *vcs;
+	struct ss_vppb *vppb;
+	struct ss_mld *mlds;
+	struct cxl_port *p;
+	struct cxl_device *d;
+	struct cxl_vppb *v;
+
+	ENTER
+
+	// Initialize variables
+	rv = 1;
+
+	STEP // 1: Validate inputs
+	if (s == NULL || filename == NULL)
+	{
+		rv = EINVAL;
+		goto end;
+	}
+
+	STEP // 2: Map and validate the file
+	base = _ss_map(filename, &len, &rv);
+	if (base == NULL)
+		goto end;
+
+	hdr 	= (struct ss_hdr*) base;
+	sw 		= (struct ss_switch*) &base[hdr->off_switch];
+	dev 	= (struct ss_device*) &base[hdr->off_devices];
+	port 	= (struct ss_port*) &base[hdr->off_ports];
+	vcs 	= (struct ss_vcs*) &base[hdr->off_vcss];
+	vppb 	= (struct ss_vppb*) &base[hdr->off_vppbs];
+	mlds 	= (struct ss_mld*) &base[hdr->off_mlds];
+	blobs 	= &base[hdr->off_blobs];
+	strs 	= (char*) &base[hdr->off_strings];
+
+	STEP // 3: Size ports and VCSs
+	rv = 1;
+	if (cxls_init_ports(s, hdr->num_ports) != 0)
+		goto unmap;
+	if (cxls_init_vcss(s, hdr->num_vcss, hdr->num_vppbs) != 0)
+		goto unmap;
+
+	STEP // 4: Restore switch record
+	s->sn 				= sw->sn;
+	s->vid 				= sw->vid;
+	s->did 				= sw->did;
+	s->svid 			= sw->svid;
+	s->ssid 			= sw->ssid;
+	s->bos_opcode 		= sw->bos_opcode;
+	s->bos_rc 			= sw->bos_rc;
+	s->bos_ext 			= sw->bos_ext;
+	s->version 			= sw->version;
+	s->max_msg_size_n 	= sw->max_msg_size_n;
+	s->msg_rsp_limit_n 	= sw->msg_rsp_limit_n;
+	s->bos_running 		= sw->bos_running;
+	s->bos_pcnt 		= sw->bos_pcnt;
+	s->ingress_port 	= sw->ingress_port;
+	s->num_decoders 	= sw->num_decoders;
+	s->mlw 				= sw->mlw;
+	s->speeds 			= sw->speeds;
+	s->mls 				= sw->mls;
+	if (sw->dir != SS_NONE)
+	{
+		free(s->dir);
+		s->dir = strdup(&strs[sw->dir]);
+	}
+
+	STEP // 5: Restore device catalog
+	if (state_devices_reserve(s, hdr->num_devices) != 0)
+		goto unmap;
+	s->num_devices = hdr->num_devices;
+
+	for ( i = 0 ; i < hdr->num_devices ; i++ )
+	{
+		d = &s->devices[i];
+
+		if (dev[i].name != SS_NONE)
+			d->name 	= strdup(&strs[dev[i].name]);
+		d->rootport 	= dev[i].rootport;
+		d->dv 			= dev[i].dv;
+		d->dt 			= dev[i].dt;
+		d->cv 			= dev[i].cv;
+		d->mlw 			= dev[i].mlw;
+		d->mls 			= dev[i].mls;
+
+		if (dev[i].cfgspace != SS_NONE)
+		{
+			d->cfgspace = malloc(CFG_SPACE_SIZE);
+			if (d->cfgspace != NULL)
+				memcpy(d->cfgspace, &blobs[(size_t) dev[i].cfgspace * CFG_SPACE_SIZE], CFG_SPACE_SIZE);
+		}
+
+		if (dev[i].mld != SS_NONE)
+		{
+			d->mld = calloc(1, sizeof(struct cxl_mld));
+			if (d->mld != NULL)
+				_ss_restore_mld(d->mld, &mlds[dev[i].mld], NULL);
+		}
+	}
+
+	if (state_devices_index(s) != 0)
+		goto unmap;
+
+	STEP // 6: Restore ports and reconnect devices
+	for ( i = 0 ; i < hdr->num_ports ; i++ )
+	{
+		p = &s->ports[i];
+
+		// Connect the named device first so the library allocates the port
+		// config space, MLD and memory. Then overwrite with the saved values
+		if (port[i].device_name != SS_NONE)
+		{
+			p->device_name = strdup(&strs[port[i].device_name]);
+
+			id = state_device_find(p->device_name);
+			if (id >= 0)
+				memspace_connect(p, &s->devices[id], s->dir);
+		}
+
+		p->ppid 		= port[i].ppid;
+		p->state 		= port[i].state;
+		p->dv 			= port[i].dv;
+		p->dt 			= port[i].dt;
+		p->cv 			= port[i].cv;
+		p->mlw 			= port[i].mlw;
+		p->nlw 			= port[i].nlw;
+		p->speeds 		= port[i].speeds;
+		p->mls 			= port[i].mls;
+		p->cls 			= port[i].cls;
+		p->ltssm 		= port[i].ltssm;
+		p->lane 		= port[i].lane;
+		p->lane_rev 	= port[i].lane_rev;
+		p->perst 		= port[i].perst;
+		p->prsnt 		= port[i].prsnt;
+		p->pwrctrl 		= port[i].pwrctrl;
+		p->ld 			= port[i].ld;
+
+		if (port[i].cfgspace != SS_NONE && state_port_cfgspace(p, 1) != NULL)
+			memcpy(p->cfgspace, &blobs[(size_t) port[i].cfgspace * CFG_SPACE_SIZE], CFG_SPACE_SIZE);
+
+		if (port[i].mld != SS_NONE)
+		{
+			for ( k = 0 ; k < FM_MAX_NUM_LD ; k++ )
+				if (mlds[port[i].mld].cfgspace[k] != SS_NONE)
+					state_ld_cfgspace(p, k, 1);
+
+			if (p->mld != NULL)
+				_ss_restore_mld(p->mld, &mlds[port[i].mld], blobs);
+		}
+	}
+
+	STEP // 7: Restore VCSs and vPPBs
+	for ( i = 0 ; i < hdr->num_vcss ; i++ )
+	{
+		s->vcss[i].vcsid 	= vcs[i].vcsid;
+		s->vcss[i].state 	= vcs[i].state;
+		s->vcss[i].uspid 	= vcs[i].uspid;
+		s->vcss[i].num 		= vcs[i].num;
+
+		for ( k = 0 ; k < hdr->num_vppbs ; k++ )
+		{
+			v = &s->vcss[i].vppbs[k];
+			v->vppbid 		= vppb->vppbid;
+			v->ldid 		= vppb->ldid;
+			v->bind_status 	= vppb->bind_status;
+			v->ppid 		= vppb->ppid;
+			vppb++;
+		}
+	}
+
+	IFV(CLVB_GENERAL) printf("%d:%s Loaded state snapshot %s: %u ports %u VCSs %u devices\n", gettid(), __FUNCTION__, filename, hdr->num_ports, hdr->num_vcss, hdr->num_devices);
+
+	rv = 0;
+
+unmap:
+
+	STEP // 8: Unmap the file
+	munmap(base, len);
+
+end:
+
+	EXIT(rv)
+
+	return rv;
+}
+
+/**
+ * Restore the memory space of file backed ports from the image file of a 
+ * snapshot
+ *
+ * Called once the backing files have been opened by memspace_open_all(). The
+ * memory space of each port saved in the image is cleared before its extents 
+ * are copied in, so memory written since the snapshot was taken is discarded.
+ * Ports that were not saved in the image are left untouched
+ *
+ * @param s 		struct cxl_switch loaded from the snapshot
+ * @param filename 	Path of the snapshot file
+ * @return 			0 upon success. Non zero otherwise
+ *
+ * STEPS
+ * 1: Validate inputs
+ * 2: Map and validate the snapshot
+ * 3: Open the image file
+ * 4: Clear the memory space of each saved port
+ * 5: Copy each extent into the memory space of its port
+ * 6: Close files
+ */
+int snapshot_load_memory(struct cxl_switch *s, char *filename)
+{
+	INIT
+	int rv, fd, mfd;
+	unsigned i;
+	size_t len;
+	char img[MAX_FILE_NAME_LEN];
+	struct stat st;
+	__u8 *base;
+	struct ss_hdr *hdr;
+	struct ss_port *port;
+	struct ss_extent *ext;
+	struct cxl_port *p;
+
+	ENTER
+
+	// Initialize variables
+	rv = 1;
+	fd = -1;
+
+	STEP // 1: Validate inputs
+	if (s == NULL || filename == NULL)
+	{
+		rv = EINVAL;
+		goto end;
+	}
+
+	STEP // 2: Map and validate the snapshot
+	base = _ss_map(filename, &len, &rv);
+	if (base == NULL)
+		goto end;
+
+	hdr 	= (struct ss_hdr*) base;
+	port 	= (struct ss_port*) &base[hdr->off_ports];
+	ext 	= (struct ss_extent*) &base[hdr->off_extents];
+
+	rv = 0;
+	if (hdr->num_ports != s->num_ports)
+	{
+		rv = EINVAL;
+		goto unmap;
+	}
+
+	STEP // 3: Open the image file
+	for ( i = 0 ; i < hdr->num_ports && !port[i].memimg ; i++ ) ;
+	if (i == hdr->num_ports)
+		goto unmap;
+
+	snprintf(img, sizeof(img), "%s%s", filename, SSFN_IMAGE);
+	fd = open(img, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) != 0 || (__u64) st.st_size < hdr->len_image)
+	{
+		rv = fd < 0 ? errno : EINVAL;
+		IFV(CLVB_ERRORS) printf("%d:%s ERR: Missing or short image file %s\n", gettid(), __FUNCTION__, img);
+		goto end_img;
+	}
+
+	STEP // 4: Clear the memory space of each saved port
+	for ( i = 0 ; i < hdr->num_ports ; i++ )
+	{
+		p = &s->ports[i];
+		if (!port[i].memimg || p->mld == NULL)
+			continue;
+
+		mfd = memspace_fd(p);
+		if (mfd < 0 || fstat(mfd, &st) != 0)
+		{
+			IFV(CLVB_ERRORS) printf("%d:%s ERR: Port %u has no memory backing file to restore\n", gettid(), __FUNCTION__, i);
+			rv = EIO;
+			continue;
+		}
+
+		// Punch out every page, or truncate and extend where holes are not supported
+		if (fallocate(mfd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, 0, st.st_size) != 0)
+			if (ftruncate(mfd, 0) != 0 || ftruncate(mfd, st.st_size) != 0)
+				rv = EIO;
+	}
+
+	STEP // 5: Copy each extent into the memory space of its port
+	for ( i = 0 ; i < hdr->num_extents ; i++ )
+	{
+		p = &s->ports[ext[i].ppid];
+
+		if (p->mld == NULL || ext[i].offset > p->mld->memory_size || ext[i].len > p->mld->memory_size - ext[i].offset)
+		{
+			IFV(CLVB_ERRORS) printf("%d:%s ERR: Extent exceeds the memory space of port %u\n", gettid(), __FUNCTION__, ext[i].ppid);
+			rv = EINVAL;
+			continue;
+		}
+
+		mfd = memspace_fd(p);
+		if (mfd < 0 || _ss_copy(fd, ext[i].image, mfd, ext[i].offset, ext[i].len) != 0)
+			rv = EIO;
+	}
+
+	IFV(CLVB_GENERAL) printf("%d:%s Restored %llu bytes of LD memory in %llu extents from %s\n", gettid(), __FUNCTION__, hdr->len_image, hdr->num_extents, img);
+
+end_img:
+
+	STEP // 6: Close files
+	if (fd >= 0)
+		close(fd);
+
+unmap:
+
+	munmap(base, len);
+
+end:
+
+	EXIT(rv)
+
+	return rv;
+}
+
+/**
+ * Append bytes to a section buffer
+ *
+ * @return 	Offset of the bytes in the buffer. On allocation failure b->err is set
+ */
+static size_t _ss_append(struct ss_buf *b, const void *ptr, size_t len)
+{
+	size_t off, cap;
+	__u8 *data;
+
+	off = b->len;
+
+	if (b->len + len > b->cap)
+	{
+		cap = b->cap * 2;
+		if (cap < b->len + len + SSLN_GROW)
+			cap = b->len + len + SSLN_GROW;
+
+		data = realloc(b->data, cap);
+		if (data == NULL)
+		{
+			b->err = 1;
+			return off;
+		}
+		b->data = data;
+		b->cap = cap;
+	}
+
+	memcpy(&b->data[b->len], ptr, len);
+	b->len += len;
+
+	return off;
+}
+
+/**
+ * Add a string to the string section
+ *
+ * @return 	Offset of the string or SS_NONE if str is NULL
+ */
+static __u32 _ss_str(struct ss_buf *strs, const char *str)
+{
+	if (str == NULL)
+		return SS_NONE;
+
+	return _ss_append(strs, str, strlen(str) + 1);
+}
+
+/**
+ * Add a config space to the blob section
+ *
+ * @return 	Index of the blob or SS_NONE if cfgspace is NULL
+ */
+static __u32 _ss_blob(struct ss_buf *blobs, __u8 *cfgspace)
+{
+	if (cfgspace == NULL)
+		return SS_NONE;
+
+	return _ss_append(blobs, cfgspace, CFG_SPACE_SIZE) / CFG_SPACE_SIZE;
+}
+
+/**
+ * Add an MLD and the config space of each of its LDs to the snapshot
+ *
+ * @return 	Index of the MLD record or SS_NONE if mld is NULL
+ */
+static __u32 _ss_mld(struct ss_buf *mlds, struct ss_buf *blobs, struct cxl_mld *mld)
+{
+	struct ss_mld r;
+	unsigned i;
+
+	if (mld == NULL)
+		return SS_NONE;
+
+	memset(&r, 0, sizeof(r));
+	r.memory_size 		= mld->memory_size;
+	r.mmap 				= mld->mmap;
+	r.num 				= mld->num;
+	r.epc 				= mld->epc;
+	r.ttr 				= mld->ttr;
+	r.granularity 		= mld->granularity;
+	r.epc_en 			= mld->epc_en;
+	r.ttr_en 			= mld->ttr_en;
+	r.egress_mod_pcnt 	= mld->egress_mod_pcnt;
+	r.egress_sev_pcnt 	= mld->egress_sev_pcnt;
+	r.sample_interval 	= mld->sample_interval;
+	r.rcb 				= mld->rcb;
+	r.comp_interval 	= mld->comp_interval;
+	r.bp_avg_pcnt 		= mld->bp_avg_pcnt;
+
+	for ( i = 0 ; i < FM_MAX_NUM_LD ; i++ )
+	{
+		r.rng1[i] 		= mld->rng1[i];
+		r.rng2[i] 		= mld->rng2[i];
+		r.alloc_bw[i] 	= mld->alloc_bw[i];
+		r.bw_limit[i] 	= mld->bw_limit[i];
+		r.cfgspace[i] 	= (i < mld->num) ? _ss_blob(blobs, mld->cfgspace[i]) : SS_NONE;
+	}
+
+	return _ss_append(mlds, &r, sizeof(r)) / sizeof(r);
+}
+
+/**
+ * Copy an MLD record into a struct cxl_mld
+ *
+ * @param blobs 	Blob section to restore the LD config spaces from or NULL
+ * 					to skip them
+ */
+static void _ss_restore_mld(struct cxl_mld *mld, struct ss_mld *r, __u8 *blobs)
+{
+	unsigned i;
+
+	mld->memory_size 		= r->memory_size;
+	mld->mmap 				= r->mmap;
+	mld->num 				= r->num;
+	mld->epc 				= r->epc;
+	mld->ttr 				= r->ttr;
+	mld->granularity 		= r->granularity;
+	mld->epc_en 			= r->epc_en;
+	mld->ttr_en 			= r->ttr_en;
+	mld->egress_mod_pcnt 	= r->egress_mod_pcnt;
+	mld->egress_sev_pcnt 	= r->egress_sev_pcnt;
+	mld->sample_interval 	= r->sample_interval;
+	mld->rcb 				= r->rcb;
+	mld->comp_interval 		= r->comp_interval;
+	mld->bp_avg_pcnt 		= r->bp_avg_pcnt;
+
+	for ( i = 0 ; i < FM_MAX_NUM_LD ; i++ )
+	{
+		mld->rng1[i] 		= r->rng1[i];
+		mld->rng2[i] 		= r->rng2[i];
+		mld->alloc_bw[i] 	= r->alloc_bw[i];
+		mld->bw_limit[i] 	= r->bw_limit[i];
+
+		if (blobs != NULL && r->cfgspace[i] != SS_NONE && mld->cfgspace[i] != NULL)
+			memcpy(mld->cfgspace[i], &blobs[(size_t) r->cfgspace[i] * CFG_SPACE_SIZE], CFG_SPACE_SIZE);
+	}
+}
+
+/**
+ * Copy the populated extents of the memory space of a port to the image file
+ *
+ * @param p 		struct cxl_port with a file backed memory space
+ * @param img 		File descriptor of the image file
+ * @param img_len 	Current length of the image file, advanced by each extent
+ * @param exts 		Section buffer the extent records are appended to
+ * @return 			0 upon success, 1 otherwise
+ */
+static int _ss_save_memory(struct cxl_port *p, int img, __u64 *img_len, struct ss_buf *exts)
+{
+	struct ss_extent e;
+	off_t data, hole, size;
+	int fd;
+
+	fd = memspace_fd(p);
+	size = p->mld->memory_size;
+
+	for ( hole = 0 ; hole < size ; )
+	{
+		// ENXIO means there is no data past this offset
+		data = lseek(fd, hole, SEEK_DATA);
+		if (data < 0)
+			return errno == ENXIO ? 0 : 1;
+		if (data >= size)
+			break;
+
+		hole = lseek(fd, data, SEEK_HOLE);
+		if (hole < 0 || hole > size)
+			hole = size;
+
+		memset(&e, 0, sizeof(e));
+		e.offset 	= data;
+		e.len 		= hole - data;
+		e.image 	= *img_len;
+		e.ppid 		= p->ppid;
+
+		if (_ss_copy(fd, e.offset, img, e.image, e.len) != 0)
+			return 1;
+
+		_ss_append(exts, &e, sizeof(e));
+		*img_len += e.len;
+	}
+
+	return 0;
+}
+
+/**
+ * Copy a range of bytes between two files
+ *
+ * The copy is done in the kernel with copy_file_range() and falls back to 
+ * read() and write() through a buffer when the file systems do not support it
+ *
+ * @return 	0 upon success, 1 otherwise
+ */
+static int _ss_copy(int in, __u64 in_off, int out, __u64 out_off, __u64 len)
+{
+	loff_t ioff, ooff;
+	ssize_t n;
+	__u8 *buf;
+
+	ioff = in_off;
+	ooff = out_off;
+
+	while (len > 0)
+	{
+		n = copy_file_range(in, &ioff, out, &ooff, len, 0);
+		if (n <= 0)
+			break;
+		len -= n;
+	}
+
+	if (len == 0)
+		return 0;
+
+	buf = malloc(SSLN_COPY);
+	if (buf == NULL)
+		return 1;
+
+	while (len > 0)
+	{
+		n = pread(in, buf, len < SSLN_COPY ? len : SSLN_COPY, ioff);
+		if (n <= 0 || pwrite(out, buf, n, ooff) != n)
+			break;
+		ioff += n;
+		ooff += n;
+		len -= n;
+	}
+
+	free(buf);
+
+	return len != 0;
+}
+
+/**
+ * Map a snapshot file read only and validate it
+ *
+ * @param filename 	Path of the snapshot file
+ * @param len 		Set to the length of the mapping
+ * @param rv 		Set to 0 upon success or an errno value
+ * @return 			Address of the mapping or NULL upon failure
+ */
+static __u8 *_ss_map(char *filename, size_t *len, int *rv)
+{
+	struct stat st;
+	__u8 *base;
+	int fd;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+	{
+		*rv = errno;
+		IFV(CLVB_ERRORS) printf("%d:%s ERR: Could not open snapshot file %s\n", gettid(), __FUNCTION__, filename);
+		return NULL;
+	}
+
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(struct ss_hdr))
+	{
+		*rv = EINVAL;
+		close(fd);
+		return NULL;
+	}
+	*len = st.st_size;
+
+	base = mmap(NULL, *len, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+	{
+		*rv = errno;
+		return NULL;
+	}
+
+	*rv = _ss_validate(base, *len);
+	if (*rv != 0)
+	{
+		IFV(CLVB_ERRORS) printf("%d:%s ERR: Invalid snapshot file %s\n", gettid(), __FUNCTION__, filename);
+		munmap(base, *len);
+		return NULL;
+	}
+
+	return base;
+}
+
+/**
+ * Check that a section of count records of size bytes lies within the file
+ */
+static int _ss_section_ok(__u64 off, __u64 count, __u64 size, size_t len)
+{
+	return off <= len && count * size <= len - off;
+}
+
+/**
+ * Check that a string offset refers to a string in the string section
+ */
+static int _ss_str_ok(struct ss_hdr *h, __u32 off)
+{
+	return off == SS_NONE || off < h->len_strings;
+}
+
+/**
+ * Check that a blob or MLD index is SS_NONE or below num
+ */
+static int _ss_idx_ok(__u32 idx, __u32 num)
+{
+	return idx == SS_NONE || idx < num;
+}
+
+/**
+ * Validate a mapped snapshot before any of it is used
+ *
+ * @return 	0 if valid, EINVAL otherwise
+ *
+ * STEPS
+ * 1: Verify header
+ * 2: Verify section bounds
+ * 3: Verify checksum
+ * 4: Verify string section is terminated
+ * 5: Verify references of every record
+ */
+static int _ss_validate(__u8 *base, size_t len)
+{
+	struct ss_hdr *h;
+	struct ss_switch *sw;
+	struct ss_device *dev;
+	struct ss_port *port;
+	struct ss_vcs *vcs;
+	struct ss_mld *mld;
+	struct ss_extent *ext;
+	unsigned i, k;
+
+	h = (struct ss_hdr*) base;
+
+	// STEP 1: Verify header
+	if (len < sizeof(*h) || memcmp(h->magic, SS_MAGIC, SSLN_MAGIC) != 0)
+		return EINVAL;
+	if (h->version != SS_VERSION || h->hdr_len != sizeof(*h) || h->file_len != len)
+		return EINVAL;
+	if (h->num_ports > MAX_PORTS || h->num_vcss > MAX_VCSS || h->num_vppbs > MAX_VPPBS_PER_VCS)
+		return EINVAL;
+
+	// STEP 2: Verify section bounds
+	if (  !_ss_section_ok(h->off_switch, 	1, 									sizeof(struct ss_switch), 	len)
+		||!_ss_section_ok(h->off_devices, 	h->num_devices, 					sizeof(struct ss_device), 	len)
+		||!_ss_section_ok(h->off_ports, 	h->num_ports, 						sizeof(struct ss_port), 	len)
+		||!_ss_section_ok(h->off_vcss, 		h->num_vcss, 						sizeof(struct ss_vcs), 		len)
+		||!_ss_section_ok(h->off_vppbs, 	(__u64) h->num_vcss * h->num_vppbs, sizeof(struct ss_vppb), 	len)
+		||!_ss_section_ok(h->off_mlds, 		h->num_mlds, 						sizeof(struct ss_mld), 		len)
+		||!_ss_section_ok(h->off_blobs, 	h->num_blobs, 						CFG_SPACE_SIZE, 			len)
+		||!_ss_section_ok(h->off_strings, 	h->len_strings, 					1, 							len)
+		||!_ss_section_ok(h->off_extents, 	h->num_extents, 					sizeof(struct ss_extent), 	len))
+		return EINVAL;
+
+	// STEP 3: Verify checksum
+	if (_ss_hash(&base[sizeof(*h)], len - sizeof(*h)) != h->checksum)
+		return EINVAL;
+
+	// STEP 4: Verify string section is terminated
+	if (h->len_strings == 0 || base[h->off_strings + h->len_strings - 1] != 0)
+		return EINVAL;
+
+	// STEP 5: Verify references of every record
+	sw = (struct ss_switch*) &base[h->off_switch];
+	if (!_ss_str_ok(h, sw->dir))
+		return EINVAL;
+
+	dev = (struct ss_device*) &base[h->off_devices];
+	for ( i = 0 ; i < h->num_devices ; i++ )
+		if (  !_ss_str_ok(h, dev[i].name)
+			||!_ss_idx_ok(dev[i].cfgspace, h->num_blobs)
+			||!_ss_idx_ok(dev[i].mld, h->num_mlds))
+			return EINVAL;
+
+	port = (struct ss_port*) &base[h->off_ports];
+	for ( i = 0 ; i < h->num_ports ; i++ )
+		if (  port[i].ppid != i
+			||port[i].ld > FM_MAX_NUM_LD
+			||!_ss_str_ok(h, port[i].device_name)
+			||!_ss_idx_ok(port[i].cfgspace, h->num_blobs)
+			||!_ss_idx_ok(port[i].mld, h->num_mlds))
+			return EINVAL;
+
+	vcs = (struct ss_vcs*) &base[h->off_vcss];
+	for ( i = 0 ; i < h->num_vcss ; i++ )
+		if (vcs[i].num > h->num_vppbs)
+			return EINVAL;
+
+	mld = (struct ss_mld*) &base[h->off_mlds];
+	for ( i = 0 ; i < h->num_mlds ; i++ )
+	{
+		if (mld[i].num > FM_MAX_NUM_LD)
+			return EINVAL;
+		for ( k = 0 ; k < FM_MAX_NUM_LD ; k++ )
+			if (!_ss_idx_ok(mld[i].cfgspace[k], h->num_blobs))
+				return EINVAL;
+	}
+
+	ext = (struct ss_extent*) &base[h->off_extents];
+	for ( i = 0 ; i < h->num_extents ; i++ )
+		if (  ext[i].ppid >= h->num_ports
+			||!port[ext[i].ppid].memimg
+			||ext[i].len > h->len_image
+			||ext[i].image > h->len_image - ext[i].len)
+			return EINVAL;
+
+	return 0;
+}
+
+/**
+ * FNV-1a hash of a buffer
+ */
+static __u64 _ss_hash(__u8 *buf, size_t len)
+{
+	__u64 h;
+	size_t i;
+
+	h = SS_FNV_BASIS;
+	for ( i = 0 ; i < len ; i++ )
+	{
+		h ^= buf[i];
+		h *= SS_FNV_PRIME;
+	}
+
+	return h;
+}
@@ -0,0 +1,217 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		snapshot.h
+ *
+ * @brief 		Header file for the binary switch state snapshot
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ * Macro / Enumeration Prefixes (SS)
+ * SSFN	- Snapshot File Name (FN)
+ * SSLN	- Snapshot Length (LN)
+ */
+#ifndef _SNAPSHOT_H
+#define _SNAPSHOT_H
+
+/* INCLUDES ==================================================================*/
+
+/* __u8
+ * __u16
+ * __u32
+ * __u64
+ */
+#include <linux/types.h>
+
+#include <fmapi.h>
+#include <cxlstate.h>
+
+/* MACROS ====================================================================*/
+
+#define SS_MAGIC 			"CSESTATE" 		//!< First bytes of a snapshot file
+#define SS_VERSION 			2 				//!< Layout version of the snapshot file
+#define SS_NONE 			0xFFFFFFFF 		//!< Index or offset that refers to nothing
+#define SSLN_MAGIC 			8 				//!< Length of the magic string
+#define SSFN_IMAGE 			".mem" 			//!< Suffix of the LD memory image file
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/**
+ * Snapshot file header
+ *
+ * Each section is an array of fixed size records at the given offset from the
+ * start of the file. Records refer to MLDs and config space blobs by index and
+ * to strings by offset into the string section. The populated extents of LD 
+ * memory are stored back to back in a separate image file named after the 
+ * snapshot with the SSFN_IMAGE suffix
+ */
+struct ss_hdr
+{
+	char magic[SSLN_MAGIC];
+	__u32 version;
+	__u32 hdr_len; 			//!< sizeof(struct ss_hdr)
+	__u64 file_len; 		//!< Total length of the file in bytes
+	__u64 checksum; 		//!< FNV-1a hash of every byte after the header
+	__u16 num_ports;
+	__u16 num_vcss;
+	__u16 num_vppbs; 		//!< vPPBs per VCS
+	__u16 num_devices;
+	__u32 num_mlds;
+	__u32 num_blobs; 		//!< Config space blobs of CFG_SPACE_SIZE bytes
+	__u64 off_switch;
+	__u64 off_devices;
+	__u64 off_ports;
+	__u64 off_vcss;
+	__u64 off_vppbs; 		//!< num_vcss * num_vppbs records
+	__u64 off_mlds;
+	__u64 off_blobs;
+	__u64 off_strings;
+	__u64 len_strings;
+	__u64 off_extents;
+	__u64 num_extents;
+	__u64 len_image; 		//!< Length of the LD memory image file in bytes
+} __attribute__((packed));
+
+/**
+ * Switch identity and capability record
+ */
+struct ss_switch
+{
+	__u64 sn;
+	__u32 dir; 				//!< String offset of the memory file directory
+	__u16 vid;
+	__u16 did;
+	__u16 svid;
+	__u16 ssid;
+	__u16 bos_opcode;
+	__u16 bos_rc;
+	__u16 bos_ext;
+	__u8 version;
+	__u8 max_msg_size_n;
+	__u8 msg_rsp_limit_n;
+	__u8 bos_running;
+	__u8 bos_pcnt;
+	__u8 ingress_port;
+	__u8 num_decoders;
+	__u8 mlw;
+	__u8 speeds;
+	__u8 mls;
+} __attribute__((packed));
+
+/**
+ * Multi-Logical Device record
+ */
+struct ss_mld
+{
+	__u64 memory_size;
+	__u64 rng1[FM_MAX_NUM_LD];
+	__u64 rng2[FM_MAX_NUM_LD];
+	__u32 cfgspace[FM_MAX_NUM_LD]; 	//!< Blob index of the config space of each LD
+	__u32 mmap;
+	__u16 num;
+	__u8 alloc_bw[FM_MAX_NUM_LD];
+	__u8 bw_limit[FM_MAX_NUM_LD];
+	__u8 epc;
+	__u8 ttr;
+	__u8 granularity;
+	__u8 epc_en;
+	__u8 ttr_en;
+	__u8 egress_mod_pcnt;
+	__u8 egress_sev_pcnt;
+	__u8 sample_interval;
+	__u8 rcb;
+	__u8 comp_interval;
+	__u8 bp_avg_pcnt;
+} __attribute__((packed));
+
+/**
+ * Device catalog record
+ */
+struct ss_device
+{
+	__u32 name; 			//!< String offset of the device name
+	__u32 cfgspace; 		//!< Blob index of the config space
+	__u32 mld; 				//!< MLD record index
+	__u8 rootport;
+	__u8 dv;
+	__u8 dt;
+	__u8 cv;
+	__u8 mlw;
+	__u8 mls;
+} __attribute__((packed));
+
+/**
+ * Physical port record
+ */
+struct ss_port
+{
+	__u32 device_name; 		//!< String offset of the connected device name
+	__u32 cfgspace; 		//!< Blob index of the config space
+	__u32 mld; 				//!< MLD record index
+	__u8 ppid;
+	__u8 state;
+	__u8 dv;
+	__u8 dt;
+	__u8 cv;
+	__u8 mlw;
+	__u8 nlw;
+	__u8 speeds;
+	__u8 mls;
+	__u8 cls;
+	__u8 ltssm;
+	__u8 lane;
+	__u8 lane_rev;
+	__u8 perst;
+	__u8 prsnt;
+	__u8 pwrctrl;
+	__u8 ld;
+	__u8 memimg; 			//!< 1 if the memory space of the port is in the image file
+} __attribute__((packed));
+
+/**
+ * Virtual CXL Switch record
+ */
+struct ss_vcs
+{
+	__u8 vcsid;
+	__u8 state;
+	__u8 uspid;
+	__u8 num;
+} __attribute__((packed));
+
+/**
+ * vPPB record
+ */
+struct ss_vppb
+{
+	__u16 vppbid;
+	__u16 ldid;
+	__u8 bind_status;
+	__u8 ppid;
+} __attribute__((packed));
+
+/**
+ * Populated extent of the memory space of a port
+ */
+struct ss_extent
+{
+	__u64 offset; 			//!< Byte offset into the memory space of the port
+	__u64 len;
+	__u64 image; 			//!< Byte offset into the image file
+	__u16 ppid;
+	__u8 rsvd[6];
+} __attribute__((packed));
+
+/* PROTOTYPES ================================================================*/
+
+int snapshot_save(struct cxl_switch *s, char *filename);
+int snapshot_load(struct cxl_switch *s, char *filename);
+int snapshot_load_memory(struct cxl_switch *s, char *filename);
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+#endif //_SNAPSHOT_H
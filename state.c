@@ -39,6 +39,10 @@ cxl_ *
  */
 #include <sys/mman.h>
 
+/* clock_gettime()
+ */
+#include <time.h>
+
 #include <pci/pci.h>
 
 /** GHashTable 
@@ -63,40 +67,66 @@ cxl_ *
 
 #include "options.h" 
 
+#include "trace.h"
+
 #include "state.h"
 
+#include "metrics.h"
+
+#include "memspace.h"
+
+#include "events.h"
+
+#include "numa.h"
+
+#include "switches.h"
+
 /* MACROS ====================================================================*/
 
 #define MAX_STR 256
 
-#ifdef CSE_VERBOSE
- #define INIT 			unsigned step = 0;
- #define ENTER 					if (opts[CLOP_VERBOSITY].u64 & CLVB_CALLSTACK) 	printf("%d:%s Enter\n", 			gettid(), __FUNCTION__);
- #define STEP 			step++; if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u\n", 			gettid(), __FUNCTION__, step);
- #define HEX32(m, i)			if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u %s: 0x%x\n",	gettid(), __FUNCTION__, step, m, i);
- #define INT32(m, i)			if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u %s: %d\n",	gettid(), __FUNCTION__, step, m, i);
- #define EXIT(rc) 				if (opts[CLOP_VERBOSITY].u64 & CLVB_CALLSTACK) 	printf("%d:%s Exit: %d\n", 			gettid(), __FUNCTION__,rc);
-#else
- #define ENTER
- #define EXIT(rc)
- #define STEP
- #define HEX32(m, i)
- #define INT32(m, i)
- #define INIT 
-#endif // CSE_VERBOSE
-
-#define IFV(u) 							if (opts[CLOP_VERBOSITY].u64 & u) 
+/**
+ * libpci fields read for each PCI device. Leaving out the bases, sizes, IRQs 
+ * and the label lookup keeps the scan of a device to its config space reads
+ */
+#define STATE_PCI_FILL 	(PCI_FILL_IDENT | PCI_FILL_CLASS | PCI_FILL_CAPS | PCI_FILL_EXT_CAPS | PCI_FILL_SUBSYS | PCI_FILL_PARENT)
 
 /* ENUMERATIONS ==============================================================*/
 
 /* STRUCTS ===================================================================*/
 
+/**
+ * Generation counters of the state of one switch, see enum _STATE_GEN
+ *
+ * Bumped atomically by code that changes the object while it holds the lock
+ * of the object, before its response is sent
+ */
+struct state_gens
+{
+	__u64 all;
+	__u64 id;
+	__u64 devices;
+	__u64 vcss[MAX_VCSS];
+	__u64 ports[MAX_PORTS];
+};
+
+/**
+ * Parse context of one VCS block. The vPPB array of a VCS is sized from the
+ * switch, so the switch travels with the VCS being parsed
+ */
+struct state_parse_vcs
+{
+	struct cxl_switch *s;
+	struct cxl_vcs *vcs;
+};
+
 /* PROTOTYPES ================================================================*/
 
 int state_load_devices(struct cxl_switch *state, GHashTable *ht);
 int state_load_emulator(struct cxl_switch *state, GHashTable *ht);
 int state_load_ports(struct cxl_switch *state, GHashTable *ht);
 int state_load_switch(struct cxl_switch *state, GHashTable *ht);
+int state_load_size(struct cxl_switch *state, GHashTable *ht);
 int state_load_vcss(struct cxl_switch *state, GHashTable *ht);
 int state_load_from_pci(struct cxl_switch *state);
 
@@ -111,6 +141,7 @@ void _parse_emulator(gpointer key, gpointer value, gpointer user_data);
 void _parse_ports(gpointer key, gpointer value, gpointer user_data);
 void _parse_port(gpointer key, gpointer value, gpointer user_data);
 void _parse_switch(gpointer key, gpointer value, gpointer user_data);
+void _parse_switch_emulator(gpointer key, gpointer value, gpointer user_data);
 void _parse_vcss(gpointer key, gpointer value, gpointer user_data);
 void _parse_vcs(gpointer key, gpointer value, gpointer user_data);
 void _parse_vppbs(gpointer key, gpointer value, gpointer user_data);
@@ -118,12 +149,64 @@ void _parse_vppb(gpointer key, gpointer value, gpointer user_data);
 
 void state_print_pcie_cfg_space(__u8 *cfgspace, unsigned indent);
 
+static struct state_bind *_state_binds_entry(struct cxl_vppb *b);
+static int _state_reload_devices(struct cxl_switch *s, struct cxl_switch *n);
+static int _state_reload_ports(struct cxl_switch *s, struct cxl_switch *n);
+static void _state_device_free(struct cxl_device *d);
+static GHashTable *_state_section(GHashTable *ht, const char *name);
+static void _state_section_add(gpointer key, gpointer value, gpointer user_data);
+static void _state_section_name(gpointer key, gpointer value, gpointer user_data);
+static int _state_name_cmp(const void *a, const void *b);
+
 /* GLOBAL VARIABLES ==========================================================*/
 
 /**
- * Global pointer to CXL Switch State
+ * CXL Switch State of the switch selected by the calling thread
+ */
+__thread struct cxl_switch *cxls = NULL;
+
+/**
+ * Index of the switch cxls points to, see switches_select()
+ */
+__thread unsigned cxls_id = 0;
+
+/**
+ * Fine grained locks of the state of each switch
+ */
+static struct state_locks locks[SWLN_SWITCHES];
+
+/**
+ * Index of the device catalog by name
+ *
+ * Maps a device name to its index in the device catalog plus one so that a 
+ * NULL lookup result means the name was not found. The keys are the name 
+ * strings owned by the catalog entries. Each switch has its own catalog, so 
+ * each has its own index, protected by the topology lock of the switch
+ */
+static GHashTable *devindex[SWLN_SWITCHES];
+
+/**
+ * Reverse index of the vPPB binding table of each switch, one entry per 
+ * physical port
+ *
+ * Protected by the topology lock
+ */
+static struct state_port_binds *binds[SWLN_SWITCHES];
+
+/**
+ * Number of entries in binds[]
+ */
+static unsigned num_binds[SWLN_SWITCHES];
+
+/**
+ * Total number of bound entries in binds[]
+ */
+static unsigned num_bound[SWLN_SWITCHES];
+
+/**
+ * Generation counters of each switch
  */
-struct cxl_switch *cxls;
+static struct state_gens gens[SWLN_SWITCHES];
 
 /* FUNCTIONS =================================================================*/
 
@@ -135,15 +218,16 @@ struct cxl_switch *cxls;
  * @return	 		Returns 0 on success, error code otherwise
  *
  * STEPS:
- * 1: Validate inputs 
- * 2: Parse config file into hash table
- * 3: Parse Emulator configuration 
- * 4: Parse Devices
- * 5: Parse Switch 
- * 6: Load physical devices if in a QEMU environment
- * 7: Parse Ports
- * 8: Parse VCSs
- * 9: Free memory allocated for hash table
+ *  1: Validate inputs 
+ *  2: Parse config file into hash table
+ *  3: Parse Emulator configuration 
+ *  4: Size ports and VCSs from the switch configuration
+ *  5: Parse Devices
+ *  6: Parse Switch 
+ *  7: Load physical devices if in a QEMU environment
+ *  8: Parse Ports
+ *  9: Parse VCSs
+ * 10: Free memory allocated for hash table
  */
 int state_load(struct cxl_switch *state, char *filename)
 {
@@ -178,17 +262,22 @@ int state_load(struct cxl_switch *state, char *filename)
 	if (rv != 0) 
 		goto end;
 
-	STEP // 4: Parse Devices
+	STEP // 4: Size ports and VCSs from the switch configuration
+	rv = state_load_size(state, ht);
+	if (rv != 0) 
+		goto end;
+
+	STEP // 5: Parse Devices
 	rv = state_load_devices(state, ht);
 	if (rv != 0) 
 		goto end;
 
-	STEP // 5: Parse Switch 
+	STEP // 6: Parse Switch 
 	rv = state_load_switch(state, ht);
 	if (rv != 0) 
 		goto end;
 	
-	STEP // 6: Load physical devices if in a QEMU environment
+	STEP // 7: Load physical devices if in a QEMU environment
 	if (opts[CLOP_QEMU].set == 1)
 	{
 		rv = state_load_from_pci(state);
@@ -198,28 +287,1056 @@ int state_load(struct cxl_switch *state, char *filename)
 		goto success;
 	}
 
-	STEP // 7: Parse Ports
+	STEP // 8: Parse Ports
 	rv = state_load_ports(state, ht);
 	if (rv != 0) 
 		goto end;
 
-	STEP // 8: Parse VCSs
+	STEP // 9: Parse VCSs
 	rv = state_load_vcss(state, ht);
 	if (rv != 0) 
 		goto end;
 
-success:
+success:
+
+	STEP // 10: Free memory allocated for hash table
+	yl_free(ht);
+
+	rv = 0;
+
+end:
+
+	EXIT(rv)
+
+	return rv;
+}
+
+/**
+ * Create and load the switches of the switches section of a config file
+ *
+ * Each entry of the switches section is a switch hosted in addition to the 
+ * one loaded by state_load(). An entry may hold emulator, switch, ports and 
+ * vcss sections of its own. The sections it does not hold are taken from the
+ * top level of the file and the devices section is always the top level one.
+ * Each switch parses its own copy of the devices section into its own catalog
+ * and name index, so a reload of one switch never changes the catalog another
+ * is using, and memspace_connect() can flip the mmap flag of a profile under 
+ * the topology lock of its own switch only. Of the emulator keys only the 
+ * listener keys, tcp-port, connections, eid and unix-socket, apply to one 
+ * switch. The switches are added in the order of 
+ * their names and the calling thread is left on the switch it had selected
+ *
+ * @param base 		struct cxl_switch loaded by state_load(). Its directory of
+ * 					backing files is used by all switches
+ * @param filename 	char * to yaml config file to load 
+ * @return	 		Returns 0 on success, error code otherwise
+ *
+ * STEPS:
+ * 1: Validate inputs 
+ * 2: Parse config file into hash table
+ * 3: Sort the names of the switches
+ * 4: Add each switch and parse its listener keys
+ * 5: Load each switch from its section
+ * 6: Free memory allocated for hash table
+ */
+int state_load_switches(struct cxl_switch *base, char *filename)
+{
+	INIT
+	int rv;
+	unsigned i, num, id;
+	GHashTable *ht, *sec;
+	yl_obj_t *ylo, *v;
+	struct cse_switch *sw;
+	struct cxl_switch *s;
+	char **names;
+	char *default_file = "config.yaml";
+
+	ENTER
+
+	// Initialize varialbes
+	rv = 1;
+	names = NULL;
+	id = cxls_id;
+
+	STEP // 1: Validate inputs 
+	if( base == NULL ) {
+		rv = EINVAL;
+		goto end;
+	}
+
+	if( filename == NULL )
+		filename = default_file;
+
+	STEP // 2: Parse config file into hash table 
+	ht = yl_load(filename);
+	if ( ht == NULL ) {
+		rv = errno;
+		goto end;
+	}
+
+	ylo = (yl_obj_t*) g_hash_table_lookup(ht, "switches");
+	if (ylo == NULL || ylo->ht == NULL || g_hash_table_size(ylo->ht) == 0) 
+	{
+		rv = 0;
+		goto free;
+	}
+
+	// The QEMU switch is the one on the PCI bus
+	if (opts[CLOP_QEMU].set == 1)
+	{
+		IFV(CLVB_ERRORS) printf("%d:%s WARN: The switches section is ignored with QEMU devices\n", gettid(), __FUNCTION__);
+		rv = 0;
+		goto free;
+	}
+
+	STEP // 3: Sort the names of the switches
+	num = 0;
+	names = calloc(g_hash_table_size(ylo->ht) + 1, sizeof(char*));
+	if (names == NULL)
+		goto free;
+	g_hash_table_foreach(ylo->ht, _state_section_name, names);
+	while (names[num] != NULL)
+		num++;
+	qsort(names, num, sizeof(char*), _state_name_cmp);
+
+	for ( i = 0 ; i < num ; i++ )
+	{
+		STEP // 4: Add each switch and parse its listener keys
+		rv = 1;
+		v = (yl_obj_t*) g_hash_table_lookup(ylo->ht, names[i]);
+		if (v == NULL || v->ht == NULL)
+			continue;
+
+		// state_load_size() sizes the switch from its section
+		s = cxls_init(1, 1, 1);
+		if (s == NULL)
+			goto free;
+
+		sw = switches_add(s, names[i]);
+		if (sw == NULL)
+		{
+			IFV(CLVB_ERRORS) printf("%d:%s ERR: Switch %s exceeds the maximum of %d switches\n", gettid(), __FUNCTION__, names[i], SWLN_SWITCHES);
+			cxls_free(s);
+			goto free;
+		}
+		sw->connections = 1;
+		if (base->dir != NULL)
+			s->dir = strdup(base->dir);
+
+		sec = _state_section(ht, names[i]);
+		if (sec == NULL)
+			goto free;
+
+		v = (yl_obj_t*) g_hash_table_lookup(v->ht, "emulator");
+		if (v != NULL && v->ht != NULL)
+			g_hash_table_foreach(v->ht, _parse_switch_emulator, sw);
+
+		STEP // 5: Load each switch from its section
+		rv = state_load_size(s, sec);
+		if (rv == 0)
+			rv = state_load_devices(s, sec);
+		if (rv == 0)
+			rv = state_load_switch(s, sec);
+		if (rv == 0)
+			rv = state_load_ports(s, sec);
+		if (rv == 0)
+			rv = state_load_vcss(s, sec);
+
+		g_hash_table_destroy(sec);
+
+		if (rv != 0)
+		{
+			IFV(CLVB_ERRORS) printf("%d:%s ERR: Could not load switch %s\n", gettid(), __FUNCTION__, names[i]);
+			goto free;
+		}
+
+		IFV(CLVB_GENERAL) printf("%d:%s Loaded switch %u: %s\n", gettid(), __FUNCTION__, sw->id, sw->name);
+	}
+
+	rv = 0;
+
+free:
+
+	STEP // 6: Free memory allocated for hash table
+	free(names);
+	yl_free(ht);
+	switches_select(id);
+
+end:
+
+	EXIT(rv)
+
+	return rv;
+}
+
+/**
+ * Return the sections a switch is loaded from
+ *
+ * The table holds the top level sections of the file with the sections of 
+ * the entry of the switch in the switches section in their place. It only 
+ * refers to the keys and values of ht
+ *
+ * @param ht 	GHashTable holding contents of config.yaml file
+ * @param name 	Key of the entry in the switches section, NULL or "" for the 
+ * 				first switch, which is loaded from the top level
+ * @return 		GHashTable* to free with g_hash_table_destroy(). NULL if there 
+ * 				is no such entry
+ */
+static GHashTable *_state_section(GHashTable *ht, const char *name)
+{
+	GHashTable *sec;
+	yl_obj_t *ylo;
+
+	ylo = NULL;
+	if (name != NULL && name[0] != 0)
+	{
+		ylo = (yl_obj_t*) g_hash_table_lookup(ht, "switches");
+		if (ylo == NULL || ylo->ht == NULL)
+			return NULL;
+
+		ylo = (yl_obj_t*) g_hash_table_lookup(ylo->ht, name);
+		if (ylo == NULL || ylo->ht == NULL)
+			return NULL;
+	}
+
+	sec = g_hash_table_new(g_str_hash, g_str_equal);
+	if (sec == NULL)
+		return NULL;
+
+	g_hash_table_foreach(ht, _state_section_add, sec);
+	if (ylo != NULL)
+		g_hash_table_foreach(ylo->ht, _state_section_add, sec);
+
+	return sec;
+}
+
+/**
+ * Add a section to the table of _state_section()
+ */
+static void _state_section_add(gpointer key, gpointer value, gpointer user_data)
+{
+	g_hash_table_replace((GHashTable*) user_data, key, value);
+}
+
+/**
+ * Append the name of an entry of the switches section to a NULL terminated 
+ * array with room for all of them
+ */
+static void _state_section_name(gpointer key, gpointer value, gpointer user_data)
+{
+	char **names;
+
+	(void) value;
+
+	for ( names = (char**) user_data ; *names != NULL ; names++ )
+		;
+	*names = (char*) key;
+}
+
+/**
+ * Compare two switch names for qsort()
+ */
+static int _state_name_cmp(const void *a, const void *b)
+{
+	return strcmp(*(char**) a, *(char**) b);
+}
+
+/**
+ * Apply the changes in a config file to the running switch 
+ *
+ * The devices and ports sections of the file are parsed into a scratch 
+ * switch and compared with the live state. New device profiles are added to
+ * the catalog and ports whose device assignment changed are disconnected and
+ * reconnected. Ports with an unchanged assignment, and their memory spaces,
+ * are not touched. Existing profiles are not modified or removed, the switch
+ * and VCS sections and the emulator options are ignored. A switch other 
+ * than the first is compared with the ports of its entry in the switches 
+ * section
+ *
+ * @param s 		struct cxl_switch that is running, the switch selected by
+ * 					the calling thread
+ * @param filename 	char * to yaml config file to load 
+ * @return	 		Returns 0 on success, error code otherwise
+ *
+ * STEPS:
+ * 1: Validate inputs 
+ * 2: Parse config file into hash table
+ * 3: Parse devices and ports into a scratch switch
+ * 4: Obtain lock on switch state 
+ * 5: Add new device profiles 
+ * 6: Apply changed port assignments 
+ * 7: Release lock on switch state 
+ * 8: Free scratch switch and hash table
+ */
+int state_reload(struct cxl_switch *s, char *filename)
+{
+	INIT
+	int rv;
+	unsigned i;
+	GHashTable *ht, *sec;
+	yl_obj_t *ylo;
+	struct cxl_switch n;
+	struct cse_switch *sw;
+	char *default_file = "config.yaml";
+
+	ENTER
+
+	// Initialize varialbes
+	rv = 1;
+	sec = NULL;
+	memset(&n, 0, sizeof(n));
+
+	STEP // 1: Validate inputs 
+	if( s == NULL ) {
+		rv = EINVAL;
+		goto end;
+	}
+
+	if( filename == NULL )
+		filename = default_file;
+
+	STEP // 2: Parse config file into hash table 
+	ht = yl_load(filename);
+	if ( ht == NULL ) {
+		rv = errno;
+		goto end;
+	}
+
+	STEP // 3: Parse devices and ports into a scratch switch
+	// The port count of a running switch cannot change
+	n.num_ports = s->num_ports;
+	n.ports = calloc(n.num_ports, sizeof(struct cxl_port));
+	if (n.ports == NULL || state_devices_reserve(&n, INITIAL_NUM_DEVICES) != 0)
+		goto free;
+	for ( i = 0 ; i < n.num_ports ; i++ )
+		n.ports[i].ppid = i;
+
+	ylo = (yl_obj_t*) g_hash_table_lookup(ht, "devices");
+	if (ylo != NULL && ylo->ht != NULL) 
+		g_hash_table_foreach(ylo->ht, _parse_devices, &n);	
+
+	sw = switches_get(cxls_id);
+	sec = _state_section(ht, (sw != NULL) ? sw->name : NULL);
+	if (sec == NULL)
+		goto free;
+
+	ylo = (yl_obj_t*) g_hash_table_lookup(sec, "ports");
+	if (ylo != NULL && ylo->ht != NULL) 
+		g_hash_table_foreach(ylo->ht, _parse_ports, &n);	
+
+	STEP // 4: Obtain lock on switch state 
+	state_lock_topology();
+
+	STEP // 5: Add new device profiles 
+	rv = _state_reload_devices(s, &n);
+
+	STEP // 6: Apply changed port assignments 
+	if (rv == 0)
+		rv = _state_reload_ports(s, &n);
+
+	STEP // 7: Release lock on switch state 
+	state_unlock_topology();
+
+free:
+
+	STEP // 8: Free scratch switch and hash table
+	for ( i = 0 ; i < n.num_devices ; i++ )
+		_state_device_free(&n.devices[i]);
+	free(n.devices);
+
+	if (n.ports != NULL)
+		for ( i = 0 ; i < n.num_ports ; i++ )
+			free(n.ports[i].device_name);
+	free(n.ports);
+
+	if (sec != NULL)
+		g_hash_table_destroy(sec);
+	yl_free(ht);
+
+end:
+
+	EXIT(rv)
+
+	return rv;
+}
+
+/**
+ * Move device profiles that are not in the live catalog into it
+ *
+ * A new profile keeps its `did` if that entry of the catalog is free and is
+ * appended otherwise, so existing indexes remain valid. Caller must hold the
+ * topology lock
+ *
+ * @param s 	struct cxl_switch that is running
+ * @param n 	struct cxl_switch parsed from the config file. Moved entries 
+ * 				are zeroed
+ * @return 		0 upon success. Non zero otherwise
+ */
+static int _state_reload_devices(struct cxl_switch *s, struct cxl_switch *n)
+{
+	unsigned i, did, added;
+
+	added = 0;
+	for ( i = 0 ; i < n->num_devices ; i++ )
+	{
+		if (n->devices[i].name == NULL || state_device_find(n->devices[i].name) >= 0)
+			continue;
+
+		did = (i < s->num_devices && s->devices[i].name == NULL) ? i : s->num_devices;
+		if (state_devices_reserve(s, did + 1) != 0)
+		{
+			IFV(CLVB_ERRORS) printf("%d:%s ERR: Could not add device: %s\n", gettid(), __FUNCTION__, n->devices[i].name);
+			return 1;
+		}
+
+		_state_device_free(&s->devices[did]);
+		s->devices[did] = n->devices[i];
+		memset(&n->devices[i], 0, sizeof(struct cxl_device));
+
+		if (did >= s->num_devices)
+			s->num_devices = did + 1;
+		state_gen_bump(STATE_GEN_DEVICES, 0);
+
+		IFV(CLVB_GENERAL) printf("%d:%s Added device %s as %u\n", gettid(), __FUNCTION__, s->devices[did].name, did);
+
+		// Index each device as it is added so a name repeated in the file is only added once
+		if (state_devices_index(s) != 0)
+			return 1;
+		added++;
+	}
+
+	IFV(CLVB_GENERAL) printf("%d:%s Added %u devices\n", gettid(), __FUNCTION__, added);
+
+	return 0;
+}
+
+/**
+ * Connect, disconnect or replace the device of each port whose assignment in
+ * the config file differs from the live port
+ *
+ * Ports with a bound vPPB are left alone. Caller must hold the topology lock 
+ *
+ * @param s 	struct cxl_switch that is running
+ * @param n 	struct cxl_switch parsed from the config file
+ * @return 		0 upon success, 1 if any port could not be changed
+ */
+static int _state_reload_ports(struct cxl_switch *s, struct cxl_switch *n)
+{
+	struct cxl_port *p;
+	char *name;
+	unsigned i;
+	int rv, k;
+
+	rv = 0;
+	for ( i = 0 ; i < s->num_ports ; i++ )
+	{
+		p = &s->ports[i];
+		name = n->ports[i].device_name;
+
+		if (name == p->device_name || (name != NULL && p->device_name != NULL && !strcmp(name, p->device_name)))
+			continue;
+
+		k = state_device_find(name);
+		if (name != NULL && (k < 0 || (unsigned) k >= s->num_devices))
+		{
+			IFV(CLVB_ERRORS) printf("%d:%s ERR: Port %u refers to unknown device: %s\n", gettid(), __FUNCTION__, i, name);
+			rv = 1;
+			continue;
+		}
+
+		if (state_binds_busy(i, STATE_BIND_PORT))
+		{
+			IFV(CLVB_ERRORS) printf("%d:%s ERR: Port %u is bound, not changing its device\n", gettid(), __FUNCTION__, i);
+			rv = 1;
+			continue;
+		}
+
+		state_lock_port(i);
+
+		if (p->device_name != NULL)
+		{
+			IFV(CLVB_GENERAL) printf("%d:%s Disconnecting device %s from port %u\n", gettid(), __FUNCTION__, p->device_name, i);
+			memspace_disconnect(p);
+			state_gen_bump(STATE_GEN_PORT, i);
+			events_post(EVTY_DISCONNECT, i);
+		}
+
+		if (k >= 0)
+		{
+			IFV(CLVB_GENERAL) printf("%d:%s Connecting device %s to port %u\n", gettid(), __FUNCTION__, name, i);
+			memspace_connect(p, &s->devices[k], s->dir);
+			state_gen_bump(STATE_GEN_PORT, i);
+			events_post(EVTY_CONNECT, i);
+		}
+
+		state_unlock_port(i);
+	}
+
+	return rv;
+}
+
+/**
+ * Free the memory owned by a device catalog entry and zero it
+ */
+static void _state_device_free(struct cxl_device *d)
+{
+	unsigned i;
+
+	free(d->name);
+	free(d->cfgspace);
+
+	if (d->mld != NULL)
+	{
+		for ( i = 0 ; i < FM_MAX_NUM_LD ; i++ )
+			free(d->mld->cfgspace[i]);
+		free(d->mld);
+	}
+
+	memset(d, 0, sizeof(struct cxl_device));
+}
+
+/**
+ * Grow the device catalog so it can hold at least num devices
+ *
+ * The catalog is one contiguous array that doubles in length when it grows.
+ * New entries are zeroed. Pointers into the catalog are invalidated when it
+ * grows, so callers must hold the topology lock once the switch is running
+ *
+ * @param s 	struct cxl_switch holding the catalog
+ * @param num 	Number of entries required
+ * @return 		0 upon success. Non zero otherwise
+ */
+int state_devices_reserve(struct cxl_switch *s, unsigned num)
+{
+	struct cxl_device *ptr;
+	unsigned len;
+
+	if (num <= s->len_devices && s->devices != NULL)
+		return 0;
+
+	if (num > MAX_DEVICES)
+		return 1;
+
+	len = s->len_devices ? s->len_devices : INITIAL_NUM_DEVICES;
+	while (len < num)
+		len *= 2;
+	if (len > MAX_DEVICES)
+		len = MAX_DEVICES;
+
+	ptr = realloc(s->devices, len * sizeof(struct cxl_device));
+	if (ptr == NULL)
+		return 1;
+
+	memset(&ptr[s->len_devices], 0, (len - s->len_devices) * sizeof(struct cxl_device));
+
+	s->devices = ptr;
+	s->len_devices = len;
+
+	return 0;
+}
+
+/**
+ * Rebuild the name index of the device catalog 
+ *
+ * Must be called after entries are added to or renamed in the catalog. The
+ * index is that of the switch selected by the calling thread
+ *
+ * @param s 	struct cxl_switch holding the catalog
+ * @return 		0 upon success. Non zero otherwise
+ */
+int state_devices_index(struct cxl_switch *s)
+{
+	GHashTable **ht;
+	unsigned i;
+
+	ht = &devindex[cxls_id];
+	if (*ht == NULL)
+		*ht = g_hash_table_new(g_str_hash, g_str_equal);
+	else 
+		g_hash_table_remove_all(*ht);
+
+	if (*ht == NULL)
+		return 1;
+
+	for ( i = 0 ; i < s->num_devices ; i++ )
+		if (s->devices[i].name != NULL)
+			g_hash_table_insert(*ht, s->devices[i].name, GUINT_TO_POINTER(i + 1));
+
+	return 0;
+}
+
+/**
+ * Look up a device in the catalog of the selected switch by name
+ *
+ * @param name 	Name of the device profile
+ * @return 		Index of the device in the catalog, -1 if not found
+ */
+int state_device_find(const char *name)
+{
+	gpointer v;
+
+	if (devindex[cxls_id] == NULL || name == NULL)
+		return -1;
+
+	v = g_hash_table_lookup(devindex[cxls_id], name);
+	if (v == NULL)
+		return -1;
+
+	return GPOINTER_TO_UINT(v) - 1;
+}
+
+/**
+ * Free the name indexes of the device catalogs of all switches
+ */
+void state_devices_free()
+{
+	unsigned i;
+
+	for ( i = 0 ; i < SWLN_SWITCHES ; i++ )
+	{
+		if (devindex[i] != NULL)
+			g_hash_table_destroy(devindex[i]);
+		devindex[i] = NULL;
+	}
+}
+
+/**
+ * Build the reverse index of the vPPB binding table
+ *
+ * Must be called after the switch state has been loaded and before any 
+ * requests are serviced
+ *
+ * @param s 	struct cxl_switch to index, the switch selected by the calling thread
+ * @return 		0 upon success. Non zero otherwise
+ *
+ * STEPS
+ * 1: Allocate an entry for each physical port
+ * 2: Add each bound vPPB of each VCS
+ */
+int state_binds_init(struct cxl_switch *s)
+{
+	INIT
+	int rv;
+	unsigned i, k;
+
+	ENTER
+
+	// Initialize variables
+	rv = 1;
+
+	STEP // 1: Allocate an entry for each physical port
+	state_binds_free();
+
+	binds[cxls_id] = calloc(s->num_ports, sizeof(struct state_port_binds));
+	if (binds[cxls_id] == NULL && s->num_ports > 0)
+		goto end;
+	num_binds[cxls_id] = s->num_ports;
+
+	STEP // 2: Add each bound vPPB of each VCS
+	for ( i = 0 ; i < s->num_vcss ; i++ )
+		for ( k = 0 ; k < s->num_vppbs ; k++ )
+			state_binds_add(i, &s->vcss[i].vppbs[k]);
+
+	rv = 0;
+
+end:
+
+	EXIT(rv)
+
+	return rv;
+}
+
+/**
+ * Free the reverse index of the switch selected by the calling thread
+ */
+void state_binds_free()
+{
+	free(binds[cxls_id]);
+	binds[cxls_id] = NULL;
+	num_binds[cxls_id] = 0;
+	num_bound[cxls_id] = 0;
+}
+
+/**
+ * Return the index entry a bound vPPB refers to
+ *
+ * @return 	struct state_bind* or NULL if the vPPB is not bound to a valid port
+ */
+static struct state_bind *_state_binds_entry(struct cxl_vppb *b)
+{
+	if (b->ppid >= num_binds[cxls_id])
+		return NULL;
+
+	if (b->bind_status == FMBS_BOUND_PORT)
+		return &binds[cxls_id][b->ppid].port;
+
+	if (b->bind_status == FMBS_BOUND_LD && b->ldid < MAX_LD)
+		return &binds[cxls_id][b->ppid].ld[b->ldid];
+
+	return NULL;
+}
+
+/**
+ * Record a vPPB binding in the reverse index
+ *
+ * Call after the bind status, ppid and ldid of the vPPB have been set 
+ *
+ * @param vcsid 	VCS ID the vPPB belongs to
+ * @param b 		struct cxl_vppb that was bound
+ */
+void state_binds_add(unsigned vcsid, struct cxl_vppb *b)
+{
+	struct state_bind *e;
+
+	e = _state_binds_entry(b);
+	if (e == NULL || e->bound)
+		return;
+
+	e->bound = 1;
+	e->vcsid = vcsid;
+	e->vppbid = b->vppbid;
+
+	binds[cxls_id][b->ppid].num++;
+	num_bound[cxls_id]++;
+}
+
+/**
+ * Remove a vPPB binding from the reverse index
+ *
+ * Call before the bind status, ppid and ldid of the vPPB are cleared 
+ *
+ * @param b 		struct cxl_vppb that is being unbound
+ */
+void state_binds_remove(struct cxl_vppb *b)
+{
+	struct state_bind *e;
+
+	e = _state_binds_entry(b);
+	if (e == NULL || !e->bound)
+		return;
+
+	e->bound = 0;
+
+	binds[cxls_id][b->ppid].num--;
+	num_bound[cxls_id]--;
+}
+
+/**
+ * Check if a port or LD cannot be bound because it, or the port it 
+ * belongs to, is already bound
+ *
+ * @param ppid 	Physical port ID
+ * @param ldid 	LD ID or STATE_BIND_PORT for the whole port
+ * @return 		1 if already bound or out of range, 0 otherwise
+ */
+int state_binds_busy(unsigned ppid, unsigned ldid)
+{
+	if (ppid >= num_binds[cxls_id])
+		return 1;
+
+	if (ldid == STATE_BIND_PORT)
+		return binds[cxls_id][ppid].num > 0;
+
+	if (ldid >= MAX_LD)
+		return 1;
+
+	return binds[cxls_id][ppid].port.bound || binds[cxls_id][ppid].ld[ldid].bound;
+}
+
+/**
+ * Return the bindings of a physical port
+ *
+ * @return 	struct state_port_binds* or NULL if ppid is out of range
+ */
+struct state_port_binds *state_binds_port(unsigned ppid)
+{
+	if (ppid >= num_binds[cxls_id])
+		return NULL;
+
+	return &binds[cxls_id][ppid];
+}
+
+/**
+ * Return the number of bound vPPBs across all VCSs
+ */
+unsigned state_binds_num()
+{
+	return num_bound[cxls_id];
+}
+
+/**
+ * Initialize the fine grained locks for the switch state 
+ *
+ * This must be called after the configuration file has been loaded as the 
+ * number of ports and VCSs is not known until then
+ *
+ * @param s 	struct cxl_switch to create locks for, the switch selected by the 
+ * 				calling thread
+ * @return 		Returns 0 upon success. Non zero otherwise
+ *
+ * STEPS
+ * 1: Validate inputs
+ * 2: Initialize identity lock
+ * 3: Allocate and initialize port locks
+ * 4: Allocate and initialize VCS locks
+ */
+int state_locks_init(struct cxl_switch *s)
+{
+	INIT
+	struct state_locks *l;
+	int rv;
+	unsigned i;
+
+	ENTER
+
+	// Initialize variables
+	rv = 1;
+	l = &locks[cxls_id];
+
+	STEP // 1: Validate inputs
+	if (s == NULL) 
+		goto end;
+
+	STEP // 2: Initialize identity lock
+	pthread_rwlock_init(&l->id, NULL);
+
+	STEP // 3: Allocate and initialize port locks
+	l->ports = calloc(s->num_ports, sizeof(pthread_mutex_t));
+	if (l->ports == NULL)
+		goto end;
+	l->num_ports = s->num_ports;
+	for ( i = 0 ; i < l->num_ports ; i++ )
+		pthread_mutex_init(&l->ports[i], NULL);
+
+	STEP // 4: Allocate and initialize VCS locks
+	l->vcss = calloc(s->num_vcss, sizeof(pthread_mutex_t));
+	if (l->vcss == NULL)
+		goto end_ports;
+	l->num_vcss = s->num_vcss;
+	for ( i = 0 ; i < l->num_vcss ; i++ )
+		pthread_mutex_init(&l->vcss[i], NULL);
+
+	rv = 0;
+	goto end;
+
+end_ports:
+
+	free(l->ports);
+	l->ports = NULL;
+	l->num_ports = 0;
+
+end:
+
+	EXIT(rv)
+
+	return rv;
+}
+
+/**
+ * Free the fine grained locks of the switch selected by the calling thread
+ */
+void state_locks_free()
+{
+	struct state_locks *l;
+	unsigned i;
+
+	l = &locks[cxls_id];
+
+	for ( i = 0 ; i < l->num_ports ; i++ )
+		pthread_mutex_destroy(&l->ports[i]);
+	free(l->ports);
+	l->ports = NULL;
+	l->num_ports = 0;
+
+	for ( i = 0 ; i < l->num_vcss ; i++ )
+		pthread_mutex_destroy(&l->vcss[i]);
+	free(l->vcss);
+	l->vcss = NULL;
+	l->num_vcss = 0;
+
+	pthread_rwlock_destroy(&l->id);
+}
+
+/**
+ * Obtain the topology lock (device catalog and vPPB binding table)
+ *
+ * The state lock functions first try to take the lock without blocking. Only
+ * if the lock is contended is the time spent waiting measured and reported 
+ * to metrics_wait()
+ */
+void state_lock_topology()
+{
+	struct timespec ts;
+
+	if (pthread_mutex_trylock(&cxls->mtx) == 0)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	pthread_mutex_lock(&cxls->mtx);
+	metrics_wait(&ts);
+}
+
+/**
+ * Release the topology lock
+ */
+void state_unlock_topology()
+{
+	pthread_mutex_unlock(&cxls->mtx);
+}
+
+/**
+ * Obtain the switch identity lock
+ *
+ * @param write 	0 to obtain a shared read lock, 1 for an exclusive write lock
+ */
+void state_lock_id(int write)
+{
+	struct timespec ts;
+
+	if (write)
+	{
+		if (pthread_rwlock_trywrlock(&locks[cxls_id].id) == 0)
+			return;
+
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		pthread_rwlock_wrlock(&locks[cxls_id].id);
+	}
+	else
+	{
+		if (pthread_rwlock_tryrdlock(&locks[cxls_id].id) == 0)
+			return;
+
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		pthread_rwlock_rdlock(&locks[cxls_id].id);
+	}
+
+	metrics_wait(&ts);
+}
+
+/**
+ * Release the switch identity lock
+ */
+void state_unlock_id()
+{
+	pthread_rwlock_unlock(&locks[cxls_id].id);
+}
+
+/**
+ * Obtain the lock of a Virtual CXL Switch 
+ *
+ * @param vcsid 	VCS ID. Caller must have validated it against num_vcss
+ */
+void state_lock_vcs(unsigned vcsid)
+{
+	struct timespec ts;
+
+	if (vcsid >= locks[cxls_id].num_vcss)
+		return;
+
+	if (pthread_mutex_trylock(&locks[cxls_id].vcss[vcsid]) == 0)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	pthread_mutex_lock(&locks[cxls_id].vcss[vcsid]);
+	metrics_wait(&ts);
+}
+
+/**
+ * Release the lock of a Virtual CXL Switch 
+ */
+void state_unlock_vcs(unsigned vcsid)
+{
+	if (vcsid < locks[cxls_id].num_vcss)
+		pthread_mutex_unlock(&locks[cxls_id].vcss[vcsid]);
+}
+
+/**
+ * Obtain the lock of a physical port
+ *
+ * @param ppid 		Physical Port ID. Caller must have validated it against num_ports
+ */
+void state_lock_port(unsigned ppid)
+{
+	struct timespec ts;
+
+	if (ppid >= locks[cxls_id].num_ports)
+		return;
+
+	if (pthread_mutex_trylock(&locks[cxls_id].ports[ppid]) == 0)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	pthread_mutex_lock(&locks[cxls_id].ports[ppid]);
+	metrics_wait(&ts);
+}
+
+/**
+ * Release the lock of a physical port
+ */
+void state_unlock_port(unsigned ppid)
+{
+	if (ppid < locks[cxls_id].num_ports)
+		pthread_mutex_unlock(&locks[cxls_id].ports[ppid]);
+}
+
+/**
+ * Return the address of a generation counter
+ *
+ * @return 	__u64* or NULL if the object or id is out of range
+ */
+static __u64 *_state_gen_ptr(unsigned obj, unsigned id)
+{
+	struct state_gens *g;
+
+	g = &gens[cxls_id];
+
+	switch (obj)
+	{
+		case STATE_GEN_ALL: 		return &g->all;
+		case STATE_GEN_ID: 			return &g->id;
+		case STATE_GEN_DEVICES: 	return &g->devices;
+		case STATE_GEN_VCS: 		return (id < MAX_VCSS) ? &g->vcss[id] : NULL;
+		case STATE_GEN_PORT: 		return (id < MAX_PORTS) ? &g->ports[id] : NULL;
+		default: 					return NULL;
+	}
+}
+
+/**
+ * Return the generation of an object of the switch state
+ *
+ * The generation changes every time the object changes, so a response built 
+ * from the object can be reused for as long as its generation is the same
+ *
+ * @param obj 	enum _STATE_GEN
+ * @param id 	VCS ID or PPID, ignored for other objects
+ * @return 		Generation. Objects out of range report the STATE_GEN_ALL counter
+ */
+__u64 state_gen(unsigned obj, unsigned id)
+{
+	__u64 *g;
 
-	STEP // 9: Free memory allocated for hash table
-	yl_free(ht);
+	g = _state_gen_ptr(obj, id);
+	if (g == NULL)
+		g = &gens[cxls_id].all;
 
-	rv = 0;
+	return __atomic_load_n(g, __ATOMIC_ACQUIRE);
+}
 
-end:
+/**
+ * Record that an object of the switch state changed
+ *
+ * @param obj 	enum _STATE_GEN
+ * @param id 	VCS ID or PPID, ignored for other objects
+ */
+void state_gen_bump(unsigned obj, unsigned id)
+{
+	__u64 *g;
 
-	EXIT(rv)
+	g = _state_gen_ptr(obj, id);
+	if (g != NULL && g != &gens[cxls_id].all)
+		__atomic_add_fetch(g, 1, __ATOMIC_RELEASE);
 
-	return rv;
+	__atomic_add_fetch(&gens[cxls_id].all, 1, __ATOMIC_RELEASE);
 }
 
 /**
@@ -232,6 +1349,7 @@ end:
  * 1: Obtain hash table 
  * 2: Allocate memory for devices in state
  * 3: Parse each entry in the hash table
+ * 4: Index the devices by name
  */
 int state_load_devices(struct cxl_switch *state, GHashTable *ht)
 {
@@ -250,15 +1368,14 @@ int state_load_devices(struct cxl_switch *state, GHashTable *ht)
 		goto end;
 
 	STEP // 2: Allocate memory for devices in state
-	state->devices = calloc(INITIAL_NUM_DEVICES, sizeof(struct cxl_device));
-	if (state->devices == NULL)
+	if (state_devices_reserve(state, INITIAL_NUM_DEVICES) != 0)
 		goto end;
-	state->len_devices = INITIAL_NUM_DEVICES;
 	
 	STEP // 3: Parse each entry in the device table
 	g_hash_table_foreach(ylo->ht, _parse_devices, state);	
 
-	rv = 0;
+	STEP // 4: Index the devices by name
+	rv = state_devices_index(state);
 
 end:
 
@@ -308,245 +1425,328 @@ end:
 /**
  * Load ports and vcs from physical pci devices
  *
- * @param ht 	GHashTable holding contents of config.yaml file
- * @return 		Returns 0 upon success. Non zero otherwise
+ * @param state 	struct cxl_switch to fill
+ * @return 			Returns 0 upon success. Non zero otherwise
  *
  * STEPS
+ * 1: Get pci_access ptr, init pci_access ptr, get all the devices
+ * 2: Iterate over all devices and add each CXL port to the state
  */
 int state_load_from_pci(struct cxl_switch *state)
 {
 	INIT
-
-	int rv, cache, mem;
-	unsigned int num_dvsec, nr;
-	__u32 l, type, vppbid;
-	__u16 w;
-	struct pci_dev *dev, *parent;
-	struct pci_cap *cap;
+	int rv;
+	unsigned vppbid;
+	struct pci_dev *dev;
 	struct cxl_port cp;
-	__u32 fillflags;
 
 	ENTER 
 
 	// Initialize variables 
 	rv = 1;
-	fillflags =  PCI_FILL_IDENT		
-				|PCI_FILL_CLASS		
-				|PCI_FILL_CAPS		
-				|PCI_FILL_EXT_CAPS	
-				|PCI_FILL_PHYS_SLOT	
-				|PCI_FILL_MODULE_ALIAS
-				|PCI_FILL_LABEL		
-				|PCI_FILL_NUMA_NODE	
-				|PCI_FILL_IO_FLAGS	
-				|PCI_FILL_CLASS_EXT	
-				|PCI_FILL_SUBSYS		
-				|PCI_FILL_PARENT		
-				|PCI_FILL_DRIVER;
-
-	STEP // : get pci_access ptr, init pci_access ptr, get all the devices
+
+	STEP // 1: Get pci_access ptr, init pci_access ptr, get all the devices
 	state->pacc = pci_alloc(); 		
+	if (state->pacc == NULL)
+		goto end;
 	pci_init(state->pacc);			
 	pci_scan_bus(state->pacc);		
 
-	// STEP 3: Iiterate over all devices
+	STEP // 2: Iterate over all devices and add each CXL port to the state
 	for ( dev = state->pacc->devices ; dev ; dev = dev->next ) 
-	{
-		pci_fill_info(dev, PCI_FILL_CLASS); 	
+		if (state_pci_read(state, dev, &cp, &vppbid) == 0)
+			state_pci_apply(state, &cp, vppbid);
 
-		// If this is a PCI-to-PCI Bridge then check if it is a CXL upstream port 
-		if ( (dev->device_class >> 8) == 0x06 && (dev->device_class & 0x0FF) == 0x04 )
-		{
-			// Get more info about this device 
-			pci_fill_info(dev, fillflags);
+	rv = 0;
 
-			// Get PCI Express Capability 
-			cap = pci_find_cap(dev, PCI_CAP_ID_EXP, PCI_CAP_NORMAL);
-			if (cap == NULL)
-				continue;
-
-			// Determine port type 
-			w = pci_read_word(dev, cap->addr + PCI_EXP_FLAGS);
-			type = (w & PCI_EXP_FLAGS_TYPE) >> 4;
-			if (type != PCI_EXP_TYPE_UPSTREAM)
-				continue;
-
-			// Clear the local CXL Port before filling it
-			memset(&cp, 0, sizeof(cp));
-
-			// Get max speed / width / vppbid 
-  			l = pci_read_long(dev, cap->addr + PCI_EXP_LNKCAP);
-  			cp.mls = l & PCI_EXP_LNKCAP_SPEED;
-  			cp.mlw = (l & PCI_EXP_LNKCAP_WIDTH) >> 4;
-			vppbid = l >> 24;
-
-			// Get cur speed / width 
-  			w = pci_read_word(dev, cap->addr + PCI_EXP_LNKSTA);
-  			cp.cls = w & PCI_EXP_LNKSTA_SPEED;
-  			cp.nlw = (w & PCI_EXP_LNKSTA_WIDTH) >> 4;
-		
-			// If parent is NULL, then skip this device as we know nothing about it
-			parent = dev->parent;
-			if (parent == NULL)
-				continue;
-		
-			// Get all info about the parent device 
-			pci_fill_info(parent, fillflags);
+end:
 
-			// Get PCI Express Capability 
-			cap = pci_find_cap(parent, PCI_CAP_ID_EXP, PCI_CAP_NORMAL);
-			if (cap == NULL)
-				continue;
-
-			// Get physical port id from Slot Number in PCI Express capability
-			l = pci_read_long(parent, cap->addr + PCI_EXP_SLTCAP);
-			cp.ppid = ((l & PCI_EXP_SLTCAP_PSN) >> 19);
-
-			// Set switch IDs based on the upstream port identifiers
-			state->vid = dev->vendor_id;
-			state->did = dev->device_id;
-			state->ssid = dev->subsys_id;
-			state->svid = dev->subsys_vendor_id;
-			state->sn =    ((__u64) dev->domain_16 		) << 48
-						|  ((__u64) dev->device_class 	) << 32
-						|  ((__u64) dev->prog_if 		) << 24
-						|  ((__u64) dev->bus 			) << 16
-						|  ((__u64) dev->dev 			) << 8
-						|  ((__u64) dev->func 			) ;
-
-			// Set bind in vcs 
-			state->vcss[0].uspid = cp.ppid;
-			state->vcss[0].state = FMVS_ENABLED;
-			state->vcss[0].vppbs[vppbid].ppid = cp.ppid;
-			state->vcss[0].vppbs[vppbid].bind_status = FMBS_BOUND_PORT;
-			state->vcss[0].vppbs[vppbid].ldid = 0;
-
-			// Fill local struct cxl_port fields 
-			cp.state = FMPS_USP;
-			cp.dt = FMDT_CXL_TYPE_1;
-			cp.speeds = cp.mls;
-			cp.ltssm = FMLS_L0;
-			cp.lane = 0;
-			cp.lane_rev = 0;
-			cp.perst = 0;
-			cp.prsnt = 1;
-			cp.pwrctrl = 0;
-			cp.dev = dev;
-			cp.dv = FMDV_CXL2_0;
-			cp.cv = FMCV_CXL1_1 | FMCV_CXL2_0;
-
-			// Copy local struct cxl_port into global state 
-			memcpy(&state->ports[cp.ppid], &cp, sizeof(cp));
-		}
+	EXIT(rv)
 
-		// If this is a CXL device, then gather more info and the parent's info 
-		else if ( (dev->device_class >> 8) == 0x05 && (dev->device_class & 0x0FF) == 0x02 )
-		{
-			// Get more info about this device 
-			pci_fill_info(dev, fillflags);
+	return rv;
+}
 
-			// If parent is NULL, then skip this device as we know nothing about it
-			parent = dev->parent;
-			if (parent == NULL)
-				continue;
-		
-			// Get all info about the parent device 
-			pci_fill_info(parent, fillflags);
+/**
+ * Read the port described by a PCI device 
+ *
+ * A CXL switch upstream port bridge describes the USP. A CXL device below a 
+ * downstream port bridge describes the DSP it is connected to. Only the 
+ * fields read here are filled by libpci so a single device can be refreshed 
+ * cheaply when it is hot plugged. The switch state is not modified
+ *
+ * @param s 		struct cxl_switch used to bound check the port and vPPB IDs
+ * @param dev 		struct pci_dev to read. The parent must be known to libpci
+ * @param cp 		struct cxl_port to fill 
+ * @param vppbid 	Set to the vPPB of VCS 0 the port is bound to
+ * @return 			0 if the device describes a port, 1 otherwise
+ */
+int state_pci_read(struct cxl_switch *s, struct pci_dev *dev, struct cxl_port *cp, unsigned *vppbid)
+{
+	int cache, mem, usp;
+	unsigned int num_dvsec, nr;
+	__u32 l, type;
+	__u16 w;
+	struct pci_dev *parent;
+	struct pci_cap *cap;
+
+	pci_fill_info(dev, PCI_FILL_CLASS); 	
+
+	// PCI-to-PCI Bridge that may be a CXL upstream port, or a CXL device 
+	if ( (dev->device_class >> 8) == 0x06 && (dev->device_class & 0x0FF) == 0x04 )
+		usp = 1;
+	else if ( (dev->device_class >> 8) == 0x05 && (dev->device_class & 0x0FF) == 0x02 )
+		usp = 0;
+	else 
+		return 1;
+
+	// Get more info about this device 
+	pci_fill_info(dev, STATE_PCI_FILL);
+
+	// If parent is NULL, then skip this device as we know nothing about it
+	parent = dev->parent;
+	if (parent == NULL)
+		return 1;
+
+	// Get all info about the parent device 
+	pci_fill_info(parent, STATE_PCI_FILL);
+
+	// Clear the local CXL Port before filling it
+	memset(cp, 0, sizeof(*cp));
+
+	if (usp)
+	{
+		// Get PCI Express Capability and determine port type 
+		cap = pci_find_cap(dev, PCI_CAP_ID_EXP, PCI_CAP_NORMAL);
+		if (cap == NULL)
+			return 1;
+
+		w = pci_read_word(dev, cap->addr + PCI_EXP_FLAGS);
+		type = (w & PCI_EXP_FLAGS_TYPE) >> 4;
+		if (type != PCI_EXP_TYPE_UPSTREAM)
+			return 1;
+
+		// Get max speed / width / vppbid 
+		l = pci_read_long(dev, cap->addr + PCI_EXP_LNKCAP);
+		cp->mls = l & PCI_EXP_LNKCAP_SPEED;
+		cp->mlw = (l & PCI_EXP_LNKCAP_WIDTH) >> 4;
+		*vppbid = l >> 24;
+
+		// Get cur speed / width 
+		w = pci_read_word(dev, cap->addr + PCI_EXP_LNKSTA);
+		cp->cls = w & PCI_EXP_LNKSTA_SPEED;
+		cp->nlw = (w & PCI_EXP_LNKSTA_WIDTH) >> 4;
+
+		// Get physical port id from Slot Number in PCI Express capability (Parent)
+		cap = pci_find_cap(parent, PCI_CAP_ID_EXP, PCI_CAP_NORMAL);
+		if (cap == NULL)
+			return 1;
+
+		l = pci_read_long(parent, cap->addr + PCI_EXP_SLTCAP);
+		cp->ppid = ((l & PCI_EXP_SLTCAP_PSN) >> 19);
+
+		cp->state = FMPS_USP;
+		cp->dt = FMDT_CXL_TYPE_1;
+	}
+	else 
+	{
+		// Get PCI Express Capability and determine port type (Parent)
+		cap = pci_find_cap(parent, PCI_CAP_ID_EXP, PCI_CAP_NORMAL);
+		if (cap == NULL)
+			return 1;
+
+		w = pci_read_word(parent, cap->addr + PCI_EXP_FLAGS);
+		type = (w & PCI_EXP_FLAGS_TYPE) >> 4;
+		if ( type != PCI_EXP_TYPE_DOWNSTREAM )
+			return 1;
+
+		// Get physical port number from SLot number in PCI Express capability (Parent)
+		l = pci_read_long(parent, cap->addr + PCI_EXP_SLTCAP);
+		cp->ppid = ((l & PCI_EXP_SLTCAP_PSN) >> 19);
+
+		// Get max speed / width / vppbid (Parent)
+		l = pci_read_long(parent, cap->addr + PCI_EXP_LNKCAP);
+		cp->mls = l & PCI_EXP_LNKCAP_SPEED;
+		cp->mlw = (l & PCI_EXP_LNKCAP_WIDTH) >> 4;
+		*vppbid = l >> 24;
+
+		// Get cur speeds
+		w = pci_read_word(parent, cap->addr + PCI_EXP_LNKSTA);
+		cp->cls = w & PCI_EXP_LNKSTA_SPEED;
+		cp->nlw = (w & PCI_EXP_LNKSTA_WIDTH) >> 4;
+	
+		// Get number of DVSEC Capabilities in Dev. Num returned in variable num_dvsec
+		num_dvsec = 0;
+		cap = pci_find_cap_nr(dev, PCI_EXT_CAP_ID_DVSEC, PCI_CAP_EXTENDED, &num_dvsec);
 
-			// Get PCI Express Capability (Parent)
-			cap = pci_find_cap(parent, PCI_CAP_ID_EXP, PCI_CAP_NORMAL);
+		// Loop through DVSEC capabilities
+		for ( nr = 0 ; nr < num_dvsec ; nr++)
+		{
+			// Get DVSEC Capability entry number nr
+			cap = pci_find_cap_nr(dev, PCI_EXT_CAP_ID_DVSEC, PCI_CAP_EXTENDED, &nr);
 			if (cap == NULL)
-				continue;
-
-			// Determine port type (Parent)
-			w = pci_read_word(parent, cap->addr + PCI_EXP_FLAGS);
-			type = (w & PCI_EXP_FLAGS_TYPE) >> 4;
-			if ( type != PCI_EXP_TYPE_DOWNSTREAM )
-				continue;
-
-			// Clear the local CXL Port before filling it
-			memset(&cp, 0, sizeof(cp));
-
-			// Get physical port number from SLot number in PCI Express capability (Parent)
-			l = pci_read_long(parent, cap->addr + PCI_EXP_SLTCAP);
-			cp.ppid = ((l & PCI_EXP_SLTCAP_PSN) >> 19);
-
-			// Get max speed / width / vppbid (Parent)
-  			l = pci_read_long(parent, cap->addr + PCI_EXP_LNKCAP);
-  			cp.mls = l & PCI_EXP_LNKCAP_SPEED;
-  			cp.mlw = (l & PCI_EXP_LNKCAP_WIDTH) >> 4;
-			vppbid = l >> 24;
-
-			// Get cur speeds
-  			w = pci_read_word(parent, cap->addr + PCI_EXP_LNKSTA);
-  			cp.cls = w & PCI_EXP_LNKSTA_SPEED;
-  			cp.nlw = (w & PCI_EXP_LNKSTA_WIDTH) >> 4;
-		
-			// Get number of DVSEC Capabilities in Dev. Num returned in variable num_dvsec
-			num_dvsec = 0;
-			cap = pci_find_cap_nr(dev, PCI_EXT_CAP_ID_DVSEC, PCI_CAP_EXTENDED, &num_dvsec);
+				break;
 
-			// Loop through DVSEC capabilities
-			for ( nr = 0 ; nr < num_dvsec ; nr++)
+			// Get the DVSEC.type
+			w = pci_read_long(dev, cap->addr + PCI_DVSEC_HEADER2);
+
+			// If DVSEC.type==0, this DVSEC Capability describes device type 
+			if (w == 0)
 			{
-				// Get DVSEC Capability entry number nr
-				cap = pci_find_cap_nr(dev, PCI_EXT_CAP_ID_DVSEC, PCI_CAP_EXTENDED, &nr);
-
-				// Get the DVSEC.type
-  				w = pci_read_long(dev, cap->addr + PCI_DVSEC_HEADER2);
-
-				// If DVSEC.type==0, this DVSEC Capability describes device type 
-				if (w == 0)
-				{
-					// Get the flags indicating what CXL protocols are supported
-					w = pci_read_word(dev, cap->addr + PCI_CXL_DEV_CAP);
-					cache = w & PCI_CXL_DEV_CAP_CACHE;
-					mem  = (w & PCI_CXL_DEV_CAP_MEM) >> 2;
-
-					// Determine Device Type 
-					if      (cache == 1 && mem == 0) cp.dt = FMDT_CXL_TYPE_1;
-					else if (cache == 1 && mem == 1) cp.dt = FMDT_CXL_TYPE_2;
-					else if (cache == 0 && mem == 1) cp.dt = FMDT_CXL_TYPE_3;
-
-					break;
-				}
-
-				// If the DVSEC Type is 9 then this is a MLD DVSEC 
-				else if (w == 9)
-				{
-					// Set that this is a MLD device 
-					cp.ld = pci_read_word(dev, cap->addr + PCI_CXL_MLD_NUM_LD);
-					cp.dt = FMDT_CXL_TYPE_3_POOLED;
-				}
+				// Get the flags indicating what CXL protocols are supported
+				w = pci_read_word(dev, cap->addr + PCI_CXL_DEV_CAP);
+				cache = w & PCI_CXL_DEV_CAP_CACHE;
+				mem  = (w & PCI_CXL_DEV_CAP_MEM) >> 2;
+
+				// Determine Device Type 
+				if      (cache == 1 && mem == 0) cp->dt = FMDT_CXL_TYPE_1;
+				else if (cache == 1 && mem == 1) cp->dt = FMDT_CXL_TYPE_2;
+				else if (cache == 0 && mem == 1) cp->dt = FMDT_CXL_TYPE_3;
+
+				break;
 			}
 
-			// Set bind in vcs 
-			state->vcss[0].state = FMVS_ENABLED;
-			state->vcss[0].vppbs[vppbid].ppid = cp.ppid;
-			state->vcss[0].vppbs[vppbid].bind_status = FMBS_BOUND_PORT;
-			state->vcss[0].vppbs[vppbid].ldid = 0;
-
-			// Fill local struct cxl_port fields 
-			cp.state = FMPS_DSP;
-			cp.speeds = cp.mls;
-			cp.ltssm = FMLS_L0;
-			cp.lane = 0;
-			cp.lane_rev = 0;
-			cp.perst = 0;
-			cp.prsnt = 1;
-			cp.pwrctrl = 0;
-			cp.dev = dev;
-			cp.dv = FMDV_CXL2_0;
-			cp.cv = FMCV_CXL1_1 | FMCV_CXL2_0;
-
-			// Copy local struct cxl_port into global state 
-			memcpy(&state->ports[cp.ppid], &cp, sizeof(cp));
+			// If the DVSEC Type is 9 then this is a MLD DVSEC 
+			else if (w == 9)
+			{
+				// Set that this is a MLD device 
+				cp->ld = pci_read_word(dev, cap->addr + PCI_CXL_MLD_NUM_LD);
+				cp->dt = FMDT_CXL_TYPE_3_POOLED;
+			}
 		}
+
+		cp->state = FMPS_DSP;
 	}
 
-	rv = 0;
+	// Discard ports and vPPBs the switch state cannot hold
+	if (cp->ppid >= s->num_ports || *vppbid >= s->num_vppbs)
+	{
+		IFV(CLVB_ERRORS) printf("%d:%s ERR: PCI device %02x:%02x.%d maps to PPID %u vPPB %u outside the switch\n", gettid(), __FUNCTION__, dev->bus, dev->dev, dev->func, cp->ppid, *vppbid);
+		return 1;
+	}
 
-	return rv;
+	// Fill local struct cxl_port fields 
+	cp->speeds = cp->mls;
+	cp->ltssm = FMLS_L0;
+	cp->lane = 0;
+	cp->lane_rev = 0;
+	cp->perst = 0;
+	cp->prsnt = 1;
+	cp->pwrctrl = 0;
+	cp->dev = dev;
+	cp->dv = FMDV_CXL2_0;
+	cp->cv = FMCV_CXL1_1 | FMCV_CXL2_0;
+
+	return 0;
+}
+
+/**
+ * Copy a port read by state_pci_read() into the switch state and bind it to
+ * its vPPB in VCS 0
+ *
+ * Caller must hold the topology lock, the write id lock for an upstream port, 
+ * and the locks of VCS 0 and the port once the switch is running
+ *
+ * @param s 		struct cxl_switch to update
+ * @param cp 		struct cxl_port filled by state_pci_read()
+ * @param vppbid 	vPPB of VCS 0 
+ */
+void state_pci_apply(struct cxl_switch *s, struct cxl_port *cp, unsigned vppbid)
+{
+	struct pci_dev *dev;
+	struct cxl_vppb *v;
+
+	dev = cp->dev;
+
+	// Set switch IDs based on the upstream port identifiers
+	if (cp->state == FMPS_USP)
+	{
+		s->vid = dev->vendor_id;
+		s->did = dev->device_id;
+		s->ssid = dev->subsys_id;
+		s->svid = dev->subsys_vendor_id;
+		s->sn =    ((__u64) dev->domain_16 		) << 48
+				|  ((__u64) dev->device_class 	) << 32
+				|  ((__u64) dev->prog_if 		) << 24
+				|  ((__u64) dev->bus 			) << 16
+				|  ((__u64) dev->dev 			) << 8
+				|  ((__u64) dev->func 			) ;
+		s->vcss[0].uspid = cp->ppid;
+	}
+
+	// Set bind in vcs 
+	v = &s->vcss[0].vppbs[vppbid];
+	state_binds_remove(v);
+
+	s->vcss[0].state = FMVS_ENABLED;
+	v->ppid = cp->ppid;
+	v->bind_status = FMBS_BOUND_PORT;
+	v->ldid = 0;
+
+	state_binds_add(0, v);
+
+	// Copy local struct cxl_port into global state 
+	memcpy(&s->ports[cp->ppid], cp, sizeof(*cp));
+}
+
+/**
+ * Find the port a PCI device was loaded into
+ *
+ * Caller must hold the topology lock once the switch is running
+ *
+ * @return 	PPID of the port or -1 if no port refers to the device
+ */
+int state_pci_find(struct cxl_switch *s, int domain, int bus, int dev, int func)
+{
+	struct pci_dev *d;
+	unsigned i;
+
+	for ( i = 0 ; i < s->num_ports ; i++ )
+	{
+		d = s->ports[i].dev;
+		if (d != NULL && d->domain_16 == domain && d->bus == bus && d->dev == dev && d->func == func)
+			return i;
+	}
+
+	return -1;
+}
+
+/**
+ * Mark a port loaded from a PCI device as empty and unbind it from VCS 0
+ *
+ * Caller must hold the topology lock and the locks of VCS 0 and the port once
+ * the switch is running
+ */
+void state_pci_clear(struct cxl_switch *s, unsigned ppid)
+{
+	struct cxl_port *p;
+	struct cxl_vppb *v;
+	unsigned i;
+
+	p = &s->ports[ppid];
+
+	for ( i = 0 ; i < s->num_vppbs ; i++ )
+	{
+		v = &s->vcss[0].vppbs[i];
+		if (v->bind_status == FMBS_UNBOUND || v->ppid != ppid)
+			continue;
+
+		state_binds_remove(v);
+		v->bind_status = FMBS_UNBOUND;
+		v->ppid = 0;
+		v->ldid = 0;
+	}
+
+	p->dev = NULL;
+	p->dt = FMDT_NONE;
+	p->dv = FMDV_NOT_CXL;
+	p->cv = 0;
+	p->ld = 0;
+	p->prsnt = 0;
+	p->ltssm = FMLS_DETECT;
+	p->cls = 0;
+	p->nlw = 0;
+	if (p->state == FMPS_DSP)
+		p->state = FMPS_DISABLED;
 }
 
 
@@ -566,8 +1766,8 @@ int state_load_from_pci(struct cxl_switch *state)
 int state_load_ports(struct cxl_switch *state, GHashTable *ht)
 {
 	INIT
-	int rv;
-	unsigned i, k;
+	int rv, k;
+	unsigned i;
 	yl_obj_t *ylo;
 	struct cxl_port *port;
 
@@ -598,7 +1798,7 @@ int state_load_ports(struct cxl_switch *state, GHashTable *ht)
 		goto end;
 
 	STEP // 3: Parse each entry in the hash table
-	g_hash_table_foreach(ylo->ht, _parse_ports, state->ports);	
+	g_hash_table_foreach(ylo->ht, _parse_ports, state);	
 
 	STEP // 4: Instantiate each port device 
 	for ( i = 0 ; i < state->num_ports ; i++ )
@@ -606,11 +1806,9 @@ int state_load_ports(struct cxl_switch *state, GHashTable *ht)
 		port = &state->ports[i];
 
 		// If the port has a device name, copy values from it 	
-		if ( port->device_name != NULL ) 
-			for ( k = 0 ; k < state->num_devices ; k++ ) 
-				if (state->devices[k].name != NULL)
-					if ( !strcmp(state->devices[k].name, port->device_name) ) 
-						cxls_connect(port, &state->devices[k], cxls->dir);		
+		k = state_device_find(port->device_name);
+		if (k >= 0)
+			memspace_connect(port, &state->devices[k], cxls->dir);		
 	}
 
 	rv = 0;
@@ -660,6 +1858,177 @@ end:
 	return rv;
 }
 
+/**
+ * Size the ports and VCSs of the switch from the switch section 
+ *
+ * num_ports, num_vcss and num_vppbs are read directly so the port and VCS 
+ * arrays are allocated once at their configured size. Keys that are not 
+ * present keep the current size
+ *
+ * @param ht 	GHashTable holding contents of config.yaml file
+ * @return 		Returns 0 upon success. Non zero otherwise
+ *
+ * STEPS
+ * 1: Obtain hash table 
+ * 2: Read sizes and clamp them to the supported maximums 
+ * 3: Allocate ports and VCSs
+ */
+int state_load_size(struct cxl_switch *state, GHashTable *ht)
+{
+	INIT
+	int rv;
+	unsigned ports, vcss, vppbs;
+	yl_obj_t *ylo, *v;
+
+	ENTER
+
+	// Initialize variables
+	rv = 1;
+	ports = state->num_ports;
+	vcss = state->num_vcss;
+	vppbs = state->num_vppbs;
+
+	STEP // 1: Obtain hash table 
+	ylo = (yl_obj_t*) g_hash_table_lookup(ht, "switch");
+	if (ylo == NULL || ylo->ht == NULL) 
+		goto end;
+
+	STEP // 2: Read sizes and clamp them to the supported maximums 
+	v = (yl_obj_t*) g_hash_table_lookup(ylo->ht, "num_ports");
+	if (v != NULL && v->str != NULL)
+		ports = strtoul(v->str, NULL, 0);
+
+	v = (yl_obj_t*) g_hash_table_lookup(ylo->ht, "num_vcss");
+	if (v != NULL && v->str != NULL)
+		vcss = strtoul(v->str, NULL, 0);
+
+	v = (yl_obj_t*) g_hash_table_lookup(ylo->ht, "num_vppbs");
+	if (v != NULL && v->str != NULL)
+		vppbs = strtoul(v->str, NULL, 0);
+
+	if (ports > MAX_PORTS) 
+	{
+		IFV(CLVB_ERRORS) printf("%d:%s ERR: num_ports %u exceeds maximum %u\n", gettid(), __FUNCTION__, ports, MAX_PORTS);
+		ports = MAX_PORTS;
+	}
+	if (vcss > MAX_VCSS) 
+	{
+		IFV(CLVB_ERRORS) printf("%d:%s ERR: num_vcss %u exceeds maximum %u\n", gettid(), __FUNCTION__, vcss, MAX_VCSS);
+		vcss = MAX_VCSS;
+	}
+	if (vppbs > MAX_VPPBS_PER_VCS) 
+	{
+		IFV(CLVB_ERRORS) printf("%d:%s ERR: num_vppbs %u exceeds maximum %u\n", gettid(), __FUNCTION__, vppbs, MAX_VPPBS_PER_VCS);
+		vppbs = MAX_VPPBS_PER_VCS;
+	}
+
+	STEP // 3: Allocate ports and VCSs
+	if (ports != state->num_ports && cxls_init_ports(state, ports) != 0)
+		goto end;
+
+	if ((vcss != state->num_vcss || vppbs != state->num_vppbs) && cxls_init_vcss(state, vcss, vppbs) != 0)
+		goto end;
+
+	IFV(CLVB_GENERAL) printf("%d:%s Switch size. Ports: %u VCSs: %u vPPBs: %u\n", gettid(), __FUNCTION__, ports, vcss, vppbs);
+
+	rv = 0;
+
+end:
+
+	EXIT(rv)
+
+	return rv;
+}
+
+/**
+ * Return the config space of a port, allocating it on first touch
+ *
+ * Config space that has never been written is not allocated and reads as
+ * zero, so a large switch with mostly empty ports does not pay for it
+ *
+ * @param p 		struct cxl_port 
+ * @param alloc 	1 to allocate the config space if it does not exist
+ * @return 			Pointer to CFG_SPACE_SIZE bytes or NULL
+ */
+__u8 *state_port_cfgspace(struct cxl_port *p, int alloc)
+{
+	if (p->cfgspace == NULL && alloc)
+		p->cfgspace = calloc(1, CFG_SPACE_SIZE);
+
+	return p->cfgspace;
+}
+
+/**
+ * Return the config space of an LD of an MLD port, allocating the MLD and 
+ * the config space on first touch
+ *
+ * @param p 		struct cxl_port 
+ * @param ldid 		LD ID. Caller must have validated it against p->ld
+ * @param alloc 	1 to allocate the config space if it does not exist
+ * @return 			Pointer to CFG_SPACE_SIZE bytes or NULL
+ */
+__u8 *state_ld_cfgspace(struct cxl_port *p, unsigned ldid, int alloc)
+{
+	if (ldid >= FM_MAX_NUM_LD)
+		return NULL;
+
+	if (p->mld == NULL)
+	{
+		if (!alloc)
+			return NULL;
+
+		p->mld = calloc(1, sizeof(struct cxl_mld));
+		if (p->mld == NULL)
+			return NULL;
+		p->mld->num = p->ld;
+	}
+
+	if (p->mld->cfgspace[ldid] == NULL && alloc)
+		p->mld->cfgspace[ldid] = calloc(1, CFG_SPACE_SIZE);
+
+	return p->mld->cfgspace[ldid];
+}
+
+/**
+ * Compute the byte range of an LD within the memory space of an MLD port
+ *
+ * The range is set by the rng1 / rng2 entries of the LD in units of the 
+ * memory granularity of the MLD
+ *
+ * @param p 		struct cxl_port. Caller must have validated p->mld != NULL
+ * @param ldid 		LD ID. Caller must have validated it against p->ld
+ * @param base 		Set to the byte offset of the LD in the memory space
+ * @param size 		Set to the size of the LD in bytes
+ * @return 			0 upon success, 1 if the range exceeds the memory space
+ */
+int state_ld_memrange(struct cxl_port *p, unsigned ldid, __u64 *base, __u64 *size)
+{
+	__u64 granularity, max;
+
+	if (ldid >= FM_MAX_NUM_LD)
+		return 1;
+
+	// Get granularity in bytes
+	granularity = 1024*1024;
+	switch (p->mld->granularity)
+	{
+		case FMMG_256MB: 	granularity *= 256; 	break;
+		case FMMG_512MB: 	granularity *= 512; 	break;
+		case FMMG_1GB:   	granularity *= 1024; 	break;
+	}
+
+	// base is the byte offset into the memspace, max is the byte offset of the next LD 
+	*base = granularity *  p->mld->rng1[ldid];
+	max   = granularity * (p->mld->rng2[ldid] + 1);
+
+	if (max <= *base || max > p->mld->memory_size)
+		return 1;
+
+	*size = max - *base;
+
+	return 0;
+}
+
 /**
  * Load VCS definitions from hash table into memory
  *
@@ -687,7 +2056,7 @@ int state_load_vcss(struct cxl_switch *state, GHashTable *ht)
 		goto end;
 
 	STEP // 2: Parse each entry in the hash table
-	g_hash_table_foreach(ylo->ht, _parse_vcss, state->vcss);	
+	g_hash_table_foreach(ylo->ht, _parse_vcss, state);	
 
 	rv = 0;
 
@@ -703,7 +2072,7 @@ end:
  *
  * STEPS
  * 1: Obtain device ID from device entry
- * 2: Check if there is space for a new device in the device table, allocate more if needed
+ * 2: Check if there is space for the device in the device table, allocate more if needed
  * 3: Duplicate key string into state object
  * 4: Run parse function for each entry in sub hash table
  */
@@ -711,9 +2080,8 @@ void _parse_devices(gpointer key, gpointer value, gpointer user_data)
 {
 	INIT
 	struct cxl_switch *s;
-	yl_obj_t *ylo, *ylo_did;
+	yl_obj_t *ylo, *ylo_did, *ylo_mld, *ylo_numa;
 	unsigned did;
-	void * ptr; 
 
 	ENTER
 
@@ -730,28 +2098,29 @@ void _parse_devices(gpointer key, gpointer value, gpointer user_data)
 
 	did = strtoul(ylo_did->str, NULL, 0);
 
-	STEP // 2: Check if there is space for a new device in the device table, allocate more if needed
-	if (s->num_devices >= s->len_devices) 
+	STEP // 2: Check if there is space for the device in the device table, allocate more if needed
+	if (state_devices_reserve(s, did + 1) != 0) 
 	{
-		// Allocate more memory
-		ptr = calloc(s->len_devices + INITIAL_NUM_DEVICES, sizeof(struct cxl_device));
-
-		// Copy the existing data to new buffer
-		memcpy(ptr, s->devices, s->num_devices * sizeof(struct cxl_device));
-
-		// free old buffer
-		free(s->devices);
-
-		// reassign new buffer to state 
-		s->devices = ptr;
+		IFV(CLVB_ERRORS) printf("%d:%s ERR: Could not allocate device ID: %u\n", gettid(), __FUNCTION__, did);
+		goto end;
 	}
 
 	STEP // 3: Duplicate key string into state object
+	free(s->devices[did].name);
 	s->devices[did].name = strdup(key);
 
 	STEP // 4: Run parse function for each entry in sub hash table
 	g_hash_table_foreach(ylo->ht, _parse_device, &s->devices[did]);	
 
+	// NUMA node of the memory space, kept in numa.c as the profile has no field for it
+	ylo_mld = (yl_obj_t*) g_hash_table_lookup(ylo->ht, "mld");
+	if (ylo_mld != NULL && ylo_mld->ht != NULL)
+	{
+		ylo_numa = (yl_obj_t*) g_hash_table_lookup(ylo_mld->ht, "numa");
+		if (ylo_numa != NULL && ylo_numa->str != NULL)
+			numa_set_device(key, atoi(ylo_numa->str));
+	}
+
 	if ( (did + 1 )> s->num_devices)
 		s->num_devices = did + 1;
 
@@ -1169,6 +2538,42 @@ void _parse_emulator(gpointer key, gpointer value, gpointer user_data)
 		opts[CLOP_TCP_PORT].set 					= 1;
 		opts[CLOP_TCP_PORT].u16 					= strtoull(ylo->str, NULL, 0);
 	}
+	else if (!strcmp(key, "connections")) {
+		opts[CLOP_CONNECTIONS].set 					= 1;
+		opts[CLOP_CONNECTIONS].u16 					= strtoul(ylo->str, NULL, 0);
+	}
+	else if (!strcmp(key, "threads")) {
+		opts[CLOP_THREADS].set 						= 1;
+		opts[CLOP_THREADS].u32 						= strtoul(ylo->str, NULL, 0);
+	}
+	else if (!strcmp(key, "hugepages")) {
+		rv = clhp_parse(ylo->str);
+		if (rv < 0) {
+			IFV(CLVB_ERRORS) printf("%d:%s ERR: Invalid huge page mode: %s\n", gettid(), __FUNCTION__, ylo->str);
+			rv = 1;
+			goto end;
+		}
+		opts[CLOP_HUGEPAGES].set 					= 1;
+		opts[CLOP_HUGEPAGES].u8 					= rv;
+	}
+	else if (!strcmp(key, "port-bw")) {
+		opts[CLOP_PORT_BW].set 						= 1;
+		opts[CLOP_PORT_BW].u32 						= strtoul(ylo->str, NULL, 0);
+	}
+	else if (!strcmp(key, "eid")) {
+		opts[CLOP_EID].set 							= 1;
+		opts[CLOP_EID].u8 							= strtoul(ylo->str, NULL, 0);
+	}
+	else if (!strcmp(key, "unix-socket")) {
+		free(opts[CLOP_UNIX_SOCKET].str);
+		opts[CLOP_UNIX_SOCKET].set 					= 1;
+		opts[CLOP_UNIX_SOCKET].str 					= strndup(ylo->str, CLMR_MAX_ARG_STR_LEN);
+	}
+	else if (!strcmp(key, "xfer-dir")) {
+		free(opts[CLOP_XFER_DIR].str);
+		opts[CLOP_XFER_DIR].set 					= 1;
+		opts[CLOP_XFER_DIR].str 					= strndup(ylo->str, CLMR_MAX_ARG_STR_LEN);
+	}
 	else if (!strcmp(key, "dir"))
 		s->dir 										= strdup(ylo->str);
 
@@ -1179,6 +2584,55 @@ end:
 	EXIT(rv)
 }
 
+/**
+ * Function to parse the listener keys of an entry of the switches section
+ *
+ * STEPS:
+ * 1: Verify the yaml loader object string is not NULL
+ * 2: Assign KV pairs to the switch 
+ */
+void _parse_switch_emulator(gpointer key, gpointer value, gpointer user_data)
+{
+	INIT
+	struct cse_switch *sw;
+	yl_obj_t *ylo;
+	int rv;
+
+	ENTER
+
+	// Initialize varialbes
+	rv = 1;
+	ylo = (yl_obj_t*) value;
+	sw = (struct cse_switch*) user_data;
+
+	STEP // 1: Verify the yaml loader object string is not NULL
+	if (ylo->str == NULL) 
+		goto end;
+
+	STEP // 2: Assign KV pairs to the switch 
+
+	IFV(CLVB_PARSE) printf("%d:%s Parsing Key: %s VAL: %s\n", gettid(), __FUNCTION__, (char*) key,  ylo->str);
+
+	if (!strcmp(key, "tcp-port"))
+		sw->tcp_port 								= strtoul(ylo->str, NULL, 0);
+	else if (!strcmp(key, "connections"))
+		sw->connections 							= strtoul(ylo->str, NULL, 0);
+	else if (!strcmp(key, "eid"))
+		sw->eid 									= strtoul(ylo->str, NULL, 0);
+	else if (!strcmp(key, "unix-socket")) {
+		free(sw->unix_socket);
+		sw->unix_socket 							= strndup(ylo->str, CLMR_MAX_ARG_STR_LEN);
+	}
+	else 
+		IFV(CLVB_ERRORS) printf("%d:%s WARN: Emulator key %s of switch %s only applies at the top level\n", gettid(), __FUNCTION__, (char*) key, sw->name);
+
+	rv = 0;
+
+end:
+
+	EXIT(rv)
+}
+
 /**
  * Function to parse switch entries in the hash table
  *
@@ -1226,9 +2680,6 @@ void _parse_switch(gpointer key, gpointer value, gpointer user_data)
 	else if (!strcmp(key, "mlw")) 				s->mlw 				= atoi(ylo->str);
 	else if (!strcmp(key, "speeds")) 			s->speeds 			= strtoul(ylo->str, NULL, 0);
 	else if (!strcmp(key, "mls"))			 	s->mls 				= atoi(ylo->str);
-	else if (!strcmp(key, "num_ports"))  		cxls_init_ports(s, atoi(ylo->str));
-	else if (!strcmp(key, "num_vcss"))     		cxls_init_vcss(s, atoi(ylo->str), s->num_vppbs);
-	else if (!strcmp(key, "num_vppbs"))    		cxls_init_vcss(s, s->num_vcss, atoi(ylo->str));
 
 	rv = 0;
 
@@ -1248,7 +2699,7 @@ void _parse_ports(gpointer key, gpointer value, gpointer user_data)
 {
 	INIT
 	yl_obj_t *ylo;
-	struct cxl_port *ports;
+	struct cxl_switch *s;
 	int rv, id;
 
 	ENTER
@@ -1256,7 +2707,7 @@ void _parse_ports(gpointer key, gpointer value, gpointer user_data)
 	// Initialize varialbes
 	rv = 1;
 	ylo = (yl_obj_t*) value;
-	ports = (struct cxl_port*) user_data;
+	s = (struct cxl_switch*) user_data;
 
 	STEP // 1: Verify the yaml loader object hash table is not NULL
 	if ( ylo->ht == NULL ) 
@@ -1264,10 +2715,15 @@ void _parse_ports(gpointer key, gpointer value, gpointer user_data)
 
 	STEP // 2: Call parse function for each port
 	id = atoi(key);
+	if (id < 0 || id >= s->num_ports)
+	{
+		IFV(CLVB_ERRORS) printf("%d:%s ERR: Port out of range: %d\n", gettid(), __FUNCTION__, id);
+		goto end;
+	}
 
 	IFV(CLVB_PARSE) printf("%d:%s Parsing Port: %d\n", gettid(), __FUNCTION__, id);
 
-	g_hash_table_foreach(ylo->ht, _parse_port, &ports[id]); 
+	g_hash_table_foreach(ylo->ht, _parse_port, &s->ports[id]); 
 
 	rv = 0;
 
@@ -1309,6 +2765,7 @@ void _parse_port(gpointer key, gpointer value, gpointer user_data)
 	else if (!strcmp(key, "mlw")) 	port->mlw 			= atoi(ylo->str);
 	else if (!strcmp(key, "mls")) 	port->mls 			= atoi(ylo->str);
 	else if (!strcmp(key, "state"))	port->state 		= strtoul(ylo->str, NULL, 0);
+	else if (!strcmp(key, "numa")) 	numa_set_port(port->ppid, atoi(ylo->str));
 
 	rv = 0;
 
@@ -1328,7 +2785,8 @@ void _parse_vcss(gpointer key, gpointer value, gpointer user_data)
 {
 	INIT
 	yl_obj_t *ylo;
-	struct cxl_vcs *vcss; 
+	struct cxl_switch *s; 
+	struct state_parse_vcs ctx;
 	int rv, id;
 
 	ENTER
@@ -1336,7 +2794,7 @@ void _parse_vcss(gpointer key, gpointer value, gpointer user_data)
 	// Initialize varialbes
 	rv = 1;
 	ylo = (yl_obj_t*) value;
-	vcss = (struct cxl_vcs*) user_data;
+	s = (struct cxl_switch*) user_data;
 
 	STEP // 1: Verify the yaml loader object hash table is not NULL
 	if ( ylo->ht == NULL ) 
@@ -1344,10 +2802,17 @@ void _parse_vcss(gpointer key, gpointer value, gpointer user_data)
 
 	STEP // 2: Call parse function for each vcs
 	id = atoi(key);
+	if (id < 0 || id >= s->num_vcss)
+	{
+		IFV(CLVB_ERRORS) printf("%d:%s ERR: VCS out of range: %d\n", gettid(), __FUNCTION__, id);
+		goto end;
+	}
 
 	IFV(CLVB_PARSE) printf("%d:%s Parsing VCS: %d\n", gettid(), __FUNCTION__, id);
 
-	g_hash_table_foreach(ylo->ht, _parse_vcs, &vcss[id]); 
+	ctx.s = s;
+	ctx.vcs = &s->vcss[id];
+	g_hash_table_foreach(ylo->ht, _parse_vcs, &ctx); 
 
 	rv = 0;
 
@@ -1367,13 +2832,15 @@ void _parse_vcs(gpointer key, gpointer value, gpointer user_data)
 {
 	INIT
 	yl_obj_t *ylo;
+	struct state_parse_vcs *ctx;
 	struct cxl_vcs *vcs;
 
 	ENTER
 
 	// Initialize varialbes
 	ylo = (yl_obj_t*) value;
-	vcs = (struct cxl_vcs*) user_data;
+	ctx = (struct state_parse_vcs*) user_data;
+	vcs = ctx->vcs;
 	
 	STEP // 1: Assign KV pairs to state variables 
 	if ( ylo->str != NULL )
@@ -1383,12 +2850,18 @@ void _parse_vcs(gpointer key, gpointer value, gpointer user_data)
 		if      (!strcmp(key, "state"))			vcs->state		= atoi(ylo->str);
 		else if (!strcmp(key, "uspid"))			vcs->uspid		= atoi(ylo->str);
 		else if (!strcmp(key, "num_vppb"))		vcs->num		= atoi(ylo->str);
+
+		if (vcs->num > ctx->s->num_vppbs)
+		{
+			IFV(CLVB_ERRORS) printf("%d:%s ERR: num_vppb %u exceeds num_vppbs %u\n", gettid(), __FUNCTION__, vcs->num, ctx->s->num_vppbs);
+			vcs->num = ctx->s->num_vppbs;
+		}
 	}
 
 	STEP // 2: Call parse function for vPPBs
 	if (ylo->ht != NULL) 
 	{
-		g_hash_table_foreach(ylo->ht, _parse_vppbs, vcs->vppbs); 
+		g_hash_table_foreach(ylo->ht, _parse_vppbs, ctx); 
 	}
 
 	EXIT(0)
@@ -1405,7 +2878,7 @@ void _parse_vppbs(gpointer key, gpointer value, gpointer user_data)
 {
 	INIT
 	yl_obj_t *ylo;
-	struct cxl_vppb *vppbs; 
+	struct state_parse_vcs *ctx; 
 	int rv, id;
 
 	ENTER
@@ -1413,7 +2886,7 @@ void _parse_vppbs(gpointer key, gpointer value, gpointer user_data)
 	// Initialize varialbes
 	rv = 1;
 	ylo = (yl_obj_t*) value;
-	vppbs = (struct cxl_vppb*) user_data;
+	ctx = (struct state_parse_vcs*) user_data;
 
 	STEP // 1: Verify the yaml loader object hash table is not NULL
 	if ( ylo->ht == NULL ) 
@@ -1421,10 +2894,15 @@ void _parse_vppbs(gpointer key, gpointer value, gpointer user_data)
 
 	STEP // 2: Call parse function for each vPPB
 	id = atoi(key);
+	if (id < 0 || id >= ctx->s->num_vppbs)
+	{
+		IFV(CLVB_ERRORS) printf("%d:%s ERR: vPPB out of range: %d\n", gettid(), __FUNCTION__, id);
+		goto end;
+	}
 
 	IFV(CLVB_PARSE) printf("%d:%s Parsing vPPB: %d", gettid(), __FUNCTION__, id);
 
-	g_hash_table_foreach(ylo->ht, _parse_vppb, &vppbs[id]); 
+	g_hash_table_foreach(ylo->ht, _parse_vppb, &ctx->vcs->vppbs[id]); 
 
 	rv = 0;
 
@@ -24,6 +24,10 @@
  */
 #include <pthread.h>
 
+/* struct pci_dev
+ */
+#include <pci/pci.h>
+
 #include <fmapi.h> 
 #include <cxlstate.h>
 
@@ -41,17 +45,112 @@
 #define MAX_FILE_NAME_LEN	256
 
 #define INITIAL_NUM_DEVICES 32
+#define MAX_DEVICES 		0xFFFF
+
+#define STATE_BIND_PORT 	0xFFFF 		//!< LDID that refers to the whole port
 
 /* ENUMERATIONS ==============================================================*/
 
+/**
+ * Objects that carry a generation counter (GEN)
+ */
+enum _STATE_GEN
+{
+	STATE_GEN_ALL 		= 0, 	//!< Bumped along with every other counter
+	STATE_GEN_ID 		= 1, 	//!< Switch identity and message limit
+	STATE_GEN_DEVICES 	= 2, 	//!< Device catalog
+	STATE_GEN_VCS 		= 3, 	//!< One Virtual CXL Switch and its vPPBs
+	STATE_GEN_PORT 		= 4, 	//!< One physical port and its MLD
+	STATE_GEN_MAX
+};
+
 /* STRUCTS ===================================================================*/
 
+/**
+ * Fine grained locks that protect the global switch state
+ *
+ * Lock ordering. When more than one lock is needed, obtain them in this order
+ * and release them in the reverse order:
+ * 1. cxls->mtx  Topology lock: device catalog and vPPB binding table
+ * 2. id         Switch identity, message limit and background operation fields
+ * 3. vcss[]     Virtual CXL Switch, lowest VCS ID first
+ * 4. ports[]    Physical port, lowest PPID first
+ */
+struct state_locks
+{
+	pthread_rwlock_t id;		//!< Read-mostly switch identity fields 
+	pthread_mutex_t *ports;		//!< One lock per physical port
+	pthread_mutex_t *vcss;		//!< One lock per Virtual CXL Switch
+	unsigned num_ports;			//!< Number of entries in ports[]
+	unsigned num_vcss;			//!< Number of entries in vcss[]
+};
+
+/**
+ * Reverse binding index entry. The vPPB a port or one of its LDs is bound to
+ */
+struct state_bind
+{
+	__u8 bound; 			//!< 1 if the port or LD is bound to a vPPB
+	__u8 vcsid;
+	__u16 vppbid;
+};
+
+/**
+ * Bindings of one physical port
+ */
+struct state_port_binds
+{
+	unsigned num; 					//!< Number of bound entries below
+	struct state_bind port; 		//!< Binding of the whole port
+	struct state_bind ld[MAX_LD]; 	//!< Binding of each LD of an MLD port
+};
+
 /* PROTOTYPES ================================================================*/
 
 int state_load(struct cxl_switch *s, char *filename);
+int state_reload(struct cxl_switch *s, char *filename);
+int state_load_switches(struct cxl_switch *base, char *filename);
+
+int state_pci_read(struct cxl_switch *s, struct pci_dev *dev, struct cxl_port *cp, unsigned *vppbid);
+void state_pci_apply(struct cxl_switch *s, struct cxl_port *cp, unsigned vppbid);
+int state_pci_find(struct cxl_switch *s, int domain, int bus, int dev, int func);
+void state_pci_clear(struct cxl_switch *s, unsigned ppid);
+
+__u8 *state_port_cfgspace(struct cxl_port *p, int alloc);
+__u8 *state_ld_cfgspace(struct cxl_port *p, unsigned ldid, int alloc);
+int state_ld_memrange(struct cxl_port *p, unsigned ldid, __u64 *base, __u64 *size);
+
+int state_devices_reserve(struct cxl_switch *s, unsigned num);
+int state_devices_index(struct cxl_switch *s);
+int state_device_find(const char *name);
+void state_devices_free();
+
+int state_binds_init(struct cxl_switch *s);
+void state_binds_free();
+void state_binds_add(unsigned vcsid, struct cxl_vppb *b);
+void state_binds_remove(struct cxl_vppb *b);
+int state_binds_busy(unsigned ppid, unsigned ldid);
+struct state_port_binds *state_binds_port(unsigned ppid);
+unsigned state_binds_num();
+
+int state_locks_init(struct cxl_switch *s);
+void state_locks_free();
+
+void state_lock_topology();
+void state_unlock_topology();
+void state_lock_id(int write);
+void state_unlock_id();
+void state_lock_vcs(unsigned vcsid);
+void state_unlock_vcs(unsigned vcsid);
+void state_lock_port(unsigned ppid);
+void state_unlock_port(unsigned ppid);
+
+__u64 state_gen(unsigned obj, unsigned id);
+void state_gen_bump(unsigned obj, unsigned id);
 
 /* GLOBAL VARIABLES ==========================================================*/
 
-extern struct cxl_switch *cxls;
+extern __thread struct cxl_switch *cxls;
+extern __thread unsigned cxls_id;
 
 #endif //ifndef _STATE_H
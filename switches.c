@@ -0,0 +1,255 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		switches.c
+ *
+ * @brief 		Code file for the switches hosted by one CSE process
+ *
+ * @details 	Each switch has its own struct cxl_switch, MCTP endpoint ID,
+ * 				FM connections, device catalog and section of the config 
+ * 				file. The worker pool and the logger are shared. The
+ * 				handlers reach the state of a switch through cxls, which is
+ * 				a per thread pointer. A thread selects a switch with
+ * 				switches_select() before it touches the state, and a thread
+ * 				that services a request selects the switch of the connection
+ * 				the request was received on with switches_enter(). The state
+ * 				modules keep their side tables, such as the locks and the
+ * 				memory spaces, per switch and index them with cxls_id.
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ */
+/* INCLUDES ==================================================================*/
+
+/* gettid()
+ */
+#define _GNU_SOURCE
+
+#include <unistd.h>
+
+/* printf()
+ */
+#include <stdio.h>
+
+/* strncpy()
+ */
+#include <string.h>
+
+/* free()
+ */
+#include <stdlib.h>
+
+/* pthread_mutex_t
+ */
+#include <pthread.h>
+
+#include <mctp.h>
+#include <cxlstate.h>
+
+#include "options.h"
+
+#include "trace.h"
+
+/* cxls
+ * cxls_id
+ */
+#include "state.h"
+
+#include "switches.h"
+
+/* MACROS ====================================================================*/
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/**
+ * An mctp instance and the switch its requests are for
+ */
+struct swlink
+{
+	struct mctp *m; 			//!< NULL if the entry is free
+	unsigned id;
+};
+
+/* PROTOTYPES ================================================================*/
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/**
+ * Hosted switches. Entries are only added before requests are serviced
+ */
+static struct cse_switch switches[SWLN_SWITCHES];
+static unsigned num_switches = 0;
+
+/**
+ * mctp instances attached to a switch
+ *
+ * Local FM connections attach and detach while requests are serviced, so an
+ * entry is published by an atomic store of m after its id is written and
+ * lookups need no lock. num_links is the high water mark of used entries
+ */
+static struct swlink links[SWLN_MCTP];
+static unsigned num_links = 0;
+static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Add a switch and select it on the calling thread
+ *
+ * @param s 	struct cxl_switch of the new switch
+ * @param name 	Key of its entry in the switches section, NULL for the first switch
+ * @return 		struct cse_switch* of the new switch. NULL if SWLN_SWITCHES are already hosted
+ */
+struct cse_switch *switches_add(struct cxl_switch *s, const char *name)
+{
+	struct cse_switch *sw;
+
+	if (s == NULL || num_switches >= SWLN_SWITCHES)
+		return NULL;
+
+	sw = &switches[num_switches];
+	memset(sw, 0, sizeof(*sw));
+	sw->id = num_switches;
+	sw->state = s;
+	if (name != NULL)
+		strncpy(sw->name, name, SWLN_NAME - 1);
+
+	num_switches++;
+
+	switches_select(sw->id);
+
+	return sw;
+}
+
+/**
+ * Return the number of hosted switches
+ */
+unsigned switches_num()
+{
+	return num_switches;
+}
+
+/**
+ * Return a hosted switch
+ *
+ * @return 	struct cse_switch* or NULL if id is out of range
+ */
+struct cse_switch *switches_get(unsigned id)
+{
+	if (id >= num_switches)
+		return NULL;
+
+	return &switches[id];
+}
+
+/**
+ * Make a switch the one cxls and cxls_id refer to on the calling thread
+ */
+void switches_select(unsigned id)
+{
+	if (id >= num_switches)
+		return;
+
+	cxls = switches[id].state;
+	cxls_id = id;
+}
+
+/**
+ * Record the switch the requests of an mctp instance are for
+ *
+ * @return 	0 upon success. Non zero otherwise
+ */
+int switches_attach(struct mctp *m, unsigned id)
+{
+	unsigned i;
+	int rv;
+
+	if (m == NULL || id >= num_switches)
+		return 1;
+
+	rv = 1;
+
+	pthread_mutex_lock(&mtx);
+	for ( i = 0 ; i < SWLN_MCTP ; i++ )
+	{
+		if (__atomic_load_n(&links[i].m, __ATOMIC_RELAXED) != NULL)
+			continue;
+
+		links[i].id = id;
+		__atomic_store_n(&links[i].m, m, __ATOMIC_RELEASE);
+		if (i >= num_links)
+			__atomic_store_n(&num_links, i + 1, __ATOMIC_RELEASE);
+		rv = 0;
+		break;
+	}
+	pthread_mutex_unlock(&mtx);
+
+	if (rv != 0)
+		IFV(CLVB_ERRORS) printf("%d:%s ERR: All %d mctp links in use\n", gettid(), __FUNCTION__, SWLN_MCTP);
+
+	return rv;
+}
+
+/**
+ * Forget the switch of an mctp instance. Call before mctp_free()
+ */
+void switches_detach(struct mctp *m)
+{
+	unsigned i;
+
+	pthread_mutex_lock(&mtx);
+	for ( i = 0 ; i < num_links ; i++ )
+		if (__atomic_load_n(&links[i].m, __ATOMIC_RELAXED) == m)
+			__atomic_store_n(&links[i].m, NULL, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&mtx);
+}
+
+/**
+ * Select the switch a request received on an mctp instance is for
+ *
+ * Called by every thread that services a request before it touches the
+ * state. An mctp instance that was never attached leaves the selection alone
+ */
+void switches_enter(struct mctp *m)
+{
+	unsigned i, num;
+
+	num = __atomic_load_n(&num_links, __ATOMIC_ACQUIRE);
+	for ( i = 0 ; i < num ; i++ )
+	{
+		if (__atomic_load_n(&links[i].m, __ATOMIC_ACQUIRE) == m)
+		{
+			switches_select(links[i].id);
+			return;
+		}
+	}
+}
+
+/**
+ * Forget all switches and links
+ *
+ * The struct cxl_switch of each switch is freed by the caller
+ */
+void switches_free()
+{
+	unsigned i;
+
+	for ( i = 0 ; i < num_switches ; i++ )
+	{
+		free(switches[i].unix_socket);
+		memset(&switches[i], 0, sizeof(struct cse_switch));
+	}
+	num_switches = 0;
+
+	pthread_mutex_lock(&mtx);
+	memset(links, 0, sizeof(links));
+	num_links = 0;
+	pthread_mutex_unlock(&mtx);
+
+	cxls = NULL;
+	cxls_id = 0;
+}
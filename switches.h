@@ -0,0 +1,76 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		switches.h
+ *
+ * @brief 		Header file for the switches hosted by one CSE process
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ * Macro / Enumeration Prefixes (SW)
+ * SWLN	- Switches Length (LN)
+ */
+#ifndef _SWITCHES_H
+#define _SWITCHES_H
+
+/* INCLUDES ==================================================================*/
+
+/* __u8
+ * __u16
+ */
+#include <linux/types.h>
+
+/* struct mctp
+ */
+#include <mctp.h>
+
+/* struct cxl_switch
+ */
+#include <cxlstate.h>
+
+/* CLMR_MAX_CONNECTIONS
+ */
+#include "options.h"
+
+/* MACROS ====================================================================*/
+
+#define SWLN_SWITCHES 		8 		//!< Max switches hosted by one process
+#define SWLN_NAME 			64 		//!< Max length of the name of a switch
+#define SWLN_MCTP 			192 	//!< Max mctp instances attached to switches, TCP and local
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/**
+ * One switch hosted by the process and its FM API listeners
+ */
+struct cse_switch
+{
+	unsigned id; 						//!< Index of the switch, the value of cxls_id
+	char name[SWLN_NAME]; 				//!< Key of its entry in the switches section, "" for the first switch
+	struct cxl_switch *state;
+	__u8 eid; 							//!< MCTP endpoint ID, 0 to keep the mctp default
+	__u16 tcp_port; 					//!< TCP port of the first connection, 0 to follow the previous switch
+	unsigned connections; 				//!< Simultaneous FM connections on consecutive TCP ports
+	char *unix_socket; 					//!< AF_UNIX socket of co-located FMs, NULL for none
+	struct mctp *m[CLMR_MAX_CONNECTIONS]; 	//!< One mctp instance per FM connection
+	unsigned running; 					//!< Entries of m[] that are listening
+};
+
+/* PROTOTYPES ================================================================*/
+
+struct cse_switch *switches_add(struct cxl_switch *s, const char *name);
+unsigned switches_num();
+struct cse_switch *switches_get(unsigned id);
+void switches_select(unsigned id);
+int switches_attach(struct mctp *m, unsigned id);
+void switches_detach(struct mctp *m);
+void switches_enter(struct mctp *m);
+void switches_free();
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+#endif //_SWITCHES_H
@@ -0,0 +1,248 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		trace.c
+ *
+ * @brief 		Code file for the per thread binary trace buffers
+ *
+ * @details 	Each thread that reaches a trace point allocates a ring of
+ * 				TRLN_RECORDS records on its first record and links it into a
+ * 				list. The ring is only ever written by its owner, so a record
+ * 				costs no lock and no shared cache line. trace_dump() walks the
+ * 				list from another thread, copies each ring and prints the
+ * 				records that were not overwritten while it copied. When a
+ * 				thread exits its ring is marked idle and is handed to the
+ * 				next new thread, so connections that come and go do not grow
+ * 				the list. The records of an exited thread can be dumped until
+ * 				its ring is reused. Rings are freed by trace_free().
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ */
+/* INCLUDES ==================================================================*/
+
+/* gettid()
+ */
+#define _GNU_SOURCE
+
+#include <unistd.h>
+
+/* fprintf()
+ */
+#include <stdio.h>
+
+/* memcpy()
+ */
+#include <string.h>
+
+/* calloc()
+ * malloc()
+ * free()
+ */
+#include <stdlib.h>
+
+/* pthread_once()
+ * pthread_key_create()
+ * pthread_setspecific()
+ */
+#include <pthread.h>
+
+#include "trace.h"
+
+/* MACROS ====================================================================*/
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/* PROTOTYPES ================================================================*/
+
+static void _trace_key_init();
+static void _trace_exit(void *arg);
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/**
+ * Ring of the calling thread, NULL until its first record
+ */
+__thread struct trace_ring *trace_ring = NULL;
+
+/**
+ * List of all rings, newest first
+ */
+static struct trace_ring *rings = NULL;
+
+/**
+ * Key whose destructor marks the ring of an exiting thread idle
+ */
+static pthread_key_t key;
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Give the calling thread a ring, reusing the ring of an exited thread
+ *
+ * @return 	The ring. NULL if none could be allocated
+ *
+ * STEPS
+ * 1: Claim an idle ring
+ * 2: Otherwise allocate one and add it to the list
+ * 3: Mark the ring idle when the thread exits
+ */
+struct trace_ring *trace_ring_new()
+{
+	struct trace_ring *r;
+	int idle;
+
+	pthread_once(&key_once, _trace_key_init);
+
+	// STEP 1: Claim an idle ring
+	for ( r = __atomic_load_n(&rings, __ATOMIC_ACQUIRE) ; r != NULL ; r = r->next )
+	{
+		idle = 1;
+		if (__atomic_compare_exchange_n(&r->idle, &idle, 0, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			break;
+	}
+
+	if (r != NULL)
+	{
+		r->tid = gettid();
+		__atomic_store_n(&r->head, 0, __ATOMIC_RELEASE);
+	}
+	else 
+	{
+		// STEP 2: Otherwise allocate one and add it to the list
+		r = calloc(1, sizeof(struct trace_ring));
+		if (r == NULL)
+			return NULL;
+
+		r->tid = gettid();
+
+		r->next = __atomic_load_n(&rings, __ATOMIC_RELAXED);
+		while (!__atomic_compare_exchange_n(&rings, &r->next, r, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+			;
+	}
+
+	// STEP 3: Mark the ring idle when the thread exits
+	pthread_setspecific(key, r);
+
+	trace_ring = r;
+
+	return r;
+}
+
+/**
+ * Create the key of the thread exit destructor
+ */
+static void _trace_key_init()
+{
+	pthread_key_create(&key, _trace_exit);
+}
+
+/**
+ * Thread exit destructor: hand the ring of the thread to the next new thread
+ *
+ * A record written by a later destructor of the same thread allocates a ring
+ * again, so the idle ring is never written by two threads
+ */
+static void _trace_exit(void *arg)
+{
+	struct trace_ring *r;
+
+	r = (struct trace_ring*) arg;
+	trace_ring = NULL;
+	__atomic_store_n(&r->idle, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Print the records held in all rings, oldest first per thread
+ *
+ * The owners keep writing while a ring is copied. Records older than the
+ * ring length behind the head read after the copy may have been overwritten
+ * and are skipped
+ *
+ * STEPS
+ * 1: Copy the ring
+ * 2: Drop the records overwritten during the copy
+ * 3: Print the records
+ */
+void trace_dump(FILE *fp)
+{
+	struct trace_ring *r;
+	struct trace_rec *copy, *e;
+	__u64 head, first, i;
+
+	copy = malloc(TRLN_RECORDS * sizeof(struct trace_rec));
+	if (copy == NULL)
+		return;
+
+	for ( r = __atomic_load_n(&rings, __ATOMIC_ACQUIRE) ; r != NULL ; r = r->next )
+	{
+		// STEP 1: Copy the ring
+		head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+		memcpy(copy, r->recs, TRLN_RECORDS * sizeof(struct trace_rec));
+
+		// STEP 2: Drop the records overwritten during the copy
+		first = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+		first = (first > TRLN_RECORDS) ? first - TRLN_RECORDS + 1 : 0;
+		if (first > head)
+			first = head;
+
+		fprintf(fp, "Trace thread %d%s: %llu records, %llu shown\n", r->tid, __atomic_load_n(&r->idle, __ATOMIC_RELAXED) ? " (exited)" : "", head, head - first);
+
+		// STEP 3: Print the records
+		for ( i = first ; i < head ; i++ )
+		{
+			e = &copy[i & (TRLN_RECORDS - 1)];
+			switch (e->type)
+			{
+				case TRTY_ENTER:
+					fprintf(fp, "%d:%llu:%s Enter\n", r->tid, e->tsc, e->fn);
+					break;
+
+				case TRTY_STEP:
+					fprintf(fp, "%d:%llu:%s STEP: %u\n", r->tid, e->tsc, e->fn, e->step);
+					break;
+
+				case TRTY_HEX32:
+					fprintf(fp, "%d:%llu:%s STEP: %u %s: 0x%x\n", r->tid, e->tsc, e->fn, e->step, e->msg, e->val);
+					break;
+
+				case TRTY_INT32:
+					fprintf(fp, "%d:%llu:%s STEP: %u %s: %d\n", r->tid, e->tsc, e->fn, e->step, e->msg, e->val);
+					break;
+
+				case TRTY_EXIT:
+					fprintf(fp, "%d:%llu:%s Exit: %d\n", r->tid, e->tsc, e->fn, e->val);
+					break;
+
+				default:
+					break;
+			}
+		}
+	}
+
+	fflush(fp);
+	free(copy);
+}
+
+/**
+ * Free all rings
+ *
+ * Only call once every thread that records has stopped
+ */
+void trace_free()
+{
+	struct trace_ring *r, *next;
+
+	for ( r = __atomic_exchange_n(&rings, NULL, __ATOMIC_ACQUIRE) ; r != NULL ; r = next )
+	{
+		next = r->next;
+		free(r);
+	}
+
+	trace_ring = NULL;
+}
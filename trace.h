@@ -0,0 +1,178 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		trace.h
+ *
+ * @brief 		Header file for the per thread binary trace buffers and the
+ * 				ENTER / STEP / EXIT trace macros shared by all code files
+ *
+ * @details 	With CSE_TRACE defined the macros append a fixed size record
+ * 				to a ring owned by the calling thread. Nothing is formatted or
+ * 				printed until the rings are dumped with trace_dump(), which
+ * 				cse does on SIGUSR1. With CSE_VERBOSE defined instead the
+ * 				macros print each call as they always did, gated by the
+ * 				CLVB_CALLSTACK and CLVB_STEPS verbosity bits. With neither
+ * 				defined they compile to nothing. CSE_TRACE is the Makefile
+ * 				default.
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ * Macro / Enumeration Prefixes (TR)
+ * TRLN	- Trace Length (LN)
+ * TRTY	- Trace Record Type (TY)
+ */
+#ifndef _TRACE_H
+#define _TRACE_H
+
+/* INCLUDES ==================================================================*/
+
+/* __u16
+ * __u64
+ */
+#include <linux/types.h>
+
+/* FILE
+ */
+#include <stdio.h>
+
+/* clock_gettime()
+ */
+#include <time.h>
+
+/* opts[]
+ */
+#include "options.h"
+
+/* MACROS ====================================================================*/
+
+#define TRLN_RECORDS 		4096 	//!< Records kept per thread, must be a power of 2
+
+#ifdef CSE_TRACE
+ #define INIT 			unsigned step = 0;
+ #define ENTER 					trace_record(TRTY_ENTER, 	__FUNCTION__, 0, 	NULL, 0);
+ #define STEP 			step++; trace_record(TRTY_STEP, 	__FUNCTION__, step, NULL, 0);
+ #define HEX32(m, i)			trace_record(TRTY_HEX32, 	__FUNCTION__, step, m, 	i);
+ #define INT32(m, i)			trace_record(TRTY_INT32, 	__FUNCTION__, step, m, 	i);
+ #define EXIT(rc) 				trace_record(TRTY_EXIT, 	__FUNCTION__, 0, 	NULL, rc);
+#elif defined CSE_VERBOSE
+ #define INIT 			unsigned step = 0;
+ #define ENTER 					if (opts[CLOP_VERBOSITY].u64 & CLVB_CALLSTACK) 	printf("%d:%s Enter\n", 			gettid(), __FUNCTION__);
+ #define STEP 			step++; if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u\n", 			gettid(), __FUNCTION__, step);
+ #define HEX32(m, i)			if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u %s: 0x%x\n",	gettid(), __FUNCTION__, step, m, i);
+ #define INT32(m, i)			if (opts[CLOP_VERBOSITY].u64 & CLVB_STEPS) 		printf("%d:%s STEP: %u %s: %d\n",	gettid(), __FUNCTION__, step, m, i);
+ #define EXIT(rc) 				if (opts[CLOP_VERBOSITY].u64 & CLVB_CALLSTACK) 	printf("%d:%s Exit: %d\n", 			gettid(), __FUNCTION__,rc);
+#else
+ #define ENTER
+ #define EXIT(rc)
+ #define STEP
+ #define HEX32(m, i)
+ #define INT32(m, i)
+ #define INIT
+#endif // CSE_TRACE
+
+#define IFV(u) 							if (opts[CLOP_VERBOSITY].u64 & u)
+
+/* ENUMERATIONS ==============================================================*/
+
+/**
+ * Trace record type (TY)
+ */
+enum _TRTY
+{
+	TRTY_ENTER 	= 0,
+	TRTY_STEP 	= 1,
+	TRTY_HEX32 	= 2,
+	TRTY_INT32 	= 3,
+	TRTY_EXIT 	= 4,
+	TRTY_MAX
+};
+
+/* STRUCTS ===================================================================*/
+
+/**
+ * Trace record
+ *
+ * Function names and messages are string literals, so their addresses
+ * identify them and are only turned back into text by trace_dump()
+ */
+struct trace_rec
+{
+	__u64 tsc; 				//!< Time stamp counter when the record was written
+	const char *fn; 		//!< Function name
+	const char *msg; 		//!< Message of a HEX32 / INT32 record, NULL otherwise
+	int val; 				//!< Value of a HEX32 / INT32 record, return code of an EXIT record
+	__u16 step;
+	__u16 type; 			//!< enum _TRTY
+};
+
+/**
+ * Ring of trace records written by a single thread
+ */
+struct trace_ring
+{
+	struct trace_ring *next; 	//!< Next ring in the list walked by trace_dump()
+	int tid;
+	int idle; 					//!< 1 once the thread exited and the ring can be reused
+	__u64 head; 				//!< Number of records written by the thread
+	struct trace_rec recs[TRLN_RECORDS];
+};
+
+/* PROTOTYPES ================================================================*/
+
+struct trace_ring *trace_ring_new();
+void trace_dump(FILE *fp);
+void trace_free();
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+extern __thread struct trace_ring *trace_ring;
+
+/* INLINE FUNCTIONS ==========================================================*/
+
+/**
+ * Read the time stamp counter, or the monotonic clock where there is none
+ */
+static inline __u64 trace_tsc()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+/**
+ * Append a record to the ring of the calling thread
+ *
+ * Inline so a trace point costs a counter read and a few stores. Only the
+ * first record of a thread calls into trace.c to allocate its ring
+ */
+static inline void trace_record(unsigned type, const char *fn, unsigned step, const char *msg, int val)
+{
+	struct trace_ring *r;
+	struct trace_rec *e;
+
+	r = trace_ring;
+	if (r == NULL)
+	{
+		r = trace_ring_new();
+		if (r == NULL)
+			return;
+	}
+
+	e = &r->recs[r->head & (TRLN_RECORDS - 1)];
+	e->tsc 	= trace_tsc();
+	e->fn 	= fn;
+	e->msg 	= msg;
+	e->val 	= val;
+	e->step = step;
+	e->type = type;
+
+	__atomic_store_n(&r->head, r->head + 1, __ATOMIC_RELEASE);
+}
+
+#endif //_TRACE_H
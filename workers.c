@@ -0,0 +1,378 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		workers.c
+ *
+ * @brief 		Code file for the pool of threads that execute API requests
+ *
+ * @details 	The MCTP library calls the registered message handlers from a
+ * 				single thread. When a worker pool is configured, the handlers
+ * 				hand each mctp_action to one of the workers instead of
+ * 				servicing it inline. A request is always assigned to a worker
+ * 				based upon its source EID and MCTP tag so requests that share a
+ * 				tag are serviced, and their responses pushed onto m->tmq, in the
+ * 				order they were received.
+ *
+ * 				When ports are placed on NUMA nodes each worker is pinned to
+ * 				a node, round robin over the nodes of the host. A request that
+ * 				names a node is assigned among the workers of that node by the
+ * 				same key, so the order of requests that share a tag is kept
+ * 				among the requests for one node.
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ */
+/* INCLUDES ==================================================================*/
+
+/* gettid()
+ */
+#define _GNU_SOURCE
+
+#include <unistd.h>
+
+/* printf()
+ */
+#include <stdio.h>
+
+/* calloc()
+ * free()
+ */
+#include <stdlib.h>
+
+/* memset()
+ */
+#include <string.h>
+
+/* pthread_create()
+ * pthread_mutex_t
+ * pthread_cond_t
+ */
+#include <pthread.h>
+
+#include <mctp.h>
+
+#include "options.h"
+
+#include "trace.h"
+
+#include "workers.h"
+
+#include "numa.h"
+
+/* cxls_id
+ */
+#include "state.h"
+
+/* switches_select()
+ */
+#include "switches.h"
+
+/* MACROS ====================================================================*/
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/**
+ * A request waiting to be serviced by a worker
+ */
+struct work
+{
+	struct mctp *m;
+	struct mctp_action *ma;
+	worker_fn fn;
+	unsigned sw; 				//!< Switch selected by the submitter [cxls_id]
+};
+
+/**
+ * A worker thread and its request queue
+ */
+struct worker
+{
+	pthread_t thread;
+	pthread_mutex_t mtx;
+	pthread_cond_t not_empty;
+	pthread_cond_t not_full;
+	struct work queue[WKLN_QUEUE];
+	unsigned head; 				//!< Index of next entry to service
+	unsigned count;				//!< Number of entries in the queue
+	unsigned max; 				//!< High water mark of count
+	int stop; 					//!< Set to 1 to request the thread to exit
+	int node; 					//!< NUMA node the thread is pinned to, -1 for none
+};
+
+/* PROTOTYPES ================================================================*/
+
+static void *workers_run(void *arg);
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+/**
+ * Array of worker threads
+ */
+static struct worker *workers = NULL;
+
+/**
+ * Number of entries in workers[]
+ */
+static unsigned num_workers = 0;
+
+/**
+ * Indexes in workers[] of the workers pinned to each NUMA node
+ */
+static unsigned node_workers[NULN_NODES][WKLN_MAX_THREADS];
+static unsigned node_num[NULN_NODES];
+
+/* FUNCTIONS =================================================================*/
+
+/**
+ * Start the pool of worker threads
+ *
+ * @param num 	Number of threads. 0 disables the pool and requests are
+ * 				serviced inline on the MCTP handler thread
+ * @return 		0 upon success. Non zero otherwise
+ *
+ * STEPS
+ * 1: Validate inputs
+ * 2: Allocate workers
+ * 3: Assign workers to NUMA nodes
+ * 4: Start threads
+ */
+int workers_init(unsigned num)
+{
+	INIT
+	int rv;
+	unsigned i, k;
+	int node;
+
+	ENTER
+
+	// Initialize variables
+	rv = 1;
+
+	STEP // 1: Validate inputs
+	if (num == 0)
+	{
+		rv = 0;
+		goto end;
+	}
+	if (num > WKLN_MAX_THREADS)
+		num = WKLN_MAX_THREADS;
+
+	STEP // 2: Allocate workers
+	workers = calloc(num, sizeof(struct worker));
+	if (workers == NULL)
+		goto end;
+
+	STEP // 3: Assign workers to NUMA nodes
+	memset(node_num, 0, sizeof(node_num));
+	node = -1;
+	for ( i = 0 ; i < num ; i++ )
+	{
+		workers[i].node = -1;
+		if (!numa_used())
+			continue;
+
+		// Next node of the host after the previous worker's
+		for ( k = 0 ; k < NULN_NODES ; k++ )
+		{
+			node = (node + 1) % NULN_NODES;
+			if (numa_present(node))
+				break;
+		}
+		workers[i].node = node;
+	}
+
+	STEP // 4: Start threads
+	for ( i = 0 ; i < num ; i++ )
+	{
+		pthread_mutex_init(&workers[i].mtx, NULL);
+		pthread_cond_init(&workers[i].not_empty, NULL);
+		pthread_cond_init(&workers[i].not_full, NULL);
+
+		if (pthread_create(&workers[i].thread, NULL, workers_run, &workers[i]) != 0)
+		{
+			IFV(CLVB_ERRORS) printf("%d:%s ERR: Could not start worker thread %u\n", gettid(), __FUNCTION__, i);
+			break;
+		}
+		num_workers++;
+
+		if (workers[i].node >= 0)
+			node_workers[workers[i].node][node_num[workers[i].node]++] = i;
+	}
+
+	if (num_workers == 0)
+	{
+		free(workers);
+		workers = NULL;
+		goto end;
+	}
+
+	IFV(CLVB_GENERAL) printf("%d:%s Started %u worker threads\n", gettid(), __FUNCTION__, num_workers);
+
+	rv = 0;
+
+end:
+
+	EXIT(rv)
+
+	return rv;
+}
+
+/**
+ * Stop the worker threads and free the pool
+ *
+ * Requests still in a queue are serviced before the thread exits
+ */
+void workers_free()
+{
+	unsigned i;
+
+	for ( i = 0 ; i < num_workers ; i++ )
+	{
+		pthread_mutex_lock(&workers[i].mtx);
+		workers[i].stop = 1;
+		pthread_cond_signal(&workers[i].not_empty);
+		pthread_mutex_unlock(&workers[i].mtx);
+	}
+
+	for ( i = 0 ; i < num_workers ; i++ )
+	{
+		pthread_join(workers[i].thread, NULL);
+		pthread_cond_destroy(&workers[i].not_full);
+		pthread_cond_destroy(&workers[i].not_empty);
+		pthread_mutex_destroy(&workers[i].mtx);
+	}
+
+	free(workers);
+	workers = NULL;
+	num_workers = 0;
+	memset(node_num, 0, sizeof(node_num));
+}
+
+/**
+ * Return the number of running worker threads
+ */
+unsigned workers_num()
+{
+	return num_workers;
+}
+
+/**
+ * Return the high water mark of the request queue of a worker thread
+ *
+ * @param i 	Index of the worker 
+ * @return 		Largest number of requests queued at once, 0 if i is out of range
+ */
+unsigned workers_max(unsigned i)
+{
+	unsigned rv;
+
+	if (i >= num_workers)
+		return 0;
+
+	pthread_mutex_lock(&workers[i].mtx);
+	rv = workers[i].max;
+	pthread_mutex_unlock(&workers[i].mtx);
+
+	return rv;
+}
+
+/**
+ * Hand a request to a worker thread
+ *
+ * The worker is selected from the source EID and tag of the request so that
+ * requests which share a tag are serviced in order. Blocks if the queue of the
+ * selected worker is full. The worker services the request on the switch
+ * selected by the calling thread.
+ *
+ * @param m 	struct mctp* the request was received on
+ * @param ma 	struct mctp_action* holding the request
+ * @param fn 	Function the worker calls to service the request
+ * @param node 	NUMA node to service the request on, -1 for any worker
+ * @return 		0 upon success, 1 otherwise
+ */
+int workers_submit(struct mctp *m, struct mctp_action *ma, worker_fn fn, int node)
+{
+	struct worker *w;
+	unsigned key;
+
+	if (num_workers == 0 || ma == NULL || ma->req == NULL)
+		return 1;
+
+	key = ((unsigned) ma->req->src << 3) | (ma->req->tag & 0x07);
+	if (node >= 0 && node < NULN_NODES && node_num[node] > 0)
+		w = &workers[node_workers[node][key % node_num[node]]];
+	else
+		w = &workers[key % num_workers];
+
+	pthread_mutex_lock(&w->mtx);
+
+	while (w->count >= WKLN_QUEUE && w->stop == 0)
+		pthread_cond_wait(&w->not_full, &w->mtx);
+
+	if (w->stop)
+	{
+		pthread_mutex_unlock(&w->mtx);
+		return 1;
+	}
+
+	w->queue[(w->head + w->count) % WKLN_QUEUE] = (struct work) { m, ma, fn, cxls_id };
+	w->count++;
+	if (w->count > w->max)
+		w->max = w->count;
+
+	pthread_cond_signal(&w->not_empty);
+	pthread_mutex_unlock(&w->mtx);
+
+	return 0;
+}
+
+/**
+ * Worker thread main loop
+ *
+ * STEPS
+ * 1: Wait for a request
+ * 2: Remove request from queue
+ * 3: Select the switch of the request and service it
+ */
+static void *workers_run(void *arg)
+{
+	struct worker *w;
+	struct work wk;
+
+	w = (struct worker*) arg;
+
+	if (w->node >= 0 && numa_pin(w->node) != 0)
+		IFV(CLVB_ERRORS) printf("%d:%s WARN: Could not pin worker to NUMA node %d\n", gettid(), __FUNCTION__, w->node);
+
+	while (1)
+	{
+		// STEP 1: Wait for a request
+		pthread_mutex_lock(&w->mtx);
+		while (w->count == 0 && w->stop == 0)
+			pthread_cond_wait(&w->not_empty, &w->mtx);
+
+		if (w->count == 0 && w->stop)
+		{
+			pthread_mutex_unlock(&w->mtx);
+			break;
+		}
+
+		// STEP 2: Remove request from queue
+		wk = w->queue[w->head];
+		w->head = (w->head + 1) % WKLN_QUEUE;
+		w->count--;
+
+		pthread_cond_signal(&w->not_full);
+		pthread_mutex_unlock(&w->mtx);
+
+		// STEP 3: Select the switch of the request and service it
+		switches_select(wk.sw);
+		wk.fn(wk.m, wk.ma);
+	}
+
+	return NULL;
+}
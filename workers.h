@@ -0,0 +1,49 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/**
+ * @file 		workers.h
+ *
+ * @brief 		Header file for the pool of threads that execute API requests
+ *
+ * @copyright 	Copyright (C) 2024 Jackrabbit Founders LLC. All rights reserved.
+ *
+ * @date 		Jan 2024
+ * @author 		Barrett Edwards <code@jrlabs.io>
+ *
+ * Macro / Enumeration Prefixes (WK)
+ * WKLN	- Worker Length (LN)
+ */
+#ifndef _WORKERS_H
+#define _WORKERS_H
+
+/* INCLUDES ==================================================================*/
+
+/* struct mctp
+ * struct mctp_action
+ */
+#include <mctp.h>
+
+/* MACROS ====================================================================*/
+
+#define WKLN_MAX_THREADS 	64 		//!< Maximum number of worker threads
+#define WKLN_QUEUE 			256		//!< Depth of the request queue of each worker
+
+/* ENUMERATIONS ==============================================================*/
+
+/* STRUCTS ===================================================================*/
+
+/**
+ * Function that a worker calls to service a request
+ */
+typedef int (*worker_fn)(struct mctp *m, struct mctp_action *ma);
+
+/* PROTOTYPES ================================================================*/
+
+int workers_init(unsigned num);
+void workers_free();
+unsigned workers_num();
+unsigned workers_max(unsigned i);
+int workers_submit(struct mctp *m, struct mctp_action *ma, worker_fn fn, int node);
+
+/* GLOBAL VARIABLES ==========================================================*/
+
+#endif //_WORKERS_H